@@ -7,29 +7,325 @@
 #include <pybind11/stl.h>                 // STL container bindings
 #include <pybind11/iostream.h>            // Redirecting C++ streams to Python
 
+#include <chrono>
+#include <concepts>
+#include <functional>
+#include <future>
+#include <optional>
+
 #include "WooWooAnalyzer.h"
+#include "lsp/LSPJson.h"
+#include "utils/CancellationToken.h"
 
 namespace py = pybind11;
 
+// owns the encoded tokens a memoryview handed to Python points to
+struct TokenBuffer {
+    std::vector<uint32_t> values;
+};
+
+namespace pybind11::detail {
+    /**
+     * Semantic tokens go to Python as a read-only memoryview (format "I") over the vector they were encoded to,
+     * instead of a list of Python ints. Any sequence of ints (a list, a memoryview) is accepted back.
+     */
+    template<>
+    struct type_caster<SemanticTokensData> {
+    public:
+        PYBIND11_TYPE_CASTER(SemanticTokensData, const_name("memoryview"));
+
+        bool load(handle src, bool convert) {
+            make_caster<std::vector<uint32_t>> values;
+            if (!values.load(src, convert)) return false;
+            value.values = cast_op<std::vector<uint32_t> &&>(std::move(values));
+            return true;
+        }
+
+        static handle cast(SemanticTokensData src, return_value_policy, handle) {
+            object buffer = pybind11::cast(TokenBuffer{std::move(src.values)});
+            // the memoryview keeps the buffer alive
+            return PyMemoryView_FromObject(buffer.ptr());
+        }
+    };
+}
+
+/**
+ * Result of a request running on the background thread of the analyzer.
+ * The result is converted to a Python object only when it is collected, on the calling thread.
+ */
+class PendingResult {
+public:
+    template<typename T>
+    static PendingResult of(std::future<T> future, CancellationToken token = CancellationToken()) {
+        std::shared_future<T> shared = future.share();
+        PendingResult pending;
+        pending.token = std::move(token);
+        pending.isDone = [shared]() {
+            return shared.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+        pending.wait = [shared]() { shared.wait(); };
+        pending.collect = [shared]() -> py::object {
+            if constexpr (std::is_void_v<T>) {
+                shared.get();
+                return py::none();
+            } else {
+                return py::cast(shared.get());
+            }
+        };
+        return pending;
+    }
+
+    [[nodiscard]] bool done() const {
+        return isDone();
+    }
+
+    // a cancelled request raises RequestCancelled from result() (unless it has already finished)
+    void cancel() {
+        token.cancel();
+    }
+
+    // waits (without holding the GIL) for the request to finish, rethrows its exception
+    py::object result() const {
+        {
+            py::gil_scoped_release release;
+            wait();
+        }
+        return collect();
+    }
+
+private:
+    CancellationToken token;
+    std::function<bool()> isDone;
+    std::function<void()> wait;
+    std::function<py::object()> collect;
+};
+
+// results which can be returned as the JSON of the protocol (see LSPJson.h)
+template<typename T>
+concept JsonEncodable = requires(const T &value) {
+    { lsp::toJson(value) } -> std::same_as<std::string>;
+};
+
+// the result encoded without the GIL, only the finished JSON is copied into a Python object
+template<typename Request>
+py::bytes jsonResult(Request &&request) {
+    std::string json;
+    {
+        py::gil_scoped_release release;
+        json = lsp::toJson(request());
+    }
+    return py::bytes(json);
+}
+
+/**
+ * Binds the method as "name" (blocking, without holding the GIL) and as "name_async" (in the background),
+ * both of them recorded while the analyzer records the session.
+ * Methods whose result has an LSP JSON encoding are bound as "name_json" too, returning it as bytes.
+ * Cancellable requests take an optional CancellationToken as the last argument
+ * and their pending results can be cancelled.
+ */
+template<typename Result, typename... Args>
+void defRequest(py::class_<WooWooAnalyzer> &analyzer, const char *name, Result (WooWooAnalyzer::*method)(Args...),
+                bool cancellable) {
+    std::string asyncName = std::string(name) + "_async";
+    analyzer.def(name, [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args) {
+        return self.traced(name, method, args...);
+    }, py::call_guard<py::gil_scoped_release>());
+    analyzer.def(asyncName.c_str(), [name, method, cancellable](WooWooAnalyzer &self, std::decay_t<Args>... args) {
+        CancellationToken token;
+        return PendingResult::of(self.submit([&self, name, method, cancellable, token, args...]() mutable {
+            std::optional<CancellationScope> scope;
+            if (cancellable) scope.emplace(token);
+            return self.traced(name, method, args...);
+        }), token);
+    }, py::keep_alive<0, 1>());
+    std::string jsonName = std::string(name) + "_json";
+    if constexpr (JsonEncodable<Result>) {
+        analyzer.def(jsonName.c_str(), [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args) {
+            return jsonResult([&]() { return self.traced(name, method, args...); });
+        });
+    }
+
+    if (!cancellable) return;
+
+    analyzer.def(name, [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args,
+                                      const CancellationToken &token) {
+        CancellationScope scope(token);
+        return self.traced(name, method, args...);
+    }, py::call_guard<py::gil_scoped_release>());
+    analyzer.def(asyncName.c_str(), [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args,
+                                                   const CancellationToken &token) {
+        return PendingResult::of(self.submit([&self, name, method, token, args...]() mutable {
+            CancellationScope scope(token);
+            return self.traced(name, method, args...);
+        }), token);
+    }, py::keep_alive<0, 1>());
+    if constexpr (JsonEncodable<Result>) {
+        analyzer.def(jsonName.c_str(), [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args,
+                                                      const CancellationToken &token) {
+            return jsonResult([&]() {
+                CancellationScope scope(token);
+                return self.traced(name, method, args...);
+            });
+        });
+    }
+}
+
+// binds a setter which has to be replayed with the requests (the dialect, the token legend) as a traced method
+template<typename... Args>
+void defTracedSetter(py::class_<WooWooAnalyzer> &analyzer, const char *name,
+                     void (WooWooAnalyzer::*method)(Args...)) {
+    analyzer.def(name, [name, method](WooWooAnalyzer &self, std::decay_t<Args>... args) {
+        self.traced(name, method, args...);
+    }, py::call_guard<py::gil_scoped_release>());
+}
+
 PYBIND11_MODULE(wuff, m) {
-    py::class_<WooWooAnalyzer>(m, "WooWooAnalyzer")
+    py::register_exception<RequestCancelled>(m, "RequestCancelled");
+
+    m.def("compile_dialect", &DialectManager::compileDialect, py::arg("dialect_path"), py::arg("image_path") = "",
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<CancellationToken>(m, "CancellationToken")
             .def(py::init<>())
-            .def("set_dialect", &WooWooAnalyzer::setDialect)
-            .def("load_workspace", &WooWooAnalyzer::loadWorkspace)
-            .def("hover", &WooWooAnalyzer::hover)
-            .def("semantic_tokens", &WooWooAnalyzer::semanticTokens)
-            .def("go_to_definition", &WooWooAnalyzer::goToDefinition)
-            .def("complete", &WooWooAnalyzer::complete)
-            .def("references", &WooWooAnalyzer::references)
-            .def("rename", &WooWooAnalyzer::rename)
-            .def("folding_ranges", &WooWooAnalyzer::foldingRanges)
-            .def("document_did_change", &WooWooAnalyzer::documentDidChange)
-            .def("open_document", &WooWooAnalyzer::openDocument)
-            .def("rename_files", &WooWooAnalyzer::renameFiles)
-            .def("did_delete_files", &WooWooAnalyzer::didDeleteFiles)
-            .def("diagnose", &WooWooAnalyzer::diagnose)
-            .def("set_token_types", &WooWooAnalyzer::setTokenTypes)
-            .def("set_token_modifiers", &WooWooAnalyzer::setTokenModifiers);
+            .def("cancel", &CancellationToken::cancel)
+            .def("set_timeout", &CancellationToken::setTimeout)
+            .def("is_cancelled", &CancellationToken::isCancelled);
+
+    py::class_<TokenBuffer>(m, "TokenBuffer", py::buffer_protocol())
+            .def_buffer([](TokenBuffer &buffer) {
+                return py::buffer_info(buffer.values.data(), sizeof(uint32_t), py::format_descriptor<uint32_t>::format(),
+                                       1, {buffer.values.size()}, {sizeof(uint32_t)}, true);
+            });
+
+    py::class_<LoadProgress>(m, "LoadProgress")
+            .def_readonly("discovered", &LoadProgress::discovered)
+            .def_readonly("parsed", &LoadProgress::parsed)
+            .def_readonly("indexed", &LoadProgress::indexed)
+            .def_readonly("done", &LoadProgress::done);
+
+    py::class_<DocumentMemoryUsage>(m, "DocumentMemoryUsage")
+            .def_readonly("uri", &DocumentMemoryUsage::uri)
+            .def_readonly("materialized", &DocumentMemoryUsage::materialized)
+            .def_readonly("source", &DocumentMemoryUsage::source)
+            .def_readonly("tree", &DocumentMemoryUsage::tree)
+            .def_readonly("meta_trees", &DocumentMemoryUsage::metaTrees)
+            .def_readonly("utf_mappings", &DocumentMemoryUsage::utfMappings)
+            .def_readonly("comment_lines", &DocumentMemoryUsage::commentLines)
+            .def_readonly("index", &DocumentMemoryUsage::index)
+            .def_property_readonly("total", &DocumentMemoryUsage::total);
+
+    py::class_<MemoryUsage>(m, "MemoryUsage")
+            .def_readonly("documents", &MemoryUsage::documents)
+            .def_readonly("subsystems", &MemoryUsage::subsystems)
+            .def_readonly("total", &MemoryUsage::total);
+
+    py::class_<PendingResult>(m, "PendingResult")
+            .def("done", &PendingResult::done)
+            .def("cancel", &PendingResult::cancel)
+            .def("result", &PendingResult::result);
+
+    // opaque, continued by next_references or next_rename_edits
+    py::class_<ReferenceSearch>(m, "ReferenceSearch")
+            .def("done", &ReferenceSearch::done);
+
+    py::class_<WooWooAnalyzer> analyzer(m, "WooWooAnalyzer");
+    analyzer.def(py::init<>())
+            .def("set_thread_pool_size", &WooWooAnalyzer::setThreadPoolSize, py::call_guard<py::gil_scoped_release>())
+            .def("set_cache_directory", &WooWooAnalyzer::setCacheDirectory, py::call_guard<py::gil_scoped_release>())
+            .def("set_memory_budget", &WooWooAnalyzer::setMemoryBudget, py::call_guard<py::gil_scoped_release>())
+            .def("set_idle_eviction", &WooWooAnalyzer::setIdleEviction, py::arg("idle_ms"),
+                 py::call_guard<py::gil_scoped_release>())
+            .def("start_background_diagnostics", &WooWooAnalyzer::startBackgroundDiagnostics,
+                 py::arg("delay_ms") = 200, py::call_guard<py::gil_scoped_release>())
+            // diagnostics are taken by the server instead of a callback, no Python code runs on the scheduler thread
+            .def("take_diagnostics", &WooWooAnalyzer::takeDiagnostics, py::arg("timeout_ms") = 0,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("queue_depths", &WooWooAnalyzer::queueDepths, py::call_guard<py::gil_scoped_release>())
+            .def("load_progress", &WooWooAnalyzer::loadProgress)
+            .def("memory_usage", &WooWooAnalyzer::memoryUsage, py::call_guard<py::gil_scoped_release>())
+            .def("set_large_file_mode", &WooWooAnalyzer::setLargeFileMode, py::arg("threshold_bytes"),
+                 py::arg("parse_budget_ms") = 50, py::call_guard<py::gil_scoped_release>())
+            .def("set_viewport", &WooWooAnalyzer::setViewport, py::call_guard<py::gil_scoped_release>())
+            .def("is_partial", &WooWooAnalyzer::isPartial, py::call_guard<py::gil_scoped_release>())
+            .def("workspace_folders", &WooWooAnalyzer::workspaceFolders, py::call_guard<py::gil_scoped_release>())
+            .def("start_references", &WooWooAnalyzer::startReferences, py::call_guard<py::gil_scoped_release>())
+            .def("next_references", &WooWooAnalyzer::nextReferences, py::arg("search"), py::arg("limit") = 256,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("next_rename_edits", &WooWooAnalyzer::nextRenameEdits, py::arg("search"), py::arg("new_name"),
+                 py::arg("limit") = 256, py::call_guard<py::gil_scoped_release>())
+            // the counters by name, and "timers": latencies in milliseconds by request or stage
+            .def("get_stats", [](const WooWooAnalyzer &) {
+                py::dict stats;
+                for (const auto &[name, value]: WooWooAnalyzer::getStats()) {
+                    stats[py::str(name)] = value;
+                }
+                py::dict timers;
+                auto ms = [](uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1e6; };
+                for (const auto &[name, timer]: WooWooAnalyzer::getTimerStats()) {
+                    py::dict summary;
+                    summary["count"] = timer.count;
+                    summary["total_ms"] = ms(timer.total);
+                    summary["mean_ms"] = ms(timer.total / timer.count);
+                    summary["p50_ms"] = ms(timer.p50);
+                    summary["p90_ms"] = ms(timer.p90);
+                    summary["p99_ms"] = ms(timer.p99);
+                    summary["max_ms"] = ms(timer.max);
+                    timers[py::str(name)] = summary;
+                }
+                stats["timers"] = timers;
+                return stats;
+            })
+            .def("get_stats_prometheus", [](const WooWooAnalyzer &) { return WooWooAnalyzer::getPrometheusStats(); })
+            .def("start_span_tracing", [](const WooWooAnalyzer &, size_t maxEventsPerThread) {
+                WooWooAnalyzer::startSpanTracing(maxEventsPerThread);
+            }, py::arg("max_events_per_thread") = 1000000)
+            .def("stop_span_tracing", [](const WooWooAnalyzer &) { WooWooAnalyzer::stopSpanTracing(); })
+            // Chrome Trace Event JSON, opens in chrome://tracing and in Perfetto
+            .def("write_span_trace", [](const WooWooAnalyzer &, const std::string &tracePath) {
+                WooWooAnalyzer::writeSpanTrace(tracePath);
+            }, py::arg("trace_path"), py::call_guard<py::gil_scoped_release>())
+            .def("get_span_trace", [](const WooWooAnalyzer &) { return WooWooAnalyzer::getSpanTrace(); },
+                 py::call_guard<py::gil_scoped_release>())
+            .def("watch_workspace", &WooWooAnalyzer::watchWorkspace, py::arg("batch_delay_ms") = 100,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("start_recording", &WooWooAnalyzer::startRecording, py::arg("trace_path"),
+                 py::call_guard<py::gil_scoped_release>())
+            .def("stop_recording", &WooWooAnalyzer::stopRecording, py::call_guard<py::gil_scoped_release>())
+            .def("stop_watching_workspace", &WooWooAnalyzer::stopWatchingWorkspace,
+                 py::call_guard<py::gil_scoped_release>());
+
+    defTracedSetter(analyzer, "set_dialect", &WooWooAnalyzer::setDialect);
+    defTracedSetter(analyzer, "set_token_types", &WooWooAnalyzer::setTokenTypes);
+    defTracedSetter(analyzer, "set_token_modifiers", &WooWooAnalyzer::setTokenModifiers);
+
+    defRequest(analyzer, "load_workspace", &WooWooAnalyzer::loadWorkspace, false);
+    defRequest(analyzer, "load_workspace_progressive", &WooWooAnalyzer::loadWorkspaceProgressive, false);
+    defRequest(analyzer, "remove_workspace_folder", &WooWooAnalyzer::removeWorkspaceFolder, false);
+    defRequest(analyzer, "hover", &WooWooAnalyzer::hover, true);
+    defRequest(analyzer, "semantic_tokens", &WooWooAnalyzer::semanticTokens, true);
+    defRequest(analyzer, "semantic_tokens_full", &WooWooAnalyzer::semanticTokensFull, true);
+    defRequest(analyzer, "semantic_tokens_range", &WooWooAnalyzer::semanticTokensRange, true);
+    defRequest(analyzer, "semantic_tokens_delta", &WooWooAnalyzer::semanticTokensDelta, true);
+    defRequest(analyzer, "go_to_definition", &WooWooAnalyzer::goToDefinition, true);
+    defRequest(analyzer, "complete", &WooWooAnalyzer::complete, true);
+    defRequest(analyzer, "references", &WooWooAnalyzer::references, true);
+    defRequest(analyzer, "rename", &WooWooAnalyzer::rename, true);
+    defRequest(analyzer, "folding_ranges", &WooWooAnalyzer::foldingRanges, true);
+    defRequest(analyzer, "analyze_document", &WooWooAnalyzer::analyzeDocument, true);
+    defRequest(analyzer, "document_symbols", &WooWooAnalyzer::documentSymbols, true);
+    defRequest(analyzer, "workspace_symbols", &WooWooAnalyzer::workspaceSymbols, true);
+    defRequest(analyzer, "document_did_change", &WooWooAnalyzer::documentDidChange, false);
+    defRequest(analyzer, "document_did_change_incremental", &WooWooAnalyzer::documentDidChangeIncremental, false);
+    defRequest(analyzer, "open_document", &WooWooAnalyzer::openDocument, false);
+    defRequest(analyzer, "close_document", &WooWooAnalyzer::closeDocument, false);
+    defRequest(analyzer, "prefetch_document", &WooWooAnalyzer::prefetchDocument, false);
+    // not cancellable: the documents are moved before the edits of their includes are collected
+    defRequest(analyzer, "rename_files", &WooWooAnalyzer::renameFiles, false);
+    defRequest(analyzer, "did_delete_files", &WooWooAnalyzer::didDeleteFiles, false);
+    defRequest(analyzer, "did_change_watched_files", &WooWooAnalyzer::didChangeWatchedFiles, false);
+    defRequest(analyzer, "diagnose", &WooWooAnalyzer::diagnose, true);
+    defRequest(analyzer, "check_workspace", &WooWooAnalyzer::checkWorkspace, false);
 
 
     py::class_<Position>(m, "Position")
@@ -100,6 +396,20 @@ PYBIND11_MODULE(wuff, m) {
             .def_readwrite("insertTextFormat", &CompletionItem::insertTextFormat)
             .def_readwrite("insertText", &CompletionItem::insertText);
 
+    py::class_<CompletionList>(m, "CompletionList")
+            .def(py::init<>())
+            .def_readwrite("is_incomplete", &CompletionList::isIncomplete)
+            .def_readwrite("items", &CompletionList::items)
+            // behaves like the plain list of items it replaced
+            .def("__len__", [](const CompletionList &list) { return list.items.size(); })
+            .def("__getitem__", [](const CompletionList &list, size_t i) {
+                if (i >= list.items.size()) throw py::index_error();
+                return list.items[i];
+            })
+            .def("__iter__", [](const CompletionList &list) {
+                return py::make_iterator(list.items.begin(), list.items.end());
+            }, py::keep_alive<0, 1>());
+
     py::class_<ReferenceParams, TextDocumentPositionParams>(m, "ReferenceParams")
             .def(py::init<const TextDocumentIdentifier&, const Position&, bool>());
     
@@ -130,7 +440,60 @@ PYBIND11_MODULE(wuff, m) {
             .def_readwrite("message", &Diagnostic::message)
             .def_readwrite("source", &Diagnostic::source)
             .def_readwrite("severity", &Diagnostic::severity);
+
+    py::class_<PublishDiagnosticsParams>(m, "PublishDiagnosticsParams")
+            .def(py::init<std::string, std::vector<Diagnostic>>())
+            .def_readwrite("uri", &PublishDiagnosticsParams::uri)
+            .def_readwrite("diagnostics", &PublishDiagnosticsParams::diagnostics);
+
+    // combined with | for analyze_document
+    py::enum_<DocumentFeature>(m, "DocumentFeature", py::arithmetic())
+            .value("SemanticTokens", DocumentFeature::SemanticTokens)
+            .value("Diagnostics", DocumentFeature::Diagnostics)
+            .value("FoldingRanges", DocumentFeature::FoldingRanges)
+            .value("All", DocumentFeature::All)
+            .export_values();
+
+    py::class_<DocumentAnalysis>(m, "DocumentAnalysis")
+            .def_readonly("version", &DocumentAnalysis::version)
+            .def_readonly("semantic_tokens", &DocumentAnalysis::semanticTokens)
+            .def_readonly("diagnostics", &DocumentAnalysis::diagnostics)
+            .def_readonly("folding_ranges", &DocumentAnalysis::foldingRanges);
     
+    py::enum_<FileChangeType>(m, "FileChangeType")
+            .value("Created", FileChangeType::Created)
+            .value("Changed", FileChangeType::Changed)
+            .value("Deleted", FileChangeType::Deleted)
+            .export_values();
+
+    py::class_<FileEvent>(m, "FileEvent")
+            .def(py::init<std::string, FileChangeType>())
+            .def_readwrite("uri", &FileEvent::uri)
+            .def_readwrite("type", &FileEvent::type);
+
+    py::class_<SemanticTokensRangeParams>(m, "SemanticTokensRangeParams")
+            .def(py::init<TextDocumentIdentifier, Range>())
+            .def_readwrite("text_document", &SemanticTokensRangeParams::textDocument)
+            .def_readwrite("range", &SemanticTokensRangeParams::range);
+
+    py::class_<SemanticTokensDeltaParams>(m, "SemanticTokensDeltaParams")
+            .def(py::init<TextDocumentIdentifier, std::string>())
+            .def_readwrite("text_document", &SemanticTokensDeltaParams::textDocument)
+            .def_readwrite("previous_result_id", &SemanticTokensDeltaParams::previousResultId);
+
+    py::class_<SemanticTokens>(m, "SemanticTokens")
+            .def_readwrite("result_id", &SemanticTokens::resultId)
+            .def_readwrite("data", &SemanticTokens::data);
+
+    py::class_<SemanticTokensEdit>(m, "SemanticTokensEdit")
+            .def_readwrite("start", &SemanticTokensEdit::start)
+            .def_readwrite("delete_count", &SemanticTokensEdit::deleteCount)
+            .def_readwrite("data", &SemanticTokensEdit::data);
+
+    py::class_<SemanticTokensDelta>(m, "SemanticTokensDelta")
+            .def_readwrite("result_id", &SemanticTokensDelta::resultId)
+            .def_readwrite("edits", &SemanticTokensDelta::edits);
+
     py::class_<FoldingRange>(m, "FoldingRange")
             .def_readwrite("start_line", &FoldingRange::startLine)
             .def_readwrite("start_character", &FoldingRange::startCharacter)
@@ -138,5 +501,28 @@ PYBIND11_MODULE(wuff, m) {
             .def_readwrite("end_character", &FoldingRange::endCharacter)
             .def_readwrite("kind", &FoldingRange::foldingRangeKind);
 
+    py::enum_<SymbolKind>(m, "SymbolKind")
+            .value("File", SymbolKind::File)
+            .value("Module", SymbolKind::Module)
+            .value("Struct", SymbolKind::Struct)
+            .value("Object", SymbolKind::Object)
+            .value("Key", SymbolKind::Key)
+             // Note: LSP lists many other possible values, which are not used in this project right now.
+            .export_values();
+
+    py::class_<SymbolInformation>(m, "SymbolInformation")
+            .def_readwrite("name", &SymbolInformation::name)
+            .def_readwrite("kind", &SymbolInformation::kind)
+            .def_readwrite("location", &SymbolInformation::location)
+            .def_readwrite("container_name", &SymbolInformation::containerName);
+
+    py::class_<DocumentSymbol>(m, "DocumentSymbol")
+            .def_readwrite("name", &DocumentSymbol::name)
+            .def_readwrite("detail", &DocumentSymbol::detail)
+            .def_readwrite("kind", &DocumentSymbol::kind)
+            .def_readwrite("range", &DocumentSymbol::range)
+            .def_readwrite("selection_range", &DocumentSymbol::selectionRange)
+            .def_readwrite("children", &DocumentSymbol::children);
+
 }
 
@@ -2,6 +2,7 @@
 // Created by Michal Janecek on 27.01.2024.
 //
 
+#include <algorithm>
 #include <filesystem>
 #include <string>
 #include <utility>
@@ -9,6 +10,8 @@
 #include "WooWooAnalyzer.h"
 #include "dialect/DialectManager.h"
 #include "project/DialectedWooWooDocument.h"
+#include "project/WorkspaceScanner.h"
+#include "parser/QueryRegistry.h"
 
 #include "components/Hoverer.h"
 #include "components/Highlighter.h"
@@ -18,23 +21,50 @@
 #include "components/Folder.h"
 
 #include "utils/utils.h"
+#include "utils/CancellationToken.h"
+#include "utils/Stats.h"
+#include "parser/WooWooSymbols.h"
+
+namespace {
+    // whether the path is the folder or anything in it
+    bool isWithin(const fs::path &path, const fs::path &folder) {
+        auto relative = path.lexically_relative(folder);
+        return !relative.empty() && *relative.begin() != "..";
+    }
+}
 
 WooWooAnalyzer::WooWooAnalyzer() {
+    woowoo::checkSymbols();
     highlighter = new Highlighter(this);
     hoverer = new Hoverer(this);
     navigator = new Navigator(this);
     completer = new Completer(this);
     linter = new Linter(this);
     folder = new Folder(this);
+    setThreadPoolSize(0);
+    requestExecutor = new ThreadPool(1);
 }
 
 WooWooAnalyzer::~WooWooAnalyzer() {
+    // its task takes the request lock, it is free here
+    idleEviction.reset();
+    // changes reported by the watchers are reconciled under the request lock, it is free here
+    fileWatchers.clear();
+    // documents still waiting to be loaded are not loaded anymore
+    stopLoading = true;
+    finishWorkspaceLoad();
+    // the scheduler diagnoses through the components, it is stopped first
+    diagnosticsScheduler.reset();
+    // requests still queued are finished before anything they use is deleted
+    delete requestExecutor;
     delete highlighter;
     delete hoverer;
     delete navigator;
     delete completer;
     delete linter;
     delete folder;
+    saveIndexCache();
+    delete threadPool;
 
     for (auto &project: projects) {
         delete project;
@@ -42,74 +72,286 @@ WooWooAnalyzer::~WooWooAnalyzer() {
 }
 
 void WooWooAnalyzer::setDialect(const std::string &dialectPath) {
+    // documents being loaded are indexed with the dialect without the request lock
+    LoadSlot slot(*this);
+    std::lock_guard<PriorityMutex> lock(requestMutex);
     DialectManager::getInstance()->loadDialect(dialectPath);
+    std::vector<WooWooProject *> reindexed;
+    for (WooWooProject *project: projects) {
+        if (!project->dialect) reindexed.push_back(project);
+    }
+    reindexProjects(reindexed);
 }
 
+void WooWooAnalyzer::setThreadPoolSize(size_t threadCount) {
+    // a workspace being loaded uses the pool
+    LoadSlot slot(*this);
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    std::lock_guard<std::mutex> poolLock(threadPoolMutex);
+    delete threadPool;
+    threadPool = threadCount > 1 ? new ThreadPool(threadCount) : nullptr;
+}
+
+void WooWooAnalyzer::setCacheDirectory(const std::string &cacheDirectoryPath) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    if (cacheDirectoryPath.empty()) {
+        cacheDirectory.reset();
+    } else {
+        cacheDirectory = fs::path(cacheDirectoryPath);
+    }
+}
+
+void WooWooAnalyzer::saveIndexCache() {
+    for (auto &[folderPath, indexCache]: indexCaches) {
+        std::vector<DialectedWooWooDocument *> documents;
+        for (auto project: projects) {
+            for (DialectedWooWooDocument *document: project->getDocuments()) {
+                if (isWithin(document->documentPath, folderPath)) {
+                    documents.push_back(document);
+                }
+            }
+        }
+        indexCache->store(documents);
+        indexCache->save();
+    }
+}
+
+std::optional<fs::path> WooWooAnalyzer::workspaceFolderOf(const fs::path &path) const {
+    std::optional<fs::path> innermost;
+    for (const fs::path &folderPath: workspaceFolderPaths) {
+        if (isWithin(path, folderPath) && (!innermost || isWithin(folderPath, innermost.value()))) {
+            innermost = folderPath;
+        }
+    }
+    return innermost;
+}
+
+const IndexCache *WooWooAnalyzer::indexCacheFor(const fs::path &documentPath) const {
+    auto folderPath = workspaceFolderOf(documentPath);
+    if (!folderPath.has_value()) return nullptr;
+    auto indexCache = indexCaches.find(folderPath.value());
+    return indexCache != indexCaches.end() ? indexCache->second.get() : nullptr;
+}
+
+std::vector<std::string> WooWooAnalyzer::workspaceFolders() {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    std::vector<std::string> uris;
+    for (const fs::path &folderPath: workspaceFolderPaths) {
+        uris.push_back(utils::pathToUri(folderPath));
+    }
+    return uris;
+}
 
 /**
  * Loads all WooWoo documents from the specified workspace URI.
  * 
  * This function converts the workspace URI to a local path and scans the directory
  * for project folders, loading any '.woo' files found within them. It also loads any
- * standalone '.woo' files that are not part of any project folder.
+ * standalone '.woo' files that are not part of any project folder. Files ignored by
+ * a .gitignore or excluded by a Woofile are skipped.
+ *
+ * The folder is added to the workspace folders, the ones loaded before stay loaded. Projects shared with them
+ * (a folder within another one) are reused, documents which are already loaded are not loaded again.
+ * 
+ * Documents are added in batches, the requests of other threads are answered between them.
+ * Returns once all documents are loaded.
  * 
  * @param workspaceUri The URI of the workspace to load documents from.
  */
 void WooWooAnalyzer::loadWorkspace(const std::string &workspaceUri) {
-    // Convert URI to a local file system path
-    workspaceRootPath = utils::uriToPathString(workspaceUri);
-
-    // Find all project folders within the workspace
-    auto projectFolders = findProjectFolders(workspaceRootPath);
+    LoadSlot slot(*this);
+    auto pending = beginWorkspaceLoad(workspaceUri);
+    loadPendingDocuments(*pending, 0, pending->size());
+}
 
-    for (const fs::path &projectFolderPath: projectFolders) {
-        projects.insert(new WooWooProject(projectFolderPath));
+/**
+ * Same as loadWorkspace, but returns as soon as the documents opened by the client are loaded,
+ * the rest of them is loaded in the background (see loadProgress).
+ */
+void WooWooAnalyzer::loadWorkspaceProgressive(const std::string &workspaceUri) {
+    // released by the background loader once it is done
+    auto slot = std::make_shared<LoadSlot>(*this);
+    auto pending = beginWorkspaceLoad(workspaceUri);
+    size_t opened = static_cast<size_t>(std::count_if(pending->begin(), pending->end(),
+                                                      [](const PendingDocument &document) { return document.opened; }));
+    loadPendingDocuments(*pending, 0, opened);
+    std::lock_guard<std::mutex> lock(loaderMutex);
+    // the previous loader released the slot, it is about to end
+    if (workspaceLoader.joinable()) {
+        workspaceLoader.join();
     }
+    workspaceLoader = std::thread([this, pending, opened, slot]() mutable {
+        loadPendingDocuments(*pending, opened, pending->size());
+        slot.reset();
+    });
+}
+
+LoadProgress WooWooAnalyzer::loadProgress() const {
+    return LoadProgress{documentsDiscovered.load(), documentsParsed.load(), documentsIndexed.load(),
+                        !workspaceLoading.load()};
+}
 
-    // Project for unassigned documents
-    auto nullProject = new WooWooProject();
-    projects.insert(nullProject);
-    
-    // Find and load all '.woo' files that are not part of any project
-    auto woowooFiles = findAllWooFiles(workspaceRootPath);
+bool WooWooAnalyzer::isWorkspaceLoaded() const {
+    return !workspaceLoading.load();
+}
 
-    for (auto &woowooFile: woowooFiles) {
-        bool partOfProject = false;
-        for (auto &project: projects) {
-            if (project->getDocument(woowooFile.generic_string())) {
-                partOfProject = true;
-            }
+void WooWooAnalyzer::finishWorkspaceLoad() {
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        if (workspaceLoader.joinable()) {
+            workspaceLoader.join();
         }
-        if (!partOfProject)
-            nullProject->loadDocument(woowooFile);
     }
+    // a load on another thread
+    std::unique_lock<std::mutex> lock(loadSlotMutex);
+    loadSlotReleased.wait(lock, [this]() { return !loadSlotTaken; });
+}
+
+WooWooAnalyzer::LoadSlot::LoadSlot(WooWooAnalyzer &analyzer) : analyzer(analyzer) {
+    std::unique_lock<std::mutex> lock(analyzer.loadSlotMutex);
+    analyzer.loadSlotReleased.wait(lock, [&analyzer]() { return !analyzer.loadSlotTaken; });
+    analyzer.loadSlotTaken = true;
+}
 
+WooWooAnalyzer::LoadSlot::~LoadSlot() {
+    {
+        std::lock_guard<std::mutex> lock(analyzer.loadSlotMutex);
+        analyzer.loadSlotTaken = false;
+    }
+    analyzer.loadSlotReleased.notify_all();
 }
 
+/**
+ * Finds the projects and documents of the workspace and registers the (still empty) projects,
+ * documents found later in them are added to them. Returns the documents to be loaded,
+ * the ones opened by the client first.
+ */
+std::shared_ptr<std::vector<WooWooAnalyzer::PendingDocument>>
+WooWooAnalyzer::beginWorkspaceLoad(const std::string &workspaceUri) {
+    // the caller holds the load slot, no other load uses the index cache anymore
+    PriorityLock lock(requestMutex, Lane::Indexing);
+    // Convert URI to a local file system path
+    fs::path folderPath = fs::path(utils::uriToPathString(workspaceUri)).lexically_normal();
+    if (std::find(workspaceFolderPaths.begin(), workspaceFolderPaths.end(), folderPath) ==
+        workspaceFolderPaths.end()) {
+        workspaceFolderPaths.push_back(folderPath);
+        if (watchDelay.has_value()) {
+            watchWorkspaceFolder(folderPath);
+        }
+    }
 
-std::set<fs::path> WooWooAnalyzer::findAllWooFiles(const fs::path &rootPath) {
-    std::set<fs::path> wooFiles;
+    indexCaches.erase(folderPath);
+    std::shared_ptr<const IndexCache> indexCache;
+    if (cacheDirectory.has_value()) {
+        auto loadedCache = std::make_shared<IndexCache>(
+                IndexCache::cacheFilePathFor(cacheDirectory.value(), folderPath));
+        loadedCache->load();
+        indexCache = indexCaches.emplace(folderPath, std::move(loadedCache)).first->second;
+    }
 
-    if (fs::exists(rootPath) && fs::is_directory(rootPath)) {
-        for (const auto &entry: fs::recursive_directory_iterator(rootPath)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".woo") {
-                wooFiles.insert(entry.path());
-            }
+    // Find all projects and documents in one walk over the workspace
+    WorkspaceLayout layout = WorkspaceScanner(threadPool).scan(folderPath);
+
+    auto pending = std::make_shared<std::vector<PendingDocument>>();
+    std::vector<WooWooProject *> loadedProjects;
+    for (const auto &project: layout.projects) {
+        // a project of another workspace folder containing this one (or of this folder loaded before)
+        auto loadedProject = getProject(project.first);
+        if (!loadedProject) {
+            loadedProject = new WooWooProject(project.first, {});
+            projects.insert(loadedProject);
+            loadedProjects.push_back(loadedProject);
+        }
+        for (const fs::path &documentPath: project.second) {
+            pending->push_back(PendingDocument{loadedProject, documentPath, false, indexCache, loadedProject->dialect});
         }
     }
+    updateBibliographies(loadedProjects, false);
 
-    return wooFiles;
+    // Project for unassigned documents, shared by all workspace folders
+    auto nullProject = getProject(std::nullopt);
+    if (!nullProject) {
+        nullProject = new WooWooProject();
+        projects.insert(nullProject);
+    }
+    for (const fs::path &documentPath: layout.standaloneDocuments) {
+        pending->push_back(PendingDocument{nullProject, documentPath, false, indexCache, nullProject->dialect});
+    }
+
+    // the order of the directory walk is unspecified, documents are added in a fixed order
+    for (PendingDocument &document: *pending) {
+        document.opened = openedPaths.count(document.path.generic_string()) != 0;
+    }
+    std::sort(pending->begin(), pending->end(), [](const PendingDocument &a, const PendingDocument &b) {
+        if (a.opened != b.opened) return a.opened;
+        return a.path < b.path;
+    });
+
+    documentsDiscovered = pending->size();
+    documentsParsed = 0;
+    documentsIndexed = 0;
+    workspaceLoading = true;
+    return pending;
 }
 
-std::vector<fs::path> WooWooAnalyzer::findProjectFolders(const fs::path &rootPath) {
+/**
+ * Loads the documents [begin, end) in batches. A batch is parsed (or read from the index cache) without
+ * the request lock, in parallel if possible, and then added to the projects at once.
+ * The lock is taken in the indexing lane, requests of the client waiting for it go first.
+ */
+void WooWooAnalyzer::loadPendingDocuments(const std::vector<PendingDocument> &pending, size_t begin, size_t end) {
+    const size_t batchSize = threadPool ? 4 * threadPool->size() : 16;
+    for (size_t batchBegin = begin; batchBegin < end && !stopLoading; batchBegin += batchSize) {
+        size_t batchEnd = std::min(end, batchBegin + batchSize);
+
+        std::vector<std::shared_ptr<DialectedWooWooDocument>> documents;
+        documents.reserve(batchEnd - batchBegin);
+        if (threadPool && batchEnd - batchBegin > 1) {
+            std::vector<std::future<std::shared_ptr<DialectedWooWooDocument>>> created;
+            created.reserve(batchEnd - batchBegin);
+            for (size_t i = batchBegin; i < batchEnd; ++i) {
+                created.emplace_back(threadPool->submit([&document = pending[i]]() {
+                    return WooWooProject::createDocument(document.path, document.indexCache.get(), document.dialect);
+                }, Lane::Indexing));
+            }
+            for (auto &document: created) {
+                documents.emplace_back(document.get());
+                ++documentsParsed;
+            }
+        } else {
+            for (size_t i = batchBegin; i < batchEnd; ++i) {
+                documents.emplace_back(WooWooProject::createDocument(pending[i].path, pending[i].indexCache.get(),
+                                                                     pending[i].dialect));
+                ++documentsParsed;
+            }
+        }
 
-    std::vector<fs::path> projectFolders;
-    for (const auto &entry: fs::recursive_directory_iterator(rootPath)) {
-        if (entry.is_regular_file() && entry.path().filename() == "Woofile") {
-            projectFolders.push_back(entry.path().parent_path());
+        PriorityLock lock(requestMutex, Lane::Indexing);
+        for (size_t i = batchBegin; i < batchEnd; ++i) {
+            const PendingDocument &document = pending[i];
+            // the client could have opened (and changed) the document in the meantime
+            if (!document.project->getDocument(document.path.generic_string())) {
+                auto &created = documents[i - batchBegin];
+                if (document.project->dialect != document.dialect) {
+                    // the Woofile named another dialect in the meantime
+                    created->setDialect(document.project->dialect);
+                    created->dematerialize();
+                }
+                document.project->addDocument(created);
+                documentTable.add(created.get());
+            }
+            ++documentsIndexed;
         }
     }
-    return projectFolders;
+
+    if (end == pending.size()) {
+        PriorityLock lock(requestMutex, Lane::Indexing);
+        saveIndexCache();
+        workspaceLoading = false;
+    }
 }
 
 std::optional<fs::path> WooWooAnalyzer::findProjectFolder(const std::string &uri) {
@@ -118,8 +360,10 @@ std::optional<fs::path> WooWooAnalyzer::findProjectFolder(const std::string &uri
     // Start from parent of the file
     fs::path parent = path.parent_path();
 
-    // Explore up to the root folder of the project
-    while (parent != workspaceRootPath.parent_path() && parent != parent.parent_path()) {
+    // Explore up to the workspace folder containing the document (if there is one)
+    auto folderPath = workspaceFolderOf(path);
+    fs::path stop = folderPath.has_value() ? folderPath->parent_path() : fs::path();
+    while (parent != stop && parent != parent.parent_path()) {
         fs::path woofilePath = parent / "Woofile";
 
         // Check if Woofile exists in this directory
@@ -133,87 +377,806 @@ std::optional<fs::path> WooWooAnalyzer::findProjectFolder(const std::string &uri
 }
 
 DialectedWooWooDocument * WooWooAnalyzer::getDocumentByUri(const std::string &docUri) {
-    auto path = utils::uriToPathString(docUri);
-    return getDocument(path);
+    auto doc = documentTable.findByUri(docUri);
+    materializeDocument(doc);
+    return doc;
+}
+
+DialectedWooWooDocument * WooWooAnalyzer::getDocumentById(DocumentId id) {
+    auto doc = documentTable.get(id);
+    materializeDocument(doc);
+    return doc;
+}
+
+DialectedWooWooDocument * WooWooAnalyzer::findDocumentById(DocumentId id) const {
+    return documentTable.get(id);
+}
+
+DocumentId WooWooAnalyzer::getDocumentId(const DialectedWooWooDocument *document) const {
+    return documentTable.idOf(document);
 }
 
 DialectedWooWooDocument * WooWooAnalyzer::getDocument(const std::string &pathToDoc) {
+    auto doc = findDocument(pathToDoc);
+    materializeDocument(doc);
+    return doc;
+}
 
-    for (auto &project: projects) {
-        auto doc = project->getDocument(pathToDoc);
-        if (doc)
-            return doc;
+void WooWooAnalyzer::materializeDocument(DialectedWooWooDocument *document) {
+    if (!document) return;
+    if (!document->isMaterialized()) {
+        auto indexedState = document->diskState;
+        document->materialize();
+        // the file could have been changed by something else than the client since it was indexed
+        if (!indexedState.has_value() || !document->diskState.has_value() ||
+            indexedState->contentHash != document->diskState->contentHash) {
+            auto project = getProjectByDocument(document);
+            if (project) {
+                project->documentChanged(document);
+            }
+        }
     }
+    residentDocuments.touch(document);
+}
 
-    return nullptr;
+void WooWooAnalyzer::setMemoryBudget(size_t bytes) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    residentDocuments.setMemoryBudget(bytes);
 }
 
+void WooWooAnalyzer::setIdleEviction(uint32_t idleMilliseconds) {
+    std::unique_ptr<PeriodicTask> eviction;
+    if (idleMilliseconds > 0) {
+        auto idle = std::chrono::milliseconds(idleMilliseconds);
+        // a document is unloaded at most a quarter of the time later than it could be
+        eviction = std::make_unique<PeriodicTask>([this, idle]() {
+            PriorityLock lock(requestMutex, Lane::Background);
+            size_t evicted = residentDocuments.evictIdle(
+                    std::chrono::steady_clock::now() - idle, [this](const DialectedWooWooDocument *document) {
+                        return openedPaths.count(document->documentPath.generic_string()) != 0;
+                    });
+            Stats::count(Counter::IdleDocumentEvicted, evicted);
+        }, std::max(idle / 4, std::chrono::milliseconds(1)));
+    }
+    {
+        std::lock_guard<PriorityMutex> lock(requestMutex);
+        idleEviction.swap(eviction);
+    }
+    // the previous task is stopped without the lock, it may be waiting for it
+}
 
-WooWooProject *WooWooAnalyzer::getProjectByDocument(WooWooDocument * document) {
+/**
+ * Warms everything the first requests of a document the client is about to open need: the document is parsed
+ * (if only its index was kept), then its semantic tokens and its diagnostics are computed into the caches of the
+ * components. Each step takes the lock in the background lane on its own, requests of the client waiting for it
+ * go first.
+ */
+void WooWooAnalyzer::prefetchDocument(const std::string &uri) {
+    requestExecutor->submit([this, uri]() {
+        {
+            PriorityLock lock(requestMutex, Lane::Background);
+            auto document = findDocument(utils::uriToPathString(uri));
+            if (!document) return;
+            if (!document->isMaterialized()) {
+                materializeDocument(document);
+                Stats::count(Counter::DocumentPrefetched);
+            }
+        }
+        {
+            PriorityLock lock(requestMutex, Lane::Background);
+            ScopedSpan span("Highlighter::semanticTokens", "component", uri);
+            highlighter->semanticTokens(TextDocumentIdentifier(uri));
+        }
+        {
+            PriorityLock lock(requestMutex, Lane::Background);
+            ScopedSpan span("Linter::diagnose", "component", uri);
+            linter->diagnose(TextDocumentIdentifier(uri));
+        }
+    }, Lane::Background);
+}
 
-    for (auto &project: projects) {
-        auto doc = project->getDocument(document);
-        if (doc)
-            return project;
+void WooWooAnalyzer::startBackgroundDiagnostics(uint32_t delayMilliseconds) {
+    auto scheduler = std::make_shared<DiagnosticsScheduler>([this](const std::string &uri) {
+        return diagnoseInBackground(uri);
+    }, std::chrono::milliseconds(delayMilliseconds));
+    {
+        std::lock_guard<PriorityMutex> lock(requestMutex);
+        // queueDepths() reads it without the lock
+        scheduler = std::atomic_exchange(&diagnosticsScheduler, scheduler);
     }
+    // the previous scheduler is stopped without the lock, its running diagnosis may be waiting for it
+}
 
-    return nullptr;
+std::vector<PublishDiagnosticsParams> WooWooAnalyzer::takeDiagnostics(uint32_t timeoutMilliseconds) {
+    std::shared_ptr<DiagnosticsScheduler> scheduler;
+    {
+        std::lock_guard<PriorityMutex> lock(requestMutex);
+        scheduler = diagnosticsScheduler;
+    }
+    if (!scheduler) return {};
+    return scheduler->take(std::chrono::milliseconds(timeoutMilliseconds));
 }
 
+std::map<std::string, size_t> WooWooAnalyzer::queueDepths() {
+    std::array<size_t, LANE_COUNT> depths{};
+    {
+        std::lock_guard<std::mutex> poolLock(threadPoolMutex);
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            depths[lane] = requestExecutor->queueDepth(static_cast<Lane>(lane)) +
+                           requestMutex.waiting(static_cast<Lane>(lane));
+            if (threadPool) {
+                depths[lane] += threadPool->queueDepth(static_cast<Lane>(lane));
+            }
+        }
+    }
+    std::shared_ptr<DiagnosticsScheduler> scheduler = std::atomic_load(&diagnosticsScheduler);
+    if (scheduler) {
+        depths[static_cast<size_t>(Lane::Background)] += scheduler->queueDepth();
+    }
+    return {{"interactive", depths[static_cast<size_t>(Lane::Interactive)]},
+            {"indexing",    depths[static_cast<size_t>(Lane::Indexing)]},
+            {"background",  depths[static_cast<size_t>(Lane::Background)]}};
+}
 
-void WooWooAnalyzer::handleDocumentChange(const TextDocumentIdentifier &tdi, std::string &source) {
-    auto docPath = utils::uriToPathString(tdi.uri);
-    auto document = getDocument(docPath);
-    if (document) {
-        document->updateSource(source);
+void WooWooAnalyzer::watchWorkspace(uint32_t batchDelayMilliseconds) {
+    std::map<fs::path, std::unique_ptr<FileWatcher>> previous;
+    {
+        std::lock_guard<PriorityMutex> lock(requestMutex);
+        previous = std::move(fileWatchers);
+        fileWatchers.clear();
+        watchDelay = std::chrono::milliseconds(batchDelayMilliseconds);
+        for (const fs::path &folderPath: workspaceFolderPaths) {
+            watchWorkspaceFolder(folderPath);
+        }
+    }
+    // the previous watchers are stopped without the lock, their callbacks may be waiting for it
+}
+
+void WooWooAnalyzer::stopWatchingWorkspace() {
+    std::map<fs::path, std::unique_ptr<FileWatcher>> previous;
+    {
+        std::lock_guard<PriorityMutex> lock(requestMutex);
+        previous = std::move(fileWatchers);
+        fileWatchers.clear();
+        watchDelay.reset();
+    }
+}
+
+void WooWooAnalyzer::watchWorkspaceFolder(const fs::path &folderPath) {
+    fileWatchers[folderPath] = std::make_unique<FileWatcher>(
+            folderPath, watchDelay.value(),
+            [this](const std::vector<fs::path> &changedPaths) { reconcileChangedPaths(changedPaths); });
+}
+
+void WooWooAnalyzer::removeWorkspaceFolder(const std::string &workspaceUri) {
+    std::unique_ptr<FileWatcher> watcher;
+    {
+        // a folder being loaded is loaded completely first, no load starts until it is removed
+        LoadSlot slot(*this);
+        PriorityLock lock(requestMutex, Lane::Indexing);
+        fs::path folderPath = fs::path(utils::uriToPathString(workspaceUri)).lexically_normal();
+        auto folder = std::find(workspaceFolderPaths.begin(), workspaceFolderPaths.end(), folderPath);
+        if (folder == workspaceFolderPaths.end()) return;
+
+        // the indexes are kept for the next time the folder is loaded
+        saveIndexCache();
+        indexCaches.erase(folderPath);
+        auto folderWatcher = fileWatchers.find(folderPath);
+        if (folderWatcher != fileWatchers.end()) {
+            watcher = std::move(folderWatcher->second);
+            fileWatchers.erase(folderWatcher);
+        }
+        workspaceFolderPaths.erase(folder);
+
+        // documents also in another workspace folder are found by its scan and stay
+        std::set<DialectedWooWooDocument *> affected;
+        reconcileWorkspaceFolders({folderPath}, {}, affected);
+    }
+    // the watcher is stopped without the lock, its callback may be waiting for it
+}
+
+// the recorder has a lock of its own, recording does not wait for the requests in progress
+void WooWooAnalyzer::startRecording(const std::string &tracePath) {
+    sessionRecorder.start(tracePath);
+}
+
+void WooWooAnalyzer::stopRecording() {
+    sessionRecorder.stop();
+}
+
+/**
+ * Applies the changes of the workspace on disk reported by the watcher.
+ *
+ * Changed documents are read again, deleted ones removed. When Woofiles, .gitignore files or folders change
+ * (or a document appears), the workspace folders containing the changes are scanned again and documents are added,
+ * removed or moved between projects to match them, projects whose Woofile is gone are deleted once they are empty.
+ * Runs in the indexing lane once no workspace is being loaded, documents changed in memory by the client
+ * are kept as they are.
+ */
+void WooWooAnalyzer::reconcileChangedPaths(const std::vector<fs::path> &changedPaths) {
+    // a load in progress still adds documents to the projects which could be deleted here
+    LoadSlot slot(*this);
+    PriorityLock lock(requestMutex, Lane::Indexing);
+    if (workspaceFolderPaths.empty()) return;
+
+    // known documents the changes may concern
+    std::set<DialectedWooWooDocument *> affected;
+    bool rescan = false;
+    bool bibliographyChanged = false;
+    for (const fs::path &path: changedPaths) {
+        std::error_code ec;
+        if (path.extension() == ".woo" && !fs::is_directory(path, ec)) {
+            auto document = findDocument(path.generic_string());
+            if (document) {
+                affected.insert(document);
+            } else if (fs::exists(path, ec)) {
+                // a new document, only the scan knows its project and whether it is excluded
+                rescan = true;
+            }
+        } else if (path.extension() == ".bib" && !fs::is_directory(path, ec)) {
+            bibliographyChanged = true;
+        } else {
+            rescan = true;
+        }
+    }
+
+    if (rescan) {
+        // only the workspace folders where something changed are scanned again
+        std::vector<fs::path> scopes;
+        for (const fs::path &folderPath: workspaceFolderPaths) {
+            if (std::any_of(changedPaths.begin(), changedPaths.end(),
+                            [&folderPath](const fs::path &path) { return isWithin(path, folderPath); })) {
+                scopes.push_back(folderPath);
+            }
+        }
+        reconcileWorkspaceFolders(scopes, changedPaths, affected);
+    }
+
+    if (rescan || bibliographyChanged) {
+        // a Woofile could have changed its bibliography, unchanged files are not read again
+        updateBibliographies(std::vector<WooWooProject *>(projects.begin(), projects.end()), rescan);
+    }
+
+    std::set<DialectedWooWooDocument *> changed;
+    for (DialectedWooWooDocument *document: affected) {
+        std::error_code ec;
+        if (fs::exists(document->documentPath, ec)) {
+            changed.insert(document);
+        } else if (document->diskState.has_value()) {
+            deleteDocument(document);
+        }
+    }
+    refreshDocuments(changed);
+}
+
+void WooWooAnalyzer::reconcileWorkspaceFolders(const std::vector<fs::path> &scopes,
+                                               const std::vector<fs::path> &changedPaths,
+                                               std::set<DialectedWooWooDocument *> &affected) {
+    auto withinScopes = [&scopes](const fs::path &path) {
+        return std::any_of(scopes.begin(), scopes.end(),
+                           [&path](const fs::path &scope) { return isWithin(path, scope); });
+    };
+
+    // every workspace folder overlapping a scope is scanned, a document belongs to the project found by any of them
+    std::map<std::string, std::optional<fs::path>> projectFolders;
+    std::set<fs::path> layoutProjects;
+    for (const fs::path &folderPath: workspaceFolderPaths) {
+        if (!withinScopes(folderPath) &&
+            std::none_of(scopes.begin(), scopes.end(),
+                         [&folderPath](const fs::path &scope) { return isWithin(scope, folderPath); })) {
+            continue;
+        }
+        WorkspaceLayout layout = WorkspaceScanner(threadPool).scan(folderPath);
+        for (const auto &project: layout.projects) {
+            layoutProjects.insert(project.first);
+            for (const fs::path &documentPath: project.second) {
+                if (withinScopes(documentPath)) projectFolders[documentPath.generic_string()] = project.first;
+            }
+        }
+        for (const fs::path &documentPath: layout.standaloneDocuments) {
+            if (withinScopes(documentPath)) projectFolders.try_emplace(documentPath.generic_string(), std::nullopt);
+        }
+    }
+
+    std::vector<DialectedWooWooDocument *> removed;
+    std::vector<std::pair<DialectedWooWooDocument *, std::optional<fs::path>>> moved;
+    for (WooWooProject *project: projects) {
+        for (DialectedWooWooDocument *document: project->getDocuments()) {
+            if (!withinScopes(document->documentPath)) continue;
+            std::string path = document->documentPath.generic_string();
+            auto projectFolder = projectFolders.find(path);
+            if (projectFolder == projectFolders.end()) {
+                std::error_code ec;
+                bool exists = fs::exists(document->documentPath, ec);
+                // excluded documents opened by the client stay, as do the ones it did not save yet
+                if ((exists && openedPaths.count(path) != 0) || (!exists && !document->diskState.has_value())) {
+                    continue;
+                }
+                removed.push_back(document);
+                continue;
+            }
+            if (project->projectFolderPath != projectFolder->second) {
+                moved.emplace_back(document, projectFolder->second);
+            }
+            for (const fs::path &changedPath: changedPaths) {
+                if (isWithin(document->documentPath, changedPath)) {
+                    affected.insert(document);
+                    break;
+                }
+            }
+            // the rest of them are new
+            projectFolders.erase(projectFolder);
+        }
+    }
+
+    for (DialectedWooWooDocument *document: removed) {
+        affected.erase(document);
+        deleteDocument(document);
+    }
+    for (auto &[document, projectFolder]: moved) {
+        auto project = getOrCreateProject(projectFolder);
+        auto oldProject = document->project;
+        auto documentShared = oldProject->getDocumentShared(document);
+        const auto &definitionSites = document->getIndex().definitionSites;
+        scheduleDependentDiagnostics(oldProject, document, definitionSites, {});
+        oldProject->deleteDocument(document);
+        project->addDocument(documentShared);
+        scheduleDependentDiagnostics(project, document, {}, definitionSites);
+        if (diagnosticsScheduler) {
+            diagnosticsScheduler->schedule(utils::pathToUri(document->documentPath));
+        }
+    }
+    addDiscoveredDocuments(projectFolders);
+
+    for (auto project = projects.begin(); project != projects.end();) {
+        auto folder = (*project)->projectFolderPath;
+        if (folder.has_value() && withinScopes(folder.value()) && layoutProjects.count(folder.value()) == 0 &&
+            (*project)->documentCount() == 0) {
+            delete *project;
+            project = projects.erase(project);
+        } else {
+            ++project;
+        }
+    }
+}
+
+bool WooWooAnalyzer::changedOnDisk(const DialectedWooWooDocument *document) {
+    // the version changed by the client is the one which counts
+    if (!document->diskState.has_value()) return false;
+    std::error_code ec;
+    auto size = fs::file_size(document->documentPath, ec);
+    if (ec) return false;
+    auto modificationTime = fs::last_write_time(document->documentPath, ec);
+    if (ec) return false;
+    return size != document->diskState->size ||
+           static_cast<int64_t>(modificationTime.time_since_epoch().count()) != document->diskState->modificationTime;
+}
+
+void WooWooAnalyzer::updateBibliographies(const std::vector<WooWooProject *> &updated, bool reloadWoofiles) {
+    std::vector<std::pair<BibliographyIndex *, std::vector<fs::path>>> bibliographies;
+    bibliographies.reserve(updated.size());
+    // projects whose Woofile names another dialect now, only their documents are indexed again
+    std::vector<WooWooProject *> reindexed;
+    for (WooWooProject *project: updated) {
+        if (!reloadWoofiles) {
+            bibliographies.emplace_back(&project->bibliography, project->bibliographyFiles());
+            continue;
+        }
+        auto previousDialect = project->dialect;
+        bibliographies.emplace_back(&project->bibliography, project->loadWoofile());
+        if (project->dialect != previousDialect) {
+            reindexed.push_back(project);
+        }
+    }
+    BibliographyIndex::setFiles(bibliographies, threadPool);
+    for (WooWooProject *project: updated) {
+        project->bibliographyChanged();
+    }
+    reindexProjects(reindexed);
+}
+
+void WooWooAnalyzer::reindexProjects(const std::vector<WooWooProject *> &reindexed) {
+    struct Reindex {
+        DialectedWooWooDocument *document;
+        bool materialized;
+        decltype(DocumentIndex::definitionSites) definitionSites;
+    };
+    if (reindexed.empty()) return;
+    std::vector<Reindex> reindexes;
+    for (WooWooProject *project: reindexed) {
+        for (DialectedWooWooDocument *document: project->getDocuments()) {
+            reindexes.push_back(Reindex{document, document->isMaterialized(), document->getIndex().definitionSites});
+        }
+    }
+
+    // the documents are independent, a document known only by its index is parsed for it
+    forEachInParallel(reindexes.size(), [&reindexes](size_t i) {
+        DialectedWooWooDocument *document = reindexes[i].document;
+        document->setDialect(document->project->dialect);
+    });
+
+    for (Reindex &reindex: reindexes) {
+        DialectedWooWooDocument *document = reindex.document;
+        document->project->documentChanged(document);
+        if (!reindex.materialized) {
+            document->dematerialize();
+        }
+        if (diagnosticsScheduler) {
+            diagnosticsScheduler->schedule(utils::pathToUri(document->documentPath));
+            scheduleDependentDiagnostics(document->project, document, reindex.definitionSites,
+                                         document->getIndex().definitionSites);
+        }
     }
+    // descriptions and resolved references depend on the dialect, the versions of the documents did not change
+    hoverer->clearCache();
+    navigator->clearCache();
+}
+
+void WooWooAnalyzer::refreshDocuments(const std::set<DialectedWooWooDocument *> &documents) {
+    struct Refresh {
+        DialectedWooWooDocument *document;
+        bool materialized;
+        decltype(DocumentIndex::definitionSites) definitionSites;
+    };
+    std::vector<Refresh> refreshes;
+    for (DialectedWooWooDocument *document: documents) {
+        if (!document->diskState.has_value()) {
+            // changed in memory, but possibly saved since
+            document->refreshDiskState();
+        } else if (changedOnDisk(document)) {
+            refreshes.push_back(Refresh{document, document->isMaterialized(), document->getIndex().definitionSites});
+        }
+    }
+
+    // the documents are independent, only the projects and the caches are shared
+    forEachInParallel(refreshes.size(), [&refreshes](size_t i) {
+        DialectedWooWooDocument *document = refreshes[i].document;
+        if (refreshes[i].materialized) {
+            document->updateSource();
+        } else {
+            document->materialize();
+        }
+    });
+
+    for (Refresh &refresh: refreshes) {
+        DialectedWooWooDocument *document = refresh.document;
+        if (document->project) {
+            document->project->documentChanged(document);
+        }
+        if (refresh.materialized) {
+            residentDocuments.touch(document);
+        } else {
+            // only the index was kept, it is not kept parsed now either
+            document->dematerialize();
+        }
+        if (diagnosticsScheduler) {
+            diagnosticsScheduler->schedule(utils::pathToUri(document->documentPath));
+            scheduleDependentDiagnostics(document->project, document, refresh.definitionSites,
+                                         document->getIndex().definitionSites);
+        }
+    }
+}
+
+void WooWooAnalyzer::addDiscoveredDocuments(const std::map<std::string, std::optional<fs::path>> &projectFolders) {
+    std::vector<std::pair<fs::path, WooWooProject *>> discovered;
+    for (const auto &[path, projectFolder]: projectFolders) {
+        discovered.emplace_back(path, getOrCreateProject(projectFolder));
+    }
+    std::vector<std::shared_ptr<DialectedWooWooDocument>> documents(discovered.size());
+    forEachInParallel(discovered.size(), [&](size_t i) {
+        documents[i] = WooWooProject::createDocument(discovered[i].first, indexCacheFor(discovered[i].first),
+                                                     discovered[i].second->dialect);
+    });
+
+    for (size_t i = 0; i < discovered.size(); ++i) {
+        WooWooProject *project = discovered[i].second;
+        project->addDocument(documents[i]);
+        documentTable.add(documents[i].get());
+        // references to it may have been unresolved until now
+        scheduleDependentDiagnostics(project, documents[i].get(), {}, documents[i]->getIndex().definitionSites);
+    }
+}
+
+void WooWooAnalyzer::forEachInParallel(size_t count, const std::function<void(size_t)> &task) {
+    if (!threadPool || threadPool->size() < 2 || count < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+    std::vector<std::future<void>> done;
+    done.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        done.emplace_back(threadPool->submit([&task, i]() { task(i); }, Lane::Indexing));
+    }
+    // every task is waited for before a failure is passed on, they use the caller's state
+    std::exception_ptr failure;
+    for (auto &finished: done) {
+        try {
+            finished.get();
+        } catch (...) {
+            if (!failure) failure = std::current_exception();
+        }
+    }
+    if (failure) std::rethrow_exception(failure);
+}
+
+std::map<std::string, uint64_t> WooWooAnalyzer::getStats() {
+    return Stats::counters();
+}
+
+std::map<std::string, TimerSummary> WooWooAnalyzer::getTimerStats() {
+    return Stats::timers();
+}
+
+std::string WooWooAnalyzer::getPrometheusStats() {
+    return Stats::prometheus();
+}
+
+void WooWooAnalyzer::setLargeFileMode(size_t thresholdBytes, uint32_t parseBudgetMilliseconds) {
+    WooWooDocument::setLargeFileMode(thresholdBytes, static_cast<uint64_t>(parseBudgetMilliseconds) * 1000);
+}
+
+void WooWooAnalyzer::setViewport(const TextDocumentIdentifier &tdi, const Range &range) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    auto document = getDocumentByUri(tdi.uri);
+    if (!document) return;
+    document->viewport = LineSpan{range.start.line, std::max(range.start.line, range.end.line)};
+}
+
+bool WooWooAnalyzer::isPartial(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    auto document = getDocumentByUri(tdi.uri);
+    return document && (document->isLarge() || document->hasDeferredWork());
+}
+
+void WooWooAnalyzer::startSpanTracing(size_t maxEventsPerThread) {
+    SpanTracer::start(maxEventsPerThread);
+}
+
+void WooWooAnalyzer::stopSpanTracing() {
+    SpanTracer::stop();
+}
+
+void WooWooAnalyzer::writeSpanTrace(const std::string &tracePath) {
+    SpanTracer::writeChromeTrace(tracePath);
+}
+
+std::string WooWooAnalyzer::getSpanTrace() {
+    return SpanTracer::chromeTrace();
+}
+
+MemoryUsage WooWooAnalyzer::memoryUsage() {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    MemoryUsage usage;
+    for (const WooWooProject *project: projects) {
+        project->measureMemory(usage);
+    }
+    for (const DocumentMemoryUsage &document: usage.documents) {
+        usage.subsystems["source"] += document.source;
+        usage.subsystems["syntax_trees"] += document.tree;
+        usage.subsystems["meta_trees"] += document.metaTrees;
+        usage.subsystems["utf_mappings"] += document.utfMappings;
+        usage.subsystems["comment_lines"] += document.commentLines;
+        usage.subsystems["document_indexes"] += document.index;
+    }
+    usage.subsystems["document_table"] = documentTable.memoryUsage();
+    // shared by all analyzers of the process
+    usage.subsystems["symbols"] = SymbolTable::getInstance()->memoryUsage();
+    usage.subsystems["queries"] = QueryRegistry::getInstance()->memoryUsage();
+    usage.subsystems["dialect"] = DialectManager::getInstance()->memoryUsage();
+    // the dialects named by Woofiles, once each even if several projects share one
+    std::set<const DialectManager *> projectDialects;
+    for (const WooWooProject *project: projects) {
+        if (project->dialect && projectDialects.insert(project->dialect.get()).second) {
+            usage.subsystems["dialect"] += project->dialect->memoryUsage();
+        }
+    }
+
+    for (const auto &[subsystem, bytes]: usage.subsystems) {
+        usage.total += bytes;
+    }
+    std::sort(usage.documents.begin(), usage.documents.end(),
+              [](const DocumentMemoryUsage &a, const DocumentMemoryUsage &b) { return a.uri < b.uri; });
+    return usage;
+}
+
+void WooWooAnalyzer::scheduleDependentDiagnostics(WooWooProject *project, const DialectedWooWooDocument *document,
+                                                  const decltype(DocumentIndex::definitionSites) &before,
+                                                  const decltype(DocumentIndex::definitionSites) &after) {
+    if (!diagnosticsScheduler || !project) return;
+
+    std::set<DialectedWooWooDocument *> dependents;
+    auto addDependents = [&](const decltype(DocumentIndex::definitionSites) &from,
+                             const decltype(DocumentIndex::definitionSites) &to) {
+        for (const auto &byKey: from) {
+            auto other = to.find(byKey.first);
+            const std::string &metaKey = SymbolTable::getInstance()->name(byKey.first);
+            for (const auto &byValue: byKey.second) {
+                if (other != to.end()) {
+                    auto otherRanges = other->second.find(byValue.first);
+                    // moved, but defined as many times as before
+                    if (otherRanges != other->second.end() && otherRanges->second.size() == byValue.second.size()) {
+                        continue;
+                    }
+                }
+                // references to the value may have become (un)resolved
+                auto referencing = project->getDocumentsReferencing(metaKey, byValue.first);
+                dependents.insert(referencing.begin(), referencing.end());
+                // and other definitions of it may have become (or stopped being) duplicates
+                auto definedAt = project->getDefinitionSites(byKey.first, byValue.first);
+                if (definedAt) {
+                    for (const auto &byDocument: *definedAt) {
+                        dependents.insert(byDocument.first);
+                    }
+                }
+            }
+        }
+    };
+    // removed and added definitions
+    addDependents(before, after);
+    addDependents(after, before);
+
+    for (DialectedWooWooDocument *dependent: dependents) {
+        if (dependent != document) {
+            diagnosticsScheduler->schedule(utils::pathToUri(dependent->documentPath));
+        }
+    }
+}
+
+DialectedWooWooDocument * WooWooAnalyzer::findDocument(const std::string &pathToDoc) {
+    return documentTable.findByPath(pathToDoc);
+}
+
+
+WooWooProject *WooWooAnalyzer::getProjectByDocument(WooWooDocument * document) {
+    if (!document) return nullptr;
+    return document->project;
+}
+
+
+/**
+ * Changes the document without blocking the other requests while it is parsed.
+ *
+ * The change is applied to a copy of the current version (syntax trees are copied by ts_tree_copy,
+ * so the copy is cheap and the incremental parse still reuses the old tree). Readers keep using
+ * the current version until the new one is published, at once, under the request lock.
+ * Changes are applied one at a time, in the order they come.
+ */
+void WooWooAnalyzer::changeDocument(const std::string &uri, const std::function<void(DialectedWooWooDocument &)> &change) {
+    std::lock_guard<std::mutex> changeLock(changeMutex);
+
+    DocumentId id;
+    std::unique_ptr<DialectedWooWooDocument> newVersion;
+    std::unique_lock<PriorityMutex> lock(requestMutex, std::defer_lock);
+    DialectedWooWooDocument *document;
+    while (true) {
+        uint64_t previousVersion;
+        uint64_t previousDialectChanges;
+        {
+            std::lock_guard<PriorityMutex> copyLock(requestMutex);
+            document = getDocumentByUri(uri);
+            if (!document) return;
+            id = getDocumentId(document);
+            previousVersion = document->version;
+            previousDialectChanges = document->dialectChanges;
+            newVersion = std::make_unique<DialectedWooWooDocument>(*document);
+        }
+
+        change(*newVersion);
+        // the change changed nothing (the same text again), the current version stays, caches included
+        if (newVersion->version == previousVersion) return;
+
+        lock.lock();
+        // the document could have been deleted in the meantime
+        document = documentTable.get(id);
+        if (!document) return;
+        // or changed in place (read again from the disk, indexed by another dialect), the copy is outdated
+        if (document->version == previousVersion && document->dialectChanges == previousDialectChanges) break;
+        lock.unlock();
+    }
+    document->publish(*newVersion);
+    auto project = getProjectByDocument(document);
+    if (project) {
+        project->documentChanged(document);
+    }
+    residentDocuments.touch(document);
+
+    if (diagnosticsScheduler) {
+        diagnosticsScheduler->schedule(uri);
+        // after the publish, the copy holds the previous version
+        scheduleDependentDiagnostics(project, document, newVersion->getIndex().definitionSites,
+                                     document->getIndex().definitionSites);
+    }
+    if (document->hasDeferredWork()) {
+        // after the requests already waiting, a newer change makes it a no-op
+        requestExecutor->submit([this, uri]() { finishDeferredWork(uri); }, Lane::Background);
+    }
+}
+
+void WooWooAnalyzer::finishDeferredWork(const std::string &uri) {
+    {
+        PriorityLock lock(requestMutex, Lane::Background);
+        auto document = findDocument(utils::uriToPathString(uri));
+        if (!document || !document->hasDeferredWork()) return;
+    }
+    changeDocument(uri, [](DialectedWooWooDocument &document) {
+        document.finishDeferredWork();
+    });
 }
 
 /**
  * Handles renaming of files within the workspace and updates internal mappings and references.
  * This function processes a list of file renames, updating the document paths and project associations.
- * It supports renaming '.woo' files within their respective projects or to new locations, and also handles
- * the cleanup of documents no longer recognized as '.woo' files after the rename.
+ * It supports renaming '.woo' files within their respective projects or to new locations, renaming folders
+ * (every document in them is renamed), and also handles the cleanup of documents no longer recognized
+ * as '.woo' files after the rename. All the renames are resolved together, the include statements are
+ * refactored in a single pass.
  *
  * @param renames A list of pairs representing old and new URIs for the files being renamed.
  * @return A WorkspaceEdit object that details the changes made to document references.
  */
 WorkspaceEdit WooWooAnalyzer::renameFiles(const std::vector<std::pair<std::string, std::string>> &renames) {
-    WorkspaceEdit we;
+    std::lock_guard<PriorityMutex> lock(requestMutex);
 
-    std::vector<std::pair<std::string, std::string>> renamedDocuments;
+    // old and new paths of the renamed files, a renamed folder stands for the documents in it
+    std::vector<std::pair<std::string, std::string>> fileRenames;
     for (const auto &fileRename: renames) {
+        auto oldPath = utils::uriToPathString(fileRename.first);
+        auto newPath = utils::uriToPathString(fileRename.second);
+        if (utils::endsWith(oldPath, ".woo") || findDocument(oldPath)) {
+            fileRenames.emplace_back(oldPath, newPath);
+            continue;
+        }
+        for (WooWooProject *project: projects) {
+            for (DialectedWooWooDocument *document: project->getDocuments()) {
+                if (isWithin(document->documentPath, oldPath)) {
+                    fs::path renamedPath = fs::path(newPath) / document->documentPath.lexically_relative(oldPath);
+                    fileRenames.emplace_back(document->documentPath.generic_string(), renamedPath.generic_string());
+                }
+            }
+        }
+    }
 
-        auto oldUri = fileRename.first;
-        auto newUri = fileRename.second;
-        auto oldPath = utils::uriToPathString(oldUri);
-        auto newPath = utils::uriToPathString(newUri);
+    // the documents of a moved folder share their project, it is looked up once per folder
+    std::unordered_map<std::string, WooWooProject *> projectsByFolder;
+    auto findNewProject = [&](const std::string &path) {
+        std::string folder = fs::path(path).parent_path().generic_string();
+        auto found = projectsByFolder.find(folder);
+        if (found != projectsByFolder.end()) return found->second;
+        auto project = getProject(findProjectFolder(utils::pathToUri(path)));
+        if (!project) {
+            // Fall back to null project
+            project = getProject(std::nullopt);
+        }
+        projectsByFolder[folder] = project;
+        return project;
+    };
 
+    std::vector<std::pair<std::string, std::string>> renamedDocuments;
+    for (const auto &[oldPath, newPath]: fileRenames) {
         if (utils::endsWith(oldPath, ".woo") && utils::endsWith(newPath, ".woo")) {
             // Handle renaming of WooWoo files within the same or to a different project
-            auto document = getDocument(oldPath);
+            auto document = findDocument(oldPath);
             if (!document) continue;
             auto oldProject = getProjectByDocument(document);
             if (!oldProject) continue;
             auto documentShared = oldProject->getDocumentShared(document);
 
-            std::optional<fs::path> newProjectFolder = findProjectFolder(newUri);
-            auto newProject = getProject(newProjectFolder);
-            if (!newProject) {
-                // Fall back to null project
-                newProject = getProject(std::nullopt);
-            }
+            auto newProject = findNewProject(newPath);
             if (newProject) {
-                document->documentPath = newPath;
+                // the project looks the document up by its path, it has to be removed under the old one
                 oldProject->deleteDocument(document);
+                document->documentPath = newPath;
                 newProject->addDocument(documentShared);
+                documentTable.rename(document, oldPath);
             }
 
             renamedDocuments.emplace_back(oldPath, newPath);
 
         } else if (utils::endsWith(oldPath, ".woo")) {
             // Handle the case where a '.woo' document is renamed to a non-WooWoo format
-            deleteDocument(oldPath);
+            deleteDocument(findDocument(oldPath));
         } else {
             // Handle renaming of non-WooWoo files or conversion of non-WooWoo to '.woo' files
             // These are handled elsewhere as new documents through openDocument
@@ -226,33 +1189,68 @@ WorkspaceEdit WooWooAnalyzer::renameFiles(const std::vector<std::pair<std::strin
 
 
 /**
- * Processes deletions of files as notified by the client. This function currently handles the deletion
- * of individual document files by removing them from the internal state and associated data structures.
- * It does not handle the deletion of folders or Woofile files yet.
+ * Processes deletions of files as notified by the client, by removing the documents from the internal state
+ * and associated data structures. A deleted folder deletes every document in it.
+ * Deleted Woofiles are handled by didChangeWatchedFiles (or the workspace watcher).
  *
  * @param uris A list of URIs for the files that have been deleted.
  */
 void WooWooAnalyzer::didDeleteFiles(const std::vector<std::string> &uris) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    // a document can be deleted with its folder too
+    std::set<DialectedWooWooDocument *> deleted;
     for (const auto &deletedFileUri: uris) {
-
-        auto doc = getDocumentByUri(deletedFileUri);
+        auto deletedPath = utils::uriToPathString(deletedFileUri);
+        auto doc = findDocument(deletedPath);
         if (doc) {
-            deleteDocument(doc);
+            deleted.insert(doc);
+            continue;
+        }
+        for (WooWooProject *project: projects) {
+            for (DialectedWooWooDocument *document: project->getDocuments()) {
+                if (isWithin(document->documentPath, deletedPath)) {
+                    deleted.insert(document);
+                }
+            }
         }
     }
-    // NOTE: This function does not yet handle the deletion of folders or Woofiles.
+    for (DialectedWooWooDocument *document: deleted) {
+        deleteDocument(document);
+    }
+}
+
+void WooWooAnalyzer::didChangeWatchedFiles(const std::vector<FileEvent> &events) {
+    // created, changed and deleted files need the same reconciliation, what happened is read from the disk
+    std::vector<fs::path> changedPaths;
+    changedPaths.reserve(events.size());
+    for (const FileEvent &event: events) {
+        changedPaths.emplace_back(utils::uriToPathString(event.uri));
+    }
+    reconcileChangedPaths(changedPaths);
 }
 
 
 void WooWooAnalyzer::deleteDocument(const std::string &uri) {
-    auto doc = getDocumentByUri(uri);
+    auto doc = findDocument(utils::uriToPathString(uri));
     deleteDocument(doc);
 }
 
 void WooWooAnalyzer::deleteDocument(DialectedWooWooDocument * document) {
     if (!document) return;
-    for (auto project: projects) {
-        project->deleteDocument(document);
+    residentDocuments.forget(document);
+    highlighter->forgetDocument(documentTable.idOf(document));
+    linter->forgetDocument(documentTable.idOf(document));
+    hoverer->forgetDocument(documentTable.idOf(document));
+    navigator->forgetDocument(documentTable.idOf(document));
+    folder->forgetDocument(documentTable.idOf(document));
+    if (diagnosticsScheduler) {
+        diagnosticsScheduler->forget(utils::pathToUri(document->documentPath));
+        // what the document defined is not defined anymore
+        scheduleDependentDiagnostics(document->project, document, document->getIndex().definitionSites, {});
+    }
+    documentTable.remove(document);
+    if (document->project) {
+        document->project->deleteDocument(document);
     }
 }
 
@@ -260,43 +1258,232 @@ void WooWooAnalyzer::deleteDocument(DialectedWooWooDocument * document) {
 // - LSP-like public interface - - -
 
 std::string WooWooAnalyzer::hover(const TextDocumentPositionParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Hoverer::hover", "component", params.textDocument.uri);
     return hoverer->hover(params);
 }
 
-std::vector<int> WooWooAnalyzer::semanticTokens(const TextDocumentIdentifier &tdi) {
+SemanticTokensData WooWooAnalyzer::semanticTokens(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Highlighter::semanticTokens", "component", tdi.uri);
     return highlighter->semanticTokens(tdi);
 }
 
+SemanticTokens WooWooAnalyzer::semanticTokensFull(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Highlighter::semanticTokensFull", "component", tdi.uri);
+    return highlighter->semanticTokensFull(tdi);
+}
+
+SemanticTokensData WooWooAnalyzer::semanticTokensRange(const SemanticTokensRangeParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    // the client asks for the tokens of what it shows
+    if (auto document = getDocumentByUri(params.textDocument.uri)) {
+        document->viewport = LineSpan{params.range.start.line,
+                                      std::max(params.range.start.line, params.range.end.line)};
+    }
+    ScopedSpan span("Highlighter::semanticTokensRange", "component", params.textDocument.uri);
+    return highlighter->semanticTokensRange(params);
+}
+
+std::variant<SemanticTokens, SemanticTokensDelta> WooWooAnalyzer::semanticTokensDelta(const SemanticTokensDeltaParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Highlighter::semanticTokensDelta", "component", params.textDocument.uri);
+    return highlighter->semanticTokensDelta(params);
+}
+
 Location WooWooAnalyzer::goToDefinition(const DefinitionParams &params) {
-    return navigator->goToDefinition(params);
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::goToDefinition", "component", params.textDocument.uri);
+    Location definition = navigator->goToDefinition(params);
+    // the client is about to open the document the definition is in
+    if (!definition.uri.empty() && definition.uri != params.textDocument.uri) {
+        prefetchDocument(definition.uri);
+    }
+    return definition;
 }
 
 std::vector<Location> WooWooAnalyzer::references(const ReferenceParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::references", "component", params.textDocument.uri);
     return navigator->references(params);
 }
 
 WorkspaceEdit WooWooAnalyzer::rename(const RenameParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::rename", "component", params.textDocument.uri);
     return navigator->rename(params);
 }
 
-std::vector<CompletionItem> WooWooAnalyzer::complete(const CompletionParams &params) {
+ReferenceSearch WooWooAnalyzer::startReferences(const ReferenceParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::startReferences", "component", params.textDocument.uri);
+    // nothing to search for is a search which is done right away
+    return navigator->startReferences(params).value_or(ReferenceSearch());
+}
+
+std::vector<Location> WooWooAnalyzer::nextReferences(ReferenceSearch &search, size_t limit) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::nextReferences", "component");
+    auto locations = navigator->nextReferences(search, std::max<size_t>(limit, 1));
+    span.setBytes(locations.size());
+    return locations;
+}
+
+WorkspaceEdit WooWooAnalyzer::nextRenameEdits(ReferenceSearch &search, const std::string &newName, size_t limit) {
+    return Navigator::renameEdits(nextReferences(search, limit), newName);
+}
+
+CompletionList WooWooAnalyzer::complete(const CompletionParams &params) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Completer::complete", "component", params.textDocument.uri);
     return completer->complete(params);
 }
 
 std::vector<FoldingRange> WooWooAnalyzer::foldingRanges(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Folder::foldingRanges", "component", tdi.uri);
     return folder->foldingRanges(tdi);
 }
 
+DocumentAnalysis WooWooAnalyzer::analyzeDocument(const TextDocumentIdentifier &tdi, uint32_t features) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    DocumentAnalysis analysis;
+    // parsed here if it was unloaded, the components then find it resident
+    auto document = getDocumentByUri(tdi.uri);
+    if (!document) return analysis;
+    analysis.version = document->version;
+    if (document->isLarge()) {
+        // the YAML of the visible meta blocks is parsed once for all the features
+        document->parseDeferredMetas(document->visibleLines());
+    }
+
+    auto requested = [features](DocumentFeature feature) {
+        return (features & static_cast<uint32_t>(feature)) != 0;
+    };
+    if (requested(DocumentFeature::SemanticTokens)) {
+        ScopedSpan span("Highlighter::semanticTokens", "component", tdi.uri);
+        analysis.semanticTokens = highlighter->semanticTokens(tdi);
+    }
+    if (requested(DocumentFeature::Diagnostics)) {
+        ScopedSpan span("Linter::diagnose", "component", tdi.uri);
+        analysis.diagnostics = linter->diagnose(tdi);
+    }
+    if (requested(DocumentFeature::FoldingRanges)) {
+        ScopedSpan span("Folder::foldingRanges", "component", tdi.uri);
+        analysis.foldingRanges = folder->foldingRanges(tdi);
+    }
+    return analysis;
+}
+
+std::vector<DocumentSymbol> WooWooAnalyzer::documentSymbols(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Navigator::documentSymbols", "component", tdi.uri);
+    return navigator->documentSymbols(tdi);
+}
+
+std::vector<SymbolInformation> WooWooAnalyzer::workspaceSymbols(const std::string &query) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    // clients show only the first few, and send a new request as the query is typed
+    const size_t maxSymbols = 256;
+
+    std::vector<LabelIndex::Match> matches;
+    for (WooWooProject *project: projects) {
+        CancellationToken::current().throwIfCancelled();
+        auto projectMatches = project->searchLabels(query, maxSymbols);
+        matches.insert(matches.end(), projectMatches.begin(), projectMatches.end());
+    }
+    if (matches.size() > maxSymbols) {
+        std::partial_sort(matches.begin(), matches.begin() + maxSymbols, matches.end(), LabelIndex::isBetter);
+        matches.resize(maxSymbols);
+    } else {
+        std::sort(matches.begin(), matches.end(), LabelIndex::isBetter);
+    }
+
+    std::vector<SymbolInformation> symbols;
+    symbols.reserve(matches.size());
+    const SymbolTable *symbolTable = SymbolTable::getInstance();
+    for (const LabelIndex::Match &match: matches) {
+        const LabelIndex::Label *label = match.label;
+        symbols.emplace_back(label->value, SymbolKind::Key,
+                             Location(utils::pathToUri(label->document->documentPath), label->range),
+                             symbolTable->name(label->metaKey));
+    }
+    return symbols;
+}
+
 void WooWooAnalyzer::documentDidChange(const TextDocumentIdentifier &tdi, std::string &source) {
-    handleDocumentChange(tdi, source);
+    changeDocument(tdi.uri, [&source](DialectedWooWooDocument &document) {
+        document.updateSource(source);
+    });
+}
+
+/**
+ * Applies ranged content changes (as in textDocument/didChange with incremental sync) to a document.
+ * Only the changed text crosses the Python boundary and the document is re-parsed incrementally.
+ *
+ * @param tdi Identifier of the changed document.
+ * @param changes Pairs of range (UTF-16 based, as sent by the client) and the text replacing it.
+ *                A change without range replaces the whole document.
+ */
+void WooWooAnalyzer::documentDidChangeIncremental(const TextDocumentIdentifier &tdi,
+                                                  const std::vector<std::pair<std::optional<Range>, std::string>> &changes) {
+    changeDocument(tdi.uri, [&changes](DialectedWooWooDocument &document) {
+        std::vector<TextEdit> edits;
+        for (const auto &change: changes) {
+            if (!change.first.has_value()) {
+                // full text replacement, everything before it is irrelevant
+                edits.clear();
+                std::string fullSource = change.second;
+                document.updateSource(fullSource);
+                continue;
+            }
+            edits.emplace_back(change.first.value(), change.second);
+        }
+
+        if (!edits.empty()) {
+            document.updateSource(edits);
+        }
+    });
 }
 
 std::vector<Diagnostic> WooWooAnalyzer::diagnose(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Linter::diagnose", "component", tdi.uri);
     return linter->diagnose(tdi);
 }
 
+std::vector<PublishDiagnosticsParams> WooWooAnalyzer::checkWorkspace() {
+    // a workspace being loaded in the background is loaded completely first (the loader needs the lock)
+    finishWorkspaceLoad();
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    ScopedSpan span("Linter::check", "component");
+    std::vector<DialectedWooWooDocument *> documents;
+    for (WooWooProject *project: projects) {
+        auto projectDocuments = project->getDocuments();
+        documents.insert(documents.end(), projectDocuments.begin(), projectDocuments.end());
+    }
+    std::sort(documents.begin(), documents.end(),
+              [](const DialectedWooWooDocument *a, const DialectedWooWooDocument *b) {
+                  return a->documentPath < b->documentPath;
+              });
+    return collectInParallel<PublishDiagnosticsParams>(
+            documents, [this](DialectedWooWooDocument *document, std::vector<PublishDiagnosticsParams> &results) {
+                results.emplace_back(utils::pathToUri(document->documentPath), linter->check(document));
+            });
+}
+
+std::vector<Diagnostic> WooWooAnalyzer::diagnoseInBackground(const std::string &uri) {
+    PriorityLock lock(requestMutex, Lane::Background);
+    ScopedSpan span("Linter::diagnose", "component", uri);
+    return linter->diagnose(TextDocumentIdentifier(uri));
+}
+
 void WooWooAnalyzer::openDocument(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
     auto docPath = utils::uriToPathString(tdi.uri);
+    // loaded first by the next workspace load
+    openedPaths.insert(fs::path(docPath).generic_string());
     if (!getDocument(docPath)) {
         // unknown document opened
         std::optional<fs::path> projectFolder = findProjectFolder(tdi.uri);
@@ -307,8 +1494,50 @@ void WooWooAnalyzer::openDocument(const TextDocumentIdentifier &tdi) {
         }
         if (project) {
             project->loadDocument(docPath);
+            auto document = project->getDocument(docPath);
+            if (document) {
+                documentTable.add(document);
+                residentDocuments.touch(document);
+                // references to it may have been unresolved until now
+                scheduleDependentDiagnostics(project, document, {}, document->getIndex().definitionSites);
+            }
+        }
+    }
+    if (diagnosticsScheduler) {
+        diagnosticsScheduler->schedule(tdi.uri);
+    }
+}
+
+void WooWooAnalyzer::closeDocument(const TextDocumentIdentifier &tdi) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
+    auto docPath = utils::uriToPathString(tdi.uri);
+    openedPaths.erase(fs::path(docPath).generic_string());
+    auto document = findDocument(docPath);
+    if (!document) return;
+    highlighter->documentClosed(documentTable.idOf(document));
+
+    if (!document->diskState.has_value() && !document->refreshDiskState()) {
+        std::error_code ec;
+        if (!fs::exists(document->documentPath, ec)) {
+            // never saved, there is nothing left of it
+            deleteDocument(document);
+            return;
+        }
+        auto definitionSites = document->getIndex().definitionSites;
+        document->updateSource();
+        auto project = getProjectByDocument(document);
+        if (project) {
+            project->documentChanged(document);
+        }
+        if (diagnosticsScheduler) {
+            diagnosticsScheduler->schedule(tdi.uri);
+            scheduleDependentDiagnostics(project, document, definitionSites, document->getIndex().definitionSites);
         }
     }
+    // with idle eviction, it is kept parsed for a while in case the client opens it again
+    if (!idleEviction && document->dematerialize()) {
+        residentDocuments.forget(document);
+    }
 }
 
 WooWooProject *WooWooAnalyzer::getProject(const std::optional<fs::path> &path) {
@@ -320,11 +1549,34 @@ WooWooProject *WooWooAnalyzer::getProject(const std::optional<fs::path> &path) {
     return nullptr;
 }
 
+WooWooProject *WooWooAnalyzer::getOrCreateProject(const std::optional<fs::path> &projectFolder) {
+    auto project = getProject(projectFolder);
+    if (!project) {
+        project = projectFolder.has_value() ? new WooWooProject(projectFolder.value(), {}) : new WooWooProject();
+        projects.insert(project);
+        updateBibliographies({project}, false);
+    }
+    return project;
+}
+
+std::set<DialectedWooWooDocument *> WooWooAnalyzer::getDocumentsIncluding(const std::string &path) {
+    std::set<DialectedWooWooDocument *> including;
+    for (WooWooProject *project: projects) {
+        auto documents = project->getDocumentsIncluding(path);
+        if (documents) {
+            including.insert(documents->begin(), documents->end());
+        }
+    }
+    return including;
+}
+
 void WooWooAnalyzer::setTokenTypes(std::vector<std::string> tokenTypes) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
     return highlighter->setTokenTypes(std::move(tokenTypes));
 }
 
 void WooWooAnalyzer::setTokenModifiers(std::vector<std::string> tokenModifiers) {
+    std::lock_guard<PriorityMutex> lock(requestMutex);
     return highlighter->setTokenModifiers(std::move(tokenModifiers));
 }
 
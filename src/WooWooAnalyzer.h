@@ -6,14 +6,42 @@
 #define WUFF_WOOWOOANALYZER_H
 
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <map>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <variant>
 #include <pybind11/pytypes.h>
 #include "project/DialectedWooWooDocument.h"
 #include "parser/Parser.h"
 #include "lsp/LSPTypes.h"
 #include "project/WooWooProject.h"
+#include "utils/ThreadPool.h"
+#include "project/IndexCache.h"
+#include "project/DocumentLru.h"
+#include "project/DocumentTable.h"
+#include "utils/DiagnosticsScheduler.h"
+#include "utils/PeriodicTask.h"
+#include "utils/PriorityMutex.h"
+#include "utils/FileWatcher.h"
+#include "utils/SessionTrace.h"
+#include "utils/Stats.h"
+#include "utils/SpanTracer.h"
+#include "utils/CancellationToken.h"
+#include "components/DocumentAnalysis.h"
+#include "components/ReferenceSearch.h"
 
 class Hoverer;
 class Highlighter;
@@ -26,6 +54,15 @@ class Folder;
 namespace fs = std::filesystem;
 namespace py = pybind11;
 
+// numbers of documents of the workspace being loaded, found so far, parsed (or read from the cache)
+// and added to the indexes of their projects
+struct LoadProgress {
+    size_t discovered;
+    size_t parsed;
+    size_t indexed;
+    bool done;
+};
+
 class WooWooAnalyzer {
 private:
     std::set<WooWooProject *> projects;
@@ -35,48 +72,340 @@ private:
     Completer * completer;
     Linter * linter;
     Folder * folder;
+    // used to load documents in parallel, nullptr if everything happens on the calling thread
+    ThreadPool * threadPool = nullptr;
+    // held while the pool is replaced, queueDepths() reads it without the request mutex
+    std::mutex threadPoolMutex;
+    // fewer items are not worth a task of their own in collectInParallel
+    static const size_t MIN_ITEMS_PER_CHUNK = 16;
+    // directory where the indexes of loaded workspaces are kept between sessions, unset disables the cache
+    std::optional<fs::path> cacheDirectory;
+    // index caches of the workspace folders, a document uses the one of the innermost folder containing it
+    // shared with the documents of a load, which read them without the request lock
+    std::map<fs::path, std::shared_ptr<IndexCache>> indexCaches;
+    // every public request holds it, requests from different threads are processed one at a time
+    // (the ones of the client first, background work only gets it when no request waits for it)
+    PriorityMutex requestMutex;
+    // held while a document change is built, keeps the changes in order
+    std::mutex changeMutex;
+    // runs the requests submitted to run in the background, in the order they were submitted
+    ThreadPool * requestExecutor = nullptr;
+    // documents which are currently parsed, the rest of them is known only by the index
+    DocumentLru residentDocuments;
+    // every document of every project, resolves ids, paths and URIs without scanning the projects
+    DocumentTable documentTable;
+    // diagnoses changed documents in the background, unset until it is started
+    std::shared_ptr<DiagnosticsScheduler> diagnosticsScheduler;
+    // unloads the documents the client does not have open once they are idle, unset unless it is turned on
+    std::unique_ptr<PeriodicTask> idleEviction;
+
+    // a document of the workspace to be loaded
+    struct PendingDocument {
+        WooWooProject * project;
+        fs::path path;
+        bool opened;
+        // kept alive by the load even if the folder is loaded again or removed meanwhile
+        std::shared_ptr<const IndexCache> indexCache;
+        // of the project when the load began
+        std::shared_ptr<const DialectManager> dialect;
+    };
+    // loads the rest of the workspace after loadWorkspaceProgressive returned, guarded by loaderMutex
+    std::thread workspaceLoader;
+    std::mutex loaderMutex;
+    /**
+     * Held by a workspace load from its scan until its last document is added (on whichever thread that is),
+     * and by the changes of what a load uses without the request lock: the thread pool, the dialect
+     * and the projects. Loads therefore run one at a time. It is never taken while the request lock is held,
+     * a load takes that lock between its batches.
+     */
+    class LoadSlot {
+    public:
+        explicit LoadSlot(WooWooAnalyzer &analyzer);
+        ~LoadSlot();
+        LoadSlot(const LoadSlot &) = delete;
+        LoadSlot &operator=(const LoadSlot &) = delete;
+
+    private:
+        WooWooAnalyzer &analyzer;
+    };
+    std::mutex loadSlotMutex;
+    std::condition_variable loadSlotReleased;
+    bool loadSlotTaken = false;
+    std::atomic<bool> stopLoading{false};
+    std::atomic<bool> workspaceLoading{false};
+    std::atomic<size_t> documentsDiscovered{0};
+    std::atomic<size_t> documentsParsed{0};
+    std::atomic<size_t> documentsIndexed{0};
+    // paths of the documents opened by the client, they are loaded first
+    std::set<std::string> openedPaths;
+    // report changes of the workspace folders made outside of the client, by folder, none until it is started
+    std::map<fs::path, std::unique_ptr<FileWatcher>> fileWatchers;
+    // the batch delay of the watchers, unset while the workspace is not watched
+    std::optional<std::chrono::milliseconds> watchDelay;
+    // writes the requests to a trace file while a recording runs
+    SessionRecorder sessionRecorder;
 
 public:
     WooWooAnalyzer();
     ~WooWooAnalyzer(); 
+    // the dialect of the client, used by every project whose Woofile does not name one (their documents are
+    // indexed again)
     void setDialect(const std::string& dialectPath);
+
+    /**
+     * Runs the request (any callable using the public interface of this analyzer) on a background thread.
+     * The analyzer has to outlive the request.
+     */
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&request) {
+        return requestExecutor->submit(std::forward<F>(request));
+    }
+
+    // number of threads used to load workspaces, 0 picks the number of cores and 1 disables parallel loading
+    void setThreadPoolSize(size_t threadCount);
+    // the cache has to be set before the workspace is loaded to be used
+    void setCacheDirectory(const std::string& cacheDirectoryPath);
+    // adds the folder to the workspace folders (loading a folder again picks up its new documents),
+    // the projects and documents of the other folders stay as they are
     void loadWorkspace(const std::string& workspaceUri);
+    // returns once the opened documents are loaded, the others are loaded in the background
+    void loadWorkspaceProgressive(const std::string& workspaceUri);
+    // unloads the documents and projects of the folder which are not in another workspace folder
+    // (documents opened by the client stay until they are closed)
+    void removeWorkspaceFolder(const std::string& workspaceUri);
+    // URIs of the workspace folders, in the order they were added
+    std::vector<std::string> workspaceFolders();
+    // can be called at any time, without waiting for other requests
+    [[nodiscard]] LoadProgress loadProgress() const;
+    // false while documents of the workspace are still being loaded, results needing all of them are partial
+    [[nodiscard]] bool isWorkspaceLoaded() const;
+    // bytes the parsed documents may take before the least recently used ones are unloaded, 0 means no limit
+    void setMemoryBudget(size_t bytes);
+    // documents the client does not have open are unloaded (their index is kept) once no request used them for
+    // the time, 0 turns it off; without it, a document is unloaded as soon as the client closes it
+    void setIdleEviction(uint32_t idleMilliseconds);
+    // from now on, opened and changed documents (and the documents referencing what they define or defined)
+    // are diagnosed in the background, once they were not changed for the delay
+    void startBackgroundDiagnostics(uint32_t delayMilliseconds);
+    // diagnostics computed in the background since the last call, waits up to the timeout if there are none yet
+    std::vector<PublishDiagnosticsParams> takeDiagnostics(uint32_t timeoutMilliseconds);
+    // work waiting to be started, by lane ("interactive", "indexing" and "background"),
+    // not to be called while the thread pool is resized
+    std::map<std::string, size_t> queueDepths();
+    // counters of the work done (or skipped) by all analyzers of the process, by name
+    [[nodiscard]] static std::map<std::string, uint64_t> getStats();
+    // latencies of the requests (made through traced()) and of the stages of source updates, by name
+    [[nodiscard]] static std::map<std::string, TimerSummary> getTimerStats();
+    // the counters and the latency histograms in the Prometheus text format
+    [[nodiscard]] static std::string getPrometheusStats();
+    // estimated bytes held by every document (by part) and by the indexes, queries and the dialect
+    MemoryUsage memoryUsage();
+    // documents of at least thresholdBytes (0 turns the mode off) are large: an edit is parsed for at most
+    // parseBudgetMilliseconds (0 for no budget) and the rest of the parse and the YAML out of view is finished
+    // in the background, highlighting, folding and diagnostics are limited to the viewport
+    void setLargeFileMode(size_t thresholdBytes, uint32_t parseBudgetMilliseconds);
+    // the lines the client shows, set also by the range of semantic tokens asked for
+    void setViewport(const TextDocumentIdentifier & tdi, const Range & range);
+    // whether the results for the document are partial (limited to the viewport or waiting for a deferred parse)
+    bool isPartial(const TextDocumentIdentifier & tdi);
+    // from now on, documents, Woofiles, bibliographies and .gitignore files of the loaded workspace changed on disk
+    // (by the client or anything else) are picked up, changes are applied once none came for the delay
+    void watchWorkspace(uint32_t batchDelayMilliseconds);
+    void stopWatchingWorkspace();
+    // from now on, the requests made through traced() are written to the trace file (replaced if it exists)
+    // with their arguments and durations, until the recording is stopped
+    void startRecording(const std::string& tracePath);
+    void stopRecording();
+
+    // from now on, requests, component calls, parses, indexing and queries are traced as spans
+    // (at most maxEventsPerThread per thread), the spans of the previous tracing are dropped
+    static void startSpanTracing(size_t maxEventsPerThread);
+    static void stopSpanTracing();
+    // the spans traced so far in the Chrome Trace Event format, for chrome://tracing or Perfetto
+    static void writeSpanTrace(const std::string& tracePath);
+    [[nodiscard]] static std::string getSpanTrace();
+
+    // calls the request, timing it under the name (a string literal), tracing it while spans are traced
+    // and recording it while a recording runs
+    template<typename Result, typename... Params, typename... Args>
+    Result traced(const char *name, Result (WooWooAnalyzer::*request)(Params...), Args &... args) {
+        ScopedTimer timer(Stats::timerId(name));
+        ScopedSpan span(name, "request");
+        if (!sessionRecorder.isRecording()) return (this->*request)(args...);
+        SessionRecorder::Call call(sessionRecorder, name, SessionRecorder::encode(args...));
+        return (this->*request)(args...);
+    }
+    // returned documents are parsed (they are read again if only their index was kept)
     DialectedWooWooDocument * getDocumentByUri(const std::string & docUri);
     DialectedWooWooDocument * getDocument(const std::string& pathToDoc);
+    void materializeDocument(DialectedWooWooDocument * document);
+    // the client is likely to open the document next: it is parsed if only its index is known, and its semantic
+    // tokens and diagnostics are computed in the background, so that its first requests are answered from caches
+    void prefetchDocument(const std::string & uri);
+    DialectedWooWooDocument * getDocumentById(DocumentId id);
+    // without parsing the document, for the ones whose index is enough; nullptr if it was removed
+    [[nodiscard]] DialectedWooWooDocument * findDocumentById(DocumentId id) const;
+    [[nodiscard]] DocumentId getDocumentId(const DialectedWooWooDocument * document) const;
     
     WooWooProject * getProjectByDocument(WooWooDocument * document);
     WooWooProject * getProject(const std::optional<fs::path> &path);
+    WooWooProject * getOrCreateProject(const std::optional<fs::path> &projectFolder);
+    // documents of all projects including the file (by its absolute, lexically normal path)
+    std::set<DialectedWooWooDocument *> getDocumentsIncluding(const std::string &path);
+
+    /**
+     * Calls collect(item, results) for every item, in chunks on the thread pool and the calling thread
+     * if there are enough items. Every chunk collects into a buffer of its own, the buffers are concatenated
+     * in the order of the items, so the result does not depend on the pool. The items must be independent,
+     * the cancellation token of the request is passed on to the chunks.
+     */
+    template<typename Result, typename Item, typename Collect>
+    std::vector<Result> collectInParallel(const std::vector<Item> &items, Collect &&collect) {
+        size_t chunkCount = 1;
+        if (threadPool && threadPool->size() > 1) {
+            chunkCount = std::clamp<size_t>(items.size() / MIN_ITEMS_PER_CHUNK, 1, threadPool->size() + 1);
+        }
+        std::vector<std::vector<Result>> buffers(chunkCount);
+        auto runChunk = [&items, &collect, &buffers, chunkCount](size_t chunk) {
+            size_t end = items.size() * (chunk + 1) / chunkCount;
+            for (size_t i = items.size() * chunk / chunkCount; i < end; ++i) {
+                CancellationToken::current().throwIfCancelled();
+                collect(items[i], buffers[chunk]);
+            }
+        };
+
+        std::vector<std::future<void>> done;
+        done.reserve(chunkCount - 1);
+        CancellationToken token = CancellationToken::current();
+        for (size_t chunk = 1; chunk < chunkCount; ++chunk) {
+            done.emplace_back(threadPool->submit([&runChunk, token, chunk]() {
+                CancellationScope scope(token);
+                runChunk(chunk);
+            }, Lane::Interactive));
+        }
+        // every chunk is waited for before a failure is passed on, they use the caller's state
+        std::exception_ptr failure;
+        try {
+            runChunk(0);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        for (auto &finished: done) {
+            try {
+                finished.get();
+            } catch (...) {
+                if (!failure) failure = std::current_exception();
+            }
+        }
+        if (failure) std::rethrow_exception(failure);
+
+        if (chunkCount == 1) return std::move(buffers[0]);
+        size_t total = 0;
+        for (const auto &buffer: buffers) total += buffer.size();
+        std::vector<Result> results;
+        results.reserve(total);
+        for (auto &buffer: buffers) {
+            std::move(buffer.begin(), buffer.end(), std::back_inserter(results));
+        }
+        return results;
+    }
 
     // LSP-like functionalities
     std::string hover(const TextDocumentPositionParams &params);
-    std::vector<int> semanticTokens(const TextDocumentIdentifier & tdi);
+    SemanticTokensData semanticTokens(const TextDocumentIdentifier & tdi);
+    SemanticTokens semanticTokensFull(const TextDocumentIdentifier & tdi);
+    SemanticTokensData semanticTokensRange(const SemanticTokensRangeParams & params);
+    std::variant<SemanticTokens, SemanticTokensDelta> semanticTokensDelta(const SemanticTokensDeltaParams & params);
     Location goToDefinition(const DefinitionParams& params);
-    std::vector<CompletionItem> complete(const CompletionParams & params);
+    CompletionList complete(const CompletionParams & params);
     std::vector<Location> references(const ReferenceParams & params);
     WorkspaceEdit rename(const RenameParams & params);
+    // references and rename in chunks (LSP partial results): the search is started, then continued until it is done;
+    // a chunk holds the locations of whole documents, at least limit of them unless it is the last one
+    ReferenceSearch startReferences(const ReferenceParams & params);
+    std::vector<Location> nextReferences(ReferenceSearch & search, size_t limit);
+    WorkspaceEdit nextRenameEdits(ReferenceSearch & search, const std::string & newName, size_t limit);
     std::vector<Diagnostic> diagnose(const TextDocumentIdentifier & tdi); 
+    // diagnostics of every document of the workspace (once it is loaded) by the path of the document, checked
+    // in parallel; the documents whose cached index has no syntax errors are not read at all
+    std::vector<PublishDiagnosticsParams> checkWorkspace();
     std::vector<FoldingRange> foldingRanges(const TextDocumentIdentifier & tdi);
+    // the features (DocumentFeature flags) of the current version of the document in one request, the document is
+    // looked up and the lock taken once; every feature comes from the per-version cache of its component
+    DocumentAnalysis analyzeDocument(const TextDocumentIdentifier & tdi, uint32_t features);
+    std::vector<DocumentSymbol> documentSymbols(const TextDocumentIdentifier & tdi);
+    // labels of all projects matching the query (by prefix, substring or fuzzy), best matches first
+    std::vector<SymbolInformation> workspaceSymbols(const std::string & query);
     
     // LSP support functions
 
     void setTokenTypes(std::vector<std::string> tokenTypes);
     void setTokenModifiers (std::vector<std::string> tokenModifiers);
     void documentDidChange(const TextDocumentIdentifier & tdi, std::string &source);
+    void documentDidChangeIncremental(const TextDocumentIdentifier & tdi,
+                                      const std::vector<std::pair<std::optional<Range>, std::string>> & changes);
     WorkspaceEdit renameFiles(const std::vector<std::pair<std::string, std::string>> & renames);
     void openDocument(const TextDocumentIdentifier & tdi);
+    // the content on disk is the one which counts from now on, changes the client did not save are dropped
+    void closeDocument(const TextDocumentIdentifier & tdi);
     void didDeleteFiles(const std::vector<std::string> & uris);
+    // all the events are applied at once, as one change of the workspace
+    void didChangeWatchedFiles(const std::vector<FileEvent> & events);
     
 private:
 
-    std::vector<fs::path> findProjectFolders(const fs::path& rootPath);
     std::optional<fs::path> findProjectFolder(const std::string& uri);
+    // the document without reading and parsing it if only its cached index is loaded
+    DialectedWooWooDocument * findDocument(const std::string& pathToDoc);
+    void saveIndexCache();
+    std::shared_ptr<std::vector<PendingDocument>> beginWorkspaceLoad(const std::string& workspaceUri);
+    void loadPendingDocuments(const std::vector<PendingDocument> & pending, size_t begin, size_t end);
+    // waits for the loads of the workspace in progress (in the background or on other threads)
+    void finishWorkspaceLoad();
+    // brings the projects and documents in line with the disk after the paths (files or folders) changed
+    void reconcileChangedPaths(const std::vector<fs::path> & changedPaths);
+    /**
+     * Scans the workspace folders overlapping the scopes again and adds, removes or moves the documents within
+     * the scopes to match them; documents within changedPaths are added to affected.
+     */
+    void reconcileWorkspaceFolders(const std::vector<fs::path> & scopes, const std::vector<fs::path> & changedPaths,
+                                   std::set<DialectedWooWooDocument *> & affected);
+    // the innermost workspace folder containing the path, nullopt if there is none
+    [[nodiscard]] std::optional<fs::path> workspaceFolderOf(const fs::path & path) const;
+    // the index cache of the innermost workspace folder containing the document, nullptr if it has none
+    [[nodiscard]] const IndexCache * indexCacheFor(const fs::path & documentPath) const;
+    void watchWorkspaceFolder(const fs::path & folderPath);
+    // reads the document again if it changed on disk and was not changed in memory, returns whether it did
+    [[nodiscard]] static bool changedOnDisk(const DialectedWooWooDocument * document);
+    // brings the bibliographies of the projects in line with their Woofiles (read again if reloadWoofiles is set)
+    // and with the disk, the changed files of all of them are parsed in parallel
+    void updateBibliographies(const std::vector<WooWooProject *> & updated, bool reloadWoofiles);
+    // indexes every document of the projects again by the dialect of its project (in parallel if possible)
+    void reindexProjects(const std::vector<WooWooProject *> & reindexed);
+    // reads the documents changed on disk again (in parallel if possible), unless they were changed in memory
+    void refreshDocuments(const std::set<DialectedWooWooDocument *> & documents);
+    // creates the documents in parallel if possible and adds them to the projects of the folders
+    void addDiscoveredDocuments(const std::map<std::string, std::optional<fs::path>> & projectFolders);
+    // runs the task for every index from 0 to count on the thread pool if there is one, returns once all are done
+    void forEachInParallel(size_t count, const std::function<void(size_t)> & task);
     
     void deleteDocument(DialectedWooWooDocument * document);
     void deleteDocument(const std::string & uri);
-    void handleDocumentChange(const TextDocumentIdentifier & tdi, std::string & source);
-    static std::set<fs::path> findAllWooFiles(const fs::path  & rootPath);
+    // applies the change to a copy of the document without the request lock and publishes the copy; if the document
+    // was changed in place meanwhile, the change is applied again to a copy of the current version
+    void changeDocument(const std::string &uri, const std::function<void(DialectedWooWooDocument &)> &change);
+    // finishes the parse and the meta blocks deferred by the large-file mode as a new version of the document
+    void finishDeferredWork(const std::string &uri);
+    // diagnose() in the background lane, yields the lock to the requests of the client
+    std::vector<Diagnostic> diagnoseInBackground(const std::string &uri);
+    // schedules the documents of the project referencing or defining values
+    // whose definitions differ between the two versions of the definition sites
+    void scheduleDependentDiagnostics(WooWooProject * project, const DialectedWooWooDocument * document,
+                                      const decltype(DocumentIndex::definitionSites) & before,
+                                      const decltype(DocumentIndex::definitionSites) & after);
 
-    fs::path workspaceRootPath;
+    // lexically normal, in the order they were added
+    std::vector<fs::path> workspaceFolderPaths;
 };
 
 
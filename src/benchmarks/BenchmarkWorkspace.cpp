@@ -0,0 +1,102 @@
+#include "BenchmarkWorkspace.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include "../dialect/DialectManager.h"
+#include "../utils/utils.h"
+
+#ifndef WUFF_TEST_FILES
+#define WUFF_TEST_FILES "tests/files"
+#endif
+
+namespace {
+    size_t sizeFromEnvironment(const char *name, size_t defaultValue) {
+        const char *value = std::getenv(name);
+        if (!value) return defaultValue;
+        char *end = nullptr;
+        unsigned long long parsed = std::strtoull(value, &end, 10);
+        return end != value ? static_cast<size_t>(parsed) : defaultValue;
+    }
+
+    void writeFile(const fs::path &path, const std::string &content) {
+        fs::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    // labels "ctN" (and references to them) made unique by the suffix
+    std::string withLabelSuffix(const std::string &content, const std::string &suffix) {
+        static const std::regex label(R"(\bct(\d+)\b)");
+        return std::regex_replace(content, label, "ct$1" + suffix);
+    }
+}
+
+const BenchmarkWorkspace &BenchmarkWorkspace::get() {
+    static BenchmarkWorkspace workspace;
+    return workspace;
+}
+
+BenchmarkWorkspace::BenchmarkWorkspace() {
+    fs::path testFiles = fs::absolute(WUFF_TEST_FILES);
+    fs::path testProject = testFiles / "test_project";
+    dialectPath = testFiles / "fit_math.yaml";
+    projectCount = sizeFromEnvironment("WUFF_BENCH_PROJECTS", 25);
+    size_t blockCount = sizeFromEnvironment("WUFF_BENCH_DOCUMENT_BLOCKS", 2000);
+
+    root = fs::temp_directory_path() / ("wuff-benchmark-" + std::to_string(std::rand()));
+    // next to the workspace, not to be loaded with it
+    generatedRoot = root;
+    generatedRoot += "-generated";
+    for (size_t project = 0; project < projectCount; ++project) {
+        // projects do not see each other's labels, the copies can keep them
+        fs::path projectFolder = root / ("project" + std::to_string(project));
+        fs::create_directories(projectFolder);
+        fs::copy(testProject, projectFolder, fs::copy_options::recursive);
+    }
+
+    std::string block = utils::readFile(testProject / "file1.woo").value_or("");
+    // the include of the test project points nowhere in the large document
+    block = block.substr(0, block.find(".include"));
+    for (size_t i = 0; i < blockCount; ++i) {
+        largeDocument += withLabelSuffix(block, "-" + std::to_string(i));
+    }
+    largeDocumentPath = root / "large" / "large.woo";
+    writeFile(root / "large" / "Woofile", "");
+    writeFile(largeDocumentPath, largeDocument);
+
+    std::cerr << "Benchmark workspace: " << root << " (" << projectCount << " projects, large document of "
+              << largeDocument.size() << " bytes)" << std::endl;
+}
+
+BenchmarkWorkspace::~BenchmarkWorkspace() {
+    std::error_code ec;
+    fs::remove_all(root, ec);
+    fs::remove_all(generatedRoot, ec);
+}
+
+std::string BenchmarkWorkspace::workspaceUri() const {
+    return utils::pathToUri(root);
+}
+
+std::string BenchmarkWorkspace::documentUri(size_t project, const std::string &fileName) const {
+    return utils::pathToUri(root / ("project" + std::to_string(project)) / fileName);
+}
+
+const GeneratedWorkspace &BenchmarkWorkspace::generated(size_t filesPerProject) const {
+    auto existing = generatedWorkspaces.find(filesPerProject);
+    if (existing != generatedWorkspaces.end()) return existing->second;
+
+    DialectManager *dialectManager = DialectManager::getInstance();
+    if (!dialectManager->activeDialect) {
+        dialectManager->loadDialect(dialectPath.string());
+    }
+    GeneratorOptions options = GeneratorOptions::fromEnvironment();
+    options.filesPerProject = filesPerProject;
+    WorkspaceGenerator generator(*dialectManager->activeDialect, options);
+    GeneratedWorkspace workspace = generator.generate(generatedRoot / std::to_string(filesPerProject));
+
+    std::cerr << "Generated workspace: " << workspace.root << " (" << workspace.documentCount << " documents, "
+              << workspace.referenceCount << " references, " << workspace.byteCount << " bytes)" << std::endl;
+    return generatedWorkspaces.emplace(filesPerProject, std::move(workspace)).first->second;
+}
@@ -0,0 +1,49 @@
+#ifndef WUFF_BENCHMARKWORKSPACE_H
+#define WUFF_BENCHMARKWORKSPACE_H
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include "WorkspaceGenerator.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * A temporary workspace the benchmarks run on, removed when the process ends.
+ *
+ * It consists of copies of tests/files/test_project, each one a project of its own, and of one large document
+ * made of the blocks of file1.woo repeated (with labels made unique per block).
+ * Sizes are taken from the environment: WUFF_BENCH_PROJECTS (default 25) and WUFF_BENCH_DOCUMENT_BLOCKS
+ * (default 2000).
+ * Workspaces of the WorkspaceGenerator are written next to it on demand, one for each size the scaling benchmarks
+ * ask for.
+ */
+class BenchmarkWorkspace {
+public:
+    static const BenchmarkWorkspace &get();
+
+    fs::path root;
+    fs::path dialectPath;
+    size_t projectCount;
+    // path of the large document, in a project of its own
+    fs::path largeDocumentPath;
+    std::string largeDocument;
+
+    [[nodiscard]] std::string workspaceUri() const;
+    // a document of one of the copies of test_project
+    [[nodiscard]] std::string documentUri(size_t project, const std::string &fileName) const;
+
+    // a generated workspace with GeneratorOptions::fromEnvironment() and the number of files per project
+    [[nodiscard]] const GeneratedWorkspace &generated(size_t filesPerProject) const;
+
+    ~BenchmarkWorkspace();
+
+private:
+    BenchmarkWorkspace();
+
+    fs::path generatedRoot;
+    mutable std::map<size_t, GeneratedWorkspace> generatedWorkspaces;
+};
+
+
+#endif //WUFF_BENCHMARKWORKSPACE_H
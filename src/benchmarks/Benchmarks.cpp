@@ -0,0 +1,281 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#ifdef __linux__
+#include <cstdio>
+#include <unistd.h>
+#endif
+#include "BenchmarkWorkspace.h"
+#include "../WooWooAnalyzer.h"
+#include "../parser/Parser.h"
+#include "../project/SourceScanner.h"
+#include "../project/UTF8toUTF16Mapping.h"
+#include "../utils/utils.h"
+
+namespace {
+    // the analyzer the component benchmarks share, with the benchmark workspace loaded
+    WooWooAnalyzer &loadedAnalyzer() {
+        static WooWooAnalyzer *analyzer = []() {
+            const BenchmarkWorkspace &workspace = BenchmarkWorkspace::get();
+            auto created = new WooWooAnalyzer();
+            created->setDialect(workspace.dialectPath.string());
+            created->loadWorkspace(workspace.workspaceUri());
+            return created;
+        }();
+        return *analyzer;
+    }
+
+    TextDocumentIdentifier benchmarkDocument() {
+        return TextDocumentIdentifier(BenchmarkWorkspace::get().documentUri(0, "file1.woo"));
+    }
+
+    TextDocumentIdentifier largeDocument() {
+        loadedAnalyzer();
+        return TextDocumentIdentifier(utils::pathToUri(BenchmarkWorkspace::get().largeDocumentPath));
+    }
+
+    void setBytesProcessed(benchmark::State &state, size_t bytes) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    }
+
+    // resident set size of the process in MiB, 0 where it is not known
+    double residentMegabytes() {
+#ifdef __linux__
+        FILE *statm = std::fopen("/proc/self/statm", "r");
+        if (!statm) return 0;
+        unsigned long long size = 0, resident = 0;
+        int read = std::fscanf(statm, "%llu %llu", &size, &resident);
+        std::fclose(statm);
+        if (read != 2) return 0;
+        return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#else
+        return 0;
+#endif
+    }
+
+    void setWorkspaceCounters(benchmark::State &state, const GeneratedWorkspace &workspace) {
+        state.counters["documents"] = static_cast<double>(workspace.documentCount);
+        state.counters["references"] = static_cast<double>(workspace.referenceCount);
+        state.counters["rss_mb"] = residentMegabytes();
+        setBytesProcessed(state, workspace.byteCount);
+    }
+}
+
+// - - - Parsing
+
+static void BM_ParseWooWoo(benchmark::State &state) {
+    const std::string &source = BenchmarkWorkspace::get().largeDocument;
+    for (auto _: state) {
+        TSTree *tree = Parser::getInstance()->parseWooWoo(source);
+        benchmark::DoNotOptimize(tree);
+        ts_tree_delete(tree);
+    }
+    setBytesProcessed(state, source.size());
+}
+BENCHMARK(BM_ParseWooWoo)->Unit(benchmark::kMillisecond);
+
+extern "C" {
+void *tree_sitter_woowoo_external_scanner_create();
+unsigned tree_sitter_woowoo_external_scanner_serialize(void *payload, char *state);
+void tree_sitter_woowoo_external_scanner_deserialize(void *payload, const char *buffer, unsigned length);
+void tree_sitter_woowoo_external_scanner_destroy(void *payload);
+}
+
+// the parser restores the scanner before every external token, this is its cost per token
+static void BM_ScannerStateRoundTrip(benchmark::State &state) {
+    void *scanner = tree_sitter_woowoo_external_scanner_create();
+    char buffer[1024];
+    for (auto _: state) {
+        unsigned length = tree_sitter_woowoo_external_scanner_serialize(scanner, buffer);
+        tree_sitter_woowoo_external_scanner_deserialize(scanner, buffer, length);
+        benchmark::DoNotOptimize(buffer);
+    }
+    tree_sitter_woowoo_external_scanner_destroy(scanner);
+}
+BENCHMARK(BM_ScannerStateRoundTrip);
+
+// a word typed in the middle of the large document, the old tree reused around it
+static void BM_ReparseWooWooEdit(benchmark::State &state) {
+    const std::string &source = BenchmarkWorkspace::get().largeDocument;
+    size_t lineEnd = source.find('\n', source.size() / 2);
+    auto at = static_cast<uint32_t>(lineEnd == std::string::npos ? source.size() : lineEnd);
+    std::string edited = source;
+    edited.insert(at, " x");
+    size_t lineStart = source.rfind('\n', at == 0 ? 0 : at - 1);
+    lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+    auto row = static_cast<uint32_t>(std::count(source.begin(), source.begin() + at, '\n'));
+    auto column = static_cast<uint32_t>(at - lineStart);
+    TSInputEdit edit{at, at, at + 2, {row, column}, {row, column}, {row, column + 2}};
+
+    TSTree *tree = Parser::getInstance()->parseWooWoo(source);
+    for (auto _: state) {
+        TSTree *oldTree = ts_tree_copy(tree);
+        ts_tree_edit(oldTree, &edit);
+        TSTree *reparsed = Parser::getInstance()->parseWooWoo(edited, oldTree);
+        benchmark::DoNotOptimize(reparsed);
+        ts_tree_delete(reparsed);
+        ts_tree_delete(oldTree);
+    }
+    ts_tree_delete(tree);
+}
+BENCHMARK(BM_ReparseWooWooEdit)->Unit(benchmark::kMicrosecond);
+
+static void BM_ParseMetas(benchmark::State &state) {
+    const std::string &source = BenchmarkWorkspace::get().largeDocument;
+    TSTree *tree = Parser::getInstance()->parseWooWoo(source);
+    for (auto _: state) {
+        auto metas = Parser::getInstance()->parseMetas(tree, source);
+        benchmark::DoNotOptimize(metas.data());
+    }
+    ts_tree_delete(tree);
+    setBytesProcessed(state, source.size());
+}
+BENCHMARK(BM_ParseMetas)->Unit(benchmark::kMillisecond);
+
+static void BM_BuildMappings(benchmark::State &state) {
+    const std::string &source = BenchmarkWorkspace::get().largeDocument;
+    UTF8toUTF16Mapping mapping;
+    for (auto _: state) {
+        SourceScan scan = SourceScanner::scan(source);
+        mapping.buildMappings(source, scan);
+        benchmark::ClobberMemory();
+    }
+    setBytesProcessed(state, source.size());
+}
+BENCHMARK(BM_BuildMappings)->Unit(benchmark::kMillisecond);
+
+// the whole pipeline of a full text change: parse, meta blocks, mappings, comments and the index
+static void BM_UpdateSourceAndIndex(benchmark::State &state) {
+    loadedAnalyzer();
+    const BenchmarkWorkspace &workspace = BenchmarkWorkspace::get();
+    DialectedWooWooDocument document(workspace.largeDocumentPath);
+    // an unchanged source would not be parsed again, the two versions alternate
+    const std::string versions[] = {workspace.largeDocument, workspace.largeDocument + "\n"};
+    size_t i = 0;
+    for (auto _: state) {
+        std::string source = versions[i++ % 2];
+        document.updateSource(source);
+    }
+    setBytesProcessed(state, workspace.largeDocument.size());
+}
+BENCHMARK(BM_UpdateSourceAndIndex)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadWorkspace(benchmark::State &state) {
+    const BenchmarkWorkspace &workspace = BenchmarkWorkspace::get();
+    for (auto _: state) {
+        WooWooAnalyzer analyzer;
+        analyzer.setDialect(workspace.dialectPath.string());
+        analyzer.loadWorkspace(workspace.workspaceUri());
+    }
+}
+BENCHMARK(BM_LoadWorkspace)->Unit(benchmark::kMillisecond);
+
+// - - - Scaling, on generated workspaces with the number of files per project as the argument
+
+static void BM_LoadGeneratedWorkspace(benchmark::State &state) {
+    const BenchmarkWorkspace &workspace = BenchmarkWorkspace::get();
+    const GeneratedWorkspace &generated = workspace.generated(static_cast<size_t>(state.range(0)));
+    for (auto _: state) {
+        WooWooAnalyzer analyzer;
+        analyzer.setDialect(workspace.dialectPath.string());
+        analyzer.loadWorkspace(utils::pathToUri(generated.root));
+        // measured while the workspace is still loaded
+        state.PauseTiming();
+        setWorkspaceCounters(state, generated);
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_LoadGeneratedWorkspace)->RangeMultiplier(4)->Range(4, 256)->Unit(benchmark::kMillisecond);
+
+static void BM_ReferencesGenerated(benchmark::State &state) {
+    const BenchmarkWorkspace &workspace = BenchmarkWorkspace::get();
+    const GeneratedWorkspace &generated = workspace.generated(static_cast<size_t>(state.range(0)));
+    WooWooAnalyzer analyzer;
+    analyzer.setDialect(workspace.dialectPath.string());
+    analyzer.loadWorkspace(utils::pathToUri(generated.root));
+    ReferenceParams params(TextDocumentIdentifier(utils::pathToUri(generated.firstLabelDocument)),
+                           Position{generated.firstLabelLine, generated.firstLabelCharacter}, true);
+    for (auto _: state) {
+        benchmark::DoNotOptimize(analyzer.references(params));
+    }
+    setWorkspaceCounters(state, generated);
+}
+BENCHMARK(BM_ReferencesGenerated)->RangeMultiplier(4)->Range(4, 256);
+
+// - - - Components
+
+static void BM_SemanticTokens(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    TextDocumentIdentifier document = largeDocument();
+    for (auto _: state) {
+        // the full tokens of an unchanged document are cached, every iteration changes it
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 0}}, " "}});
+        benchmark::DoNotOptimize(analyzer.semanticTokens(document));
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 1}}, ""}});
+    }
+}
+BENCHMARK(BM_SemanticTokens)->Unit(benchmark::kMillisecond);
+
+static void BM_Hover(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    TextDocumentPositionParams params(benchmarkDocument(), Position{0, 3});
+    for (auto _: state) {
+        benchmark::DoNotOptimize(analyzer.hover(params));
+    }
+}
+BENCHMARK(BM_Hover);
+
+static void BM_References(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    // "ct1" of "label: ct1"
+    ReferenceParams params(benchmarkDocument(), Position{1, 9}, true);
+    for (auto _: state) {
+        benchmark::DoNotOptimize(analyzer.references(params));
+    }
+}
+BENCHMARK(BM_References);
+
+static void BM_Rename(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    RenameParams params(benchmarkDocument(), Position{1, 9}, "renamed");
+    for (auto _: state) {
+        benchmark::DoNotOptimize(analyzer.rename(params));
+    }
+}
+BENCHMARK(BM_Rename);
+
+static void BM_Complete(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    // right after ".reference:"
+    CompletionParams params(benchmarkDocument(), Position{4, 41},
+                            CompletionContext(CompletionTriggerKind::TriggerCharacter, ":"));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(analyzer.complete(params));
+    }
+}
+BENCHMARK(BM_Complete);
+
+static void BM_Diagnose(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    TextDocumentIdentifier document = largeDocument();
+    for (auto _: state) {
+        // diagnostics of an unchanged document are cached, every iteration changes it
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 0}}, " "}});
+        benchmark::DoNotOptimize(analyzer.diagnose(document));
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 1}}, ""}});
+    }
+}
+BENCHMARK(BM_Diagnose)->Unit(benchmark::kMillisecond);
+
+static void BM_AnalyzeDocument(benchmark::State &state) {
+    WooWooAnalyzer &analyzer = loadedAnalyzer();
+    TextDocumentIdentifier document = largeDocument();
+    for (auto _: state) {
+        // what a client asks for after every change, in one request instead of three
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 0}}, " "}});
+        benchmark::DoNotOptimize(analyzer.analyzeDocument(document, static_cast<uint32_t>(DocumentFeature::All)));
+        analyzer.documentDidChangeIncremental(document, {{Range{{0, 0}, {0, 1}}, ""}});
+    }
+}
+BENCHMARK(BM_AnalyzeDocument)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
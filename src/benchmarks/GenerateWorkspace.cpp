@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "WorkspaceGenerator.h"
+#include "../dialect/DialectManager.h"
+
+/*
+ * wuff_generate_workspace <dialect.yaml> <output folder> [--option=value ...]
+ *
+ * Writes a synthetic workspace for the dialect, for scaling measurements outside of the benchmarks.
+ * The options start from GeneratorOptions::fromEnvironment(), the command line overrides them.
+ */
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <dialect.yaml> <output folder> [--projects=N] [--files=N]"
+                  << " [--structures=N] [--references=N] [--cross-ratio=R] [--meta-fields=N]"
+                  << " [--non-ascii-ratio=R] [--include-depth=N] [--seed=N]" << std::endl;
+        return 2;
+    }
+
+    GeneratorOptions options = GeneratorOptions::fromEnvironment();
+    auto size = [](size_t &option) {
+        return [&option](const std::string &value) { option = std::stoull(value); };
+    };
+    auto ratio = [](double &option) {
+        return [&option](const std::string &value) { option = std::stod(value); };
+    };
+    const std::pair<std::string, std::function<void(const std::string &)>> setters[] = {
+            {"--projects",        size(options.projects)},
+            {"--files",           size(options.filesPerProject)},
+            {"--structures",      size(options.structuresPerFile)},
+            {"--references",      size(options.referencesPerStructure)},
+            {"--cross-ratio",     ratio(options.crossDocumentRatio)},
+            {"--meta-fields",     size(options.metaFields)},
+            {"--non-ascii-ratio", ratio(options.nonAsciiRatio)},
+            {"--include-depth",   size(options.includeDepth)},
+            {"--seed",            [&options](const std::string &value) { options.seed = std::stoull(value); }},
+    };
+
+    try {
+        for (int i = 3; i < argc; ++i) {
+            std::string argument = argv[i];
+            auto separator = argument.find('=');
+            std::string name = argument.substr(0, separator);
+            bool known = false;
+            for (const auto &setter: setters) {
+                if (setter.first == name && separator != std::string::npos) {
+                    setter.second(argument.substr(separator + 1));
+                    known = true;
+                }
+            }
+            if (!known) {
+                std::cerr << "Unknown option: " << argument << std::endl;
+                return 2;
+            }
+        }
+
+        DialectManager::getInstance()->loadDialect(argv[1]);
+        WorkspaceGenerator generator(*DialectManager::getInstance()->activeDialect, options);
+        GeneratedWorkspace workspace = generator.generate(argv[2]);
+
+        std::cout << "Generated " << workspace.root << ": " << workspace.documentCount << " documents, "
+                  << workspace.labelCount << " labels, " << workspace.referenceCount << " references, "
+                  << workspace.byteCount << " bytes" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
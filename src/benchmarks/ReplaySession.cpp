@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../WooWooAnalyzer.h"
+#include "../utils/SessionTrace.h"
+#include "../utils/utils.h"
+
+/*
+ * wuff_replay <trace> <workspace folder> [--dialect=<dialect.yaml>] [--repeat=N]
+ *
+ * Runs the calls of a trace recorded by WooWooAnalyzer::startRecording one after another, in the order they
+ * started, on a snapshot of the recorded workspace, and prints latency histograms of the methods.
+ * URIs of the recorded workspace (the one its load_workspace call got) are moved to the given folder.
+ */
+
+namespace {
+    using Replayer = std::function<void(WooWooAnalyzer &, TraceReader &)>;
+
+    template<typename Result, typename... Params>
+    Replayer replayer(Result (WooWooAnalyzer::*request)(Params...)) {
+        return [request](WooWooAnalyzer &analyzer, TraceReader &reader) {
+            // braced initialization reads the arguments in their order
+            std::tuple<std::decay_t<Params>...> args{TraceCodec<std::decay_t<Params>>::read(reader)...};
+            if (!reader.reader.ok) throw std::runtime_error("malformed arguments");
+            std::apply([&analyzer, request](auto &... values) { (analyzer.*request)(values...); }, args);
+        };
+    }
+
+    // the methods bound to Python by defRequest and defTracedSetter, by their Python names
+    const std::map<std::string, Replayer> &replayers() {
+        static const std::map<std::string, Replayer> methods = {
+                {"set_dialect",                     replayer(&WooWooAnalyzer::setDialect)},
+                {"set_token_types",                 replayer(&WooWooAnalyzer::setTokenTypes)},
+                {"set_token_modifiers",             replayer(&WooWooAnalyzer::setTokenModifiers)},
+                {"load_workspace",                  replayer(&WooWooAnalyzer::loadWorkspace)},
+                {"load_workspace_progressive",      replayer(&WooWooAnalyzer::loadWorkspaceProgressive)},
+                {"hover",                           replayer(&WooWooAnalyzer::hover)},
+                {"semantic_tokens",                 replayer(&WooWooAnalyzer::semanticTokens)},
+                {"semantic_tokens_full",            replayer(&WooWooAnalyzer::semanticTokensFull)},
+                {"semantic_tokens_range",           replayer(&WooWooAnalyzer::semanticTokensRange)},
+                {"semantic_tokens_delta",           replayer(&WooWooAnalyzer::semanticTokensDelta)},
+                {"go_to_definition",                replayer(&WooWooAnalyzer::goToDefinition)},
+                {"complete",                        replayer(&WooWooAnalyzer::complete)},
+                {"references",                      replayer(&WooWooAnalyzer::references)},
+                {"rename",                          replayer(&WooWooAnalyzer::rename)},
+                {"folding_ranges",                  replayer(&WooWooAnalyzer::foldingRanges)},
+                {"analyze_document",                replayer(&WooWooAnalyzer::analyzeDocument)},
+                {"document_symbols",                replayer(&WooWooAnalyzer::documentSymbols)},
+                {"workspace_symbols",               replayer(&WooWooAnalyzer::workspaceSymbols)},
+                {"document_did_change",             replayer(&WooWooAnalyzer::documentDidChange)},
+                {"document_did_change_incremental", replayer(&WooWooAnalyzer::documentDidChangeIncremental)},
+                {"open_document",                   replayer(&WooWooAnalyzer::openDocument)},
+                {"close_document",                  replayer(&WooWooAnalyzer::closeDocument)},
+                {"prefetch_document",               replayer(&WooWooAnalyzer::prefetchDocument)},
+                {"rename_files",                    replayer(&WooWooAnalyzer::renameFiles)},
+                {"did_delete_files",                replayer(&WooWooAnalyzer::didDeleteFiles)},
+                {"did_change_watched_files",        replayer(&WooWooAnalyzer::didChangeWatchedFiles)},
+                {"diagnose",                        replayer(&WooWooAnalyzer::diagnose)},
+        };
+        return methods;
+    }
+
+    struct MethodLatencies {
+        std::vector<uint64_t> recorded;
+        std::vector<uint64_t> replayed;
+        size_t errors = 0;
+    };
+
+    // nearest-rank percentile of sorted durations
+    uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+        if (sorted.empty()) return 0;
+        auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    std::string milliseconds(uint64_t microseconds) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", static_cast<double>(microseconds) / 1000.0);
+        return text;
+    }
+
+    void printReport(const std::map<std::string, MethodLatencies> &latencies) {
+        std::printf("%-32s %7s %6s %10s %10s %10s %10s %12s\n", "method", "calls", "errors", "p50 ms", "p90 ms",
+                    "p99 ms", "max ms", "recorded p50");
+        for (const auto &[method, latency]: latencies) {
+            std::vector<uint64_t> replayed = latency.replayed;
+            std::vector<uint64_t> recorded = latency.recorded;
+            std::sort(replayed.begin(), replayed.end());
+            std::sort(recorded.begin(), recorded.end());
+            std::printf("%-32s %7zu %6zu %10s %10s %10s %10s %12s\n", method.c_str(), replayed.size(),
+                        latency.errors, milliseconds(percentile(replayed, 0.5)).c_str(),
+                        milliseconds(percentile(replayed, 0.9)).c_str(),
+                        milliseconds(percentile(replayed, 0.99)).c_str(),
+                        milliseconds(replayed.empty() ? 0 : replayed.back()).c_str(),
+                        milliseconds(percentile(recorded, 0.5)).c_str());
+        }
+
+        // calls by power of two buckets of microseconds
+        std::printf("\nhistograms (replayed calls with a duration up to the bucket, in microseconds)\n");
+        for (const auto &[method, latency]: latencies) {
+            std::map<uint64_t, size_t> buckets;
+            for (uint64_t duration: latency.replayed) {
+                uint64_t bucket = 1;
+                while (bucket < duration) bucket <<= 1;
+                ++buckets[bucket];
+            }
+            std::printf("%s:", method.c_str());
+            for (const auto &[bucket, count]: buckets) {
+                std::printf(" <=%llu:%zu", static_cast<unsigned long long>(bucket), count);
+            }
+            std::printf("\n");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <trace> <workspace folder> [--dialect=<dialect.yaml>] [--repeat=N]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::string dialectPath;
+    size_t repeat = 1;
+    for (int i = 3; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument.rfind("--dialect=", 0) == 0) {
+            dialectPath = argument.substr(10);
+        } else if (argument.rfind("--repeat=", 0) == 0) {
+            repeat = std::max<size_t>(1, std::stoull(argument.substr(9)));
+        } else {
+            std::cerr << "Unknown option: " << argument << std::endl;
+            return 2;
+        }
+    }
+
+    auto records = SessionRecorder::read(argv[1]);
+    if (!records.has_value()) {
+        std::cerr << "Not a trace of this version of wuff: " << argv[1] << std::endl;
+        return 1;
+    }
+    std::string workspaceUri = utils::pathToUri(fs::absolute(argv[2]));
+
+    std::map<std::string, MethodLatencies> latencies;
+    size_t unknown = 0;
+    for (size_t run = 0; run < repeat; ++run) {
+        // every run starts from a fresh analyzer, the workspace is the same unless the trace changes files on disk
+        WooWooAnalyzer analyzer;
+        if (!dialectPath.empty()) analyzer.setDialect(dialectPath);
+        std::string recordedRoot;
+        for (const TraceRecord &record: records.value()) {
+            auto method = replayers().find(record.method);
+            if (method == replayers().end()) {
+                ++unknown;
+                continue;
+            }
+
+            TraceReader reader(record.arguments);
+            if (record.method == "load_workspace" || record.method == "load_workspace_progressive") {
+                recordedRoot = TraceReader(record.arguments).str();
+            }
+            reader.recordedRoot = recordedRoot;
+            reader.replayedRoot = workspaceUri;
+
+            MethodLatencies &latency = latencies[record.method];
+            if (run == 0) latency.recorded.push_back(record.duration);
+
+            auto begin = std::chrono::steady_clock::now();
+            try {
+                if (record.method == "set_dialect" && !dialectPath.empty()) {
+                    analyzer.setDialect(dialectPath);
+                } else {
+                    method->second(analyzer, reader);
+                }
+            } catch (const std::exception &) {
+                ++latency.errors;
+            }
+            auto duration = std::chrono::steady_clock::now() - begin;
+            latency.replayed.push_back(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+        }
+    }
+
+    std::printf("%zu calls replayed %zu times on %s\n\n", records->size(), repeat, workspaceUri.c_str());
+    if (unknown > 0) std::printf("%zu calls of unknown methods skipped\n\n", unknown);
+    printReport(latencies);
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "WorkspaceGenerator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+namespace {
+    const char *const ASCII_WORDS[] = {
+            "set", "group", "element", "function", "limit", "proof", "number", "space", "matrix", "vector",
+            "sequence", "value", "graph", "order", "field", "basis", "series", "bound", "image", "kernel"
+    };
+    // Czech and German words, and words with characters outside of the BMP (surrogate pairs in UTF-16)
+    const char *const NON_ASCII_WORDS[] = {
+            "množina", "zobrazení", "řešení", "příklad", "člen", "Übung", "Größe", "𝛼-limit", "𝔽-prostor",
+            "∑-řada"
+    };
+
+    size_t sizeFromEnvironment(const char *name, size_t defaultValue) {
+        const char *value = std::getenv(name);
+        if (!value) return defaultValue;
+        char *end = nullptr;
+        unsigned long long parsed = std::strtoull(value, &end, 10);
+        return end != value ? static_cast<size_t>(parsed) : defaultValue;
+    }
+
+    double ratioFromEnvironment(const char *name, double defaultValue) {
+        const char *value = std::getenv(name);
+        if (!value) return defaultValue;
+        char *end = nullptr;
+        double parsed = std::strtod(value, &end);
+        return end != value ? std::clamp(parsed, 0.0, 1.0) : defaultValue;
+    }
+
+    bool hasField(const std::vector<Field> &fields, const std::string &name) {
+        return std::any_of(fields.begin(), fields.end(), [&name](const Field &field) { return field.name == name; });
+    }
+
+    void writeFile(const fs::path &path, const std::string &content) {
+        std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+}
+
+GeneratorOptions GeneratorOptions::fromEnvironment() {
+    GeneratorOptions options;
+    options.projects = sizeFromEnvironment("WUFF_GEN_PROJECTS", options.projects);
+    options.filesPerProject = sizeFromEnvironment("WUFF_GEN_FILES", options.filesPerProject);
+    options.structuresPerFile = sizeFromEnvironment("WUFF_GEN_STRUCTURES", options.structuresPerFile);
+    options.referencesPerStructure = sizeFromEnvironment("WUFF_GEN_REFERENCES", options.referencesPerStructure);
+    options.crossDocumentRatio = ratioFromEnvironment("WUFF_GEN_CROSS_RATIO", options.crossDocumentRatio);
+    options.metaFields = sizeFromEnvironment("WUFF_GEN_META_FIELDS", options.metaFields);
+    options.nonAsciiRatio = ratioFromEnvironment("WUFF_GEN_NON_ASCII_RATIO", options.nonAsciiRatio);
+    options.includeDepth = sizeFromEnvironment("WUFF_GEN_INCLUDE_DEPTH", options.includeDepth);
+    options.seed = sizeFromEnvironment("WUFF_GEN_SEED", options.seed);
+    return options;
+}
+
+
+WorkspaceGenerator::WorkspaceGenerator(const Dialect &dialect, GeneratorOptions options)
+        : dialect(dialect), options(options), random(options.seed) {
+    collectForms();
+    collectStructures();
+}
+
+void WorkspaceGenerator::collectForms() {
+    std::map<std::string, size_t> metaKeyCounts;
+    auto countMetaKeys = [&metaKeyCounts](const std::vector<Reference> &references) {
+        for (const Reference &reference: references) {
+            ++metaKeyCounts[reference.metaKey];
+        }
+    };
+    for (const auto &environment: dialect.environments) {
+        countMetaKeys(environment->references);
+    }
+    if (dialect.shorthand_hash) countMetaKeys(dialect.shorthand_hash->references);
+    if (dialect.shorthand_at) countMetaKeys(dialect.shorthand_at->references);
+
+    auto mostReferenced = std::max_element(metaKeyCounts.begin(), metaKeyCounts.end(),
+                                           [](const auto &a, const auto &b) { return a.second < b.second; });
+    if (mostReferenced == metaKeyCounts.end()) return;
+    labelKey = mostReferenced->first;
+
+    auto addForm = [this](const std::string &name, bool shorthand, const std::vector<Reference> &references) {
+        ReferencingForm form{name, shorthand, {}};
+        for (const Reference &reference: references) {
+            if (reference.metaKey == labelKey) form.references.push_back(&reference);
+        }
+        if (!form.references.empty()) forms.push_back(std::move(form));
+    };
+    for (const auto &environment: dialect.environments) {
+        addForm(environment->name, false, environment->references);
+    }
+    if (dialect.shorthand_hash) addForm("#", true, dialect.shorthand_hash->references);
+    if (dialect.shorthand_at) addForm("@", true, dialect.shorthand_at->references);
+}
+
+void WorkspaceGenerator::collectStructures() {
+    if (labelKey.empty()) return;
+    // only structures which can be labelled are generated
+    auto labelled = [this](const MetaBlock &metaBlock) {
+        return hasField(metaBlock.requiredFields, labelKey) || hasField(metaBlock.optionalFields, labelKey);
+    };
+    for (const auto &documentPart: dialect.document_parts) {
+        if (labelled(documentPart->metaBlock)) {
+            documentParts.push_back({"document_part", documentPart->name, &documentPart->metaBlock});
+        }
+    }
+    for (const auto &wobject: dialect.wobjects) {
+        if (labelled(wobject->metaBlock)) {
+            wobjects.push_back({"wobject", wobject->name, &wobject->metaBlock});
+        }
+    }
+}
+
+// modulo instead of the distributions of the standard library, which differ between implementations
+size_t WorkspaceGenerator::pick(size_t count) {
+    return count == 0 ? 0 : static_cast<size_t>(random() % count);
+}
+
+bool WorkspaceGenerator::chance(double ratio) {
+    return static_cast<double>(random() % 1000000) < ratio * 1000000;
+}
+
+std::string WorkspaceGenerator::word() {
+    if (chance(options.nonAsciiRatio)) {
+        return NON_ASCII_WORDS[pick(std::size(NON_ASCII_WORDS))];
+    }
+    return ASCII_WORDS[pick(std::size(ASCII_WORDS))];
+}
+
+std::string WorkspaceGenerator::words(size_t count) {
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) text += ' ';
+        text += word();
+    }
+    return text;
+}
+
+std::vector<const WorkspaceGenerator::ReferencingForm *>
+WorkspaceGenerator::formsReferencing(const Target &target) const {
+    std::vector<const ReferencingForm *> referencing;
+    for (const ReferencingForm &form: forms) {
+        bool accepts = std::any_of(form.references.begin(), form.references.end(), [&target](const Reference *r) {
+            return (r->structureType.empty() || r->structureType == target.structure->type)
+                   && (r->structureName.empty() || r->structureName == target.structure->name);
+        });
+        if (accepts) referencing.push_back(&form);
+    }
+    return referencing;
+}
+
+std::string WorkspaceGenerator::referenceTo(const Target &target, const ReferencingForm &form) {
+    if (form.shorthand) {
+        return "\"" + words(1 + pick(2)) + "\"" + form.name + target.label;
+    }
+    return "." + form.name + ":" + target.label;
+}
+
+const WorkspaceGenerator::Target *
+WorkspaceGenerator::pickTarget(const std::vector<std::vector<Target>> &targets, size_t file) {
+    size_t targetFile = file;
+    if (targets.size() > 1 && chance(options.crossDocumentRatio)) {
+        targetFile = pick(targets.size() - 1);
+        if (targetFile >= file) ++targetFile;
+    }
+    const auto &candidates = targets[targetFile];
+    return candidates.empty() ? nullptr : &candidates[pick(candidates.size())];
+}
+
+std::string WorkspaceGenerator::generateDocument(const std::vector<std::vector<Target>> &targets, size_t file,
+                                                 GeneratedWorkspace &result, bool recordFirstLabel) {
+    std::string content;
+    auto lineCount = [&content]() {
+        return static_cast<uint32_t>(std::count(content.begin(), content.end(), '\n'));
+    };
+
+    for (size_t s = 0; s < targets[file].size(); ++s) {
+        const Target &target = targets[file][s];
+        bool wobject = target.structure->type == "wobject";
+        std::string indent = "  ";
+
+        if (wobject) {
+            content += "." + target.structure->name + ":\n";
+        } else {
+            content += "." + target.structure->name + " " + words(1 + pick(3)) + "\n";
+        }
+
+        // the label first, then the required fields and some of the optional ones
+        if (recordFirstLabel && s == 0) {
+            result.firstLabelLine = lineCount();
+            result.firstLabelCharacter = static_cast<uint32_t>(indent.size() + labelKey.size() + 2);
+        }
+        content += indent + labelKey + ": " + target.label + "\n";
+        ++result.labelCount;
+
+        std::vector<const Field *> fields;
+        for (const Field &field: target.structure->metaBlock->requiredFields) {
+            if (field.name != labelKey) fields.push_back(&field);
+        }
+        std::vector<const Field *> optionalFields;
+        for (const Field &field: target.structure->metaBlock->optionalFields) {
+            if (field.name != labelKey) optionalFields.push_back(&field);
+        }
+        for (size_t i = 0; i < options.metaFields && i < optionalFields.size(); ++i) {
+            std::swap(optionalFields[i], optionalFields[i + pick(optionalFields.size() - i)]);
+            fields.push_back(optionalFields[i]);
+        }
+        for (const Field *field: fields) {
+            // fields referencing labels get one of them, any other field a few words
+            const Target *referenced = field->references.empty() ? nullptr : pickTarget(targets, file);
+            if (referenced) {
+                content += indent + field->name + ": " + referenced->label + "\n";
+                ++result.referenceCount;
+            } else {
+                content += indent + field->name + ": " + words(1 + pick(3)) + "\n";
+            }
+        }
+
+        std::string body = words(1 + pick(4));
+        for (size_t r = 0; r < options.referencesPerStructure; ++r) {
+            const Target *referenced = pickTarget(targets, file);
+            if (!referenced) continue;
+            auto referencing = formsReferencing(*referenced);
+            if (referencing.empty()) continue;
+            body += " " + referenceTo(*referenced, *referencing[pick(referencing.size())]);
+            body += " " + words(1 + pick(6));
+            ++result.referenceCount;
+        }
+        body += ".";
+
+        if (wobject) {
+            content += "\n" + indent + body + "\n\n";
+        } else {
+            content += "\n\n" + body + "\n\n";
+        }
+    }
+
+    // chains of includeDepth includes: 0 -> 1 -> 2, 3 -> 4 -> 5, ...
+    if (options.includeDepth > 0 && file % (options.includeDepth + 1) < options.includeDepth
+        && file + 1 < targets.size()) {
+        content += ".include doc" + std::to_string(file + 1) + ".woo\n";
+    }
+    return content;
+}
+
+GeneratedWorkspace WorkspaceGenerator::generate(const fs::path &root) {
+    random.seed(options.seed);
+
+    GeneratedWorkspace result;
+    result.root = root;
+    fs::create_directories(root);
+
+    for (size_t project = 0; project < options.projects; ++project) {
+        fs::path projectFolder = root / ("project" + std::to_string(project));
+        fs::create_directories(projectFolder);
+        writeFile(projectFolder / "Woofile", "");
+
+        // what every document defines, decided before the documents are written so they can reference each other
+        std::vector<std::vector<Target>> targets(options.filesPerProject);
+        for (size_t file = 0; file < options.filesPerProject; ++file) {
+            for (size_t s = 0; s < options.structuresPerFile; ++s) {
+                // every document starts by a document part, the rest are mostly wobjects
+                const std::vector<Structure> &kind =
+                        wobjects.empty() || (!documentParts.empty() && (s == 0 || chance(0.25)))
+                        ? documentParts : wobjects;
+                if (kind.empty()) break;
+                const Structure &structure = kind[pick(kind.size())];
+                targets[file].push_back({&structure, "d" + std::to_string(file) + "-s" + std::to_string(s)});
+            }
+        }
+
+        for (size_t file = 0; file < options.filesPerProject; ++file) {
+            fs::path documentPath = projectFolder / ("doc" + std::to_string(file) + ".woo");
+            bool first = project == 0 && file == 0 && !targets[file].empty();
+            std::string content = generateDocument(targets, file, result, first);
+            if (first) result.firstLabelDocument = documentPath;
+            writeFile(documentPath, content);
+            ++result.documentCount;
+            result.byteCount += content.size();
+        }
+    }
+    return result;
+}
@@ -0,0 +1,110 @@
+#ifndef WUFF_WORKSPACEGENERATOR_H
+#define WUFF_WORKSPACEGENERATOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include "../dialect/Dialect.h"
+
+namespace fs = std::filesystem;
+
+struct GeneratorOptions {
+    size_t projects = 4;
+    size_t filesPerProject = 25;
+    // labelled document parts and wobjects per file
+    size_t structuresPerFile = 20;
+    // references made from the body of every structure
+    size_t referencesPerStructure = 3;
+    // share of the references pointing to other documents of the project
+    double crossDocumentRatio = 0.5;
+    // optional meta fields of every meta block, besides the label
+    size_t metaFields = 2;
+    // share of the words of the text with non-ASCII characters (some of them outside of the BMP)
+    double nonAsciiRatio = 0.1;
+    // length of the chains of documents including each other, 0 for no includes
+    size_t includeDepth = 2;
+    uint64_t seed = 1;
+
+    /**
+     * The defaults overridden by WUFF_GEN_PROJECTS, WUFF_GEN_FILES, WUFF_GEN_STRUCTURES, WUFF_GEN_REFERENCES,
+     * WUFF_GEN_CROSS_RATIO, WUFF_GEN_META_FIELDS, WUFF_GEN_NON_ASCII_RATIO, WUFF_GEN_INCLUDE_DEPTH and WUFF_GEN_SEED.
+     */
+    static GeneratorOptions fromEnvironment();
+};
+
+struct GeneratedWorkspace {
+    fs::path root;
+    size_t documentCount = 0;
+    size_t labelCount = 0;
+    size_t referenceCount = 0;
+    size_t byteCount = 0;
+
+    // the value of the first label of the first document of the first project, for reference lookups
+    fs::path firstLabelDocument;
+    uint32_t firstLabelLine = 0;
+    uint32_t firstLabelCharacter = 0;
+};
+
+/**
+ * Writes a synthetic workspace which uses the structures of a dialect: document parts and wobjects with labels
+ * in their meta blocks, and the environments and shorthands which can reference them.
+ * Every project is a folder with a Woofile and documents referencing each other within the project.
+ * The output depends only on the dialect and the options, the same seed gives the same workspace.
+ */
+class WorkspaceGenerator {
+public:
+    WorkspaceGenerator(const Dialect &dialect, GeneratorOptions options);
+
+    // the root is created if needed, existing files of the same names are overwritten
+    GeneratedWorkspace generate(const fs::path &root);
+
+private:
+    struct Structure {
+        std::string type;  // document_part or wobject
+        std::string name;
+        const MetaBlock *metaBlock;
+    };
+
+    struct Target {
+        const Structure *structure;
+        std::string label;
+    };
+
+    struct ReferencingForm {
+        std::string name;
+        bool shorthand;
+        std::vector<const Reference *> references;
+    };
+
+    const Dialect &dialect;
+    GeneratorOptions options;
+    std::mt19937_64 random;
+
+    // the meta key the references of the dialect point to the most
+    std::string labelKey;
+    std::vector<Structure> documentParts;
+    std::vector<Structure> wobjects;
+    std::vector<ReferencingForm> forms;
+
+    void collectStructures();
+    void collectForms();
+
+    size_t pick(size_t count);
+    bool chance(double ratio);
+    std::string word();
+    std::string words(size_t count);
+
+    // the referencing forms of the dialect which can point to the target
+    std::vector<const ReferencingForm *> formsReferencing(const Target &target) const;
+    std::string referenceTo(const Target &target, const ReferencingForm &form);
+    // a target in the same or (by the cross document ratio) in another document, nullptr if there is none
+    const Target *pickTarget(const std::vector<std::vector<Target>> &targets, size_t file);
+
+    std::string generateDocument(const std::vector<std::vector<Target>> &targets, size_t file,
+                                 GeneratedWorkspace &result, bool recordFirstLabel);
+};
+
+
+#endif //WUFF_WORKSPACEGENERATOR_H
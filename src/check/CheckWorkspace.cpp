@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../WooWooAnalyzer.h"
+#include "../lsp/LSPJson.h"
+#include "../utils/utils.h"
+
+/*
+ * wuff_check <workspace folder>... [--dialect=<dialect.yaml>] [--cache=<folder>] [--threads=N]
+ *                                  [--format=json|sarif] [--output=<file>] [--warnings-as-errors]
+ *
+ * Checks every document of the workspace folders (syntax errors, unresolved references, duplicate definitions)
+ * on all cores and writes the diagnostics as JSON (the documents with some, as in publishDiagnostics) or SARIF.
+ * With a cache folder, the documents which did not change since the last run are checked by their cached index
+ * alone, unless they had syntax errors. Exits with 1 if an error (or a warning, if they count) was found.
+ */
+namespace {
+
+    void appendString(std::string &out, std::string_view text) {
+        out += '"';
+        utils::appendJsonEscaped(out, text);
+        out += '"';
+    }
+
+    std::string toJson(const std::vector<PublishDiagnosticsParams> &results) {
+        std::string out = "[";
+        bool first = true;
+        for (const PublishDiagnosticsParams &result: results) {
+            if (result.diagnostics.empty()) continue;
+            if (!first) out += ',';
+            first = false;
+            out += "{\"uri\":";
+            appendString(out, result.uri);
+            out += ",\"diagnostics\":";
+            out += lsp::toJson(result.diagnostics);
+            out += '}';
+        }
+        out += "]\n";
+        return out;
+    }
+
+    const char *sarifLevel(DiagnosticSeverity severity) {
+        switch (severity) {
+            case DiagnosticSeverity::Error:
+                return "error";
+            case DiagnosticSeverity::Warning:
+                return "warning";
+            default:
+                return "note";
+        }
+    }
+
+    // SARIF 2.1.0, lines and columns from 1, columns in UTF-16 code units (the default column kind) as in LSP
+    std::string toSarif(const std::vector<PublishDiagnosticsParams> &results) {
+        std::string out = "{\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\",\"version\":\"2.1.0\","
+                          "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"wuff\"}},\"results\":[";
+        bool first = true;
+        for (const PublishDiagnosticsParams &result: results) {
+            for (const Diagnostic &diagnostic: result.diagnostics) {
+                if (!first) out += ',';
+                first = false;
+                out += "{\"level\":\"";
+                out += sarifLevel(diagnostic.severity);
+                out += "\",\"message\":{\"text\":";
+                appendString(out, diagnostic.message);
+                out += "},\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":";
+                appendString(out, result.uri);
+                out += "},\"region\":{\"startLine\":" + std::to_string(diagnostic.range.start.line + 1) +
+                       ",\"startColumn\":" + std::to_string(diagnostic.range.start.character + 1) +
+                       ",\"endLine\":" + std::to_string(diagnostic.range.end.line + 1) +
+                       ",\"endColumn\":" + std::to_string(diagnostic.range.end.character + 1) + "}}}]}";
+            }
+        }
+        out += "]}]}\n";
+        return out;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> folders;
+    std::string dialectPath;
+    std::string cachePath;
+    std::string format = "json";
+    std::string outputPath;
+    size_t threads = 0;
+    bool warningsAsErrors = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+            if (argument.rfind("--dialect=", 0) == 0) {
+                dialectPath = argument.substr(10);
+            } else if (argument.rfind("--cache=", 0) == 0) {
+                cachePath = argument.substr(8);
+            } else if (argument.rfind("--threads=", 0) == 0) {
+                threads = std::stoull(argument.substr(10));
+            } else if (argument.rfind("--format=", 0) == 0 &&
+                       (argument.substr(9) == "json" || argument.substr(9) == "sarif")) {
+                format = argument.substr(9);
+            } else if (argument.rfind("--output=", 0) == 0) {
+                outputPath = argument.substr(9);
+            } else if (argument == "--warnings-as-errors") {
+                warningsAsErrors = true;
+            } else if (argument.rfind("--", 0) != 0) {
+                folders.push_back(argument);
+            } else {
+                std::cerr << "Unknown option: " << argument << std::endl;
+                return 2;
+            }
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Invalid number in the options" << std::endl;
+        return 2;
+    }
+    if (folders.empty()) {
+        std::cerr << "usage: " << argv[0] << " <workspace folder>... [--dialect=<dialect.yaml>] [--cache=<folder>]"
+                  << " [--threads=N] [--format=json|sarif] [--output=<file>] [--warnings-as-errors]" << std::endl;
+        return 2;
+    }
+
+    std::vector<PublishDiagnosticsParams> results;
+    try {
+        // the cache is written when the analyzer is destroyed
+        WooWooAnalyzer analyzer;
+        analyzer.setThreadPoolSize(threads);
+        if (!dialectPath.empty()) analyzer.setDialect(dialectPath);
+        if (!cachePath.empty()) analyzer.setCacheDirectory(cachePath);
+        for (const std::string &folder: folders) {
+            analyzer.loadWorkspace(utils::pathToUri(fs::absolute(folder).lexically_normal()));
+        }
+        results = analyzer.checkWorkspace();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::string report = format == "sarif" ? toSarif(results) : toJson(results);
+    if (outputPath.empty()) {
+        std::cout << report;
+    } else {
+        std::ofstream output(outputPath, std::ios::binary);
+        output << report;
+        if (!output) {
+            std::cerr << "Could not write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+
+    size_t errors = 0;
+    size_t warnings = 0;
+    for (const PublishDiagnosticsParams &result: results) {
+        for (const Diagnostic &diagnostic: result.diagnostics) {
+            if (diagnostic.severity == DiagnosticSeverity::Error) ++errors;
+            if (diagnostic.severity == DiagnosticSeverity::Warning) ++warnings;
+        }
+    }
+    std::cerr << results.size() << " documents checked, " << errors << " errors, " << warnings << " warnings"
+              << std::endl;
+    return errors > 0 || (warningsAsErrors && warnings > 0) ? 1 : 0;
+}
@@ -4,35 +4,42 @@
 
 #include "Completer.h"
 #include "../utils/utils.h"
+#include "../utils/CancellationToken.h"
+#include <algorithm>
+#include <sstream>
 
 Completer::Completer(WooWooAnalyzer *analyzer) : Component(analyzer) {
     prepareQueries();
 }
 
 
-std::vector<CompletionItem> Completer::complete(const CompletionParams &params) {
-    std::vector<CompletionItem> completionItems;
+CompletionList Completer::complete(const CompletionParams &params) {
+    CompletionList completionList;
+    if (!params.context.has_value()) return completionList;
 
     if (params.context->triggerKind == CompletionTriggerKind::TriggerCharacter) {
+        auto document = analyzer->getDocumentByUri(params.textDocument.uri);
+        auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
         if (params.context->triggerCharacter == ".") {
-            completeInclude(completionItems, params);
+            completeInclude(completionList, params);
         } else if (params.context->triggerCharacter == ":") {
-            completeInnerEnvs(completionItems, params);
+            completeInnerEnvs(completionList, document, TSPoint{pos.first, pos.second}, "");
         } else if (params.context->triggerCharacter == "#" ||
                    params.context->triggerCharacter == "@") {
-            completeShorthand(completionItems, params);
+            completeShorthand(completionList, document, params.context->triggerCharacter.value(), "");
         }
+    } else if (params.context->triggerKind == CompletionTriggerKind::TriggerForIncompleteCompletions) {
+        completeIncomplete(completionList, params);
     }
 
-    return completionItems;
+    return completionList;
 }
 
 
-void Completer::completeInclude(std::vector<CompletionItem> &completionItems, const CompletionParams &params) {
-    auto docPath = utils::uriToPathString(params.textDocument.uri);
-    auto document = analyzer->getDocument(docPath);
+void Completer::completeInclude(CompletionList &completionList, const CompletionParams &params) {
+    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
     auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
     uint32_t line = pos.first;
     uint32_t character = pos.second;
@@ -49,92 +56,122 @@ void Completer::completeInclude(std::vector<CompletionItem> &completionItems, co
         return;
     }
 
-    std::vector<std::string> relativePaths;
-    std::string currentDocDir = std::filesystem::path(document->documentPath).parent_path().string();
-
-    for (auto doc: analyzer->getProjectByDocument(document)->getAllDocuments()) {
-        if (doc != nullptr && !doc->documentPath.empty()) {
-            std::string relPath = std::filesystem::relative(doc->documentPath, currentDocDir).string();
-            relativePaths.push_back(relPath);
+    // the paths are computed again only once documents are added to or removed from the project
+    auto project = analyzer->getProjectByDocument(document);
+    fs::path currentDocDir = document->documentPath.parent_path();
+    IncludeChoices &cached = includeChoicesByDirectory[currentDocDir.generic_string()];
+    if (cached.documentsVersion != project->getDocumentsVersion()) {
+        std::vector<std::string> relativePaths;
+        for (auto doc: project->getDocuments()) {
+            if (doc != nullptr && !doc->documentPath.empty()) {
+                relativePaths.push_back(fs::relative(doc->documentPath, currentDocDir).string());
+            }
         }
-    }
-
-    std::stringstream ss;
-    for (size_t i = 0; i < relativePaths.size(); ++i) {
-        ss << relativePaths[i];
-        if (i != relativePaths.size() - 1) {
-            // Don't add a comma after the last element
-            ss << ",";
+        std::sort(relativePaths.begin(), relativePaths.end());
+
+        std::stringstream ss;
+        for (size_t i = 0; i < relativePaths.size(); ++i) {
+            ss << relativePaths[i];
+            if (i != relativePaths.size() - 1) {
+                // Don't add a comma after the last element
+                ss << ",";
+            }
         }
+        cached.choices = ss.str();
+        cached.documentsVersion = project->getDocumentsVersion();
     }
-    std::string pathsJoined = ss.str();
 
-    std::string insertText = "include ${1|" + pathsJoined + "|}";
+    std::string insertText = "include ${1|" + cached.choices + "|}";
     CompletionItem item{
             ".include", // label
             CompletionItemKind::Snippet, // kind
             InsertTextFormat::Snippet, // insert_text_format
             insertText // insert_text
     };
-    completionItems.emplace_back(item);
-
-    ts_query_cursor_delete(cursor);
+    completionList.items.emplace_back(item);
 }
 
 /**
 * Autocomplete the bodies of inner environments. Behaviour entirely given by the dialect.
 * For example, suggest possible "reference" values based on "labels" used in the document.
 * .reference:<autocomplete>
- * \param completionItems 
- * \param params 
+ * \param completionList 
+ * \param trigger Position right after the ':'.
+ * \param prefix What was typed after the ':' so far.
  */
-void Completer::completeInnerEnvs(std::vector<CompletionItem> &completionItems, const CompletionParams &params) {
-    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
-
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    auto start = params.position.character - 2 > 0 ? params.position.character - 2 : 0;
-    TSPoint start_point = {params.position.line, start};
-    TSPoint end_point = {params.position.line, params.position.character + 1};
+void Completer::completeInnerEnvs(CompletionList &completionList, WooWooDocument *document, TSPoint trigger,
+                                  std::string_view prefix) {
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
+    TSPoint start_point = {trigger.row, trigger.column >= 2 ? trigger.column - 2 : 0};
+    TSPoint end_point = {trigger.row, trigger.column + 1};
     ts_query_cursor_set_point_range(cursor, start_point, end_point);
     ts_query_cursor_exec(cursor, queries[shortInnerEnvironmentQuery], ts_tree_root_node(document->tree));
 
     TSQueryMatch match;
     if (ts_query_cursor_next_match(cursor, &match)) {
         TSNode node = match.captures[0].node;
-        std::string shortInnerEnvType = document->getNodeText(node);
+        std::string_view shortInnerEnvType = document->getNodeText(node);
 
+        if (BibliographyIndex::isCitation(shortInnerEnvType)) {
+            completeCitations(completionList, document, prefix);
+            return;
+        }
         // nodes that can be referenced by this env.
-        searchProjectForReferencables(completionItems, document, shortInnerEnvType);
+        searchProjectForReferencables(completionList, document, shortInnerEnvType, prefix);
     }
-    ts_query_cursor_delete(cursor);
 }
 
-void Completer::completeShorthand(std::vector<CompletionItem> &completionItems, const CompletionParams &params) {
+void Completer::completeShorthand(CompletionList &completionList, WooWooDocument *document,
+                                  std::string_view shorthandName, std::string_view prefix) {
     // NOTE: As of now, suggesting completion everytime, even out of context.
+    searchProjectForReferencables(completionList, document, shorthandName, prefix);
+}
 
-    std::string shorthandName;
-    if (params.context->triggerCharacter == "#") shorthandName = "#";
-    if (params.context->triggerCharacter == "@") shorthandName = "@";
-    if (shorthandName.empty()) return;
+void Completer::completeIncomplete(CompletionList &completionList, const CompletionParams &params) {
+    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
+    auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
 
-    auto docPath = utils::uriToPathString(params.textDocument.uri);
-    auto document = analyzer->getDocument(docPath);
+    // the line up to the cursor, the typed prefix follows the last trigger character
+    std::string_view lineText = document->substr(document->utfMappings->lineStart(pos.first),
+                                                 document->utfMappings->lineStart(pos.first) + pos.second);
+    size_t triggerIndex = lineText.find_last_of(":#@ \t\"");
+    if (triggerIndex == std::string_view::npos) return;
+    std::string_view prefix = lineText.substr(triggerIndex + 1);
+
+    char trigger = lineText[triggerIndex];
+    if (trigger == ':') {
+        completeInnerEnvs(completionList, document, TSPoint{pos.first, static_cast<uint32_t>(triggerIndex + 1)}, prefix);
+    } else if (trigger == '#' || trigger == '@') {
+        completeShorthand(completionList, document, lineText.substr(triggerIndex, 1), prefix);
+    }
+}
 
-    searchProjectForReferencables(completionItems, document, shorthandName);
 
+void Completer::searchProjectForReferencables(CompletionList &completionList, WooWooDocument *doc,
+                                              std::string_view referencingValue, std::string_view prefix) {
+    // served from the index of the project, the documents themselves are not visited
+    bool incomplete = false;
+    auto values = analyzer->getProjectByDocument(doc)->completeReferencables(referencingValue, prefix,
+                                                                             maxReferencables, incomplete);
+    // values of documents which are not loaded yet would be missing
+    completionList.isIncomplete = completionList.isIncomplete || incomplete || !analyzer->isWorkspaceLoaded();
+    completionList.items.reserve(completionList.items.size() + values.size());
+    for (std::string_view value: values) {
+        completionList.items.emplace_back(std::string(value));
+    }
 }
 
 
-void Completer::searchProjectForReferencables(std::vector<CompletionItem> &completionItems, WooWooDocument * doc,
-                                              std::string &referencingValue) {
-
-    for (auto projectDocument: analyzer->getProjectByDocument(doc)->getAllDocuments()) {
-        for (auto referencable: projectDocument->getReferencablesBy(referencingValue)) {
-            CompletionItem item(projectDocument->getMetaNodeText(referencable.first, referencable.second));
-            completionItems.emplace_back(item);
-        }
+void Completer::completeCitations(CompletionList &completionList, WooWooDocument *doc, std::string_view prefix) {
+    WooWooProject *project = analyzer->getProjectByDocument(doc);
+    if (!project) return;
+    bool incomplete = false;
+    auto entries = project->bibliography.completions(prefix, maxReferencables, incomplete);
+    completionList.isIncomplete = completionList.isIncomplete || incomplete;
+    completionList.items.reserve(completionList.items.size() + entries.size());
+    for (const BibliographyIndex::Entry *entry: entries) {
+        completionList.items.emplace_back(entry->key, CompletionItemKind::Reference);
     }
-
 }
 
 
@@ -9,19 +9,40 @@
 #include "../lsp/LSPTypes.h"
 #include "Component.h"
 
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 class Completer : Component {
 
 public:
     explicit Completer(WooWooAnalyzer *analyzer);
-    std::vector<CompletionItem> complete(const CompletionParams & params);
+    CompletionList complete(const CompletionParams & params);
     
 private:
-    void completeInclude(std::vector<CompletionItem> & completionItems, const CompletionParams & params);
-    void completeInnerEnvs(std::vector<CompletionItem> & completionItems, const CompletionParams & params);
-    void completeShorthand(std::vector<CompletionItem> & completionItems, const CompletionParams & params);
-    void searchProjectForReferencables(std::vector<CompletionItem> & completionItems, WooWooDocument * doc, std::string & referencingValue);
+    void completeInclude(CompletionList & completionList, const CompletionParams & params);
+    // trigger is the position (UTF-8 based) right after the ':' of the inner environment
+    void completeInnerEnvs(CompletionList & completionList, WooWooDocument * document, TSPoint trigger,
+                           std::string_view prefix);
+    void completeShorthand(CompletionList & completionList, WooWooDocument * document, std::string_view shorthandName,
+                           std::string_view prefix);
+    // continues an incomplete list, by what was typed since the trigger character
+    void completeIncomplete(CompletionList & completionList, const CompletionParams & params);
+    // keys of the bibliography of the project starting with the prefix
+    void completeCitations(CompletionList & completionList, WooWooDocument * doc, std::string_view prefix);
+    void searchProjectForReferencables(CompletionList & completionList, WooWooDocument * doc,
+                                       std::string_view referencingValue, std::string_view prefix);
+
+    // the choices of the include snippet, relative to the directory of the including document
+    struct IncludeChoices {
+        // WooWooProject::getDocumentsVersion of the project they were made for
+        uint64_t documentsVersion = 0;
+        std::string choices;
+    };
+    std::unordered_map<std::string, IncludeChoices> includeChoicesByDirectory;
+
+    // more values than this are not sent at once, the list is marked incomplete instead
+    static const size_t maxReferencables = 200;
 
     [[nodiscard]] const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>>& getQueryStringByName() const override;
     
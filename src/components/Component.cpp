@@ -3,37 +3,19 @@
 //
 
 #include "Component.h"
-#include "../utils/utils.h"
+#include "../parser/QueryRegistry.h"
 
 Component::Component(WooWooAnalyzer *analyzer) : analyzer(analyzer) {}
 
 void Component::prepareQueries() {
-    uint32_t errorOffset;
-    TSQueryError errorType;
-
     for (const auto &q: getQueryStringByName()) {
         const auto &queryName = q.first;
         const auto &queryLanguage = q.second.first;
         const auto &queryString = q.second.second;
 
-        TSQuery *query = ts_query_new(
-                queryLanguage,
-                queryString.c_str(),
-                queryString.length(),
-                &errorOffset,
-                &errorType
-        );
-
-        if (!query) {
-            utils::reportQueryError(queryName, errorOffset, errorType);
-        }
-
-        queries[queryName] = query;
+        // compiled queries are shared by all components and owned by the registry
+        queries[queryName] = QueryRegistry::getInstance()->getQuery(queryLanguage, queryString, queryName);
     }
 }
 
-Component::~Component() {
-    for (const auto& query: queries) {
-        ts_query_delete(query.second);
-    }
-}
\ No newline at end of file
+Component::~Component() = default;
@@ -6,6 +6,7 @@
 #define WUFF_COMPONENT_H
 
 #include "../WooWooAnalyzer.h"
+#include "../parser/QueryCursorPool.h"
 
 class Component {
     
@@ -19,8 +20,8 @@ protected:
     
     // pair of queryName, <lang, queryString>
     virtual const std::unordered_map<std::string, std::pair<TSLanguage*, std::string>>& getQueryStringByName() const = 0;
-    // queryName, query
-    std::unordered_map<std::string, TSQuery *> queries;
+    // queryName, query (borrowed from the QueryRegistry)
+    std::unordered_map<std::string, const TSQuery *> queries;
 };
 
 
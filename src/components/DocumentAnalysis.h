@@ -0,0 +1,30 @@
+#ifndef WUFF_DOCUMENTANALYSIS_H
+#define WUFF_DOCUMENTANALYSIS_H
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "../lsp/LSPTypes.h"
+
+// features of a document computed together by WooWooAnalyzer::analyzeDocument, combined as bit flags
+enum class DocumentFeature : uint32_t {
+    SemanticTokens = 1,
+    Diagnostics = 2,
+    FoldingRanges = 4,
+    All = 7,
+};
+
+/**
+ * The features of one version of a document asked for in a single request (e.g. after every change),
+ * the ones which were not asked for are not set.
+ */
+struct DocumentAnalysis {
+    // of the document the features were computed for, 0 if there is no such document
+    uint64_t version = 0;
+    std::optional<SemanticTokensData> semanticTokens;
+    std::optional<std::vector<Diagnostic>> diagnostics;
+    std::optional<std::vector<FoldingRange>> foldingRanges;
+};
+
+
+#endif //WUFF_DOCUMENTANALYSIS_H
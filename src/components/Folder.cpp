@@ -3,51 +3,149 @@
 //
 
 #include "Folder.h"
+#include <algorithm>
 #include "../utils/utils.h"
 
-// TODO feat: Add other kinds of folding ranges.
-// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#foldingRangeKind
+namespace {
+
+    bool overlaps(uint32_t startLine, uint32_t endLine, const std::optional<LineSpan> &lines) {
+        return !lines.has_value() || (endLine >= lines->first && startLine <= lines->last);
+    }
+
+    bool byStartLine(const FoldingRange &a, const FoldingRange &b) {
+        return a.startLine < b.startLine;
+    }
+}
 
 Folder::Folder(WooWooAnalyzer *analyzer) : Component(analyzer) {
     prepareQueries();
 }
 
 
+/**
+ * The ranges are computed once per version of the document, after an incremental change only the ones
+ * around the changed lines are collected again. A large document gets the ranges overlapping its visible
+ * lines only, they are not cached.
+ */
 std::vector<FoldingRange> Folder::foldingRanges(const TextDocumentIdentifier &tdi) {
 
     auto document = analyzer->getDocumentByUri(tdi.uri);
 
+    if (document->isLarge()) {
+        LineSpan visible = document->visibleLines();
+        document->parseDeferredMetas(visible);
+        return collectRanges(document, visible);
+    }
+    DocumentId id = analyzer->getDocumentId(document);
+    if (id == DocumentTable::NO_DOCUMENT) {
+        return collectRanges(document, std::nullopt);
+    }
+
+    CachedRanges &cached = rangeCache[id];
+    if (cached.version != 0 && cached.version == document->version) {
+        return cached.ranges;
+    }
+    if (cached.version != 0 && cached.version + 1 == document->version && document->lastChange.has_value()) {
+        updateRanges(document, cached);
+    } else {
+        cached.ranges = collectRanges(document, std::nullopt);
+    }
+    cached.version = document->version;
+    return cached.ranges;
+}
+
+/**
+ * Brings the ranges of the previous version up to date with the last change of the document.
+ * A range touching the changed lines (or the lines right next to them, a run of comments can grow into them)
+ * is collected again, the ones before are kept and the ones after are moved by the number of added lines.
+ */
+void Folder::updateRanges(DialectedWooWooDocument *document, CachedRanges &cached) {
+    const ChangedLines &change = document->lastChange.value();
+    uint32_t first = change.first == 0 ? 0 : change.first - 1;
+
     std::vector<FoldingRange> ranges;
+    ranges.reserve(cached.ranges.size());
+    for (const FoldingRange &range: cached.ranges) {
+        if (range.endLine < first) ranges.emplace_back(range);
+    }
+    size_t kept = ranges.size();
+    // ranges enclosing the change start before the kept ones may end
+    for (FoldingRange &range: collectRanges(document, LineSpan{first, change.newLast + 1})) {
+        ranges.emplace_back(std::move(range));
+    }
+    std::inplace_merge(ranges.begin(), ranges.begin() + static_cast<std::ptrdiff_t>(kept), ranges.end(), byStartLine);
+    for (const FoldingRange &range: cached.ranges) {
+        if (range.startLine <= change.oldLast + 1) continue;
+        FoldingRange &moved = ranges.emplace_back(range);
+        moved.startLine = moved.startLine + change.newLast - change.oldLast;
+        moved.endLine = moved.endLine + change.newLast - change.oldLast;
+    }
+    cached.ranges = std::move(ranges);
+}
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    ts_query_cursor_exec(cursor, queries[foldableTypesQuery], ts_tree_root_node(document->tree));
+/**
+ * Structures and blocks of the outline are regions, whole meta blocks too, runs of comment lines are comments
+ * and runs of includes on consecutive lines are imports. Except for the outline, which is kept as the client
+ * always got it, only ranges spanning more lines are folded.
+ */
+std::vector<FoldingRange> Folder::collectRanges(DialectedWooWooDocument *document,
+                                                const std::optional<LineSpan> &lines) {
+    std::vector<FoldingRange> ranges;
 
-    TSQueryMatch match;
-    while (ts_query_cursor_next_match(cursor, &match)) {
-        for (uint32_t i = 0; i < match.capture_count; ++i) {
-            TSNode capturedNode = match.captures[i].node;
+    // the outline is built once per version of the document, when it is indexed
+    for (const OutlineNode &node: document->getOutline()) {
+        if (lines && node.range.start.line > lines->last) break;
+        if (node.kind == OutlineNode::Kind::OuterEnvironment) continue;
+        if (!overlaps(node.range.start.line, node.range.end.line, lines)) continue;
+        ranges.emplace_back(node.range.start.line, node.range.start.character, node.range.end.line,
+                            node.range.end.character, "region");
+    }
 
-            TSPoint start_point = ts_node_start_point(capturedNode);
-            TSPoint end_point = ts_node_end_point(capturedNode);
+    for (const MetaContext &mx: document->metaBlocks) {
+        if (lines && mx.lineOffset > lines->last) break;
+        if (mx.lineCount == 0 || !overlaps(mx.lineOffset, mx.lastLine(), lines)) continue;
+        ranges.emplace_back(mx.lineOffset, 0, mx.lastLine(), 0, "region");
+    }
 
-            FoldingRange fr = FoldingRange(start_point.row, start_point.column, end_point.row, end_point.column,
-                                           "region");
-            ranges.emplace_back(fr);
+    const std::vector<CommentLine> &comments = document->commentLines;
+    for (size_t i = 0; i < comments.size();) {
+        size_t last = i;
+        while (last + 1 < comments.size() && comments[last + 1].lineNumber == comments[last].lineNumber + 1) {
+            ++last;
+        }
+        if (last > i && overlaps(comments[i].lineNumber, comments[last].lineNumber, lines)) {
+            ranges.emplace_back(comments[i].lineNumber, 0, comments[last].lineNumber, comments[last].lineLength,
+                                "comment");
         }
+        i = last + 1;
     }
-    ts_query_cursor_delete(cursor);
 
+    const std::vector<DocumentIndex::Include> &includes = document->getIndex().includes;
+    for (size_t i = 0; i < includes.size();) {
+        size_t last = i;
+        while (last + 1 < includes.size() &&
+               includes[last + 1].range.start.line == includes[last].range.end.line + 1) {
+            ++last;
+        }
+        if (last > i && overlaps(includes[i].range.start.line, includes[last].range.end.line, lines)) {
+            // the statement starts at the beginning of its line, the range is the one of the path
+            ranges.emplace_back(includes[i].range.start.line, 0, includes[last].range.end.line,
+                                includes[last].range.end.character, "imports");
+        }
+        i = last + 1;
+    }
+
+    std::stable_sort(ranges.begin(), ranges.end(), byStartLine);
     return ranges;
 }
 
+void Folder::forgetDocument(DocumentId id) {
+    rangeCache.erase(id);
+}
+
 const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> &Folder::getQueryStringByName() const {
     return queryStringsByName;
 }
 
-const std::string Folder::foldableTypesQuery = "foldableTypesQuery";
-const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Folder::queryStringsByName = {
-        {foldableTypesQuery, std::make_pair(tree_sitter_woowoo(), R"(
-(document_part) @dp
-(wobject) @ob
-(block) @b
-)")}};
+// no queries of its own, the outline of the document is folded
+const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Folder::queryStringsByName = {};
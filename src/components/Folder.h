@@ -15,14 +15,27 @@ public:
     explicit Folder(WooWooAnalyzer * analyzer);
     
     std::vector<FoldingRange> foldingRanges (const TextDocumentIdentifier & tdi);
+    // drops the cached ranges of a document which was removed from the workspace
+    void forgetDocument(DocumentId id);
     
 private:
     
     [[nodiscard]] const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>>& getQueryStringByName() const override;
     static const std::unordered_map<std::string, std::pair<TSLanguage*,std::string>> queryStringsByName;
-    
-    static const std::string foldableTypesQuery;
 
+    // the ranges of one version of a document, ordered by their start lines
+    struct CachedRanges {
+        uint64_t version = 0;
+        std::vector<FoldingRange> ranges;
+    };
+
+    // by the id of the document
+    std::unordered_map<DocumentId, CachedRanges> rangeCache;
+
+    void updateRanges(DialectedWooWooDocument * document, CachedRanges & cached);
+    // the ranges overlapping the lines (all of them if there are none), ordered by their start lines
+    static std::vector<FoldingRange> collectRanges(DialectedWooWooDocument * document,
+                                                   const std::optional<LineSpan> & lines);
 };
 
 
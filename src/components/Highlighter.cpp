@@ -10,44 +10,190 @@
 
 Highlighter::Highlighter(WooWooAnalyzer *analyzer) : Component(analyzer) {
     prepareQueries();
+    buildCaptureTokenTypes();
 }
 
 
-std::vector<int> Highlighter::semanticTokens(const TextDocumentIdentifier &tdi) {
-    auto documentPath = utils::uriToPathString(tdi.uri);
-    auto document = analyzer->getDocument(documentPath);
+SemanticTokensData Highlighter::semanticTokens(const TextDocumentIdentifier &tdi) {
+    auto document = analyzer->getDocumentByUri(tdi.uri);
+    if (!document) return {};
+    return SemanticTokensData{documentTokens(document).data};
+}
 
-    std::vector<int> data;
-    std::vector<NodeInfo> nodes;
+SemanticTokens Highlighter::semanticTokensFull(const TextDocumentIdentifier &tdi) {
+    auto document = analyzer->getDocumentByUri(tdi.uri);
+    if (!document) return rememberResult(DocumentTable::NO_DOCUMENT, {});
+    return rememberResult(analyzer->getDocumentId(document), documentTokens(document).data);
+}
 
+SemanticTokensData Highlighter::semanticTokensRange(const SemanticTokensRangeParams &params) {
+    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
+    if (!document) return {};
+    // a range ending at the start of a line does not include anything of that line
+    uint32_t lastLine = params.range.end.line;
+    if (params.range.end.character == 0 && lastLine > params.range.start.line) --lastLine;
+    LineRange lines{params.range.start.line, std::max(params.range.start.line, lastLine)};
+    if (document->isLarge()) {
+        document->parseDeferredMetas(LineSpan{lines.first, lines.last});
+    }
 
-    TSQueryCursor *wooCursor = ts_query_cursor_new();
-    ts_query_cursor_exec(wooCursor, queries[woowooHighlightQuery], ts_tree_root_node(document->tree));
+    auto cached = tokenCache.find(analyzer->getDocumentId(document));
+    if (cached == tokenCache.end() || cached->second.version != document->version) {
+        return SemanticTokensData{encodeTokens(collectTokens(document, lines))};
+    }
+    // the tokens of the current version are known, no need to query the trees
+    std::vector<Token> tokens;
+    for (const Token &token: cached->second.tokens) {
+        if (token.line > lines.last) break;
+        if (token.lastLine >= lines.first) {
+            tokens.emplace_back(token);
+        }
+    }
+    return SemanticTokensData{encodeTokens(tokens)};
+}
 
-    TSQueryMatch match;
-    while (ts_query_cursor_next_match(wooCursor, &match)) {
-        for (uint32_t i = 0; i < match.capture_count; ++i) {
-            uint32_t capture_index = match.captures[i].index;
-            TSNode capturedNode = match.captures[i].node;
+std::variant<SemanticTokens, SemanticTokensDelta> Highlighter::semanticTokensDelta(const SemanticTokensDeltaParams &params) {
+    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
+    std::vector<uint32_t> data = document ? documentTokens(document).data : std::vector<uint32_t>();
+    DocumentId id = document ? analyzer->getDocumentId(document) : DocumentTable::NO_DOCUMENT;
 
-            uint32_t capture_name_length;
-            const char *capture_name_chars = ts_query_capture_name_for_id(queries[woowooHighlightQuery], capture_index,
-                                                                          &capture_name_length);
-            std::string capture_name(capture_name_chars, capture_name_length);
+    auto previous = previousResults.find(id);
+    if (previous == previousResults.end() || previous->second.resultId != params.previousResultId) {
+        return rememberResult(id, std::move(data));
+    }
 
-            TSPoint start_point = ts_node_start_point(capturedNode);
-            TSPoint end_point = ts_node_end_point(capturedNode);
+    // a single edit replacing everything between the common prefix and the common suffix
+    const std::vector<uint32_t> &old = previous->second.data.values;
+    size_t prefix = 0;
+    while (prefix < old.size() && prefix < data.size() && old[prefix] == data[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < old.size() - prefix && suffix < data.size() - prefix &&
+           old[old.size() - 1 - suffix] == data[data.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    SemanticTokensDelta delta;
+    if (prefix != old.size() || prefix != data.size()) {
+        SemanticTokensEdit edit;
+        edit.start = static_cast<uint32_t>(prefix);
+        edit.deleteCount = static_cast<uint32_t>(old.size() - prefix - suffix);
+        edit.data.values.assign(data.begin() + static_cast<std::ptrdiff_t>(prefix),
+                                data.end() - static_cast<std::ptrdiff_t>(suffix));
+        delta.edits.emplace_back(std::move(edit));
+    }
+    delta.resultId = rememberResult(id, std::move(data)).resultId;
+    return delta;
+}
+
+SemanticTokens Highlighter::rememberResult(DocumentId id, std::vector<uint32_t> data) {
+    if (id == DocumentTable::NO_DOCUMENT) {
+        return SemanticTokens{std::to_string(nextResultId++), SemanticTokensData{std::move(data)}};
+    }
+    SemanticTokens &result = previousResults[id];
+    result.resultId = std::to_string(nextResultId++);
+    result.data.values = std::move(data);
+    return result;
+}
+
+/**
+ * The tokens of the current version of the document. They are computed once per version,
+ * after an incremental change only the changed lines are queried again.
+ * A large document gets only the tokens of its visible lines, they are not cached.
+ */
+const Highlighter::CachedTokens &Highlighter::documentTokens(DialectedWooWooDocument *document) {
+    if (document->isLarge()) {
+        LineSpan visible = document->visibleLines();
+        document->parseDeferredMetas(visible);
+        uncachedTokens.version = document->version;
+        uncachedTokens.tokens = collectTokens(document, LineRange{visible.first, visible.last});
+        uncachedTokens.data = encodeTokens(uncachedTokens.tokens);
+        return uncachedTokens;
+    }
+    DocumentId id = analyzer->getDocumentId(document);
+    if (id == DocumentTable::NO_DOCUMENT) {
+        uncachedTokens.version = document->version;
+        uncachedTokens.tokens = collectTokens(document, std::nullopt);
+        uncachedTokens.data = encodeTokens(uncachedTokens.tokens);
+        return uncachedTokens;
+    }
+
+    CachedTokens &cached = tokenCache[id];
+    if (cached.version != 0 && cached.version == document->version) {
+        return cached;
+    }
+    if (cached.version != 0 && cached.version + 1 == document->version && document->lastChange.has_value()) {
+        updateTokens(document, cached);
+    } else {
+        cached.tokens = collectTokens(document, std::nullopt);
+    }
+    cached.version = document->version;
+    cached.data = encodeTokens(cached.tokens);
+    return cached;
+}
 
-            nodes.emplace_back(start_point, end_point, capture_name);
+/**
+ * Brings the tokens of the previous version up to date with the last change of the document.
+ * Tokens before the changed lines are kept, tokens after them are moved by the number of added
+ * (or removed) lines, and only the changed lines are collected again.
+ */
+void Highlighter::updateTokens(WooWooDocument *document, CachedTokens &cached) {
+    ChangedLines change = document->lastChange.value();
+
+    // YAML is highlighted by the trees of whole meta blocks, a block touching the change is collected whole
+    for (const MetaContext &metaContext: document->metaBlocks) {
+        uint32_t firstLine = metaContext.lineOffset;
+        uint32_t lastLine = metaContext.lastLine();
+        if (lastLine < change.first || firstLine > change.newLast) continue;
+        change.first = std::min(change.first, firstLine);
+        if (lastLine > change.newLast) {
+            change.oldLast += lastLine - change.newLast;
+            change.newLast = lastLine;
         }
     }
-    ts_query_cursor_delete(wooCursor);
+    // as well as a token which reaches into the changed lines from before them
+    for (const Token &token: cached.tokens) {
+        if (token.line >= change.first) break;
+        if (token.lastLine >= change.first) {
+            change.first = token.line;
+            break;
+        }
+    }
+
+    std::vector<Token> tokens;
+    tokens.reserve(cached.tokens.size());
+    auto oldToken = cached.tokens.begin();
+    for (; oldToken != cached.tokens.end() && oldToken->line < change.first; ++oldToken) {
+        tokens.emplace_back(*oldToken);
+    }
+    for (const Token &token: collectTokens(document, LineRange{change.first, change.newLast})) {
+        if (token.line >= change.first && token.line <= change.newLast) {
+            tokens.emplace_back(token);
+        }
+    }
+    for (; oldToken != cached.tokens.end(); ++oldToken) {
+        if (oldToken->line <= change.oldLast) continue;
+        Token moved = *oldToken;
+        moved.line = moved.line + change.newLast - change.oldLast;
+        moved.lastLine = moved.lastLine + change.newLast - change.oldLast;
+        tokens.emplace_back(moved);
+    }
+    cached.tokens = std::move(tokens);
+}
+
+/**
+ * Collects the tokens of the document (or of the given lines only), sorted by their position.
+ */
+std::vector<Highlighter::Token> Highlighter::collectTokens(WooWooDocument *document, const std::optional<LineRange> &lines) {
+    std::vector<NodeInfo> nodes;
 
+    addWooWooNodes(document, nodes, lines);
 
     // - - Adding nodes from YAML highlights
-    addMetaBlocksNodes(document, nodes);
+    addMetaBlocksNodes(document, nodes, lines);
 
-    addCommentNodes(document, nodes);
+    addCommentNodes(document, nodes, lines);
 
     // Filtering
     std::vector<NodeInfo> unique;
@@ -75,39 +221,62 @@ std::vector<int> Highlighter::semanticTokens(const TextDocumentIdentifier &tdi)
         return a.startPoint.column < b.startPoint.column;
     });
 
-    uint32_t lastLine = 0;
-    uint32_t lastStart = 0;
+    std::vector<Token> tokens;
+    tokens.reserve(nodes.size());
     for (const NodeInfo &node: nodes) {
-
         std::pair<uint32_t , uint32_t> startPoint = document->utfMappings->utf8ToUtf16(node.startPoint.row,
                                                                             node.startPoint.column);
         std::pair<uint32_t, uint32_t> endPoint = document->utfMappings->utf8ToUtf16(node.endPoint.row, node.endPoint.column);
+        tokens.emplace_back(Token{startPoint.first, startPoint.second, endPoint.second - startPoint.second,
+                                  endPoint.first, node.tokenType});
+    }
+    return tokens;
+}
 
-        uint32_t deltaStart =
-                lastLine == startPoint.first ? startPoint.second - lastStart : startPoint.second;
+/**
+ * Encodes the tokens as LSP semantic tokens, each relative to the previous one.
+ */
+std::vector<uint32_t> Highlighter::encodeTokens(const std::vector<Token> &tokens) {
+    std::vector<uint32_t> data;
+    data.reserve(tokens.size() * 5);
 
-        uint32_t deltaLine = startPoint.first - lastLine;
-        lastLine = startPoint.first;
-        lastStart = startPoint.second;
+    uint32_t lastLine = 0;
+    uint32_t lastStart = 0;
+    for (const Token &token: tokens) {
+        uint32_t deltaStart = lastLine == token.line ? token.start - lastStart : token.start;
+        uint32_t deltaLine = token.line - lastLine;
+        lastLine = token.line;
+        lastStart = token.start;
 
         data.emplace_back(deltaLine);
         data.emplace_back(deltaStart);
-        data.emplace_back(endPoint.second - startPoint.second);
-        data.emplace_back(tokenTypeIndices[node.name]);
+        data.emplace_back(token.length);
+        data.emplace_back(token.tokenType);
         data.emplace_back(0);
     }
 
-
     return data;
 }
 
 
-void Highlighter::addMetaBlocksNodes(WooWooDocument *document, std::vector<NodeInfo> &nodes) {
+void Highlighter::addMetaBlocksNodes(WooWooDocument *document, std::vector<NodeInfo> &nodes,
+                                     const std::optional<LineRange> &lines) {
 
 
-    for (MetaContext *metaContext: document->metaBlocks) {
-        TSQueryCursor *yamlCursor = ts_query_cursor_new();
-        ts_query_cursor_exec(yamlCursor, queries[yamlHighlightQuery], ts_tree_root_node(metaContext->tree));
+    for (const MetaContext &metaContext: document->metaBlocks) {
+        // the YAML of a large document is parsed once its lines are asked for
+        if (!metaContext.isParsed()) continue;
+        QueryCursorPool::Lease yamlCursor = QueryCursorPool::acquire();
+        TSNode root = ts_tree_root_node(metaContext.tree);
+        if (lines.has_value()) {
+            uint32_t firstLine = metaContext.lineOffset;
+            uint32_t lastLine = metaContext.lastLine();
+            // meta blocks outside of the range are not queried at all
+            if (lastLine < lines->first || firstLine > lines->last) continue;
+            ts_query_cursor_set_point_range(yamlCursor, TSPoint{std::max(lines->first, firstLine), 0},
+                                            TSPoint{lines->last + 1, 0});
+        }
+        ts_query_cursor_exec(yamlCursor, queries[yamlHighlightQuery], root);
 
         TSQueryMatch match;
         while (ts_query_cursor_next_match(yamlCursor, &match)) {
@@ -116,45 +285,87 @@ void Highlighter::addMetaBlocksNodes(WooWooDocument *document, std::vector<NodeI
                 // The capture ID uniquely identifies the capture within the query
                 uint32_t capture_id = match.captures[i].index;
 
-                // Get the capture name using the capture ID
-                uint32_t capture_name_length;
-                const char *capture_name_chars = ts_query_capture_name_for_id(queries[yamlHighlightQuery], capture_id,
-                                                                              &capture_name_length);
-                std::string capture_name(capture_name_chars, capture_name_length);
-
-                TSPoint start_point = ts_node_start_point(capturedNode);
-                start_point.row += metaContext->lineOffset;
-                TSPoint end_point = ts_node_end_point(capturedNode);
-                end_point.row += metaContext->lineOffset;
-
-
-                nodes.emplace_back(start_point, end_point, capture_name);
+                // the tree has the positions of the document
+                nodes.emplace_back(ts_node_start_point(capturedNode), ts_node_end_point(capturedNode),
+                                   yamlCaptureTokenTypes[capture_id]);
             }
         }
-
-        ts_query_cursor_delete(yamlCursor);
     }
 
 }
 
-void Highlighter::addCommentNodes(WooWooDocument *document, std::vector<NodeInfo> &nodes) {
+void Highlighter::addCommentNodes(WooWooDocument *document, std::vector<NodeInfo> &nodes,
+                                  const std::optional<LineRange> &lines) {
 
-    for (CommentLine *cl: document->commentLines) {
-        TSPoint start = {cl->lineNumber, 0};
-        TSPoint end = {cl->lineNumber, cl->lineLength};
-        nodes.emplace_back(start, end, "comment");
+    for (const CommentLine &cl: document->commentLines) {
+        if (lines.has_value() && (cl.lineNumber < lines->first || cl.lineNumber > lines->last)) continue;
+        TSPoint start = {cl.lineNumber, 0};
+        TSPoint end = {cl.lineNumber, cl.lineLength};
+        nodes.emplace_back(start, end, commentTokenType);
     }
 
 }
 
 
+
+void Highlighter::addWooWooNodes(WooWooDocument *document, std::vector<NodeInfo> &nodes,
+                                 const std::optional<LineRange> &lines) {
+    QueryCursorPool::Lease wooCursor = QueryCursorPool::acquire();
+    if (lines.has_value()) {
+        ts_query_cursor_set_point_range(wooCursor, TSPoint{lines->first, 0}, TSPoint{lines->last + 1, 0});
+    }
+    ts_query_cursor_exec(wooCursor, queries[woowooHighlightQuery], ts_tree_root_node(document->tree));
+
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(wooCursor, &match)) {
+        for (uint32_t i = 0; i < match.capture_count; ++i) {
+            uint32_t capture_index = match.captures[i].index;
+            TSNode capturedNode = match.captures[i].node;
+
+            TSPoint start_point = ts_node_start_point(capturedNode);
+            TSPoint end_point = ts_node_end_point(capturedNode);
+
+            nodes.emplace_back(start_point, end_point, woowooCaptureTokenTypes[capture_index]);
+        }
+    }
+}
+
 void Highlighter::setTokenTypes(std::vector<std::string> tokenTypesFromClient) {
     this->tokenTypes = std::move(tokenTypesFromClient);
 
     // build a map for fast access
+    tokenTypeIndices.clear();
     for (size_t i = 0; i < tokenTypes.size(); ++i) {
         tokenTypeIndices[tokenTypes[i]] = i;
     }
+    buildCaptureTokenTypes();
+    tokenCache.clear();
+}
+
+void Highlighter::buildCaptureTokenTypes() {
+    woowooCaptureTokenTypes = captureTokenTypes(queries[woowooHighlightQuery]);
+    yamlCaptureTokenTypes = captureTokenTypes(queries[yamlHighlightQuery]);
+    commentTokenType = tokenTypeIndex("comment");
+}
+
+std::vector<uint32_t> Highlighter::captureTokenTypes(const TSQuery *query) const {
+    std::vector<uint32_t> table;
+    if (!query) return table;
+
+    uint32_t captureCount = ts_query_capture_count(query);
+    table.reserve(captureCount);
+    for (uint32_t id = 0; id < captureCount; ++id) {
+        uint32_t length;
+        const char *name = ts_query_capture_name_for_id(query, id, &length);
+        table.emplace_back(tokenTypeIndex(std::string(name, length)));
+    }
+    return table;
+}
+
+uint32_t Highlighter::tokenTypeIndex(const std::string &tokenType) const {
+    // token types unknown to the client fall back to the first one
+    auto it = tokenTypeIndices.find(tokenType);
+    return it != tokenTypeIndices.end() ? it->second : 0;
 }
 
 void Highlighter::setTokenModifiers(std::vector<std::string> tokenModifiersFromClient) {
@@ -164,6 +375,16 @@ void Highlighter::setTokenModifiers(std::vector<std::string> tokenModifiersFromC
     for (size_t i = 0; i < tokenModifiers.size(); ++i) {
         tokenModifierIndices[tokenModifiers[i]] = i;
     }
+    tokenCache.clear();
+}
+
+void Highlighter::forgetDocument(DocumentId id) {
+    tokenCache.erase(id);
+    previousResults.erase(id);
+}
+
+void Highlighter::documentClosed(DocumentId id) {
+    previousResults.erase(id);
 }
 
 
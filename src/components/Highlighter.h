@@ -5,7 +5,9 @@
 #ifndef WUFF_HIGHLIGHTER_H
 #define WUFF_HIGHLIGHTER_H
 
+#include <optional>
 #include <string>
+#include <variant>
 #include <vector>
 
 #include "../WooWooAnalyzer.h"
@@ -14,10 +16,10 @@
 struct NodeInfo {
     TSPoint startPoint;
     TSPoint endPoint;  
-    std::string name;  
+    uint32_t tokenType; // index into the token types of the client
 
-    NodeInfo(const TSPoint& start, const TSPoint& end, const std::string& captureName)
-            : startPoint(start), endPoint(end), name(captureName) {}
+    NodeInfo(const TSPoint& start, const TSPoint& end, uint32_t tokenType)
+            : startPoint(start), endPoint(end), tokenType(tokenType) {}
 };
 
 struct pairHash {
@@ -35,10 +37,20 @@ class Highlighter : Component {
 public:
     Highlighter(WooWooAnalyzer * analyzer);
     
-    std::vector<int> semanticTokens(const TextDocumentIdentifier &tdi);
+    SemanticTokensData semanticTokens(const TextDocumentIdentifier &tdi);
+    // textDocument/semanticTokens/full, the result is remembered for the next delta request
+    SemanticTokens semanticTokensFull(const TextDocumentIdentifier &tdi);
+    // textDocument/semanticTokens/range, only the lines of the range are queried
+    SemanticTokensData semanticTokensRange(const SemanticTokensRangeParams &params);
+    // textDocument/semanticTokens/full/delta, all tokens if the previous result is not known (anymore)
+    std::variant<SemanticTokens, SemanticTokensDelta> semanticTokensDelta(const SemanticTokensDeltaParams &params);
     
     void setTokenTypes(std::vector<std::string>);
     void setTokenModifiers (std::vector<std::string>);
+    // drops the cached tokens of a document which was removed from the workspace
+    void forgetDocument(DocumentId id);
+    // drops the result remembered for the next delta, the client does not ask for one after closing the document
+    void documentClosed(DocumentId id);
     
     
 private:
@@ -54,9 +66,56 @@ private:
     
     std::unordered_map<std::string, size_t> tokenTypeIndices;
     std::unordered_map<std::string, size_t> tokenModifierIndices;
+
+    // capture id -> token type index, rebuilt whenever the client token types change
+    std::vector<uint32_t> woowooCaptureTokenTypes;
+    std::vector<uint32_t> yamlCaptureTokenTypes;
+    uint32_t commentTokenType = 0;
+
+    void buildCaptureTokenTypes();
+    [[nodiscard]] std::vector<uint32_t> captureTokenTypes(const TSQuery * query) const;
+    [[nodiscard]] uint32_t tokenTypeIndex(const std::string & tokenType) const;
     
-    void addMetaBlocksNodes(WooWooDocument * document,  std::vector<NodeInfo> & nodes);
-    void addCommentNodes(WooWooDocument * document,  std::vector<NodeInfo> & nodes);
+    // lines (both inclusive) to collect the tokens from
+    struct LineRange {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    // the last full result for every document (by its id), the base of the next delta
+    std::unordered_map<DocumentId, SemanticTokens> previousResults;
+    uint64_t nextResultId = 1;
+
+    // a token with its position in UTF-16 code units
+    struct Token {
+        uint32_t line;
+        uint32_t start;
+        uint32_t length;
+        uint32_t lastLine;
+        uint32_t tokenType;
+    };
+
+    // the tokens of one version of a document, together with their encoding
+    struct CachedTokens {
+        uint64_t version = 0;
+        std::vector<Token> tokens;
+        std::vector<uint32_t> data;
+    };
+
+    // by the id of the document, cleared when the token types of the client change
+    std::unordered_map<DocumentId, CachedTokens> tokenCache;
+    // used for documents without an id and for large documents, never reused between requests
+    CachedTokens uncachedTokens;
+
+    const CachedTokens & documentTokens(DialectedWooWooDocument * document);
+    void updateTokens(WooWooDocument * document, CachedTokens & cached);
+    std::vector<Token> collectTokens(WooWooDocument * document, const std::optional<LineRange> & lines);
+    static std::vector<uint32_t> encodeTokens(const std::vector<Token> & tokens);
+    // a result of a document which is not in the workspace is not remembered
+    SemanticTokens rememberResult(DocumentId id, std::vector<uint32_t> data);
+    void addWooWooNodes(WooWooDocument * document,  std::vector<NodeInfo> & nodes, const std::optional<LineRange> & lines);
+    void addMetaBlocksNodes(WooWooDocument * document,  std::vector<NodeInfo> & nodes, const std::optional<LineRange> & lines);
+    void addCommentNodes(WooWooDocument * document,  std::vector<NodeInfo> & nodes, const std::optional<LineRange> & lines);
 };
 
 
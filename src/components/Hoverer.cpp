@@ -15,26 +15,43 @@ std::string Hoverer::hover(const TextDocumentPositionParams &params) {
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
     auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
     
-    TSQueryCursor *cursor = ts_query_cursor_new();
     TSPoint start_point = {pos.first, pos.second};
     TSPoint end_point = {pos.first, pos.second + 1};
+    DocumentId id = analyzer->getDocumentId(document);
+    // the description does not depend on the other documents of the project
+    if (const std::string *cached = hoverCache.find(id, document->version, 0, start_point)) {
+        return *cached;
+    }
+
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
     ts_query_cursor_set_point_range(cursor, start_point, end_point);
     ts_query_cursor_exec(cursor, queries[hoverableNodesQuery], ts_tree_root_node(document->tree));
 
     TSQueryMatch match;
-    std::string nodeType;
-    std::string nodeText;
+    std::string_view nodeType;
+    std::string_view nodeText;
     if (ts_query_cursor_next_match(cursor, &match)) {
         if (match.capture_count > 0) {
             TSNode node = match.captures[0].node;
             nodeType = ts_node_type(node);
             nodeText = document->getNodeText(node);
-
+            // hoverable nodes do not nest, the whole node has the same description
+            start_point = ts_node_start_point(node);
+            end_point = ts_node_end_point(node);
         }
     }
 
-    ts_query_cursor_delete(cursor);
-    return DialectManager::getInstance()->getDescription(nodeType, nodeText);
+    std::string description = document->getDialect()->getDescription(nodeType, nodeText);
+    hoverCache.insert(id, document->version, 0, start_point, end_point, description);
+    return description;
+}
+
+void Hoverer::forgetDocument(DocumentId id) {
+    hoverCache.forgetDocument(id);
+}
+
+void Hoverer::clearCache() {
+    hoverCache.clear();
 }
 
 const std::unordered_map <std::string, std::pair<TSLanguage *, std::string>> &Hoverer::getQueryStringByName() const {
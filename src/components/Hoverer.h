@@ -10,6 +10,7 @@
 
 #include "../WooWooAnalyzer.h"
 #include "Component.h"
+#include "PositionCache.h"
 
 class Hoverer : Component {
 public:
@@ -17,7 +18,14 @@ public:
 
     std::string hover(const TextDocumentPositionParams &params);
 
+    // drops the cached descriptions of a document which was removed from the workspace
+    void forgetDocument(DocumentId id);
+    // the descriptions come from the dialect, they are dropped when it changes
+    void clearCache();
+
 private:
+    // the description of the hovered node (or of nothing), by its range
+    PositionCache<std::string> hoverCache;
 
     [[nodiscard]] const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>>& getQueryStringByName() const override;
 
@@ -3,6 +3,14 @@
 //
 
 #include "Linter.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace {
+    // the symbol of ERROR nodes in every tree-sitter language (ts_builtin_sym_error)
+    const TSSymbol errorSymbol = static_cast<TSSymbol>(-1);
+}
 
 Linter::Linter(WooWooAnalyzer *analyzer) : Component(analyzer) {
     prepareQueries();
@@ -11,78 +19,226 @@ Linter::Linter(WooWooAnalyzer *analyzer) : Component(analyzer) {
 std::vector<Diagnostic> Linter::diagnose(const TextDocumentIdentifier &tdi) {
 
     auto doc = analyzer->getDocumentByUri(tdi.uri);
+    if (!doc) return {};
 
     std::vector<Diagnostic> diagnostics;
-    diagnoseErrors(doc, diagnostics);
-    diagnoseMissingNodes(doc, diagnostics);
+    if (doc->isLarge()) {
+        // only the visible lines of a large document are checked
+        LineSpan visible = doc->visibleLines();
+        diagnostics = toDiagnostics(collectFindings(doc, LineRange{visible.first, visible.last}));
+        diagnoseReferences(doc, diagnostics);
+        std::erase_if(diagnostics, [&visible](const Diagnostic &diagnostic) {
+            return diagnostic.range.end.line < visible.first || diagnostic.range.start.line > visible.last;
+        });
+        return diagnostics;
+    }
+    DocumentId id = analyzer->getDocumentId(doc);
+    if (id == DocumentTable::NO_DOCUMENT) {
+        diagnostics = toDiagnostics(collectFindings(doc, std::nullopt));
+    } else {
+        diagnostics = toDiagnostics(syntaxFindings(doc, findingsCache[id]));
+    }
+    diagnoseReferences(doc, diagnostics);
+    return diagnostics;
+}
 
+std::vector<Diagnostic> Linter::check(DialectedWooWooDocument *doc) {
+    std::vector<Diagnostic> diagnostics;
+    if (doc->getIndex().syntaxErrors) {
+        bool materialized = doc->isMaterialized();
+        doc->materialize();
+        diagnostics = toDiagnostics(collectFindings(doc, std::nullopt));
+        if (!materialized) doc->dematerialize();
+    }
+    diagnoseReferences(doc, diagnostics);
     return diagnostics;
 }
 
+/**
+ * The syntax errors of the current version of the document. They are computed once per version,
+ * after an incremental change only the changed lines are checked again.
+ */
+const std::vector<Linter::Finding> &Linter::syntaxFindings(DialectedWooWooDocument *doc, CachedFindings &cached) {
+    if (cached.version != 0 && cached.version == doc->version) {
+        return cached.findings;
+    }
+    if (cached.version != 0 && cached.version + 1 == doc->version && doc->lastChange.has_value()) {
+        updateFindings(doc, cached);
+    } else {
+        cached.findings = collectFindings(doc, std::nullopt);
+    }
+    cached.version = doc->version;
+    return cached.findings;
+}
 
-void Linter::diagnoseErrors(WooWooDocument *doc, std::vector<Diagnostic> &diagnostics) {
+/**
+ * Checks the references and definitions of the document against the reference index of its project,
+ * the other documents are not visited. A reference is unresolved if none of the metaKeys it can reference
+ * defines its value, and a value defined by more than one field (in any documents) is a duplicate.
+ */
+void Linter::diagnoseReferences(DialectedWooWooDocument *doc, std::vector<Diagnostic> &diagnostics) {
+    WooWooProject *project = analyzer->getProjectByDocument(doc);
+    if (!project) return;
+    const DocumentIndex &index = doc->getIndex();
+
+    // a site is listed for every metaKey it can reference, by its position and value
+    std::map<std::tuple<uint32_t, uint32_t, std::string_view>, std::pair<Range, bool>> sites;
+    for (const auto &byKey: index.referenceSites) {
+        for (const auto &byValue: byKey.second) {
+            bool defined = project->getDefinitionSites(byKey.first, byValue.first) != nullptr;
+            for (const Range &range: byValue.second) {
+                auto &site = sites.try_emplace({range.start.line, range.start.character, byValue.first},
+                                               range, false).first->second;
+                site.second = site.second || defined;
+            }
+        }
+    }
 
-    TSQueryCursor *errorCursor = ts_query_cursor_new();
-    ts_query_cursor_exec(errorCursor, queries[errorNodesQuery], ts_tree_root_node(doc->tree));
+    std::vector<Diagnostic> semantic;
+    for (const auto &site: sites) {
+        if (site.second.second) continue;
+        semantic.emplace_back(site.second.first, "Unresolved reference: " + std::string(std::get<2>(site.first)),
+                              "source", DiagnosticSeverity::Warning);
+    }
 
-    TSQueryMatch match;
-    while (ts_query_cursor_next_match(errorCursor, &match)) {
-        for (unsigned i = 0; i < match.capture_count; ++i) {
-            TSNode error_node = match.captures[i].node;
-            auto text = doc->getNodeText(error_node);
-            // Construct the range
-            TSPoint start_point = ts_node_start_point(error_node);
-            TSPoint end_point = ts_node_end_point(error_node);
-            Range range = {Position{start_point.row, start_point.column}, Position{end_point.row, end_point.column}};
-            doc->utfMappings->utf8ToUtf16(range);
-            if (range.start.line != range.end.line) {
-                range.end = Position{start_point.row, start_point.column + 1};
+    const SymbolTable *symbols = SymbolTable::getInstance();
+    for (const auto &byKey: index.definitionSites) {
+        for (const auto &byValue: byKey.second) {
+            auto definedAt = project->getDefinitionSites(byKey.first, byValue.first);
+            uint32_t count = 0;
+            if (definedAt) {
+                for (const auto &byDocument: *definedAt) {
+                    count += byDocument.second;
+                }
             }
+            if (count < 2) continue;
+            for (const Range &range: byValue.second) {
+                semantic.emplace_back(range, "Duplicate " + symbols->name(byKey.first) + ": " + byValue.first,
+                                      "source", DiagnosticSeverity::Warning);
+            }
+        }
+    }
 
-            Diagnostic diagnostic = {range, "Syntax error", "source", DiagnosticSeverity::Error};
-            diagnostics.emplace_back(diagnostic);
+    std::sort(semantic.begin(), semantic.end(), [](const Diagnostic &a, const Diagnostic &b) {
+        return std::tie(a.range.start.line, a.range.start.character) <
+               std::tie(b.range.start.line, b.range.start.character);
+    });
+    diagnostics.insert(diagnostics.end(), semantic.begin(), semantic.end());
+}
+
+void Linter::forgetDocument(DocumentId id) {
+    findingsCache.erase(id);
+}
+
+/**
+ * Brings the findings of the previous version up to date with the last change of the document.
+ * Findings before the changed lines are kept, findings after them are moved by the number of added
+ * (or removed) lines, and only the changed lines are checked again.
+ */
+void Linter::updateFindings(WooWooDocument *doc, CachedFindings &cached) {
+    ChangedLines change = doc->lastChange.value();
+
+    // a node which reaches into the changed lines from before them is checked again as a whole
+    for (const Finding &finding: cached.findings) {
+        if (finding.line >= change.first) break;
+        if (finding.lastLine >= change.first) {
+            change.first = finding.line;
+            break;
         }
     }
 
+    std::vector<Finding> changed = collectFindings(doc, LineRange{change.first, change.newLast});
+    if (!changed.empty() && changed.front().line < change.first) {
+        // a new error node starts before the changed lines, the kept findings cannot be trusted
+        cached.findings = collectFindings(doc, std::nullopt);
+        return;
+    }
+
+    std::vector<Finding> findings;
+    findings.reserve(cached.findings.size() + changed.size());
+    auto oldFinding = cached.findings.begin();
+    for (; oldFinding != cached.findings.end() && oldFinding->line < change.first; ++oldFinding) {
+        findings.emplace_back(*oldFinding);
+    }
+    for (Finding &finding: changed) {
+        if (finding.line <= change.newLast) {
+            findings.emplace_back(std::move(finding));
+        }
+    }
+    for (; oldFinding != cached.findings.end(); ++oldFinding) {
+        if (oldFinding->line <= change.oldLast) continue;
+        Finding moved = *oldFinding;
+        moved.line = moved.line + change.newLast - change.oldLast;
+        moved.lastLine = moved.lastLine + change.newLast - change.oldLast;
+        moved.diagnostic.range.start.line = moved.diagnostic.range.start.line + change.newLast - change.oldLast;
+        moved.diagnostic.range.end.line = moved.diagnostic.range.end.line + change.newLast - change.oldLast;
+        findings.emplace_back(std::move(moved));
+    }
+    cached.findings = std::move(findings);
 }
 
-void Linter::diagnoseMissingNodes(WooWooDocument *doc, std::vector<Diagnostic> &diagnostics) {
-    // Recursive lambda function to traverse the syntax tree
-    std::function<void(TSNode)> traverseTree = [&](TSNode node) {
-        uint32_t childCount = ts_node_child_count(node);
-
-        for (uint32_t i = 0; i < childCount; ++i) {
-            TSNode child = ts_node_child(node, i);
-
-            if (ts_node_is_missing(child)) {
-                // Constructing the range for the missing node
-                TSPoint start_point = ts_node_start_point(child);
-                TSPoint end_point = ts_node_end_point(child);
-
-                Range range = {Position{start_point.row, start_point.column},
-                               Position{end_point.row, end_point.column + 1}};
-                doc->utfMappings->utf8ToUtf16(range);
-                // Create the diagnostic for the missing node
-                Diagnostic diagnostic = {range, "Syntax error: MISSING " + std::string(ts_node_type(child)), "source",
-                                         DiagnosticSeverity::Error};
-                diagnostics.emplace_back(diagnostic);
+/**
+ * Collects the ERROR and MISSING nodes of the document (or of the nodes overlapping the given lines),
+ * in document order. Subtrees without an error are not entered, a clean document is checked at its root.
+ */
+std::vector<Linter::Finding> Linter::collectFindings(WooWooDocument *doc, const std::optional<LineRange> &lines) {
+    std::vector<Finding> findings;
+    if (!doc->tree) return findings;
+
+    TSNode root = ts_tree_root_node(doc->tree);
+    if (!ts_node_has_error(root)) return findings;
+
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    bool done = false;
+    while (!done) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        TSPoint start_point = ts_node_start_point(node);
+        TSPoint end_point = ts_node_end_point(node);
+
+        bool enter = ts_node_has_error(node) &&
+                     (!lines.has_value() || (end_point.row >= lines->first && start_point.row <= lines->last));
+        if (enter && ts_node_is_missing(node)) {
+            // Constructing the range for the missing node
+            Range range = {Position{start_point.row, start_point.column},
+                           Position{end_point.row, end_point.column + 1}};
+            doc->utfMappings->utf8ToUtf16(range);
+            Diagnostic diagnostic = {range, "Syntax error: MISSING " + std::string(ts_node_type(node)), "source",
+                                     DiagnosticSeverity::Error};
+            findings.push_back(Finding{start_point.row, end_point.row, diagnostic});
+        } else if (enter && ts_node_symbol(node) == errorSymbol) {
+            Range range = {Position{start_point.row, start_point.column}, Position{end_point.row, end_point.column}};
+            doc->utfMappings->utf8ToUtf16(range);
+            if (range.start.line != range.end.line) {
+                range.end = Position{range.start.line, range.start.character + 1};
             }
+            Diagnostic diagnostic = {range, "Syntax error", "source", DiagnosticSeverity::Error};
+            findings.push_back(Finding{start_point.row, end_point.row, diagnostic});
+        }
 
-            // Recursively traverse the child nodes
-            traverseTree(child);
+        if (enter && ts_tree_cursor_goto_first_child(&cursor)) continue;
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                done = true;
+                break;
+            }
         }
-    };
+    }
+    ts_tree_cursor_delete(&cursor);
+    return findings;
+}
 
-    // Start the tree traversal from the root node
-    traverseTree(ts_tree_root_node(doc->tree));
+std::vector<Diagnostic> Linter::toDiagnostics(const std::vector<Finding> &findings) {
+    std::vector<Diagnostic> diagnostics;
+    diagnostics.reserve(findings.size());
+    for (const Finding &finding: findings) {
+        diagnostics.emplace_back(finding.diagnostic);
+    }
+    return diagnostics;
 }
 
 const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> &Linter::getQueryStringByName() const {
     return queryStringsByName;
 }
 
-const std::string Linter::errorNodesQuery = "errorNodesQuery";
-
-const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Linter::queryStringsByName = {
-        {errorNodesQuery, std::make_pair(tree_sitter_woowoo(), "(ERROR) @error")}
-};
\ No newline at end of file
+// ERROR and MISSING nodes are found by a walk over the tree, no queries are needed
+const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Linter::queryStringsByName = {};
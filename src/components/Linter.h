@@ -8,6 +8,7 @@
 #include "../WooWooAnalyzer.h"
 #include "Component.h"
 #include "../lsp/LSPTypes.h"
+#include <optional>
 #include <vector>
 
 class Linter : Component {
@@ -15,14 +16,45 @@ class Linter : Component {
 public:
     explicit Linter(WooWooAnalyzer *analyzer);
     std::vector<Diagnostic> diagnose(const TextDocumentIdentifier & tdi);
+    // all diagnostics of the document without the caches, so that different documents can be checked in parallel;
+    // a document known only by its index is parsed (and unloaded again) only if the index has syntax errors
+    std::vector<Diagnostic> check(DialectedWooWooDocument * doc);
+    // drops the cached diagnostics of a document which was removed from the workspace
+    void forgetDocument(DocumentId id);
 
 private:
-    void diagnoseErrors(WooWooDocument * doc, std::vector<Diagnostic> & d);
-    void diagnoseMissingNodes(WooWooDocument * doc, std::vector<Diagnostic> & d);
+    // lines (both inclusive) to collect the diagnostics from
+    struct LineRange {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    // a diagnostic together with the lines of the node it was reported for
+    struct Finding {
+        uint32_t line;
+        uint32_t lastLine;
+        Diagnostic diagnostic;
+    };
+
+    // the findings of one version of a document, sorted by their position
+    struct CachedFindings {
+        uint64_t version = 0;
+        std::vector<Finding> findings;
+    };
+
+    // by the id of the document
+    std::unordered_map<DocumentId, CachedFindings> findingsCache;
+
+    // syntax errors, kept between the versions of the document
+    const std::vector<Finding> & syntaxFindings(DialectedWooWooDocument * doc, CachedFindings & cached);
+    // unresolved references and duplicate definitions, from the project index (they depend on other documents)
+    void diagnoseReferences(DialectedWooWooDocument * doc, std::vector<Diagnostic> & diagnostics);
+    void updateFindings(WooWooDocument * doc, CachedFindings & cached);
+    static std::vector<Finding> collectFindings(WooWooDocument * doc, const std::optional<LineRange> & lines);
+    static std::vector<Diagnostic> toDiagnostics(const std::vector<Finding> & findings);
 
     [[nodiscard]] const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>>& getQueryStringByName() const override;
 
-    static const std::string errorNodesQuery;
     static const std::unordered_map<std::string, std::pair<TSLanguage*,std::string>> queryStringsByName;
     
 };
@@ -5,94 +5,122 @@
 #include "Navigator.h"
 
 #include "../utils/utils.h"
+#include "../utils/CancellationToken.h"
+#include "../parser/QueryRegistry.h"
+#include "../parser/WooWooSymbols.h"
 #include <algorithm>  // Include for std::find_if
 
 Navigator::Navigator(WooWooAnalyzer *analyzer) : Component(analyzer) {
     prepareQueries();
+    metaFieldKeyCaptureId = QueryRegistry::captureId(queries[metaFieldQuery], "key");
+    metaFieldValueCaptureId = QueryRegistry::captureId(queries[metaFieldQuery], "value");
 }
 
 // - - REFERENCES
 
 std::vector<Location> Navigator::references(const ReferenceParams &params) {
+    std::optional<ReferenceSearch> search = startReferences(params);
+    if (!search.has_value()) return {};
+
+    std::vector<Location> locations = std::move(search->found);
+    searchProjectForReferences(locations, search.value());
+    return locations;
+}
+
+std::optional<ReferenceSearch> Navigator::startReferences(const ReferenceParams &params) {
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
     auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
     uint32_t line = pos.first;
     uint32_t character = pos.second;
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
     TSPoint start_point = {line, character};
     TSPoint end_point = {line, character + 1};
     ts_query_cursor_set_point_range(cursor, start_point, end_point);
     ts_query_cursor_exec(cursor, queries[findReferencesQuery], ts_tree_root_node(document->tree));
 
     TSQueryMatch match;
-    std::string nodeType;
-    std::string nodeText;
     if (ts_query_cursor_next_match(cursor, &match)) {
         if (match.capture_count > 0) {
             TSNode node = match.captures[0].node;
 
-            nodeType = ts_node_type(node);
-            nodeText = document->getNodeText(node);
-
-            if (nodeType == "meta_block") {
+            if (ts_node_symbol(node) == woowoo::sym_meta_block) {
                 // user executed Find All References on a meta-block
-                return findMetaBlockReferences(params);
+                return startMetaBlockReferences(params);
             }
 
         }
     }
 
-    return {};
+    return std::nullopt;
 
 }
 
-std::vector<Location> Navigator::findMetaBlockReferences(const ReferenceParams &params) {
-    std::vector<Location> locations;
-
+std::optional<ReferenceSearch> Navigator::startMetaBlockReferences(const ReferenceParams &params) {
     auto metaFieldContext = extractMetaFieldKeyValue(params.textDocument, params.position);
-    if (metaFieldContext.has_value()) {
+    if (!metaFieldContext.has_value()) return std::nullopt;
 
-        auto document = analyzer->getDocumentByUri(params.textDocument.uri);
-        auto mx = metaFieldContext->first;
-        auto keyNode = metaFieldContext->second.first;
-        auto valueNode = metaFieldContext->second.second;
+    auto document = analyzer->getDocumentByUri(params.textDocument.uri);
+    auto keyNode = metaFieldContext->second.first;
+    auto valueNode = metaFieldContext->second.second;
 
-        auto s = ts_node_start_point(valueNode);
-        auto e = ts_node_end_point(valueNode);
-        
-        auto metaKey = document->getMetaNodeText(mx, keyNode);
-
-        // check if we should include declaration, and if this metaKey is referencable (dialect-specific behaviour)
-        if (params.includeDeclaration &&
-            std::any_of(DialectManager::getInstance()->allReferences.begin(),
-                        DialectManager::getInstance()->allReferences.end(),
-                        [&metaKey](const Reference& ref) { return ref.metaKey == metaKey; })) {
-
-            Location l = {utils::pathToUri(document->documentPath), Range{{s.row + mx->lineOffset, s.column},
-                                                                          {e.row + mx->lineOffset, e.column}}};
-            document->utfMappings->utf8ToUtf16(l);
-            locations.emplace_back(l);
-        }
+    auto s = ts_node_start_point(valueNode);
+    auto e = ts_node_end_point(valueNode);
 
-        searchProjectForReferences(locations, document, Reference(metaKey),
-                                   document->getMetaNodeText(mx, valueNode));
-        return locations;
-    } else {
-        return {};
+    auto metaKey = document->getNodeText(keyNode);
+
+    // the owned strings are made once for the whole search
+    ReferenceSearch search;
+    search.reference = Reference(std::string(metaKey));
+    search.value = std::string(document->getNodeText(valueNode));
+
+    // check if we should include declaration, and if this metaKey is referencable (dialect-specific behaviour)
+    if (params.includeDeclaration &&
+        document->getDialect()->isReferencedMetaKey(metaKey)) {
+
+        Location l = {utils::pathToUri(document->documentPath), Range{{s.row, s.column}, {e.row, e.column}}};
+        document->utfMappings->utf8ToUtf16(l);
+        search.found.emplace_back(l);
+    }
+
+    // only the documents which contain such a reference are visited
+    auto project = analyzer->getProjectByDocument(document);
+    for (auto projectDocument: project->getDocumentsReferencing(search.reference, search.value)) {
+        search.documents.push_back(analyzer->getDocumentId(projectDocument));
     }
+    return search;
 }
 
-void
-Navigator::searchProjectForReferences(std::vector<Location> &locations, WooWooDocument *doc, const Reference &reference,
-                                      const std::string &referenceValue) {
+void Navigator::searchProjectForReferences(std::vector<Location> &locations, ReferenceSearch &search) {
+    std::vector<DialectedWooWooDocument *> documents;
+    documents.reserve(search.documents.size() - search.nextDocument);
+    for (; search.nextDocument < search.documents.size(); ++search.nextDocument) {
+        auto document = analyzer->findDocumentById(search.documents[search.nextDocument]);
+        if (document) documents.push_back(document);
+    }
+    // a large project is searched on the thread pool
+    auto found = analyzer->collectInParallel<Location>(
+            documents, [&search](DialectedWooWooDocument *projectDocument, std::vector<Location> &results) {
+                for (auto &refLocation: projectDocument->findLocationsOfReferences(search.reference, search.value)) {
+                    results.emplace_back(std::move(refLocation));
+                }
+            });
+    locations.insert(locations.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+}
 
-    for (auto projectDocument: analyzer->getProjectByDocument(doc)->getAllDocuments()) {
-        for (auto refLocation: projectDocument->findLocationsOfReferences(reference, referenceValue)) {
-            projectDocument->utfMappings->utf8ToUtf16(refLocation);
-            locations.emplace_back(refLocation);
+std::vector<Location> Navigator::nextReferences(ReferenceSearch &search, size_t limit) {
+    std::vector<Location> locations = std::move(search.found);
+    search.found.clear();
+    // whole documents are taken until the limit is reached
+    while (locations.size() < limit && search.nextDocument < search.documents.size()) {
+        CancellationToken::current().throwIfCancelled();
+        auto document = analyzer->findDocumentById(search.documents[search.nextDocument++]);
+        if (!document) continue;
+        for (auto &refLocation: document->findLocationsOfReferences(search.reference, search.value)) {
+            locations.emplace_back(std::move(refLocation));
         }
     }
+    return locations;
 }
 
 // - - RENAME
@@ -101,56 +129,112 @@ WorkspaceEdit Navigator::rename(const RenameParams &params) {
 
     // First, get all references of the symbol.
     ReferenceParams rp = ReferenceParams(params.textDocument, params.position, true);
-    auto referencesLocations = references(rp);
+    return renameEdits(references(rp), params.newName);
+}
 
+WorkspaceEdit Navigator::renameEdits(const std::vector<Location> &locations, const std::string &newName) {
     WorkspaceEdit we;
-    for (const auto &refLoc: referencesLocations) {
-        TextEdit te = TextEdit(refLoc.range, params.newName);
+    for (const auto &refLoc: locations) {
+        TextEdit te = TextEdit(refLoc.range, newName);
         we.add_change(refLoc.uri, te);
     }
 
     return we;
 }
 
+// - - DOCUMENT SYMBOLS
+
+std::vector<DocumentSymbol> Navigator::documentSymbols(const TextDocumentIdentifier &tdi) {
+    auto document = analyzer->getDocumentByUri(tdi.uri);
+    const std::vector<OutlineNode> &outline = document->getOutline();
+
+    // children of every structure, in document order (parents come before their children)
+    std::vector<std::vector<uint32_t>> children(outline.size());
+    std::vector<uint32_t> roots;
+    for (uint32_t i = 0; i < outline.size(); ++i) {
+        if (outline[i].kind == OutlineNode::Kind::Block) continue;
+        (outline[i].parent == OutlineNode::NO_PARENT ? roots : children[outline[i].parent]).push_back(i);
+    }
+
+    std::function<DocumentSymbol(uint32_t)> toSymbol = [&](uint32_t i) {
+        const OutlineNode &node = outline[i];
+        SymbolKind kind = node.kind == OutlineNode::Kind::DocumentPart ? SymbolKind::Module
+                          : node.kind == OutlineNode::Kind::Wobject ? SymbolKind::Object : SymbolKind::Struct;
+        std::string name = node.type.empty() ? "(unnamed)" : node.type;
+        if (!node.title.empty()) {
+            name += " " + node.title;
+        }
+        DocumentSymbol symbol(std::move(name), node.label, kind, node.range, node.selectionRange);
+        symbol.children.reserve(children[i].size());
+        for (uint32_t child: children[i]) {
+            symbol.children.emplace_back(toSymbol(child));
+        }
+        return symbol;
+    };
+
+    std::vector<DocumentSymbol> symbols;
+    symbols.reserve(roots.size());
+    for (uint32_t root: roots) {
+        symbols.emplace_back(toSymbol(root));
+    }
+    return symbols;
+}
+
 // - - GO TO DEFINITION
 Location Navigator::goToDefinition(const DefinitionParams &params) {
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
     auto pos = document->utfMappings->utf16ToUtf8(params.position.line, params.position.character);
-    uint32_t line = pos.first;
-    uint32_t character = pos.second;
+    TSPoint point = {pos.first, pos.second};
+
+    DocumentId id = analyzer->getDocumentId(document);
+    WooWooProject *project = analyzer->getProjectByDocument(document);
+    // the definition can be in any document of the project
+    uint64_t indexVersion = project ? project->getIndexVersion() : 0;
+    if (const Location *cached = definitionCache.find(id, document->version, indexVersion, point)) {
+        return *cached;
+    }
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    TSPoint start_point = {line, character};
-    TSPoint end_point = {line, character + 1};
+    TSPoint nodeStart = point;
+    TSPoint nodeEnd = {point.row, point.column + 1};
+    Location definition = definitionAt(params, document, point, nodeStart, nodeEnd);
+    definitionCache.insert(id, document->version, indexVersion, nodeStart, nodeEnd, definition);
+    return definition;
+}
+
+Location Navigator::definitionAt(const DefinitionParams &params, WooWooDocument *document, TSPoint point,
+                                 TSPoint &nodeStart, TSPoint &nodeEnd) {
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
+    TSPoint start_point = point;
+    TSPoint end_point = {point.row, point.column + 1};
     ts_query_cursor_set_point_range(cursor, start_point, end_point);
     ts_query_cursor_exec(cursor, queries[goToDefinitionQuery], ts_tree_root_node(document->tree));
 
     TSQueryMatch match;
-    std::string nodeType;
-    std::string nodeText;
     if (ts_query_cursor_next_match(cursor, &match)) {
         if (match.capture_count > 0) {
             TSNode node = match.captures[0].node;
+            TSSymbol symbol = ts_node_symbol(node);
 
-            nodeType = ts_node_type(node);
-            nodeText = document->getNodeText(node);
-
-            if (nodeType == "filename") {
-                return navigateToFile(params, nodeText);
-            }
-            if (nodeType == "short_inner_environment") {
-                return resolveShortInnerEnvironmentReference(params, node);
-            }
-            if (nodeType == "verbose_inner_environment_hash_end") {
-                return resolveShorthandReference("#", params, node);
-            }
-            if (nodeType == "verbose_inner_environment_at_end") {
-                return resolveShorthandReference("@", params, node);
-            }
-            if (nodeType == "meta_block") {
+            if (symbol == woowoo::sym_meta_block) {
+                // the definition depends on the field at the position, not on the whole block
                 return resolveMetaBlockReference(params);
             }
 
+            // the referencing nodes do not nest, the whole node refers to the same definition
+            nodeStart = ts_node_start_point(node);
+            nodeEnd = ts_node_end_point(node);
+            switch (symbol) {
+                case woowoo::sym_filename:
+                    return navigateToFile(params, std::string(document->getNodeText(node)));
+                case woowoo::sym_short_inner_environment:
+                    return resolveShortInnerEnvironmentReference(params, node);
+                case woowoo::sym_verbose_inner_environment_hash_end:
+                    return resolveShorthandReference("#", params, node);
+                case woowoo::sym_verbose_inner_environment_at_end:
+                    return resolveShorthandReference("@", params, node);
+                default:
+                    break;
+            }
         }
     }
     return Location("", Range{Position{0, 0}, Position{0, 0}});
@@ -167,16 +251,28 @@ Location Navigator::navigateToFile(const DefinitionParams &params, const std::st
 
 Location Navigator::resolveShortInnerEnvironmentReference(const DefinitionParams &params, TSNode node) {
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
-    auto shortInnerEnvironmentType = utils::getChildText(node, "short_inner_environment_type", document);
+    auto shortInnerEnvironmentType = utils::getChildText(node, woowoo::sym_short_inner_environment_type, document);
+    if (BibliographyIndex::isCitation(shortInnerEnvironmentType)) {
+        return resolveCitation(document, utils::getChildText(node, woowoo::sym_short_inner_environment_body, document));
+    }
 
     // obtain what can be referenced by this environment
-    std::vector<Reference> referenceTargets = DialectManager::getInstance()->getPossibleReferencesByTypeName(
+    std::span<const Reference> referenceTargets = document->getDialect()->getPossibleReferencesByTypeName(
             shortInnerEnvironmentType);
 
     // obtain the body part of the referencing environment 
-    auto value = utils::getChildText(node, "short_inner_environment_body", document);
+    auto value = utils::getChildText(node, woowoo::sym_short_inner_environment_body, document);
+
+    return findReference(params, referenceTargets, std::string(value));
+}
 
-    return findReference(params, referenceTargets, value);
+Location Navigator::resolveCitation(WooWooDocument *document, std::string_view key) {
+    WooWooProject *project = analyzer->getProjectByDocument(document);
+    const BibliographyIndex::Entry *entry = project ? project->bibliography.find(key) : nullptr;
+    if (!entry) {
+        return Location("", Range{Position{0, 0}, Position{0, 0}});
+    }
+    return {utils::pathToUri(BibliographyIndex::filePath(*entry)), BibliographyIndex::keyRange(*entry)};
 }
 
 Location
@@ -184,9 +280,10 @@ Navigator::resolveShorthandReference(const std::string &shorthandType, const Def
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
 
     // obtain what can be referenced by this environment
-    std::vector<Reference> referenceTargets = DialectManager::getInstance()->getPossibleReferencesByTypeName(shorthandType);
+    std::span<const Reference> referenceTargets =
+            document->getDialect()->getPossibleReferencesByTypeName(shorthandType);
 
-    return findReference(params, referenceTargets, document->getNodeText(node));
+    return findReference(params, referenceTargets, std::string(document->getNodeText(node)));
 }
 
 
@@ -196,11 +293,15 @@ Navigator::extractMetaFieldKeyValue(const TextDocumentIdentifier &tdi, const Pos
     auto pos = document->utfMappings->utf16ToUtf8(p.line, p.character);
     uint32_t line = pos.first;
     uint32_t character = pos.second;
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    MetaContext *mx = document->getMetaContextByLine(line);
-    // points adjusted by metablock position
-    TSPoint start_point = {line - mx->lineOffset, character};
-    TSPoint end_point = {line - mx->lineOffset, character + 1};
+    MetaContext *mx = document->getMetaContextAt(line, character);
+    if (!mx || !mx->isParsed()) {
+        // the position is not inside of a meta block
+        return std::nullopt;
+    }
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
+    // the tree of the block has the positions of the document
+    TSPoint start_point = {line, character};
+    TSPoint end_point = {line, character + 1};
     ts_query_cursor_set_point_range(cursor, start_point, end_point);
     ts_query_cursor_exec(cursor, queries[metaFieldQuery], ts_tree_root_node(mx->tree));
 
@@ -214,38 +315,31 @@ Navigator::extractMetaFieldKeyValue(const TextDocumentIdentifier &tdi, const Pos
             TSNode capturedNode = match.captures[i].node;
             uint32_t capture_id = match.captures[i].index;
 
-            uint32_t capture_name_length;
-            const char *capture_name_chars = ts_query_capture_name_for_id(queries[metaFieldQuery], capture_id,
-                                                                          &capture_name_length);
-            std::string capture_name(capture_name_chars, capture_name_length);
-            if (capture_name == "key") {
+            if (capture_id == metaFieldKeyCaptureId) {
                 foundValue = true;
                 metaFieldName = capturedNode;
-            } else if (capture_name == "value") {
+            } else if (capture_id == metaFieldValueCaptureId) {
                 foundKey = true;
                 metaFieldValue = capturedNode;
             }
         }
         if (foundKey && foundValue) {
-            ts_query_cursor_delete(cursor);
             return std::make_pair(mx, std::make_pair(metaFieldName, metaFieldValue));
         }
     }
 
-    ts_query_cursor_delete(cursor);
     return std::nullopt;
 }
 
 Location Navigator::resolveMetaBlockReference(const DefinitionParams &params) {
     auto metaFieldContext = extractMetaFieldKeyValue(params.textDocument, params.position);
     if (metaFieldContext.has_value()) {
-        auto mx = metaFieldContext->first;
         auto keyNode = metaFieldContext->second.first;
         auto valueNode = metaFieldContext->second.second;
         auto document = analyzer->getDocumentByUri(params.textDocument.uri);
-        return findReference(params, DialectManager::getInstance()->getPossibleReferencesByTypeName(
-                                     document->getMetaNodeText(mx, keyNode)),
-                             document->getMetaNodeText(mx, valueNode));
+        return findReference(params, document->getDialect()->getPossibleReferencesByTypeName(
+                                     document->getNodeText(keyNode)),
+                             std::string(document->getNodeText(valueNode)));
     } else {
         return Location("", Range{Position{0, 0}, Position{0, 0}});
 
@@ -253,24 +347,24 @@ Location Navigator::resolveMetaBlockReference(const DefinitionParams &params) {
 }
 
 
-Location Navigator::findReference(const DefinitionParams &params, const std::vector<Reference> &possibleReferences,
+Location Navigator::findReference(const DefinitionParams &params, std::span<const Reference> possibleReferences,
                                   const std::string &referencingValue) {
     auto document = analyzer->getDocumentByUri(params.textDocument.uri);
 
-    for (auto doc: analyzer->getProjectByDocument(document)->getAllDocuments()) {
-        std::optional<std::pair<MetaContext *, TSNode>> foundRef = doc->findReferencable(possibleReferences,
-                                                                                         referencingValue);
-
-        if (foundRef.has_value()) {
-            MetaContext *mx = foundRef.value().first;
-            TSPoint start_point = ts_node_start_point(foundRef.value().second);
-            TSPoint end_point = ts_node_end_point(foundRef.value().second);
-            auto s = document->utfMappings->utf8ToUtf16(start_point.row + mx->lineOffset, start_point.column);
-            auto e = document->utfMappings->utf8ToUtf16(end_point.row + mx->lineOffset, end_point.column);
-
-            auto fieldRange = Range{Position{s.first, s.second}, Position{e.first, e.second}};
-            return {utils::pathToUri(doc->documentPath), fieldRange};
-        }
+    auto project = analyzer->getProjectByDocument(document);
+    auto defining = project->getDocumentsDefining(possibleReferences, referencingValue);
+    std::vector<DialectedWooWooDocument *> documents(defining.begin(), defining.end());
+    // the definitions are in the order of the documents, the first one wins as if they were searched one by one
+    auto definitions = analyzer->collectInParallel<Location>(
+            documents, [possibleReferences, &referencingValue](DialectedWooWooDocument *doc,
+                                                               std::vector<Location> &results) {
+                std::optional<Range> definition = doc->findDefinition(possibleReferences, referencingValue);
+                if (definition.has_value()) {
+                    results.emplace_back(utils::pathToUri(doc->documentPath), definition.value());
+                }
+            });
+    if (!definitions.empty()) {
+        return definitions.front();
     }
     return Location("", Range{Position{0, 0}, Position{0, 0}});
 }
@@ -278,61 +372,85 @@ Location Navigator::findReference(const DefinitionParams &params, const std::vec
 
 // - - - - - - -
 
+/**
+ * Updates the include statements referring to the renamed documents, and the relative ones
+ * within the renamed documents themselves. Only the documents including a renamed one (by the include graph)
+ * are visited, their includes are taken from their indexes, none of them has to be parsed.
+ */
 WorkspaceEdit Navigator::refactorDocumentReferences(const std::vector<std::pair<std::string, std::string>> & renamedDocuments) {
     WorkspaceEdit we;
+    // old path -> new path, as the include graph knows them (resolved before the rename)
+    std::unordered_map<std::string, fs::path> newPaths;
+    std::set<DialectedWooWooDocument *> affected;
     for (const auto &documentRename: renamedDocuments) {
-        // document that was renamed (internally, in analyzer, the path should be already updated)
-        WooWooDocument *renamedDoc = analyzer->getDocument(documentRename.second);
-        std::string oldFileName = documentRename.first;
-        fs::path oldFilePath(oldFileName);
-        fs::path oldFileDir = oldFilePath.parent_path();
-        
-        // iterate over every document from the same project and look for references (from include statements)
-        for (auto projectDocument: analyzer->getProjectByDocument(renamedDoc)->getAllDocuments()) {
-            TSQueryCursor *cursor = ts_query_cursor_new();
-            ts_query_cursor_exec(cursor, queries[filenameQuery], ts_tree_root_node(projectDocument->tree));
-            TSQueryMatch match;
-            std::string nodeType;
-            std::string nodeText;
-            
-            while (ts_query_cursor_next_match(cursor, &match)) {
-                if (match.capture_count > 0) {
-                    TSNode node = match.captures[0].node;
-                    nodeText = projectDocument->getNodeText(node);
-
-                    fs::path includedFilePath(nodeText);
-                    if (!includedFilePath.is_absolute()) {
-                        includedFilePath = projectDocument->documentPath.parent_path() / includedFilePath;
-                    }
-
-                    try {
-                        if(fs::canonical(oldFilePath) == fs::canonical(includedFilePath)){
-                            // found include referring to the old filename
-                            // we want to replace it with the new filename
-                            
-                            fs::path relativePath = fs::relative(renamedDoc->documentPath, projectDocument->documentPath.parent_path());
-
-                            auto s = ts_node_start_point(node);
-                            auto e = ts_node_end_point(node);
-
-                            Location l = {utils::pathToUri(projectDocument->documentPath), Range{{s.row, s.column},
-                                                                                              {e.row, e.column}}};
-                            projectDocument->utfMappings->utf8ToUtf16(l);
-                            
-                            TextEdit te = TextEdit(l.range, relativePath.generic_string());
-                            we.add_change(l.uri, te);
-                        }
-
-                    } catch (...) {
-                        // if something fails, simply do not refactor it
-                    }
-                }
+        std::string oldPath = fs::path(documentRename.first).lexically_normal().generic_string();
+        newPaths[oldPath] = fs::path(documentRename.second).lexically_normal();
+        auto including = analyzer->getDocumentsIncluding(oldPath);
+        affected.insert(including.begin(), including.end());
+    }
+    std::set<std::string> renamedPaths;
+    for (const auto &newPath: newPaths) {
+        renamedPaths.insert(newPath.second.generic_string());
+    }
+
+    // (uri, edit) pairs of a document, the documents are independent and visited on the thread pool
+    using IncludeEdit = std::pair<std::string, TextEdit>;
+    auto refactorIncludes = [&newPaths](DialectedWooWooDocument *document, bool documentRenamed,
+                                        std::vector<IncludeEdit> &edits) {
+        fs::path documentFolder = document->documentPath.parent_path();
+        std::string uri = utils::pathToUri(document->documentPath);
+        for (const DocumentIndex::Include &include: document->getIndex().includes) {
+            bool absolute = fs::path(include.text).is_absolute();
+            auto renamed = newPaths.find(include.target);
+
+            std::string newText;
+            if (renamed != newPaths.end()) {
+                newText = absolute ? renamed->second.generic_string()
+                                   : renamed->second.lexically_relative(documentFolder).generic_string();
+            } else if (documentRenamed && !absolute) {
+                // the included file stayed where it was, the document including it did not
+                newText = fs::path(include.target).lexically_relative(documentFolder).generic_string();
+            } else {
+                continue;
             }
+            if (newText.empty() || newText == include.text) continue;
+            edits.emplace_back(uri, TextEdit(include.range, newText));
         }
+    };
+
+    std::vector<std::pair<DialectedWooWooDocument *, bool>> documents;
+    documents.reserve(affected.size());
+    for (DialectedWooWooDocument *document: affected) {
+        bool documentRenamed = renamedPaths.count(document->documentPath.lexically_normal().generic_string()) != 0;
+        documents.emplace_back(document, documentRenamed);
+    }
+    // renamed documents including nothing renamed, their relative includes could have broken
+    for (const std::string &renamedPath: renamedPaths) {
+        auto document = analyzer->getDocument(renamedPath);
+        if (document && affected.count(document) == 0) {
+            documents.emplace_back(document, true);
+        }
+    }
+
+    auto edits = analyzer->collectInParallel<IncludeEdit>(
+            documents, [&refactorIncludes](const std::pair<DialectedWooWooDocument *, bool> &document,
+                                           std::vector<IncludeEdit> &results) {
+                refactorIncludes(document.first, document.second, results);
+            });
+    for (auto &[uri, edit]: edits) {
+        we.add_change(uri, edit);
     }
     return we;
 }
 
+void Navigator::forgetDocument(DocumentId id) {
+    definitionCache.forgetDocument(id);
+}
+
+void Navigator::clearCache() {
+    definitionCache.clear();
+}
+
 // - - - - - - -
 
 const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> &Navigator::getQueryStringByName() const {
@@ -342,7 +460,6 @@ const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> &Nav
 const std::string Navigator::metaFieldQuery = "metaFieldQuery";
 const std::string Navigator::goToDefinitionQuery = "goToDefinitionQuery";
 const std::string Navigator::findReferencesQuery = "findReferencesQuery";
-const std::string Navigator::filenameQuery = "filenameQuery";
 const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Navigator::queryStringsByName = {
         {metaFieldQuery,      std::make_pair(tree_sitter_yaml(), MetaContext::metaFieldQueryString)},
         {goToDefinitionQuery, std::make_pair(tree_sitter_woowoo(),
@@ -356,8 +473,7 @@ const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> Navi
         {findReferencesQuery, std::make_pair(tree_sitter_woowoo(),
                                              R"(
 (meta_block) @type
-)")},
-        {filenameQuery,       std::make_pair(tree_sitter_woowoo(), "(filename) @filename")}
+)")}
 };
 
 
@@ -5,9 +5,12 @@
 #ifndef WUFF_NAVIGATOR_H
 #define WUFF_NAVIGATOR_H
 
+#include <span>
 #include <string>
 #include "../WooWooAnalyzer.h"
 #include "Component.h"
+#include "PositionCache.h"
+#include "ReferenceSearch.h"
 #include "../lsp/LSPTypes.h"
 
 
@@ -19,31 +22,54 @@ public:
     Location goToDefinition(const DefinitionParams &params);
 
     std::vector<Location> references(const ReferenceParams &params);
+    // the search for the references at the position (including the declaration, if asked for), nullopt if there
+    // is nothing to search for there
+    std::optional<ReferenceSearch> startReferences(const ReferenceParams &params);
+    // the locations of the next documents of the search; whole documents are taken until there are at least limit
+    // locations or the search is done
+    std::vector<Location> nextReferences(ReferenceSearch &search, size_t limit);
 
     WorkspaceEdit rename(const RenameParams &params);
+    // edits replacing every location by the new name
+    static WorkspaceEdit renameEdits(const std::vector<Location> &locations, const std::string &newName);
+
+    // structures of the document as a tree, from its cached outline
+    std::vector<DocumentSymbol> documentSymbols(const TextDocumentIdentifier &tdi);
     
     // document which was renamed (should be already updated) + its old path string
     WorkspaceEdit refactorDocumentReferences(const std::vector<std::pair<std::string, std::string>> & renamedDocuments);
 
+    // drops the cached definitions of a document which was removed from the workspace
+    void forgetDocument(DocumentId id);
+    // the references depend on the dialect, the definitions are dropped when it changes
+    void clearCache();
+
 private:
+    // the definition of the node at the point; nodeStart and nodeEnd are set to the points it is valid for
+    Location definitionAt(const DefinitionParams &params, WooWooDocument *document, TSPoint point,
+                          TSPoint &nodeStart, TSPoint &nodeEnd);
+
     Location navigateToFile(const DefinitionParams &params, const std::string &relativeFilePath);
 
     Location resolveShortInnerEnvironmentReference(const DefinitionParams &params, TSNode node);
 
+    // the entry of the bibliography of the project with the key
+    Location resolveCitation(WooWooDocument *document, std::string_view key);
+
     Location resolveShorthandReference(const std::string &shorthandType, const DefinitionParams &params, TSNode node);
 
     Location resolveMetaBlockReference(const DefinitionParams &params);
 
-    Location findReference(const DefinitionParams &params, const std::vector<Reference> &possibleReferences,
+    Location findReference(const DefinitionParams &params, std::span<const Reference> possibleReferences,
                            const std::string &referencingValue);
 
     std::optional<std::pair<MetaContext *, std::pair<TSNode, TSNode>>>
     extractMetaFieldKeyValue(const TextDocumentIdentifier &tdi, const Position &p);
 
-    std::vector<Location> findMetaBlockReferences(const ReferenceParams &params);
+    std::optional<ReferenceSearch> startMetaBlockReferences(const ReferenceParams &params);
 
-    void searchProjectForReferences(std::vector<Location> &locations, WooWooDocument *doc, const Reference &reference,
-                                    const std::string &referenceValue);
+    // the locations in all the documents left to the search, on the thread pool in a large project
+    void searchProjectForReferences(std::vector<Location> &locations, ReferenceSearch &search);
 
     [[nodiscard]] const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> &
     getQueryStringByName() const override;
@@ -51,10 +77,13 @@ private:
     static const std::string goToDefinitionQuery;
     static const std::string metaFieldQuery;
     static const std::string findReferencesQuery;
-    static const std::string filenameQuery;
     static const std::unordered_map<std::string, std::pair<TSLanguage *, std::string>> queryStringsByName;
 
+    // definitions by the range of the referencing node, valid for one version of the document and of the index
+    PositionCache<Location> definitionCache;
 
+    uint32_t metaFieldKeyCaptureId;
+    uint32_t metaFieldValueCaptureId;
 };
 
 
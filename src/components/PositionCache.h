@@ -0,0 +1,90 @@
+#ifndef WUFF_POSITIONCACHE_H
+#define WUFF_POSITIONCACHE_H
+
+#include <tree_sitter/api.h>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../project/DocumentTable.h"
+#include "../utils/Stats.h"
+
+/**
+ * Results of the last few requests made at positions (UTF-8 points) of documents, each valid for the range
+ * of the node it was computed from. Editors ask again and again for the same token while the mouse moves,
+ * those requests are answered without touching the syntax tree.
+ *
+ * The entries of a document belong to one version of it and to one version of the index of its project
+ * (results pointing to other documents depend on them), any other version drops them.
+ */
+template<typename T>
+class PositionCache {
+public:
+    // the result for the point, nullptr if there is none
+    const T *find(DocumentId id, uint64_t version, uint64_t indexVersion, TSPoint point) {
+        auto document = documents.find(id);
+        if (document == documents.end()) return nullptr;
+        DocumentEntries &cached = document->second;
+        if (cached.version != version || cached.indexVersion != indexVersion) {
+            documents.erase(document);
+            return nullptr;
+        }
+        // the most recent entries are at the back
+        for (auto entry = cached.entries.rbegin(); entry != cached.entries.rend(); ++entry) {
+            if (!before(point, entry->start) && before(point, entry->end)) {
+                Stats::count(Counter::PositionCacheHit);
+                return &entry->value;
+            }
+        }
+        return nullptr;
+    }
+
+    // remembers the result for the points in [start, end)
+    void insert(DocumentId id, uint64_t version, uint64_t indexVersion, TSPoint start, TSPoint end, T value) {
+        if (id == DocumentTable::NO_DOCUMENT) return;
+        DocumentEntries &cached = documents[id];
+        if (cached.version != version || cached.indexVersion != indexVersion) {
+            cached.entries.clear();
+            cached.version = version;
+            cached.indexVersion = indexVersion;
+        }
+        if (cached.entries.size() == maxEntriesPerDocument) {
+            cached.entries.erase(cached.entries.begin());
+        }
+        cached.entries.push_back(Entry{start, end, std::move(value)});
+    }
+
+    void forgetDocument(DocumentId id) {
+        documents.erase(id);
+    }
+
+    void clear() {
+        documents.clear();
+    }
+
+private:
+    struct Entry {
+        TSPoint start;
+        TSPoint end;
+        T value;
+    };
+
+    struct DocumentEntries {
+        uint64_t version = 0;
+        uint64_t indexVersion = 0;
+        std::vector<Entry> entries;
+    };
+
+    static bool before(TSPoint a, TSPoint b) {
+        return a.row < b.row || (a.row == b.row && a.column < b.column);
+    }
+
+    // the nodes hovered recently, older entries are dropped
+    static const size_t maxEntriesPerDocument = 8;
+
+    std::unordered_map<DocumentId, DocumentEntries> documents;
+};
+
+
+#endif //WUFF_POSITIONCACHE_H
@@ -0,0 +1,30 @@
+#ifndef WUFF_REFERENCESEARCH_H
+#define WUFF_REFERENCESEARCH_H
+
+#include <string>
+#include <vector>
+#include "../dialect/Reference.h"
+#include "../lsp/LSPTypes.h"
+#include "../project/DocumentTable.h"
+
+/**
+ * A search for the references of a value which is continued chunk by chunk (see WooWooAnalyzer::nextReferences).
+ * The documents to visit are fixed when it starts and kept by their ids: a document removed in the meantime
+ * is skipped, a changed one yields its references as they are when it is visited.
+ */
+struct ReferenceSearch {
+    Reference reference;
+    std::string value;
+    // locations found without searching the project (the declaration), returned with the first chunk
+    std::vector<Location> found;
+    // documents referencing the value, visited in this order
+    std::vector<DocumentId> documents;
+    size_t nextDocument = 0;
+
+    [[nodiscard]] bool done() const {
+        return found.empty() && nextDocument == documents.size();
+    }
+};
+
+
+#endif //WUFF_REFERENCESEARCH_H
@@ -0,0 +1,212 @@
+#include "DialectImage.h"
+#include <fstream>
+#include <sstream>
+#include "../utils/BinaryStream.h"
+
+#ifndef WUFF_VERSION
+#define WUFF_VERSION "dev"
+#endif
+
+namespace {
+
+    const char MAGIC[8] = {'W', 'U', 'F', 'F', 'D', 'L', 'C', '\0'};
+    // has to be increased with every change of the layout of the image or of the dialect classes
+    const uint32_t FORMAT_VERSION = 1;
+
+    std::string versionTag() {
+        std::stringstream tag;
+        tag << WUFF_VERSION << "/" << FORMAT_VERSION;
+        return tag.str();
+    }
+
+    void writeReferences(BinaryWriter &w, const std::vector<Reference> &references) {
+        w.u32(static_cast<uint32_t>(references.size()));
+        for (const Reference &reference: references) {
+            w.str(reference.metaKey);
+            w.str(reference.structureType);
+            w.str(reference.structureName);
+        }
+    }
+
+    void writeFields(BinaryWriter &w, const std::vector<Field> &fields) {
+        w.u32(static_cast<uint32_t>(fields.size()));
+        for (const Field &field: fields) {
+            w.str(field.name);
+            writeReferences(w, field.references);
+        }
+    }
+
+    void writeMetaBlock(BinaryWriter &w, const MetaBlock &metaBlock) {
+        writeFields(w, metaBlock.requiredFields);
+        writeFields(w, metaBlock.optionalFields);
+    }
+
+    void writeShorthand(BinaryWriter &w, const std::shared_ptr<Shorthand> &shorthand) {
+        w.u32(shorthand ? 1 : 0);
+        if (!shorthand) return;
+        w.str(shorthand->type);
+        w.str(shorthand->description);
+        writeReferences(w, shorthand->references);
+        writeMetaBlock(w, shorthand->metaBlock);
+    }
+
+    std::vector<Reference> readReferences(BinaryReader &r) {
+        std::vector<Reference> references;
+        for (uint32_t i = r.count(3 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+            Reference reference;
+            reference.metaKey = r.str();
+            reference.structureType = r.str();
+            reference.structureName = r.str();
+            references.emplace_back(std::move(reference));
+        }
+        return references;
+    }
+
+    std::vector<Field> readFields(BinaryReader &r) {
+        std::vector<Field> fields;
+        for (uint32_t i = r.count(2 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+            Field field;
+            field.name = r.str();
+            field.references = readReferences(r);
+            fields.emplace_back(std::move(field));
+        }
+        return fields;
+    }
+
+    MetaBlock readMetaBlock(BinaryReader &r) {
+        MetaBlock metaBlock;
+        metaBlock.requiredFields = readFields(r);
+        metaBlock.optionalFields = readFields(r);
+        return metaBlock;
+    }
+
+    std::shared_ptr<Shorthand> readShorthand(BinaryReader &r) {
+        if (r.u32() == 0) return nullptr;
+        auto shorthand = std::make_shared<Shorthand>();
+        shorthand->type = r.str();
+        shorthand->description = r.str();
+        shorthand->references = readReferences(r);
+        shorthand->metaBlock = readMetaBlock(r);
+        return shorthand;
+    }
+}
+
+
+fs::path DialectImage::imagePathFor(const fs::path &dialectPath) {
+    fs::path imagePath = dialectPath;
+    imagePath += ".bin";
+    return imagePath;
+}
+
+bool DialectImage::isImage(const std::string &data) {
+    return data.size() >= sizeof(MAGIC) && data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool DialectImage::write(const Dialect &dialect, uint64_t sourceHash, const fs::path &imagePath) {
+    fs::path temporaryPath = imagePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        BinaryWriter w(out);
+        w.bytes(MAGIC, sizeof(MAGIC));
+        w.str(versionTag());
+        w.u64(sourceHash);
+
+        w.str(dialect.name);
+        w.str(dialect.version_code);
+        w.str(dialect.version_name);
+        w.str(dialect.description);
+        w.str(dialect.implicit_outer_environment);
+
+        w.u32(static_cast<uint32_t>(dialect.document_parts.size()));
+        for (const auto &documentPart: dialect.document_parts) {
+            w.str(documentPart->name);
+            w.str(documentPart->description);
+            writeMetaBlock(w, documentPart->metaBlock);
+        }
+
+        w.u32(static_cast<uint32_t>(dialect.wobjects.size()));
+        for (const auto &wobject: dialect.wobjects) {
+            w.str(wobject->name);
+            w.str(wobject->description);
+            writeMetaBlock(w, wobject->metaBlock);
+        }
+
+        w.u32(static_cast<uint32_t>(dialect.environments.size()));
+        for (const auto &environment: dialect.environments) {
+            w.str(environment->name);
+            w.str(environment->description);
+            w.u32(environment->fragile ? 1 : 0);
+            writeReferences(w, environment->references);
+            writeMetaBlock(w, environment->metaBlock);
+        }
+
+        writeShorthand(w, dialect.shorthand_hash);
+        writeShorthand(w, dialect.shorthand_at);
+        if (!out) return false;
+    }
+
+    std::error_code ec;
+    fs::rename(temporaryPath, imagePath, ec);
+    if (ec) {
+        fs::remove(temporaryPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Dialect> DialectImage::read(const std::string &data, std::optional<uint64_t> expectedSourceHash,
+                                            uint64_t &sourceHash) {
+    BinaryReader r(data);
+    if (!r.expect(MAGIC, sizeof(MAGIC)) || r.str() != versionTag()) {
+        return nullptr;
+    }
+    uint64_t imageSourceHash = r.u64();
+    if (!r.ok || (expectedSourceHash.has_value() && expectedSourceHash.value() != imageSourceHash)) {
+        return nullptr;
+    }
+
+    auto dialect = std::make_unique<Dialect>();
+    dialect->name = r.str();
+    dialect->version_code = r.str();
+    dialect->version_name = r.str();
+    dialect->description = r.str();
+    dialect->implicit_outer_environment = r.str();
+
+    for (uint32_t i = r.count(4 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+        auto documentPart = std::make_shared<DocumentPart>();
+        documentPart->name = r.str();
+        documentPart->description = r.str();
+        documentPart->metaBlock = readMetaBlock(r);
+        dialect->document_parts.emplace_back(std::move(documentPart));
+    }
+
+    for (uint32_t i = r.count(4 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+        auto wobject = std::make_shared<Wobject>();
+        wobject->name = r.str();
+        wobject->description = r.str();
+        wobject->metaBlock = readMetaBlock(r);
+        dialect->wobjects.emplace_back(std::move(wobject));
+    }
+
+    for (uint32_t i = r.count(6 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+        auto environment = std::make_shared<Environment>();
+        environment->name = r.str();
+        environment->description = r.str();
+        environment->fragile = r.u32() != 0;
+        environment->references = readReferences(r);
+        environment->metaBlock = readMetaBlock(r);
+        dialect->environments.emplace_back(std::move(environment));
+    }
+
+    dialect->shorthand_hash = readShorthand(r);
+    dialect->shorthand_at = readShorthand(r);
+
+    if (!r.ok || !r.atEnd()) {
+        return nullptr;
+    }
+    sourceHash = imageSourceHash;
+    return dialect;
+}
@@ -0,0 +1,37 @@
+#ifndef WUFF_DIALECTIMAGE_H
+#define WUFF_DIALECTIMAGE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include "Dialect.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * A dialect compiled to a binary file, which is loaded without parsing any YAML.
+ * The image records the hash of the YAML it was compiled from, it is valid only for the same YAML,
+ * the same layout of the image and the same version of wuff.
+ */
+class DialectImage {
+public:
+    // where the image of the dialect file is looked for when the dialect is loaded
+    static fs::path imagePathFor(const fs::path &dialectPath);
+    // true if the content of a file looks like an image
+    static bool isImage(const std::string &data);
+
+    // writes the image atomically, returns false if it could not be written
+    static bool write(const Dialect &dialect, uint64_t sourceHash, const fs::path &imagePath);
+    /**
+     * The dialect of the image, nullptr if the image is corrupted, was written by another version of wuff
+     * or (if expectedSourceHash is given) if it was compiled from another YAML.
+     * The hash of the YAML the image was compiled from is stored to sourceHash.
+     */
+    static std::unique_ptr<Dialect> read(const std::string &data, std::optional<uint64_t> expectedSourceHash,
+                                         uint64_t &sourceHash);
+};
+
+
+#endif //WUFF_DIALECTIMAGE_H
@@ -3,11 +3,17 @@
 //
 
 #include "DialectManager.h"
+#include <algorithm>
 #include "yaml-cpp/yaml.h"
+#include "../utils/utils.h"
+#include "DialectImage.h"
+#include "../utils/MemoryUsage.h"
 
 
 std::unique_ptr<DialectManager> DialectManager::instance;
 std::once_flag DialectManager::initInstanceFlag;
+std::mutex DialectManager::sharedMutex;
+std::unordered_map<uint64_t, std::weak_ptr<const DialectManager>> DialectManager::shared;
 
 DialectManager* DialectManager::getInstance() {
     std::call_once(initInstanceFlag, []() {
@@ -17,13 +23,99 @@ DialectManager* DialectManager::getInstance() {
 }
 
 
+namespace {
+    std::string readDialectFile(const std::string &path) {
+        auto dialectSource = utils::readFile(path);
+        if (!dialectSource.has_value()) {
+            throw YAML::BadFile(path);
+        }
+        return std::move(dialectSource.value());
+    }
+
+    std::unique_ptr<Dialect> parseDialect(const std::string &dialectSource) {
+        YAML::Node yamlData = YAML::Load(dialectSource);
+        auto dialect = std::make_unique<Dialect>();
+        dialect->deserialize(yamlData);
+        return dialect;
+    }
+
+    size_t referencesBytes(const std::vector<Reference> &references) {
+        size_t bytes = references.capacity() * sizeof(Reference);
+        for (const Reference &reference: references) {
+            bytes += memory::heapBytes(reference.metaKey) + memory::heapBytes(reference.structureType) +
+                     memory::heapBytes(reference.structureName);
+        }
+        return bytes;
+    }
+
+    size_t fieldsBytes(const std::vector<Field> &fields) {
+        size_t bytes = fields.capacity() * sizeof(Field);
+        for (const Field &field: fields) {
+            bytes += memory::heapBytes(field.name) + referencesBytes(field.references);
+        }
+        return bytes;
+    }
+}
+
+/**
+ * Loads the dialect from its YAML, or from the image compiled from the same YAML if there is one
+ * (see compileDialect). The path can also point to an image directly.
+ */
 void DialectManager::loadDialect(const std::string &dialectFilePath) {
-    YAML::Node yamlData = YAML::LoadFile(dialectFilePath);
-    activeDialect = std::make_unique<Dialect>();
-    activeDialect->deserialize(yamlData);
+    std::string dialectSource = readDialectFile(dialectFilePath);
+    std::unique_ptr<Dialect> dialect;
+    uint64_t sourceHash = 0;
+
+    if (DialectImage::isImage(dialectSource)) {
+        // there is no YAML to fall back to
+        dialect = DialectImage::read(dialectSource, std::nullopt, sourceHash);
+        if (!dialect) {
+            throw std::runtime_error("Dialect image is corrupted or was compiled by another version of wuff: " +
+                                     dialectFilePath);
+        }
+    } else {
+        sourceHash = utils::hashContent(dialectSource);
+        std::error_code ec;
+        fs::path imagePath = DialectImage::imagePathFor(dialectFilePath);
+        if (fs::exists(imagePath, ec)) {
+            // a stale image is ignored
+            dialect = DialectImage::read(readDialectFile(imagePath.string()), sourceHash, sourceHash);
+        }
+        if (!dialect) {
+            dialect = parseDialect(dialectSource);
+        }
+    }
+
+    dialectHash = sourceHash;
+    dialectFileSize = dialectSource.size();
+    activeDialect = std::move(dialect);
     processDialect();
 }
 
+std::shared_ptr<const DialectManager> DialectManager::loadShared(const std::string &dialectFilePath) {
+    uint64_t contentHash = utils::hashContent(readDialectFile(dialectFilePath));
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    if (auto loaded = shared[contentHash].lock()) {
+        return loaded;
+    }
+    std::shared_ptr<DialectManager> dialect(new DialectManager());
+    dialect->loadDialect(dialectFilePath);
+    shared[contentHash] = dialect;
+    // forget the dialects nobody uses anymore
+    std::erase_if(shared, [](const auto &entry) { return entry.second.expired(); });
+    return dialect;
+}
+
+std::string DialectManager::compileDialect(const std::string &dialectFilePath, const std::string &imagePath) {
+    std::string dialectSource = readDialectFile(dialectFilePath);
+    auto dialect = parseDialect(dialectSource);
+    fs::path target = imagePath.empty() ? DialectImage::imagePathFor(dialectFilePath) : fs::path(imagePath);
+    if (!DialectImage::write(*dialect, utils::hashContent(dialectSource), target)) {
+        throw std::runtime_error("Could not write the dialect image: " + target.string());
+    }
+    return target.string();
+}
+
 void DialectManager::processDialect() {
     collectReferencesAndMetas();
     buildMaps();
@@ -31,11 +123,21 @@ void DialectManager::processDialect() {
 
 void DialectManager::buildMaps() {
     // process all possible queries in advance, for fast live lookups
+    referencingTypes.clear();
+    referencedMetaKeys.clear();
+    typeNamesByReference.clear();
+    collectReferencingTypeNames();
+    SymbolTable *symbols = SymbolTable::getInstance();
+
+    environmentDescriptions = describeByName(activeDialect->environments);
+    documentPartDescriptions = describeByName(activeDialect->document_parts);
+    wobjectDescriptions = describeByName(activeDialect->wobjects);
 
     // References by type name - start
     // note: if there are two different types with the same name, their references will get merged
-    for (std::string &referencingTypeName: getReferencingTypeNames()) {
-        auto &rbtn = referencesByTypeName[referencingTypeName]; // create the key
+    for (const std::string &referencingTypeName: referencingTypeNames) {
+        ReferencingType type{symbols->intern(referencingTypeName), {}, {}};
+        auto &rbtn = type.references;
         for (const std::shared_ptr<Environment> &ie: activeDialect->environments) {
             if (ie->name == referencingTypeName) {
                 rbtn.insert(rbtn.end(),
@@ -71,39 +173,78 @@ void DialectManager::buildMaps() {
         }
         // References by type name - end
 
+        // the other direction, used to index definitions with a single pass over the meta blocks
+        for (const Reference &reference: rbtn) {
+            ReferenceKey key{symbols->intern(reference.metaKey), symbols->intern(reference.structureType),
+                             symbols->intern(reference.structureName)};
+            if (std::find(type.metaKeys.begin(), type.metaKeys.end(), key.metaKey) == type.metaKeys.end()) {
+                type.metaKeys.push_back(key.metaKey);
+            }
+            auto &typeNames = typeNamesByReference[key];
+            if (std::find(typeNames.begin(), typeNames.end(), type.id) == typeNames.end()) {
+                typeNames.push_back(type.id);
+            }
+        }
+        referencingTypes.emplace_back(std::move(type));
     }
+    std::sort(referencingTypes.begin(), referencingTypes.end(),
+              [](const ReferencingType &a, const ReferencingType &b) { return a.id < b.id; });
 
+    for (const Reference &reference: allReferences) {
+        referencedMetaKeys.push_back(symbols->intern(reference.metaKey));
+    }
+    std::sort(referencedMetaKeys.begin(), referencedMetaKeys.end());
+    referencedMetaKeys.erase(std::unique(referencedMetaKeys.begin(), referencedMetaKeys.end()), referencedMetaKeys.end());
 }
 
-std::string DialectManager::getDescription(const std::string &type, const std::string &name) {
-    std::string description;
+template<typename T>
+std::vector<DialectManager::DescribedName>
+DialectManager::describeByName(const std::vector<std::shared_ptr<T> > &describables) {
+    static_assert(std::is_base_of<IDescribable, T>::value, "T must derive from IDescribable");
 
-    if (type == "outer_environment_type" || type == "short_inner_environment_type" ||
-        type == "verbose_inner_environment_type") {
-        description = scanForDescriptionByName(activeDialect->environments, name);
-    } else if (type == "document_part_type") {
-        description = scanForDescriptionByName(activeDialect->document_parts, name);
-    } else if (type == "wobject_type") {
-        description = scanForDescriptionByName(activeDialect->wobjects, name);
+    std::vector<DescribedName> table;
+    table.reserve(describables.size());
+    for (const auto &describable: describables) {
+        table.push_back(DescribedName{describable->getName(), describable->getDescription()});
     }
+    // the first one of the same name is the one described, as when the dialect was scanned in order
+    std::stable_sort(table.begin(), table.end(),
+                     [](const DescribedName &a, const DescribedName &b) { return a.name < b.name; });
+    table.erase(std::unique(table.begin(), table.end(),
+                            [](const DescribedName &a, const DescribedName &b) { return a.name == b.name; }),
+                table.end());
+    return table;
+}
 
-    return description; // Return the description if found, or an empty string if not
+template<typename Entry>
+const Entry *DialectManager::findByName(const std::vector<Entry> &table, std::string_view name) {
+    auto entry = std::lower_bound(table.begin(), table.end(), name,
+                                  [](const Entry &e, std::string_view n) { return std::string_view(e.name) < n; });
+    if (entry == table.end() || entry->name != name) return nullptr;
+    return &*entry;
 }
 
-template<typename T>
-std::string DialectManager::scanForDescriptionByName(const std::vector<std::shared_ptr<T> > &describables,
-                                                     const std::string &name) {
-    static_assert(std::is_base_of<IDescribable, T>::value, "T must derive from IDescribable");
+const std::string &DialectManager::getDescription(std::string_view type, std::string_view name) const {
+    static const std::string noDescription;
 
-    for (const auto &describable: describables) {
-        if (describable->getName() == name) {
-            return describable->getDescription();
-        }
+    const std::vector<DescribedName> *table = nullptr;
+    if (type == "outer_environment_type" || type == "short_inner_environment_type" ||
+        type == "verbose_inner_environment_type") {
+        table = &environmentDescriptions;
+    } else if (type == "document_part_type") {
+        table = &documentPartDescriptions;
+    } else if (type == "wobject_type") {
+        table = &wobjectDescriptions;
     }
-    return ""; // Return an empty string if no matching describable is found
+    if (!table) return noDescription;
+
+    const DescribedName *described = findByName(*table, name);
+    return described ? described->description : noDescription;
 }
 
 void DialectManager::collectReferencesAndMetas() {
+    allReferences.clear();
+    metaBlocks.clear();
     for (const std::shared_ptr<Environment> &env: activeDialect->environments) {
         allReferences.insert(allReferences.end(), env->references.begin(), env->references.end());
         extractReferences(env->metaBlock, allReferences);
@@ -136,7 +277,7 @@ void DialectManager::extractReferences(const MetaBlock &mb, std::vector<Referenc
     }
 }
 
-std::vector<std::string> DialectManager::getReferencingTypeNames() {
+void DialectManager::collectReferencingTypeNames() {
     std::vector<std::string> names;
 
     for (const std::shared_ptr<Environment> &env: activeDialect->environments) {
@@ -155,7 +296,17 @@ std::vector<std::string> DialectManager::getReferencingTypeNames() {
 
     extractReferencingMetaFieldNames(names);
 
-    return names;
+    // a field of the same name can be in several meta blocks
+    referencingTypeNames.clear();
+    for (std::string &name: names) {
+        if (std::find(referencingTypeNames.begin(), referencingTypeNames.end(), name) == referencingTypeNames.end()) {
+            referencingTypeNames.emplace_back(std::move(name));
+        }
+    }
+}
+
+const std::vector<std::string> &DialectManager::getReferencingTypeNames() const {
+    return referencingTypeNames;
 }
 
 
@@ -179,12 +330,66 @@ void DialectManager::extractReferencingMetaFieldNames(std::vector<std::string> &
 
 }
 
-std::vector<Reference> DialectManager::getPossibleReferencesByTypeName(const std::string &name) {
-
-    if (referencesByTypeName.contains(name)) {
-        return referencesByTypeName[name];
+std::span<const Reference> DialectManager::getPossibleReferencesByTypeName(std::string_view name) const {
+    // read-only lookup, documents are indexed from several threads at once
+    const ReferencingType *type = findReferencingType(SymbolTable::getInstance()->find(name));
+    if (type) {
+        return type->references;
     }
 
     // unknown type to the dialect
     return {};
 }
+
+std::span<const SymbolId> DialectManager::getReferencedMetaKeysByTypeName(SymbolId name) const {
+    const ReferencingType *type = findReferencingType(name);
+    if (type) {
+        return type->metaKeys;
+    }
+    return {};
+}
+
+const std::vector<SymbolId> *DialectManager::getTypeNamesReferencing(const ReferenceKey &reference) const {
+    auto typeNames = typeNamesByReference.find(reference);
+    if (typeNames != typeNamesByReference.end()) {
+        return &typeNames->second;
+    }
+    return nullptr;
+}
+
+bool DialectManager::isReferencedMetaKey(std::string_view metaKey) const {
+    return std::binary_search(referencedMetaKeys.begin(), referencedMetaKeys.end(),
+                              SymbolTable::getInstance()->find(metaKey));
+}
+
+const DialectManager::ReferencingType *DialectManager::findReferencingType(SymbolId id) const {
+    auto type = std::lower_bound(referencingTypes.begin(), referencingTypes.end(), id,
+                                 [](const ReferencingType &t, SymbolId i) { return t.id < i; });
+    if (type == referencingTypes.end() || type->id != id) return nullptr;
+    return &*type;
+}
+
+size_t DialectManager::memoryUsage() const {
+    if (!activeDialect) return 0;
+    // the objects of the dialect are not walked, they take about twice the size of the file they were loaded from
+    size_t bytes = 2 * dialectFileSize;
+
+    for (const auto *descriptions: {&environmentDescriptions, &documentPartDescriptions, &wobjectDescriptions}) {
+        bytes += descriptions->capacity() * sizeof(DescribedName);
+        for (const DescribedName &described: *descriptions) {
+            bytes += memory::heapBytes(described.name) + memory::heapBytes(described.description);
+        }
+    }
+    bytes += memory::heapBytes(referencingTypeNames);
+    bytes += referencingTypes.capacity() * sizeof(ReferencingType);
+    for (const ReferencingType &type: referencingTypes) {
+        bytes += referencesBytes(type.references) + memory::heapBytes(type.metaKeys);
+    }
+    bytes += memory::heapBytes(referencedMetaKeys) + memory::heapBytes(typeNamesByReference);
+
+    bytes += referencesBytes(allReferences) + metaBlocks.capacity() * sizeof(MetaBlock);
+    for (const MetaBlock &metaBlock: metaBlocks) {
+        bytes += fieldsBytes(metaBlock.requiredFields) + fieldsBytes(metaBlock.optionalFields);
+    }
+    return bytes;
+}
@@ -7,43 +7,105 @@
 
 
 #include <string>
+#include <string_view>
+#include <span>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 
 #include "Dialect.h"
 
 class DialectManager {
 public:
+    // the dialect set by the client (setDialect), used by every project which does not name its own
     static DialectManager * getInstance();
+    /**
+     * The dialect compiled from the file (YAML or image), shared by everyone loading a file with the same content.
+     * It is compiled only if no dialect loaded from such a file is still in use. Throws like loadDialect.
+     */
+    static std::shared_ptr<const DialectManager> loadShared(const std::string &dialectFilePath);
 
     std::unique_ptr<Dialect> activeDialect;
 
     void loadDialect(const std::string &dialectFilePath);
+    /**
+     * Compiles the YAML of a dialect to a binary image, which loadDialect uses instead of the YAML
+     * while the YAML does not change. The image is written next to the YAML unless imagePath is given.
+     * Returns the path of the image.
+     */
+    static std::string compileDialect(const std::string &dialectFilePath, const std::string &imagePath = "");
 
-    std::string getDescription(const std::string &type, const std::string &name);
+    // hash of the content of the loaded dialect file, anything derived from the dialect is valid only for it
+    uint64_t dialectHash = 0;
+
+    // description of the environment, document part or wobject of the name, empty if the dialect has none
+    [[nodiscard]] const std::string &getDescription(std::string_view type, std::string_view name) const;
 
     // all references from the entire dialect in one place
     std::vector<Reference> allReferences;
     // all metaBlocks from the entire dialect in one place
     std::vector<MetaBlock> metaBlocks;
 
-    std::vector<std::string> getReferencingTypeNames();
-    std::vector<Reference> getPossibleReferencesByTypeName(const std::string& name);
+    // every name of a type which can reference something (an environment, a shorthand or a meta field), once
+    [[nodiscard]] const std::vector<std::string> &getReferencingTypeNames() const;
+    [[nodiscard]] std::span<const Reference> getPossibleReferencesByTypeName(std::string_view name) const;
+    // distinct (interned) metaKeys of the references of the type
+    [[nodiscard]] std::span<const SymbolId> getReferencedMetaKeysByTypeName(SymbolId name) const;
+    // (interned) names of the types which can reference what the reference points to, nullptr if no type can
+    [[nodiscard]] const std::vector<SymbolId> *getTypeNamesReferencing(const ReferenceKey &reference) const;
+    // true if some reference of the dialect points to meta fields with the key
+    [[nodiscard]] bool isReferencedMetaKey(std::string_view metaKey) const;
+
+    // estimated heap bytes of the loaded dialect and of the tables built from it
+    [[nodiscard]] size_t memoryUsage() const;
 
 private:
     DialectManager() = default;
     static std::unique_ptr<DialectManager> instance;
     static std::once_flag initInstanceFlag;
+    // content hash of the dialect file -> the dialect compiled from it, while someone uses it
+    static std::mutex sharedMutex;
+    static std::unordered_map<uint64_t, std::weak_ptr<const DialectManager>> shared;
+
+    /*
+     * The dialect compiled for lookups once it is loaded. Tables are sorted by name (or by the interned name)
+     * and searched by binary search, their entries are never changed until another dialect is loaded.
+     * Every name and metaKey of the dialect is interned in the SymbolTable.
+     */
+    struct DescribedName {
+        std::string name;
+        std::string description;
+    };
+    struct ReferencingType {
+        SymbolId id;
+        std::vector<Reference> references;
+        std::vector<SymbolId> metaKeys;
+    };
 
     template<typename T>
-    std::string scanForDescriptionByName(const std::vector<std::shared_ptr<T> > &describables, const std::string &name);
+    static std::vector<DescribedName> describeByName(const std::vector<std::shared_ptr<T> > &describables);
+    template<typename Entry>
+    static const Entry *findByName(const std::vector<Entry> &table, std::string_view name);
+    [[nodiscard]] const ReferencingType *findReferencingType(SymbolId id) const;
     static void extractReferences(const MetaBlock& mb, std::vector<Reference> & target) ;
+    void collectReferencingTypeNames();
     void extractReferencingMetaFieldNames(std::vector<std::string> & names);
     void processDialect();
     void collectReferencesAndMetas();
 
     void buildMaps();
-    std::unordered_map<std::string, std::vector<Reference>> referencesByTypeName;
+    std::vector<DescribedName> environmentDescriptions;
+    std::vector<DescribedName> documentPartDescriptions;
+    std::vector<DescribedName> wobjectDescriptions;
+    // in the order of the dialect
+    std::vector<std::string> referencingTypeNames;
+    // sorted by id
+    std::vector<ReferencingType> referencingTypes;
+    // sorted
+    std::vector<SymbolId> referencedMetaKeys;
+    std::unordered_map<ReferenceKey, std::vector<SymbolId>> typeNamesByReference;
+    // size of the file the dialect was loaded from (YAML or image)
+    size_t dialectFileSize = 0;
 
 };
 
@@ -15,6 +15,10 @@ bool Reference::operator==(const Reference& other) const {
     return metaKey == other.metaKey && structureType == other.structureType && structureName == other.structureName;
 }
 
+ReferenceKey Reference::key() const {
+    const SymbolTable *symbols = SymbolTable::getInstance();
+    return ReferenceKey{symbols->find(metaKey), symbols->find(structureType), symbols->find(structureName)};
+}
 
 void Reference::deserialize(const YAML::Node& node) {
     if (!node["meta_key"]) {
@@ -36,4 +40,9 @@ namespace std {
     size_t hash<Reference>::operator()(const Reference& ref) const noexcept {
         return hash<string>()(ref.metaKey) ^ hash<string>()(ref.structureType) ^ hash<string>()(ref.structureName);
     }
+
+    size_t hash<ReferenceKey>::operator()(const ReferenceKey& key) const noexcept {
+        uint64_t h = (static_cast<uint64_t>(key.metaKey) << 32 | key.structureType) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 29) ^ (static_cast<uint64_t>(key.structureName) * 0xC2B2AE3D27D4EB4Full));
+    }
 }
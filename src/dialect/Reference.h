@@ -8,7 +8,16 @@
 #include <string>
 #include <functional>  // For std::hash
 #include "yaml-cpp/yaml.h"
+#include "../utils/SymbolTable.h"
 
+// a reference with its parts interned, compared and hashed as integers
+struct ReferenceKey {
+    SymbolId metaKey = SymbolTable::EMPTY;
+    SymbolId structureType = SymbolTable::EMPTY;
+    SymbolId structureName = SymbolTable::EMPTY;
+
+    bool operator==(const ReferenceKey &other) const = default;
+};
 
 class Reference {
 public:
@@ -20,6 +29,9 @@ public:
     Reference(const std::string& metaKey, const std::string& structureType = "", const std::string& structureName = "");
     void deserialize(const YAML::Node& node);
 
+    // the interned parts, a part which was never interned is NO_SYMBOL (nothing indexed matches it)
+    [[nodiscard]] ReferenceKey key() const;
+
     bool operator==(const Reference& other) const;
 };
 
@@ -28,6 +40,11 @@ namespace std {
     struct hash<Reference> {
         std::size_t operator()(const Reference& ref) const noexcept;
     };
+
+    template <>
+    struct hash<ReferenceKey> {
+        std::size_t operator()(const ReferenceKey& key) const noexcept;
+    };
 }
 
 #endif 
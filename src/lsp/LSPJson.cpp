@@ -0,0 +1,200 @@
+#include "LSPJson.h"
+#include <charconv>
+#include "../utils/utils.h"
+
+namespace {
+
+    void appendNumber(std::string &out, uint32_t value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    }
+
+    void appendString(std::string &out, std::string_view text) {
+        out += '"';
+        utils::appendJsonEscaped(out, text);
+        out += '"';
+    }
+
+    void append(std::string &out, const Position &position) {
+        out += "{\"line\":";
+        appendNumber(out, position.line);
+        out += ",\"character\":";
+        appendNumber(out, position.character);
+        out += '}';
+    }
+
+    void append(std::string &out, const Range &range) {
+        out += "{\"start\":";
+        append(out, range.start);
+        out += ",\"end\":";
+        append(out, range.end);
+        out += '}';
+    }
+
+    void append(std::string &out, const Location &location) {
+        out += "{\"uri\":";
+        appendString(out, location.uri);
+        out += ",\"range\":";
+        append(out, location.range);
+        out += '}';
+    }
+
+    void append(std::string &out, const TextEdit &edit) {
+        out += "{\"range\":";
+        append(out, edit.range);
+        out += ",\"newText\":";
+        appendString(out, edit.newText);
+        out += '}';
+    }
+
+    void append(std::string &out, const Diagnostic &diagnostic) {
+        out += "{\"range\":";
+        append(out, diagnostic.range);
+        out += ",\"severity\":";
+        appendNumber(out, static_cast<uint32_t>(diagnostic.severity));
+        out += ",\"source\":";
+        appendString(out, diagnostic.source);
+        out += ",\"message\":";
+        appendString(out, diagnostic.message);
+        out += '}';
+    }
+
+    void append(std::string &out, const CompletionItem &item) {
+        out += "{\"label\":";
+        appendString(out, item.label);
+        if (item.kind.has_value()) {
+            out += ",\"kind\":";
+            appendNumber(out, static_cast<uint32_t>(item.kind.value()));
+        }
+        if (item.insertTextFormat.has_value()) {
+            out += ",\"insertTextFormat\":";
+            appendNumber(out, static_cast<uint32_t>(item.insertTextFormat.value()));
+        }
+        if (item.insertText.has_value()) {
+            out += ",\"insertText\":";
+            appendString(out, item.insertText.value());
+        }
+        out += '}';
+    }
+
+    void append(std::string &out, const FoldingRange &range) {
+        out += "{\"startLine\":";
+        appendNumber(out, range.startLine);
+        out += ",\"startCharacter\":";
+        appendNumber(out, range.startCharacter);
+        out += ",\"endLine\":";
+        appendNumber(out, range.endLine);
+        out += ",\"endCharacter\":";
+        appendNumber(out, range.endCharacter);
+        if (!range.foldingRangeKind.empty()) {
+            out += ",\"kind\":";
+            appendString(out, range.foldingRangeKind);
+        }
+        out += '}';
+    }
+
+    void append(std::string &out, const DocumentSymbol &symbol);
+    void append(std::string &out, const SymbolInformation &symbol);
+
+    template<typename T>
+    void append(std::string &out, const std::vector<T> &values) {
+        out += '[';
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i != 0) out += ',';
+            append(out, values[i]);
+        }
+        out += ']';
+    }
+
+    void append(std::string &out, const DocumentSymbol &symbol) {
+        out += "{\"name\":";
+        appendString(out, symbol.name);
+        out += ",\"detail\":";
+        appendString(out, symbol.detail);
+        out += ",\"kind\":";
+        appendNumber(out, static_cast<uint32_t>(symbol.kind));
+        out += ",\"range\":";
+        append(out, symbol.range);
+        out += ",\"selectionRange\":";
+        append(out, symbol.selectionRange);
+        out += ",\"children\":";
+        append(out, symbol.children);
+        out += '}';
+    }
+
+    void append(std::string &out, const SymbolInformation &symbol) {
+        out += "{\"name\":";
+        appendString(out, symbol.name);
+        out += ",\"kind\":";
+        appendNumber(out, static_cast<uint32_t>(symbol.kind));
+        out += ",\"location\":";
+        append(out, symbol.location);
+        out += ",\"containerName\":";
+        appendString(out, symbol.containerName);
+        out += '}';
+    }
+
+    // about the size of a location, the string rarely has to grow
+    template<typename T>
+    std::string arrayToJson(const std::vector<T> &values) {
+        std::string out;
+        out.reserve(values.size() * 96 + 2);
+        append(out, values);
+        return out;
+    }
+}
+
+namespace lsp {
+
+    std::string toJson(const Location &location) {
+        if (location.uri.empty()) return "null";
+        std::string out;
+        append(out, location);
+        return out;
+    }
+
+    std::string toJson(const std::vector<Location> &locations) {
+        return arrayToJson(locations);
+    }
+
+    std::string toJson(const WorkspaceEdit &edit) {
+        std::string out = "{\"changes\":{";
+        bool first = true;
+        for (const auto &[uri, edits]: edit.changes) {
+            if (!first) out += ',';
+            first = false;
+            appendString(out, uri);
+            out += ':';
+            append(out, edits);
+        }
+        out += "}}";
+        return out;
+    }
+
+    std::string toJson(const std::vector<Diagnostic> &diagnostics) {
+        return arrayToJson(diagnostics);
+    }
+
+    std::string toJson(const CompletionList &completions) {
+        std::string out = completions.isIncomplete ? "{\"isIncomplete\":true,\"items\":"
+                                                   : "{\"isIncomplete\":false,\"items\":";
+        out.reserve(out.size() + completions.items.size() * 48 + 3);
+        append(out, completions.items);
+        out += '}';
+        return out;
+    }
+
+    std::string toJson(const std::vector<FoldingRange> &ranges) {
+        return arrayToJson(ranges);
+    }
+
+    std::string toJson(const std::vector<DocumentSymbol> &symbols) {
+        return arrayToJson(symbols);
+    }
+
+    std::string toJson(const std::vector<SymbolInformation> &symbols) {
+        return arrayToJson(symbols);
+    }
+
+} // namespace lsp
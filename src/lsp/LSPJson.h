@@ -0,0 +1,28 @@
+#ifndef WUFF_LSPJSON_H
+#define WUFF_LSPJSON_H
+
+#include <string>
+#include <vector>
+#include "LSPTypes.h"
+
+/**
+ * LSP results encoded as the JSON of the protocol, written straight from the structs into one string.
+ * A server which sends them on as they are does not have to build (and serialize again) a Python object per
+ * location, edit or diagnostic. Optional fields which are not set are left out.
+ */
+namespace lsp {
+
+    // null for a location with no URI (no definition was found)
+    std::string toJson(const Location &location);
+    std::string toJson(const std::vector<Location> &locations);
+    std::string toJson(const WorkspaceEdit &edit);
+    std::string toJson(const std::vector<Diagnostic> &diagnostics);
+    std::string toJson(const CompletionList &completions);
+    std::string toJson(const std::vector<FoldingRange> &ranges);
+    std::string toJson(const std::vector<DocumentSymbol> &symbols);
+    std::string toJson(const std::vector<SymbolInformation> &symbols);
+
+} // namespace lsp
+
+
+#endif //WUFF_LSPJSON_H
@@ -1,5 +1,9 @@
 #include <utility>
 #include <optional>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 //
 // Created by Michal Janecek on 31.01.2024.
@@ -114,6 +118,11 @@ struct CompletionItem {
               insertText(std::move(insertText)) {}
 };
 
+// an incomplete list is requested again (with TriggerForIncompleteCompletions) as the user keeps typing
+struct CompletionList {
+    bool isIncomplete = false;
+    std::vector<CompletionItem> items;
+};
 
 struct ReferenceParams: public TextDocumentPositionParams {
     bool includeDeclaration;
@@ -166,6 +175,29 @@ struct Diagnostic {
             : range(range), message(std::move(message)), source(std::move(source)), severity(severity) {}
 };
 
+// textDocument/publishDiagnostics, diagnostics computed in the background
+struct PublishDiagnosticsParams {
+    std::string uri;
+    std::vector<Diagnostic> diagnostics;
+
+    PublishDiagnosticsParams(std::string uri, std::vector<Diagnostic> diagnostics)
+            : uri(std::move(uri)), diagnostics(std::move(diagnostics)) {}
+};
+
+enum class FileChangeType {
+    Created = 1,
+    Changed = 2,
+    Deleted = 3,
+};
+
+// workspace/didChangeWatchedFiles, a file (or folder) changed on disk
+struct FileEvent {
+    std::string uri;
+    FileChangeType type;
+
+    FileEvent(std::string uri, FileChangeType type) : uri(std::move(uri)), type(type) {}
+};
+
 
 struct FoldingRange {
     uint32_t startLine;
@@ -180,4 +212,94 @@ struct FoldingRange {
                                                  foldingRangeKind(std::move(foldingRangeKind)) {}
 };
 
+enum class SymbolKind {
+    File = 1,
+    Module = 2,
+    Namespace = 3,
+    Package = 4,
+    Class = 5,
+    Method = 6,
+    Property = 7,
+    Field = 8,
+    Constructor = 9,
+    Enum = 10,
+    Interface = 11,
+    Function = 12,
+    Variable = 13,
+    Constant = 14,
+    String = 15,
+    Number = 16,
+    Boolean = 17,
+    Array = 18,
+    Object = 19,
+    Key = 20,
+    Null = 21,
+    EnumMember = 22,
+    Struct = 23,
+    Event = 24,
+    Operator = 25,
+    TypeParameter = 26
+};
+
+struct SymbolInformation {
+    std::string name;
+    SymbolKind kind;
+    Location location;
+    std::string containerName;
+
+    SymbolInformation(std::string name, SymbolKind kind, Location location, std::string containerName)
+            : name(std::move(name)), kind(kind), location(std::move(location)),
+              containerName(std::move(containerName)) {}
+};
+
+struct DocumentSymbol {
+    std::string name;
+    std::string detail;
+    SymbolKind kind;
+    Range range;
+    Range selectionRange;
+    std::vector<DocumentSymbol> children;
+
+    DocumentSymbol(std::string name, std::string detail, SymbolKind kind, Range range, Range selectionRange)
+            : name(std::move(name)), detail(std::move(detail)), kind(kind), range(range),
+              selectionRange(selectionRange) {}
+};
+
+struct SemanticTokensRangeParams {
+    TextDocumentIdentifier textDocument;
+    Range range;
+
+    SemanticTokensRangeParams(TextDocumentIdentifier textDocument, Range range)
+            : textDocument(std::move(textDocument)), range(range) {}
+};
+
+struct SemanticTokensDeltaParams {
+    TextDocumentIdentifier textDocument;
+    std::string previousResultId;
+
+    SemanticTokensDeltaParams(TextDocumentIdentifier textDocument, std::string previousResultId)
+            : textDocument(std::move(textDocument)), previousResultId(std::move(previousResultId)) {}
+};
+
+// encoded semantic tokens, five integers per token, handed to Python as a buffer (not as a list)
+struct SemanticTokensData {
+    std::vector<uint32_t> values;
+};
+
+struct SemanticTokens {
+    std::string resultId;
+    SemanticTokensData data;
+};
+
+struct SemanticTokensEdit {
+    uint32_t start;
+    uint32_t deleteCount;
+    SemanticTokensData data;
+};
+
+struct SemanticTokensDelta {
+    std::string resultId;
+    std::vector<SemanticTokensEdit> edits;
+};
+
 #endif //WUFF_LSPTYPES_H
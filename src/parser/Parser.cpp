@@ -3,9 +3,19 @@
 //
 
 #include "Parser.h"
+#include <algorithm>
 #include <iostream>
+#include <chrono>
 #include <cstring>
+#include <optional>
+#include <unordered_map>
+#include "QueryRegistry.h"
+#include "QueryCursorPool.h"
+#include "ParserPool.h"
+#include "WooWooSymbols.h"
+#include "../utils/CancellationToken.h"
 #include "../utils/utils.h"
+#include "../utils/SpanTracer.h"
 
 std::unique_ptr<Parser> Parser::instance;
 std::once_flag Parser::initInstanceFlag;
@@ -18,38 +28,46 @@ Parser* Parser::getInstance() {
 }
 
 
-Parser::Parser() : WooWooParser(ts_parser_new()), YAMLParser(ts_parser_new()), BibTeXParser(ts_parser_new()) {
-    ts_parser_set_language(WooWooParser, tree_sitter_woowoo());
-    ts_parser_set_language(YAMLParser, tree_sitter_yaml());
-    ts_parser_set_language(BibTeXParser, tree_sitter_bibtex());
+Parser::Parser() {
     prepareQueries();
 }
 
-Parser::~Parser() {
-    ts_parser_delete(WooWooParser);
-    ts_parser_delete(YAMLParser);
-    ts_parser_delete(BibTeXParser);
-    ts_query_delete(metaBlocksQuery);
-}
-
-void Parser::prepareQueries() {
-
-    const char *queryString = "(meta_block) @metablock";
-    uint32_t errorOffset;
-    TSQueryError errorType;
+Parser::~Parser() = default;
 
-    metaBlocksQuery = ts_query_new(tree_sitter_woowoo(), queryString, strlen(queryString), &errorOffset, &errorType);
+PendingParse::PendingParse() : parser(ParserPool::acquire(tree_sitter_woowoo())) {}
 
-    if (!metaBlocksQuery) {
-        utils::reportQueryError("metaBlockQuery", errorOffset, errorType);
-    }
+PendingParse::~PendingParse() {
+    // the pooled parser must not resume the abandoned parse for someone else
+    ts_parser_reset(parser);
+}
 
+void Parser::prepareQueries() {
+    metaBlocksQuery = QueryRegistry::getInstance()->getQuery(tree_sitter_woowoo(), "(meta_block) @metablock",
+                                                             "metaBlockQuery");
 }
 
-std::vector<MetaContext *> Parser::parseMetas(TSTree *WooWooTree, const std::string &source) {
+/**
+ * Finds all meta blocks in the WooWoo tree and parses them as YAML.
+ *
+ * @param previousMetas Meta blocks of the previous version of the document, their offsets and trees already
+ *                      moved by the edits. A block found at the same position with the same length and not
+ *                      edited is moved over instead of being parsed again, any other block at the position
+ *                      is parsed incrementally from its tree; unused ones are freed.
+ * @param parsedLines If given, blocks entirely outside of these lines are left unparsed (large documents
+ *                    parse the YAML of a block once it is visible). Without it, every block is parsed.
+ */
+std::vector<MetaContext> Parser::parseMetas(TSTree *WooWooTree, const std::string &source,
+                                            std::vector<MetaContext> previousMetas,
+                                            std::optional<LineSpan> parsedLines) {
+
+    std::unordered_map<uint32_t, MetaContext *> previousByOffset;
+    for (MetaContext &mx: previousMetas) {
+        previousByOffset[mx.byteOffset] = &mx;
+    }
 
-    std::vector<MetaContext *> metaBlocks;
-    TSQueryCursor *queryCursor = ts_query_cursor_new();
+    std::vector<MetaContext> metaBlocks;
+    metaBlocks.reserve(previousMetas.size());
+    QueryCursorPool::Lease queryCursor = QueryCursorPool::acquire();
     ts_query_cursor_exec(queryCursor, metaBlocksQuery, ts_tree_root_node(WooWooTree));
 
     TSQueryMatch match;
@@ -63,72 +81,160 @@ std::vector<MetaContext *> Parser::parseMetas(TSTree *WooWooTree, const std::str
         TSNode parent = ts_node_parent(metaBlockNode);
 
         // Retrieve the type of the parent node
-        std::string parentType = ts_node_type(parent);
-        std::string parentName = extractStructureName(parent, source);
+        const char *parentType = ts_node_type(parent);
+        std::string_view parentName = extractStructureName(parent, source);
 
         uint32_t startByte = ts_node_start_byte(metaBlockNode);
         uint32_t endByte = ts_node_end_byte(metaBlockNode);
-        std::string yamlText = source.substr(startByte, endByte - startByte);
+        uint32_t lineOffset = ts_node_start_point(metaBlockNode).row;
+        uint32_t lineCount = ts_node_end_point(metaBlockNode).row - lineOffset;
+        bool deferred = parsedLines.has_value() &&
+                        (lineOffset + lineCount < parsedLines->first || lineOffset > parsedLines->last);
+
+        auto previous = previousByOffset.find(startByte);
+        MetaContext *previousBlock = previous != previousByOffset.end() ? previous->second : nullptr;
+        if (previousBlock && ((previousBlock->byteLength == endByte - startByte && previousBlock->isParsed()) ||
+                              deferred)) {
+            // the block is untouched (only its surroundings could have changed) or its parse waits,
+            // an edited tree is kept for it
+            MetaContext &metaContext = *previousBlock;
+            previousByOffset.erase(previous);
+            metaContext.edited = metaContext.tree &&
+                                 (metaContext.edited || metaContext.byteLength != endByte - startByte);
+            metaContext.lineOffset = lineOffset;
+            metaContext.lineCount = lineCount;
+            metaContext.byteLength = endByte - startByte;
+            metaContext.setParent(parentType, parentName);
+            metaBlocks.emplace_back(std::move(metaContext));
+            continue;
+        }
 
-        TSTree *yamlTree = ts_parser_parse_string(YAMLParser, nullptr, yamlText.c_str(), yamlText.length());
-        auto *metaContext = new MetaContext(yamlTree, ts_node_start_point(metaBlockNode).row, startByte, parentType,
-                                            parentName);
-        metaBlocks.emplace_back(metaContext);
+        TSTree *yamlTree = nullptr;
+        if (!deferred) {
+            yamlTree = parseYaml(source, startByte, endByte - startByte, lineOffset,
+                                 previousBlock ? previousBlock->tree : nullptr);
+        }
+        metaBlocks.emplace_back(yamlTree, lineOffset, lineCount, startByte, endByte - startByte, parentType,
+                                parentName);
     }
 
-    ts_query_cursor_delete(queryCursor);
     return metaBlocks;
 }
 
 
-TSTree *Parser::parseWooWoo(const std::string &source) {
-    // Parse the given source string and return the new syntax tree
-    auto tree = ts_parser_parse_string(WooWooParser, nullptr, source.c_str(), source.length());
+TSTree *Parser::parseWooWoo(const std::string &source, const TSTree *oldTree) {
+    // Parse the given source string and return the new syntax tree.
+    // If an (already edited) old tree is given, unchanged parts of it are reused.
+    // The parse stops (and RequestCancelled is thrown) once the request running it is cancelled.
+    const CancellationToken &token = CancellationToken::current();
+    token.throwIfCancelled();
+
+    ParserPool::Lease parser = ParserPool::acquire(tree_sitter_woowoo());
+    ts_parser_set_cancellation_flag(parser, token.flag());
+    ts_parser_set_timeout_micros(parser, token.remainingMicros());
+    auto tree = ts_parser_parse_string(parser, oldTree, source.c_str(), source.length());
+    if (!tree) {
+        // the parser would otherwise try to resume the abandoned parse next time
+        ts_parser_reset(parser);
+        throw RequestCancelled();
+    }
     return tree;
 }
 
+/**
+ * Parses the source in chunks of at most chunkMicros, checking the cancellation of the request between them.
+ * Once budgetMicros passed, the parse stops and nullptr is returned; calling this again with the same
+ * pending parse and the same source resumes it (oldTree is only used when a parse starts).
+ */
+TSTree *Parser::parseWooWoo(PendingParse &parse, const std::string &source, const TSTree *oldTree,
+                            uint64_t chunkMicros, uint64_t budgetMicros) {
+    const CancellationToken &token = CancellationToken::current();
+    auto start = std::chrono::steady_clock::now();
+    ts_parser_set_cancellation_flag(parse.parser, token.flag());
+    while (true) {
+        if (token.isCancelled()) {
+            ts_parser_reset(parse.parser);
+            throw RequestCancelled();
+        }
+        uint64_t timeout = chunkMicros;
+        if (token.remainingMicros() != 0) {
+            timeout = timeout != 0 ? std::min(timeout, token.remainingMicros()) : token.remainingMicros();
+        }
+        ts_parser_set_timeout_micros(parse.parser, timeout);
+        TSTree *tree;
+        {
+            ScopedSpan span("parse_chunk", "parse", std::string(), source.size());
+            tree = ts_parser_parse_string(parse.parser, oldTree, source.c_str(), source.length());
+        }
+        if (tree) return tree;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (budgetMicros != 0 && !token.isCancelled() &&
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) >=
+            budgetMicros) {
+            return nullptr;
+        }
+    }
+}
+
 TSTree *Parser::parseYaml(const std::string &source) {
-    auto tree = ts_parser_parse_string(YAMLParser, nullptr, source.c_str(), source.length());
+    ParserPool::Lease parser = ParserPool::acquire(tree_sitter_yaml());
+    auto tree = ts_parser_parse_string(parser, nullptr, source.c_str(), source.length());
     return tree;
 }
 
-TSTree * Parser::parseBibTeX(const std::string &source) {
-    auto tree = ts_parser_parse_string(BibTeXParser, nullptr, source.c_str(), source.length());
+TSTree *Parser::parseYaml(const std::string &source, uint32_t startByte, uint32_t length, uint32_t startRow,
+                          const TSTree *oldTree) {
+    std::string_view text(source);
+    size_t lineStart = startByte == 0 ? std::string_view::npos : text.rfind('\n', startByte - 1);
+    TSPoint startPoint{startRow, static_cast<uint32_t>(lineStart == std::string_view::npos ? startByte
+                                                                                          : startByte - lineStart - 1)};
+    std::string_view block = text.substr(startByte, length);
+    size_t lastNewLine = block.rfind('\n');
+    TSPoint endPoint{startRow + static_cast<uint32_t>(std::count(block.begin(), block.end(), '\n')),
+                     lastNewLine == std::string_view::npos ? startPoint.column + length
+                                                           : static_cast<uint32_t>(length - lastNewLine - 1)};
+    TSRange range{startPoint, endPoint, startByte, startByte + length};
+
+    ParserPool::Lease parser = ParserPool::acquire(tree_sitter_yaml());
+    ts_parser_set_included_ranges(parser, &range, 1);
+    TSTree *tree = ts_parser_parse_string(parser, oldTree, source.c_str(), source.length());
+    // the pooled parser parses whole sources for others
+    ts_parser_set_included_ranges(parser, nullptr, 0);
     return tree;
 }
 
-std::string Parser::extractStructureName(const TSNode &node, const std::string &source) {
-    std::string nodeType = ts_node_type(node);
-
-    std::string childWithNameType;
-    if (nodeType == "document_part") {
-        childWithNameType = "document_part_type";
-    } else if (nodeType.find("outer_environment") != std::string::npos) {
-        childWithNameType = "outer_environment_type";
-    } else if (nodeType == "wobject") {
-        childWithNameType = "wobject_type";
-    }
+TSTree * Parser::parseBibTeX(const std::string &source, const TSTree *oldTree) {
+    ParserPool::Lease parser = ParserPool::acquire(tree_sitter_bibtex());
+    auto tree = ts_parser_parse_string(parser, oldTree, source.c_str(), source.length());
+    return tree;
+}
 
-    if (childWithNameType.empty()) {
-        return "";
+std::string_view Parser::extractStructureName(const TSNode &node, const std::string &source) {
+    TSSymbol childWithNameSymbol;
+    switch (ts_node_symbol(node)) {
+        case woowoo::sym_document_part:
+            childWithNameSymbol = woowoo::sym_document_part_type;
+            break;
+        case woowoo::sym_fragile_outer_environment:
+        case woowoo::sym_classic_outer_environment:
+        case woowoo::sym_implicit_outer_environment:
+            childWithNameSymbol = woowoo::sym_outer_environment_type;
+            break;
+        case woowoo::sym_wobject:
+            childWithNameSymbol = woowoo::sym_wobject_type;
+            break;
+        default:
+            return {};
     }
 
-    uint32_t childCount = ts_node_child_count(node);
-    for (uint32_t i = 0; i < childCount; ++i) {
-        TSNode child = ts_node_child(node, i);
-        std::string childType = ts_node_type(child);
-
-        if (childType == childWithNameType) {
-            // Extract the text of the child node from the source code
-            uint32_t startByte = ts_node_start_byte(child);
-            uint32_t endByte = ts_node_end_byte(child);
-
-            std::string childText = source.substr(startByte, endByte - startByte);
-
-            return childText;
-        }
+    auto child = utils::getChild(node, childWithNameSymbol);
+    if (child.has_value()) {
+        // Extract the text of the child node from the source code
+        uint32_t startByte = ts_node_start_byte(child.value());
+        uint32_t endByte = ts_node_end_byte(child.value());
+        return std::string_view(source).substr(startByte, endByte - startByte);
     }
 
     // Return an empty string if no matching child is found
-    return "";
+    return {};
 }
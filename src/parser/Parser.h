@@ -7,6 +7,8 @@
 
 #include "tree_sitter/api.h"
 #include "../project/MetaContext.h"
+#include "ParserPool.h"
+#include <optional>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -17,13 +19,45 @@ extern "C" TSLanguage* tree_sitter_woowoo();
 extern "C" TSLanguage* tree_sitter_yaml();
 extern "C" TSLanguage* tree_sitter_bibtex();
 
+// lines (both inclusive) of a document
+struct LineSpan {
+    uint32_t first;
+    uint32_t last;
+};
+
+/**
+ * A WooWoo parse which ran out of its time budget. The parser keeps its state and the parse is resumed
+ * where it stopped, as long as it is given the same source again. Dropping it abandons the parse.
+ */
+class PendingParse {
+public:
+    PendingParse();
+    ~PendingParse();
+    PendingParse(const PendingParse &) = delete;
+    PendingParse &operator=(const PendingParse &) = delete;
+
+    ParserPool::Lease parser;
+};
+
 class Parser {
 public:
     ~Parser();
-    TSTree* parseWooWoo(const std::string& source);
+    TSTree* parseWooWoo(const std::string& source, const TSTree* oldTree = nullptr);
+    // parses in chunks of chunkMicros, nullptr once budgetMicros (0 for no budget) passed and the parse is pending
+    TSTree* parseWooWoo(PendingParse &parse, const std::string& source, const TSTree* oldTree,
+                        uint64_t chunkMicros, uint64_t budgetMicros);
     TSTree* parseYaml(const std::string& source);
-    TSTree* parseBibTeX(const std::string& source);
-    std::vector<MetaContext *> parseMetas(TSTree * WooWooTree, const std::string& source);
+    // the bytes (starting on the row) as an included range of the source, the tree has the positions of the source;
+    // oldTree (edited to match the source) makes the parse incremental
+    TSTree* parseYaml(const std::string& source, uint32_t startByte, uint32_t length, uint32_t startRow,
+                      const TSTree* oldTree = nullptr);
+    // oldTree (edited to match the source) makes the parse incremental
+    TSTree* parseBibTeX(const std::string& source, const TSTree* oldTree = nullptr);
+    // new blocks outside of the deferral span (if given) are not parsed, see MetaContext::isParsed();
+    // the YAML of every block is an included range of the source, it is never copied out of it
+    std::vector<MetaContext> parseMetas(TSTree * WooWooTree, const std::string& source,
+                                        std::vector<MetaContext> previousMetas = {},
+                                        std::optional<LineSpan> parsedLines = std::nullopt);
     static Parser * getInstance();
 
 private:
@@ -31,13 +65,10 @@ private:
     static std::unique_ptr<Parser> instance;
     static std::once_flag initInstanceFlag;
 
-    TSParser* WooWooParser;
-    TSParser* YAMLParser;
-    TSParser* BibTeXParser;
-    
     void prepareQueries();
-    TSQuery * metaBlocksQuery;
-    static std::string extractStructureName(const TSNode & node, const std::string &source);
+    const TSQuery * metaBlocksQuery;
+    // a view into the source, empty if the structure has no name
+    static std::string_view extractStructureName(const TSNode & node, const std::string &source);
 };
 
 
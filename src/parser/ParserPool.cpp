@@ -0,0 +1,70 @@
+#include "ParserPool.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    struct Pool {
+        std::mutex mutex;
+        std::unordered_map<const TSLanguage *, std::vector<TSParser *>> idleParsers;
+        // enough for every core to parse at once, anything above this is freed
+        const size_t maxIdleParsers = std::max<size_t>(2, std::thread::hardware_concurrency());
+
+        ~Pool() {
+            for (auto &parsers: idleParsers) {
+                for (TSParser *parser: parsers.second) {
+                    ts_parser_delete(parser);
+                }
+            }
+        }
+    };
+
+    Pool &pool() {
+        static Pool instance;
+        return instance;
+    }
+}
+
+ParserPool::Lease ParserPool::acquire(const TSLanguage *language) {
+    {
+        std::lock_guard<std::mutex> lock(pool().mutex);
+        auto &parsers = pool().idleParsers[language];
+        if (!parsers.empty()) {
+            TSParser *parser = parsers.back();
+            parsers.pop_back();
+            return {language, parser};
+        }
+    }
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, language);
+    return {language, parser};
+}
+
+void ParserPool::release(const TSLanguage *language, TSParser *parser) {
+    // undo whatever the previous user set
+    ts_parser_set_cancellation_flag(parser, nullptr);
+    ts_parser_set_timeout_micros(parser, 0);
+    ts_parser_set_included_ranges(parser, nullptr, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(pool().mutex);
+        auto &parsers = pool().idleParsers[language];
+        if (parsers.size() < pool().maxIdleParsers) {
+            parsers.emplace_back(parser);
+            return;
+        }
+    }
+    ts_parser_delete(parser);
+}
+
+ParserPool::Lease::Lease(Lease &&other) noexcept: language(other.language), parser(other.parser) {
+    other.parser = nullptr;
+}
+
+ParserPool::Lease::~Lease() {
+    if (parser) {
+        release(language, parser);
+    }
+}
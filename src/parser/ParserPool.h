@@ -0,0 +1,43 @@
+#ifndef WUFF_PARSERPOOL_H
+#define WUFF_PARSERPOOL_H
+
+#include "tree_sitter/api.h"
+
+/**
+ * Process-wide pool of tree-sitter parsers, one free list per language.
+ *
+ * A TSParser can be used by one thread at a time, a lease gives it to the caller exclusively and returns it
+ * to the pool when it goes out of scope. Parsers (and the parse stacks they allocated) are reused by whichever
+ * thread parses next, at most as many idle parsers per language are kept as there are cores.
+ */
+class ParserPool {
+public:
+    class Lease {
+    public:
+        ~Lease();
+        Lease(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        [[nodiscard]] TSParser *get() const { return parser; }
+        operator TSParser *() const { return parser; }
+
+    private:
+        friend class ParserPool;
+        Lease(const TSLanguage *language, TSParser *parser) : language(language), parser(parser) {}
+        const TSLanguage *language;
+        TSParser *parser;
+    };
+
+    /**
+     * Returns a parser of the language with no cancellation flag, timeout or included ranges set.
+     */
+    static Lease acquire(const TSLanguage *language);
+
+private:
+    static void release(const TSLanguage *language, TSParser *parser);
+};
+
+
+#endif //WUFF_PARSERPOOL_H
@@ -0,0 +1,55 @@
+#include "QueryCursorPool.h"
+#include <cstdint>
+#include <vector>
+
+namespace {
+    // nested queries need only a few cursors at once, anything above this is freed
+    const size_t MAX_POOLED_CURSORS = 16;
+
+    struct CursorPool {
+        std::vector<TSQueryCursor *> cursors;
+
+        ~CursorPool() {
+            for (TSQueryCursor *cursor: cursors) {
+                ts_query_cursor_delete(cursor);
+            }
+        }
+    };
+
+    thread_local CursorPool pool;
+}
+
+QueryCursorPool::Lease QueryCursorPool::acquire() {
+    if (pool.cursors.empty()) {
+        return Lease(ts_query_cursor_new());
+    }
+    TSQueryCursor *cursor = pool.cursors.back();
+    pool.cursors.pop_back();
+    return Lease(cursor);
+}
+
+void QueryCursorPool::release(TSQueryCursor *cursor) {
+    if (pool.cursors.size() >= MAX_POOLED_CURSORS) {
+        ts_query_cursor_delete(cursor);
+        return;
+    }
+    // undo whatever restrictions the previous user set
+    ts_query_cursor_set_byte_range(cursor, 0, UINT32_MAX);
+    ts_query_cursor_set_point_range(cursor, {0, 0}, {UINT32_MAX, UINT32_MAX});
+    ts_query_cursor_set_match_limit(cursor, UINT32_MAX);
+    pool.cursors.emplace_back(cursor);
+}
+
+QueryCursorPool::Lease::Lease(Lease &&other) noexcept: cursor(other.cursor), traced(other.traced), begin(other.begin) {
+    other.cursor = nullptr;
+    other.traced = false;
+}
+
+QueryCursorPool::Lease::~Lease() {
+    if (cursor) {
+        release(cursor);
+    }
+    if (traced) {
+        SpanTracer::record("query", "query", begin, SpanTracer::Clock::now(), {}, 0);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef WUFF_QUERYCURSORPOOL_H
+#define WUFF_QUERYCURSORPOOL_H
+
+#include "tree_sitter/api.h"
+#include "../utils/SpanTracer.h"
+
+/**
+ * Per-thread pool of reusable tree-sitter query cursors.
+ *
+ * Cursors are leased with acquire() and returned to the pool of the current thread when the lease
+ * goes out of scope, so every exit path of a caller gives the cursor back and no cursor is leaked.
+ * While spans are traced, a lease is recorded as a "query" span (the execution and the iteration of the matches).
+ */
+class QueryCursorPool {
+public:
+    class Lease {
+    public:
+        ~Lease();
+        Lease(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        [[nodiscard]] TSQueryCursor *get() const { return cursor; }
+        operator TSQueryCursor *() const { return cursor; }
+
+    private:
+        friend class QueryCursorPool;
+        explicit Lease(TSQueryCursor *cursor) : cursor(cursor), traced(SpanTracer::isEnabled()) {
+            if (traced) begin = SpanTracer::Clock::now();
+        }
+        TSQueryCursor *cursor;
+        bool traced;
+        SpanTracer::Clock::time_point begin;
+    };
+
+    /**
+     * Returns a cursor with no byte range, point range or match limit set.
+     */
+    static Lease acquire();
+
+private:
+    static void release(TSQueryCursor *cursor);
+};
+
+
+#endif //WUFF_QUERYCURSORPOOL_H
@@ -0,0 +1,63 @@
+#include "QueryRegistry.h"
+#include "../utils/utils.h"
+#include "../utils/MemoryUsage.h"
+
+std::unique_ptr<QueryRegistry> QueryRegistry::instance;
+std::once_flag QueryRegistry::initInstanceFlag;
+
+QueryRegistry *QueryRegistry::getInstance() {
+    std::call_once(initInstanceFlag, []() {
+        instance.reset(new QueryRegistry());
+    });
+    return instance.get();
+}
+
+const TSQuery *QueryRegistry::getQuery(const TSLanguage *language, const std::string &queryString,
+                                       const std::string &queryName) {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+
+    auto key = std::make_pair(language, queryString);
+    auto it = queries.find(key);
+    if (it != queries.end()) {
+        return it->second;
+    }
+
+    uint32_t errorOffset;
+    TSQueryError errorType;
+    TSQuery *query = ts_query_new(language, queryString.c_str(), queryString.length(), &errorOffset, &errorType);
+    if (!query) {
+        // throws, invalid queries are never cached
+        utils::reportQueryError(queryName, errorOffset, errorType);
+    }
+    queries.emplace(std::move(key), query);
+    return query;
+}
+
+size_t QueryRegistry::memoryUsage() {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    // tree-sitter does not report the size of a query, its steps and symbol tables take a few times its source
+    const size_t compiledBytesPerQueryByte = 8;
+    size_t bytes = memory::heapBytes(queries);
+    for (const auto &[key, query]: queries) {
+        bytes += key.second.size() * compiledBytesPerQueryByte;
+    }
+    return bytes;
+}
+
+uint32_t QueryRegistry::captureId(const TSQuery *query, const std::string &captureName) {
+    if (!query) return NO_CAPTURE;
+    for (uint32_t id = 0; id < ts_query_capture_count(query); ++id) {
+        uint32_t length;
+        const char *name = ts_query_capture_name_for_id(query, id, &length);
+        if (captureName.compare(0, std::string::npos, name, length) == 0) {
+            return id;
+        }
+    }
+    return NO_CAPTURE;
+}
+
+QueryRegistry::~QueryRegistry() {
+    for (auto &query: queries) {
+        ts_query_delete(query.second);
+    }
+}
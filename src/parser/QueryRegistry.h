@@ -0,0 +1,55 @@
+#ifndef WUFF_QUERYREGISTRY_H
+#define WUFF_QUERYREGISTRY_H
+
+#include "tree_sitter/api.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * Process-wide cache of compiled tree-sitter queries.
+ *
+ * Every query string is compiled only once per language, documents and components borrow
+ * the resulting handles. Compiled queries are immutable and can be shared between threads,
+ * they live until the registry is destroyed at exit.
+ */
+class QueryRegistry {
+public:
+    ~QueryRegistry();
+    static QueryRegistry *getInstance();
+
+    /**
+     * Returns the compiled query, compiling it on the first request.
+     *
+     * @param queryName Used only to report an error if the query cannot be compiled.
+     * @return nullptr if the query string is invalid.
+     */
+    const TSQuery *getQuery(const TSLanguage *language, const std::string &queryString, const std::string &queryName);
+
+    /**
+     * Resolves a capture name to its id, so that matches can be dispatched without comparing strings.
+     *
+     * @return NO_CAPTURE if the query has no capture of that name.
+     */
+    static uint32_t captureId(const TSQuery *query, const std::string &captureName);
+
+    static const uint32_t NO_CAPTURE = UINT32_MAX;
+
+    // estimated heap bytes of the compiled queries and their keys
+    size_t memoryUsage();
+
+private:
+    QueryRegistry() = default;
+    static std::unique_ptr<QueryRegistry> instance;
+    static std::once_flag initInstanceFlag;
+
+    std::mutex queriesMutex;
+    // (language, query string) -> compiled query
+    std::map<std::pair<const TSLanguage *, std::string>, TSQuery *> queries;
+};
+
+
+#endif //WUFF_QUERYREGISTRY_H
@@ -0,0 +1,25 @@
+#include "WooWooSymbols.h"
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+extern "C" TSLanguage *tree_sitter_woowoo();
+
+namespace woowoo {
+
+    void checkSymbols() {
+        static std::once_flag checkedFlag;
+        std::call_once(checkedFlag, []() {
+            const TSLanguage *language = tree_sitter_woowoo();
+            for (const SymbolName &entry: symbolNames) {
+                TSSymbol compiled = ts_language_symbol_for_name(language, entry.name.data(),
+                                                                static_cast<uint32_t>(entry.name.size()), true);
+                if (compiled != entry.symbol) {
+                    throw std::logic_error("The WooWoo grammar was regenerated, copy its symbols to WooWooSymbols.h: " +
+                                           std::string(entry.name));
+                }
+            }
+        });
+    }
+
+} // namespace woowoo
@@ -0,0 +1,100 @@
+#ifndef WUFF_WOOWOOSYMBOLS_H
+#define WUFF_WOOWOOSYMBOLS_H
+
+#include "tree_sitter/api.h"
+#include <string_view>
+
+/**
+ * Symbols of the named nodes of the WooWoo grammar, numbered as in the enum of tree-sitter/woowoo/parser.c
+ * (its "sym_" entries which are not hidden), so that nodes are dispatched by ts_node_symbol instead of comparing
+ * their types as strings. The grammar has no aliases, a node of the type has always this symbol.
+ *
+ * The tables are copied from the generated parser and have to be copied again whenever it is regenerated,
+ * checkSymbols() tells if they were not.
+ */
+namespace woowoo {
+
+    enum Symbol : TSSymbol {
+        sym_filename = 2,
+        sym_short_inner_environment_body = 10,
+        sym_outer_environment_type = 16,
+        sym_text = 24,
+        sym_fragile_outer_environment_body = 25,
+        sym_verbose_inner_environment_meta = 27,
+        sym_error_sentinel = 33,
+        sym_source_file = 34,
+        sym_include = 35,
+        sym_document_part = 36,
+        sym_document_part_type = 37,
+        sym_document_part_title = 38,
+        sym_meta_block = 39,
+        sym_document_part_body = 40,
+        sym_wobject = 42,
+        sym_wobject_type = 43,
+        sym_block = 45,
+        sym_text_block = 46,
+        sym_math_environment = 48,
+        sym_math_environment_body = 49,
+        sym_short_inner_environment = 51,
+        sym_short_inner_environment_type = 52,
+        sym_verbose_inner_environment_body = 53,
+        sym_verbose_inner_environment = 54,
+        sym_verbose_inner_environment_classic = 55,
+        sym_verbose_inner_environment_at = 56,
+        sym_verbose_inner_environment_hash = 57,
+        sym_verbose_inner_environment_hash_end = 59,
+        sym_verbose_inner_environment_at_end = 60,
+        sym_verbose_inner_environment_type = 61,
+        sym_fragile_outer_environment = 64,
+        sym_classic_outer_environment = 65,
+        sym_implicit_outer_environment = 66,
+    };
+
+    struct SymbolName {
+        Symbol symbol;
+        std::string_view name;
+    };
+
+    inline constexpr SymbolName symbolNames[] = {
+        {sym_filename, "filename"},
+        {sym_short_inner_environment_body, "short_inner_environment_body"},
+        {sym_outer_environment_type, "outer_environment_type"},
+        {sym_text, "text"},
+        {sym_fragile_outer_environment_body, "fragile_outer_environment_body"},
+        {sym_verbose_inner_environment_meta, "verbose_inner_environment_meta"},
+        {sym_error_sentinel, "error_sentinel"},
+        {sym_source_file, "source_file"},
+        {sym_include, "include"},
+        {sym_document_part, "document_part"},
+        {sym_document_part_type, "document_part_type"},
+        {sym_document_part_title, "document_part_title"},
+        {sym_meta_block, "meta_block"},
+        {sym_document_part_body, "document_part_body"},
+        {sym_wobject, "wobject"},
+        {sym_wobject_type, "wobject_type"},
+        {sym_block, "block"},
+        {sym_text_block, "text_block"},
+        {sym_math_environment, "math_environment"},
+        {sym_math_environment_body, "math_environment_body"},
+        {sym_short_inner_environment, "short_inner_environment"},
+        {sym_short_inner_environment_type, "short_inner_environment_type"},
+        {sym_verbose_inner_environment_body, "verbose_inner_environment_body"},
+        {sym_verbose_inner_environment, "verbose_inner_environment"},
+        {sym_verbose_inner_environment_classic, "verbose_inner_environment_classic"},
+        {sym_verbose_inner_environment_at, "verbose_inner_environment_at"},
+        {sym_verbose_inner_environment_hash, "verbose_inner_environment_hash"},
+        {sym_verbose_inner_environment_hash_end, "verbose_inner_environment_hash_end"},
+        {sym_verbose_inner_environment_at_end, "verbose_inner_environment_at_end"},
+        {sym_verbose_inner_environment_type, "verbose_inner_environment_type"},
+        {sym_fragile_outer_environment, "fragile_outer_environment"},
+        {sym_classic_outer_environment, "classic_outer_environment"},
+        {sym_implicit_outer_environment, "implicit_outer_environment"},
+    };
+
+    // throws if a symbol of the tables is not the one of its name in the compiled grammar, checked only once
+    void checkSymbols();
+
+} // namespace woowoo
+
+
+#endif //WUFF_WOOWOOSYMBOLS_H
@@ -0,0 +1,386 @@
+#include "BibliographyIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include "../parser/Parser.h"
+#include "../parser/QueryCursorPool.h"
+#include "../parser/QueryRegistry.h"
+#include "../utils/MemoryUsage.h"
+#include "../utils/utils.h"
+
+namespace {
+    const TSQuery *entriesQuery() {
+        static const TSQuery *query = QueryRegistry::getInstance()->getQuery(tree_sitter_bibtex(), "(entry) @entry",
+                                                                             "bibtexEntriesQuery");
+        return query;
+    }
+
+    std::string_view nodeText(const std::string &source, TSNode node) {
+        uint32_t start = ts_node_start_byte(node);
+        return std::string_view(source).substr(start, ts_node_end_byte(node) - start);
+    }
+
+    std::string lowerCase(std::string_view text) {
+        std::string lower(text);
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return lower;
+    }
+
+    // the value of a field without its outer braces or quotes and with its white space collapsed
+    std::string fieldValue(std::string_view value) {
+        while (value.size() >= 2 && ((value.front() == '{' && value.back() == '}') ||
+                                     (value.front() == '"' && value.back() == '"'))) {
+            value = value.substr(1, value.size() - 2);
+        }
+        std::string collapsed;
+        collapsed.reserve(value.size());
+        for (char c: value) {
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                if (!collapsed.empty() && collapsed.back() != ' ') collapsed += ' ';
+            } else {
+                collapsed += c;
+            }
+        }
+        while (!collapsed.empty() && collapsed.back() == ' ') collapsed.pop_back();
+        return collapsed;
+    }
+
+    TSPoint pointAt(const std::string &source, uint32_t byte) {
+        auto begin = source.begin();
+        auto row = static_cast<uint32_t>(std::count(begin, begin + byte, '\n'));
+        size_t lineStart = byte == 0 ? std::string::npos : source.rfind('\n', byte - 1);
+        uint32_t column = lineStart == std::string::npos ? byte : byte - static_cast<uint32_t>(lineStart) - 1;
+        return TSPoint{row, column};
+    }
+}
+
+BibliographyIndex::File::~File() {
+    ts_tree_delete(tree);
+}
+
+BibliographyIndex::~BibliographyIndex() = default;
+
+bool BibliographyIndex::isCitation(std::string_view innerEnvironmentType) {
+    return innerEnvironmentType == "cite";
+}
+
+void BibliographyIndex::setFiles(const std::vector<std::pair<BibliographyIndex *, std::vector<fs::path>>> &bibliographies,
+                                 ThreadPool *threadPool) {
+    std::vector<std::pair<BibliographyIndex *, File *>> toRead;
+    for (const auto &[bibliography, paths]: bibliographies) {
+        std::set<std::string> wanted;
+        for (const fs::path &path: paths) {
+            wanted.insert(path.lexically_normal().generic_string());
+        }
+        for (size_t i = bibliography->files.size(); i-- > 0;) {
+            if (wanted.erase(bibliography->files[i]->path.generic_string()) == 0) {
+                bibliography->removeFile(i);
+            }
+        }
+        for (const std::string &path: wanted) {
+            bibliography->files.push_back(std::make_unique<File>(fs::path(path)));
+        }
+        for (const auto &file: bibliography->files) {
+            toRead.emplace_back(bibliography, file.get());
+        }
+    }
+
+    // the files are read and parsed in parallel, the indexes are updated on this thread
+    std::vector<Update> updates(toRead.size());
+    if (threadPool && threadPool->size() > 1 && toRead.size() > 1) {
+        std::vector<std::future<void>> read;
+        read.reserve(toRead.size());
+        for (size_t i = 0; i < toRead.size(); ++i) {
+            read.emplace_back(threadPool->submit([&toRead, &updates, i]() {
+                updates[i] = toRead[i].first->readAgain(*toRead[i].second);
+            }, Lane::Indexing));
+        }
+        for (auto &future: read) {
+            future.get();
+        }
+    } else {
+        for (size_t i = 0; i < toRead.size(); ++i) {
+            updates[i] = toRead[i].first->readAgain(*toRead[i].second);
+        }
+    }
+
+    for (size_t i = 0; i < toRead.size(); ++i) {
+        if (updates[i].changed) {
+            toRead[i].first->apply(*toRead[i].second, updates[i]);
+        }
+    }
+}
+
+void BibliographyIndex::setFiles(const std::vector<fs::path> &paths, ThreadPool *threadPool) {
+    setFiles({{this, paths}}, threadPool);
+}
+
+bool BibliographyIndex::hasFile(const fs::path &path) const {
+    std::string normal = path.lexically_normal().generic_string();
+    return std::any_of(files.begin(), files.end(),
+                       [&normal](const std::unique_ptr<File> &file) { return file->path.generic_string() == normal; });
+}
+
+/**
+ * Reads the file again and parses what changed, the index is only read. The tree is edited by the part
+ * between the common prefix and suffix of the two sources, entries are extracted from the ranges whose syntax
+ * changed, extended until both the old and the new entries at their ends are whole.
+ */
+BibliographyIndex::Update BibliographyIndex::readAgain(File &file) const {
+    Update update;
+    std::error_code ec;
+    auto modificationTime = fs::last_write_time(file.path, ec);
+    int64_t time = ec ? 0 : static_cast<int64_t>(modificationTime.time_since_epoch().count());
+    auto size = fs::file_size(file.path, ec);
+    if (file.tree && time != 0 && time == file.modificationTime && !ec && size == file.source.size()) {
+        return update;
+    }
+    auto source = utils::readFile(file.path);
+    if (!source.has_value()) {
+        std::cerr << "Could not read the bibliography " << file.path << std::endl;
+        // it has no entries until it can be read
+        source.emplace();
+    }
+    file.modificationTime = time;
+    if (file.tree && source.value() == file.source) {
+        return update;
+    }
+
+    const std::string &oldSource = file.source;
+    const std::string &newSource = source.value();
+    auto common = std::mismatch(oldSource.begin(), oldSource.end(), newSource.begin(), newSource.end());
+    auto prefix = static_cast<uint32_t>(common.first - oldSource.begin());
+    uint32_t suffix = 0;
+    while (suffix < oldSource.size() - prefix && suffix < newSource.size() - prefix &&
+           oldSource[oldSource.size() - 1 - suffix] == newSource[newSource.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    TSInputEdit edit;
+    edit.start_byte = prefix;
+    edit.old_end_byte = static_cast<uint32_t>(oldSource.size()) - suffix;
+    edit.new_end_byte = static_cast<uint32_t>(newSource.size()) - suffix;
+    edit.start_point = pointAt(oldSource, edit.start_byte);
+    edit.old_end_point = pointAt(oldSource, edit.old_end_byte);
+    edit.new_end_point = pointAt(newSource, edit.new_end_byte);
+
+    TSTree *oldTree = file.tree;
+    uint32_t changedStart = edit.start_byte;
+    uint32_t changedEnd = edit.new_end_byte;
+    if (oldTree) {
+        ts_tree_edit(oldTree, &edit);
+    }
+    TSTree *newTree = Parser::getInstance()->parseBibTeX(newSource, oldTree);
+    if (oldTree) {
+        uint32_t rangeCount = 0;
+        TSRange *ranges = ts_tree_get_changed_ranges(oldTree, newTree, &rangeCount);
+        for (uint32_t i = 0; i < rangeCount; ++i) {
+            changedStart = std::min(changedStart, ranges[i].start_byte);
+            changedEnd = std::max(changedEnd, ranges[i].end_byte);
+        }
+        std::free(ranges);
+        ts_tree_delete(oldTree);
+    } else {
+        changedStart = 0;
+        changedEnd = static_cast<uint32_t>(newSource.size());
+    }
+
+    update.changed = true;
+    update.delta = static_cast<int64_t>(newSource.size()) - static_cast<int64_t>(oldSource.size());
+    file.tree = newTree;
+    file.source = std::move(source.value());
+    file.lineStarts.assign(1, 0);
+    for (uint32_t i = 0; i < file.source.size(); ++i) {
+        if (file.source[i] == '\n') file.lineStarts.push_back(i + 1);
+    }
+
+    auto oldStart = [this, &file](size_t i) { return entries[file.slots[i]].startByte; };
+    auto oldEnd = [this, &file, &update](size_t i) {
+        return static_cast<uint32_t>(entries[file.slots[i]].endByte + update.delta);
+    };
+    while (true) {
+        update.entries = extractEntries(file, changedStart, changedEnd);
+        if (!update.entries.empty()) {
+            changedStart = std::min(changedStart, update.entries.front().startByte);
+            changedEnd = std::max(changedEnd, update.entries.back().endByte);
+        }
+        // old entries are kept if they end before the change, moved if they start after it (old bytes)
+        update.first = static_cast<size_t>(std::partition_point(
+                file.slots.begin(), file.slots.end(),
+                [this, changedStart](uint32_t slot) { return entries[slot].endByte <= changedStart; }) -
+                                           file.slots.begin());
+        int64_t oldChangedEnd = static_cast<int64_t>(changedEnd) - update.delta;
+        update.last = static_cast<size_t>(std::partition_point(
+                file.slots.begin(), file.slots.end(),
+                [this, oldChangedEnd](uint32_t slot) { return entries[slot].startByte < oldChangedEnd; }) -
+                                          file.slots.begin());
+        update.last = std::max(update.last, update.first);
+        if (update.first == update.last) break;
+        // an old entry reaching out of the change takes the change with it
+        uint32_t start = std::min(changedStart, oldStart(update.first));
+        uint32_t end = std::max(changedEnd, oldEnd(update.last - 1));
+        if (start == changedStart && end == changedEnd) break;
+        changedStart = start;
+        changedEnd = end;
+    }
+    return update;
+}
+
+void BibliographyIndex::apply(File &file, Update &update) {
+    for (size_t i = update.first; i < update.last; ++i) {
+        removeEntry(file.slots[i]);
+    }
+    for (size_t i = update.last; i < file.slots.size(); ++i) {
+        Entry &entry = entries[file.slots[i]];
+        entry.startByte = static_cast<uint32_t>(entry.startByte + update.delta);
+        entry.endByte = static_cast<uint32_t>(entry.endByte + update.delta);
+        entry.keyByte = static_cast<uint32_t>(entry.keyByte + update.delta);
+    }
+    std::vector<uint32_t> added;
+    added.reserve(update.entries.size());
+    for (Entry &entry: update.entries) {
+        entry.file = &file;
+        added.push_back(addEntry(std::move(entry)));
+    }
+    auto first = file.slots.begin() + static_cast<std::ptrdiff_t>(update.first);
+    first = file.slots.erase(first, file.slots.begin() + static_cast<std::ptrdiff_t>(update.last));
+    file.slots.insert(first, added.begin(), added.end());
+}
+
+void BibliographyIndex::removeFile(size_t index) {
+    for (uint32_t slot: files[index]->slots) {
+        removeEntry(slot);
+    }
+    files.erase(files.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+uint32_t BibliographyIndex::addEntry(Entry entry) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        entries[slot] = std::move(entry);
+    } else {
+        slot = static_cast<uint32_t>(entries.size());
+        entries.emplace_back(std::move(entry));
+    }
+    auto byKey = slotsByKey.try_emplace(entries[slot].key).first;
+    if (byKey->second.empty()) {
+        sortedKeys.insert(byKey->first);
+    }
+    byKey->second.push_back(slot);
+    return slot;
+}
+
+void BibliographyIndex::removeEntry(uint32_t slot) {
+    Entry &entry = entries[slot];
+    auto byKey = slotsByKey.find(entry.key);
+    if (byKey != slotsByKey.end()) {
+        std::erase(byKey->second, slot);
+        if (byKey->second.empty()) {
+            sortedKeys.erase(byKey->first);
+            slotsByKey.erase(byKey);
+        }
+    }
+    entry = Entry{};
+    freeSlots.push_back(slot);
+}
+
+std::vector<BibliographyIndex::Entry> BibliographyIndex::extractEntries(const File &file, uint32_t startByte,
+                                                                         uint32_t endByte) {
+    std::vector<Entry> extracted;
+    if (!file.tree) return extracted;
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
+    ts_query_cursor_set_byte_range(cursor, startByte, endByte);
+    ts_query_cursor_exec(cursor, entriesQuery(), ts_tree_root_node(file.tree));
+
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(cursor, &match)) {
+        TSNode node = match.captures[0].node;
+        TSNode type = ts_node_child_by_field_name(node, "ty", 2);
+        TSNode key = ts_node_child_by_field_name(node, "key", 3);
+        if (ts_node_is_null(type) || ts_node_is_null(key)) continue;
+
+        Entry entry;
+        entry.key = std::string(nodeText(file.source, key));
+        std::string_view typeText = nodeText(file.source, type);
+        entry.type = lowerCase(typeText.starts_with('@') ? typeText.substr(1) : typeText);
+        entry.startByte = ts_node_start_byte(node);
+        entry.endByte = ts_node_end_byte(node);
+        entry.keyByte = ts_node_start_byte(key);
+        for (uint32_t i = 0; i < ts_node_named_child_count(node); ++i) {
+            TSNode field = ts_node_named_child(node, i);
+            if (std::string_view(ts_node_type(field)) != "field") continue;
+            TSNode name = ts_node_child_by_field_name(field, "name", 4);
+            TSNode value = ts_node_child_by_field_name(field, "value", 5);
+            if (ts_node_is_null(name) || ts_node_is_null(value)) continue;
+            if (lowerCase(nodeText(file.source, name)) == "title") {
+                entry.title = fieldValue(nodeText(file.source, value));
+                break;
+            }
+        }
+        extracted.emplace_back(std::move(entry));
+    }
+    return extracted;
+}
+
+const BibliographyIndex::Entry *BibliographyIndex::find(std::string_view key) const {
+    auto byKey = slotsByKey.find(std::string(key));
+    if (byKey == slotsByKey.end()) return nullptr;
+    return &entries[byKey->second.front()];
+}
+
+std::vector<const BibliographyIndex::Entry *>
+BibliographyIndex::completions(std::string_view prefix, size_t limit, bool &incomplete) const {
+    std::vector<const Entry *> found;
+    incomplete = false;
+    for (auto key = sortedKeys.lower_bound(prefix); key != sortedKeys.end() && key->starts_with(prefix); ++key) {
+        if (found.size() == limit) {
+            incomplete = true;
+            break;
+        }
+        found.push_back(find(*key));
+    }
+    return found;
+}
+
+const fs::path &BibliographyIndex::filePath(const Entry &entry) {
+    return entry.file->path;
+}
+
+Range BibliographyIndex::keyRange(const Entry &entry) {
+    const File &file = *entry.file;
+    auto line = std::upper_bound(file.lineStarts.begin(), file.lineStarts.end(), entry.keyByte) - 1;
+    // UTF-16 code units of the line up to the byte, a 4-byte sequence is a surrogate pair
+    auto utf16Column = [&file, lineStart = *line](uint32_t byte) {
+        uint32_t column = 0;
+        for (uint32_t i = lineStart; i < byte; ++i) {
+            auto c = static_cast<unsigned char>(file.source[i]);
+            if ((c & 0xC0) != 0x80) column += c >= 0xF0 ? 2 : 1;
+        }
+        return column;
+    };
+    auto row = static_cast<uint32_t>(line - file.lineStarts.begin());
+    auto keyLength = static_cast<uint32_t>(entry.key.size());
+    return Range{Position{row, utf16Column(entry.keyByte)}, Position{row, utf16Column(entry.keyByte + keyLength)}};
+}
+
+size_t BibliographyIndex::size() const {
+    return entries.size() - freeSlots.size();
+}
+
+size_t BibliographyIndex::memoryUsage() const {
+    size_t bytes = memory::heapBytes(freeSlots) + memory::heapBytes(slotsByKey) + memory::heapBytes(sortedKeys) +
+                   entries.capacity() * sizeof(Entry);
+    for (const Entry &entry: entries) {
+        bytes += memory::heapBytes(entry.key) + memory::heapBytes(entry.type) + memory::heapBytes(entry.title);
+    }
+    for (const auto &file: files) {
+        bytes += sizeof(File) + memory::ALLOCATION_OVERHEAD + memory::heapBytes(file->source) +
+                 memory::treeBytes(file->tree) + memory::heapBytes(file->lineStarts) + memory::heapBytes(file->slots);
+    }
+    return bytes + files.capacity() * sizeof(void *);
+}
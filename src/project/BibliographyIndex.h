@@ -0,0 +1,126 @@
+#ifndef WUFF_BIBLIOGRAPHYINDEX_H
+#define WUFF_BIBLIOGRAPHYINDEX_H
+
+#include <tree_sitter/api.h>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../lsp/LSPTypes.h"
+#include "../utils/ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * Entries of the BibTeX files of a project (its Woofile's builder.bibtex), by their citation keys.
+ *
+ * A key is found in constant time, keys starting with a prefix by a walk of an ordered set of them.
+ * The source and the syntax tree of every file are kept: a file changed on disk is parsed again incrementally
+ * (the edit is the part between the common prefix and suffix of its two versions) and only the entries
+ * within the changed ranges of the tree are extracted again, the ones after them are just moved.
+ */
+class BibliographyIndex {
+private:
+    struct File;
+
+public:
+    struct Entry {
+        std::string key;
+        // lower case, without the '@' (e.g. "article")
+        std::string type;
+        // without the outer braces or quotes, empty if the entry has none
+        std::string title;
+        // the whole entry and the start of its key, bytes of the file
+        uint32_t startByte;
+        uint32_t endByte;
+        uint32_t keyByte;
+        const File *file = nullptr;
+    };
+
+    BibliographyIndex() = default;
+    BibliographyIndex(const BibliographyIndex &) = delete;
+    BibliographyIndex &operator=(const BibliographyIndex &) = delete;
+    ~BibliographyIndex();
+
+    /**
+     * Makes the files (absolute paths) the bibliography. Files which did not change on disk since they were
+     * read are kept as they are, the rest is read and parsed on the pool (if given); a file which cannot be read
+     * has no entries. The indexes themselves are updated on the calling thread.
+     */
+    static void setFiles(const std::vector<std::pair<BibliographyIndex *, std::vector<fs::path>>> &bibliographies,
+                         ThreadPool *threadPool);
+    void setFiles(const std::vector<fs::path> &paths, ThreadPool *threadPool = nullptr);
+    // whether the file (absolute, lexically normal) is a part of the bibliography
+    [[nodiscard]] bool hasFile(const fs::path &path) const;
+
+    // the entry with the key (of the first file defining it), nullptr if there is none
+    [[nodiscard]] const Entry *find(std::string_view key) const;
+    // at most limit entries whose keys start with the prefix, by their keys; incomplete is set if there are more
+    [[nodiscard]] std::vector<const Entry *> completions(std::string_view prefix, size_t limit,
+                                                         bool &incomplete) const;
+    [[nodiscard]] static const fs::path &filePath(const Entry &entry);
+    // UTF-16 based range of the key of the entry
+    [[nodiscard]] static Range keyRange(const Entry &entry);
+
+    [[nodiscard]] size_t size() const;
+    // estimated heap bytes of the index, the sources and the syntax trees of its files
+    [[nodiscard]] size_t memoryUsage() const;
+
+    // inner environments citing an entry by its key (e.g. ".cite:knuth84")
+    static bool isCitation(std::string_view innerEnvironmentType);
+
+private:
+    struct File {
+        fs::path path;
+        std::string source;
+        TSTree *tree = nullptr;
+        // of the file when it was read, 0 if it is unknown
+        int64_t modificationTime = 0;
+        // bytes where the lines of the source start
+        std::vector<uint32_t> lineStarts;
+        // the entries of the file in document order
+        std::vector<uint32_t> slots;
+
+        explicit File(fs::path path) : path(std::move(path)) {}
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+        ~File();
+    };
+
+    // what reading a file again changed, made without touching the index (on any thread)
+    struct Update {
+        bool changed = false;
+        // the entries of the file in [first, last) (positions in File::slots) are replaced by these ones
+        size_t first = 0;
+        size_t last = 0;
+        std::vector<Entry> entries;
+        // moves the entries after them
+        int64_t delta = 0;
+    };
+
+    // by slot, a removed entry leaves a free slot (reused by the next one)
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    std::vector<std::unique_ptr<File>> files;
+    // key -> slots of the entries with the key, in the order they were added
+    std::unordered_map<std::string, std::vector<uint32_t>> slotsByKey;
+    // views of the keys of slotsByKey
+    std::set<std::string_view> sortedKeys;
+
+    Update readAgain(File &file) const;
+    void apply(File &file, Update &update);
+    void removeFile(size_t index);
+    uint32_t addEntry(Entry entry);
+    void removeEntry(uint32_t slot);
+
+    // the entries of the file intersecting the bytes, in document order
+    static std::vector<Entry> extractEntries(const File &file, uint32_t startByte, uint32_t endByte);
+};
+
+
+#endif //WUFF_BIBLIOGRAPHYINDEX_H
@@ -4,270 +4,462 @@
 
 #include "DialectedWooWooDocument.h"
 #include <algorithm>
+#include <set>
 #include "../utils/utils.h"
-
-DialectedWooWooDocument::DialectedWooWooDocument(const fs::path &documentPath1)
-        : WooWooDocument(documentPath1) {
+#include "../parser/QueryRegistry.h"
+#include "../parser/QueryCursorPool.h"
+#include "../parser/WooWooSymbols.h"
+#include "../utils/CancellationToken.h"
+#include "../utils/Stats.h"
+#include "../utils/SpanTracer.h"
+
+DialectedWooWooDocument::DialectedWooWooDocument(const fs::path &documentPath1,
+                                                 std::shared_ptr<const DialectManager> dialect)
+        : WooWooDocument(documentPath1), dialect(std::move(dialect)) {
     prepareQueries();
     index();
 }
 
-
-DialectedWooWooDocument::~DialectedWooWooDocument() {
-    ts_query_delete(fieldQuery);
-    ts_query_delete(referencesQuery);
+DialectedWooWooDocument::DialectedWooWooDocument(const fs::path &documentPath1, DocumentIndex index,
+                                                 const FileState &state,
+                                                 std::shared_ptr<const DialectManager> dialect)
+        : WooWooDocument(documentPath1, false), dialect(std::move(dialect)), documentIndex(std::move(index)) {
+    prepareQueries();
+    diskState = state;
 }
 
-void DialectedWooWooDocument::prepareQueries() {
-    uint32_t errorOffset;
-    TSQueryError errorType;
-    fieldQuery = ts_query_new(
-            tree_sitter_yaml(),
-            MetaContext::metaFieldQueryString.c_str(),
-            MetaContext::metaFieldQueryString.size(),
-            &errorOffset,
-            &errorType
-    );
-
-    if (!fieldQuery) {
-        utils::reportQueryError("fieldQuery", errorOffset, errorType);
-    }
+DialectedWooWooDocument::DialectedWooWooDocument(const DialectedWooWooDocument &other)
+        : WooWooDocument(other), dialectChanges(other.dialectChanges), dialect(other.dialect),
+          documentIndex(other.documentIndex), outline(other.outline) {}
 
-    referencesQuery = ts_query_new(
-            tree_sitter_woowoo(),
-            referencesQueryString.c_str(),
-            referencesQueryString.size(),
-            &errorOffset,
-            &errorType
-    );
+DialectedWooWooDocument::~DialectedWooWooDocument() = default;
 
-    if (!referencesQuery) {
-        utils::reportQueryError("fieldQuery", errorOffset, errorType);
-    }
+std::once_flag DialectedWooWooDocument::prepareQueriesFlag;
+const TSQuery *DialectedWooWooDocument::fieldQuery = nullptr;
+uint32_t DialectedWooWooDocument::fieldKeyCaptureId = QueryRegistry::NO_CAPTURE;
+uint32_t DialectedWooWooDocument::fieldValueCaptureId = QueryRegistry::NO_CAPTURE;
+const TSQuery *DialectedWooWooDocument::referencesQuery = nullptr;
+const TSQuery *DialectedWooWooDocument::outlineQuery = nullptr;
+uint32_t DialectedWooWooDocument::outlineDocumentPartCaptureId = QueryRegistry::NO_CAPTURE;
+uint32_t DialectedWooWooDocument::outlineWobjectCaptureId = QueryRegistry::NO_CAPTURE;
+uint32_t DialectedWooWooDocument::outlineOuterEnvironmentCaptureId = QueryRegistry::NO_CAPTURE;
+
+void DialectedWooWooDocument::prepareQueries() {
+    std::call_once(prepareQueriesFlag, []() {
+        fieldQuery = QueryRegistry::getInstance()->getQuery(tree_sitter_yaml(), MetaContext::metaFieldQueryString,
+                                                            "fieldQuery");
+        fieldKeyCaptureId = QueryRegistry::captureId(fieldQuery, "key");
+        fieldValueCaptureId = QueryRegistry::captureId(fieldQuery, "value");
+        referencesQuery = QueryRegistry::getInstance()->getQuery(tree_sitter_woowoo(), referencesQueryString,
+                                                                 "referencesQuery");
+        outlineQuery = QueryRegistry::getInstance()->getQuery(tree_sitter_woowoo(), outlineQueryString,
+                                                              "outlineQuery");
+        outlineDocumentPartCaptureId = QueryRegistry::captureId(outlineQuery, "document_part");
+        outlineWobjectCaptureId = QueryRegistry::captureId(outlineQuery, "wobject");
+        outlineOuterEnvironmentCaptureId = QueryRegistry::captureId(outlineQuery, "outer_environment");
+    });
 }
 
 void DialectedWooWooDocument::index() {
-    referencablesByNode.clear();
-    referencableNodes.clear();
-    for (const std::string &typeName: DialectManager::getInstance()->getReferencingTypeNames()) {
-        for (const Reference &ref: DialectManager::getInstance()->getPossibleReferencesByTypeName(typeName)) {
-
-            // create if not exist
-            referencableNodes[ref];
-
-            for (MetaContext *mx: metaBlocks) {
-                if ((ref.structureType.empty() || ref.structureType == mx->parentType) &&
-                    (ref.structureName.empty() || ref.structureName == mx->parentName)) {
-                    // this metablock is matching the requiremens by the reference
-
-                    TSQueryCursor *wooCursor = ts_query_cursor_new();
-                    ts_query_cursor_exec(wooCursor, fieldQuery, ts_tree_root_node(mx->tree));
-
-                    TSQueryMatch match;
-                    while (ts_query_cursor_next_match(wooCursor, &match)) {
-                        TSNode valueNode;
-                        bool correctKey = false;
-                        for (uint32_t i = 0; i < match.capture_count; ++i) {
-                            uint32_t capture_index = match.captures[i].index;
-                            TSNode capturedNode = match.captures[i].node;
-
-                            uint32_t valueCaptureName;
-                            const char *valueCaptureNameChars = ts_query_capture_name_for_id(
-                                    fieldQuery, capture_index, &valueCaptureName);
-                            std::string valueCaptureNameStr(valueCaptureNameChars, valueCaptureName);
-
-                            if (valueCaptureNameStr == "value") {
-                                // mark the value node
-                                valueNode = capturedNode;
-                            } else if (valueCaptureNameStr == "key") {
-                                if (getMetaNodeText(mx, capturedNode) == ref.metaKey) {
-                                    // the field key is what we want
-                                    correctKey = true;
-                                } else {
-                                    break;
-                                }
-                            }
-                        }
-                        if (!correctKey) continue;
-                        referencablesByNode[typeName].emplace_back(std::make_pair(mx, valueNode));
-                        referencableNodes[ref][getMetaNodeText(mx, valueNode)] = std::make_pair(mx, valueNode);
+    ScopedTimer timer(Timer::Index);
+    ScopedSpan span("index", "index", documentPath, source.size());
+    documentIndex = DocumentIndex();
+    std::vector<std::string> metaBlockLabels(metaBlocks.size());
+    indexMetaBlocks(metaBlockLabels);
+    indexReferenceSites();
+    indexLayout();
+    indexOutline(metaBlockLabels);
+}
 
+/**
+ * Indexes the fields of all meta blocks in a single pass: every field is looked up in the maps
+ * prepared by the DialectManager, both as something that can be referenced (a definition)
+ * and as something that can reference (a reference site).
+ */
+void DialectedWooWooDocument::indexMetaBlocks(std::vector<std::string> &metaBlockLabels) {
+    const DialectManager *dialectManager = getDialect();
+    SymbolTable *symbols = SymbolTable::getInstance();
+    ReferenceKey pattern;
+    // referencing types the value of the current field was already added to
+    std::vector<SymbolId> addedTypeNames;
+
+    for (size_t block = 0; block < metaBlocks.size(); ++block) {
+        MetaContext *mx = &metaBlocks[block];
+        // a deferred block is indexed once finishDeferredWork() parsed it
+        if (!mx->isParsed()) continue;
+        // structure names of the dialect are interned, the ones only found in the source are not
+        SymbolId parentName = mx->parentName.empty() ? SymbolTable::EMPTY : symbols->find(mx->parentName);
+        QueryCursorPool::Lease wooCursor = QueryCursorPool::acquire();
+        ts_query_cursor_exec(wooCursor, fieldQuery, ts_tree_root_node(mx->tree));
+
+        TSQueryMatch match;
+        while (ts_query_cursor_next_match(wooCursor, &match)) {
+            std::optional<TSNode> keyNode;
+            std::optional<TSNode> valueNode;
+            for (uint32_t i = 0; i < match.capture_count; ++i) {
+                uint32_t capture_index = match.captures[i].index;
+                if (capture_index == fieldValueCaptureId) {
+                    valueNode = match.captures[i].node;
+                } else if (capture_index == fieldKeyCaptureId) {
+                    keyNode = match.captures[i].node;
+                }
+            }
+            if (!keyNode || !valueNode) continue;
+
+            // every metaKey and referencing type name of the dialect is interned, a field which is
+            // neither can neither define nor reference anything
+            SymbolId key = symbols->find(getNodeText(keyNode.value()));
+            if (key == SymbolTable::NO_SYMBOL) continue;
+            std::string value(getNodeText(valueNode.value()));
+            Range range = nodeRange(valueNode.value());
+
+            // DEFINITIONS (example --> "label: chapter-01"), by the references matching this block
+            pattern.metaKey = key;
+            addedTypeNames.clear();
+            bool defines = false;
+            const SymbolId structureTypes[] = {mx->parentType, SymbolTable::EMPTY};
+            const SymbolId structureNames[] = {parentName, SymbolTable::EMPTY};
+            for (size_t t = 0; t < 2; ++t) {
+                for (size_t n = 0; n < 2; ++n) {
+                    // a reference without a structure type (or name) matches any, do not look it up twice,
+                    // a name no reference of the dialect mentions cannot match at all
+                    if ((t == 1 && mx->parentType == SymbolTable::EMPTY) ||
+                        (n == 0 && parentName == SymbolTable::NO_SYMBOL) ||
+                        (n == 1 && parentName == SymbolTable::EMPTY)) {
+                        continue;
+                    }
+                    pattern.structureType = structureTypes[t];
+                    pattern.structureName = structureNames[n];
+                    const std::vector<SymbolId> *typeNames = dialectManager->getTypeNamesReferencing(pattern);
+                    if (!typeNames) continue;
+
+                    documentIndex.definitions[pattern][value] = range;
+                    defines = true;
+                    if (metaBlockLabels[block].empty()) {
+                        metaBlockLabels[block] = value;
+                    }
+                    for (SymbolId typeName: *typeNames) {
+                        if (std::find(addedTypeNames.begin(), addedTypeNames.end(), typeName) != addedTypeNames.end()) {
+                            continue;
+                        }
+                        addedTypeNames.push_back(typeName);
+                        documentIndex.referencableValues[typeName].emplace_back(value);
                     }
-                    ts_query_cursor_delete(wooCursor);
+                }
+            }
+            if (defines) {
+                // every defining field, even one defining a value already defined before
+                documentIndex.definitionSites[key][value].emplace_back(range);
+            }
+
+            // REFERENCES FROM META-BLOCKS (example --> "ref: chapter-01")
+            addReferenceSite(key, value, range);
+        }
+    }
+}
+
+void DialectedWooWooDocument::indexLayout() {
+    documentIndex.metaBlocks.reserve(metaBlocks.size());
+    for (const MetaContext &mx: metaBlocks) {
+        documentIndex.metaBlocks.push_back(DocumentIndex::MetaBlockSpan{mx.lineOffset, mx.byteOffset, mx.byteLength});
+    }
+    documentIndex.commentLines.reserve(commentLines.size());
+    for (const CommentLine &commentLine: commentLines) {
+        documentIndex.commentLines.emplace_back(commentLine.lineNumber);
+    }
+    documentIndex.syntaxErrors = tree && ts_node_has_error(ts_tree_root_node(tree));
+}
+
+/**
+ * Collects the structures (and blocks) of the document in a single query over the tree, in document order,
+ * with the enclosing structure of each of them.
+ */
+void DialectedWooWooDocument::indexOutline(std::vector<std::string> &metaBlockLabels) {
+    outline.clear();
+
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
+    ts_query_cursor_exec(cursor, outlineQuery, ts_tree_root_node(tree));
+
+    // indexes of the nodes enclosing the current one, innermost last
+    std::vector<uint32_t> enclosing;
+    TSQueryMatch match;
+    uint32_t captureIndex;
+    while (ts_query_cursor_next_capture(cursor, &match, &captureIndex)) {
+        TSNode node = match.captures[captureIndex].node;
+        uint32_t captureId = match.captures[captureIndex].index;
+
+        OutlineNode item{};
+        // the symbol of the child naming the type of the structure, none for a block
+        std::optional<TSSymbol> typeChild;
+        if (captureId == outlineDocumentPartCaptureId) {
+            item.kind = OutlineNode::Kind::DocumentPart;
+            typeChild = woowoo::sym_document_part_type;
+        } else if (captureId == outlineWobjectCaptureId) {
+            item.kind = OutlineNode::Kind::Wobject;
+            typeChild = woowoo::sym_wobject_type;
+        } else if (captureId == outlineOuterEnvironmentCaptureId) {
+            item.kind = OutlineNode::Kind::OuterEnvironment;
+            typeChild = woowoo::sym_outer_environment_type;
+        } else {
+            item.kind = OutlineNode::Kind::Block;
+        }
+        item.startByte = ts_node_start_byte(node);
+        item.endByte = ts_node_end_byte(node);
+        item.range = nodeRange(node);
+        item.selectionRange = Range{item.range.start, item.range.start};
+
+        while (!enclosing.empty() && outline[enclosing.back()].endByte <= item.startByte) {
+            enclosing.pop_back();
+        }
+        item.parent = OutlineNode::NO_PARENT;
+        for (auto it = enclosing.rbegin(); it != enclosing.rend(); ++it) {
+            if (outline[*it].kind != OutlineNode::Kind::Block) {
+                item.parent = *it;
+                break;
+            }
+        }
+
+        if (typeChild) {
+            auto typeNode = utils::getChild(node, typeChild.value());
+            if (typeNode.has_value()) {
+                item.type = getNodeText(typeNode.value());
+                item.selectionRange = nodeRange(typeNode.value());
+            }
+            if (item.kind == OutlineNode::Kind::DocumentPart) {
+                item.title = utils::getChildText(node, woowoo::sym_document_part_title, this);
+            }
+            // the meta block of the structure was already indexed, blocks are in document order
+            auto metaBlockNode = utils::getChild(node, woowoo::sym_meta_block);
+            if (metaBlockNode.has_value()) {
+                uint32_t metaStart = ts_node_start_byte(metaBlockNode.value());
+                auto mx = std::lower_bound(metaBlocks.begin(), metaBlocks.end(), metaStart,
+                                           [](const MetaContext &m, uint32_t start) { return m.byteOffset < start; });
+                if (mx != metaBlocks.end() && mx->byteOffset == metaStart) {
+                    item.label = std::move(metaBlockLabels[mx - metaBlocks.begin()]);
                 }
             }
         }
+
+        enclosing.push_back(static_cast<uint32_t>(outline.size()));
+        outline.emplace_back(std::move(item));
     }
 }
 
+Range DialectedWooWooDocument::nodeRange(TSNode node) const {
+    TSPoint start = ts_node_start_point(node);
+    TSPoint end = ts_node_end_point(node);
+    Range range{{start.row, start.column}, {end.row, end.column}};
+    utfMappings->utf8ToUtf16(range);
+    return range;
+}
+
+
 
-std::vector<std::pair<MetaContext *, TSNode> > DialectedWooWooDocument::getReferencablesBy(
-        const std::string &referencingTypeName) {
-    auto refTypes = DialectManager::getInstance()->getReferencingTypeNames();
-    if (std::find(refTypes.begin(), refTypes.end(), referencingTypeName) == refTypes.end()) {
+std::span<const std::string> DialectedWooWooDocument::getReferencableValuesBy(std::string_view referencingTypeName) const {
+    auto values = documentIndex.referencableValues.find(SymbolTable::getInstance()->find(referencingTypeName));
+    if (values == documentIndex.referencableValues.end()) {
         return {};
     }
-    return referencablesByNode[referencingTypeName];
+    return values->second;
 }
 
-std::optional<std::pair<MetaContext *, TSNode>>
-DialectedWooWooDocument::findReferencable(const std::vector<Reference> &references, const std::string &referenceValue) {
+std::optional<Range>
+DialectedWooWooDocument::findDefinition(std::span<const Reference> references, const std::string &referenceValue) const {
 
     for (auto &ref: references) {
-        if (referencableNodes[ref].contains(referenceValue)) {
-            return referencableNodes[ref][referenceValue];
+        auto definitions = documentIndex.definitions.find(ref.key());
+        if (definitions == documentIndex.definitions.end()) continue;
+        auto definition = definitions->second.find(referenceValue);
+        if (definition != definitions->second.end()) {
+            return definition->second;
         }
     }
 
     return std::nullopt;
 }
 
-std::vector<Location>
-DialectedWooWooDocument::findLocationsOfReferences(const Reference &reference, const std::string &referenceValue) {
+void DialectedWooWooDocument::materialize() {
+    if (materialized) return;
+    auto indexedState = diskState;
+    try {
+        // the cached index is replaced by indexing the parsed document
+        updateSource();
+    } catch (const RequestCancelled &) {
+        // back to the index only, the partly parsed document must not be used
+        unload();
+        diskState = indexedState;
+        throw;
+    }
+}
 
-    std::vector<Location> locations;
+const DialectManager *DialectedWooWooDocument::getDialect() const {
+    return dialect ? dialect.get() : DialectManager::getInstance();
+}
 
-    // need to search for possible references in all meta block and environments
-    // this is done on-the-fly and thus take some time, as this operation should not occure very often
+void DialectedWooWooDocument::setDialect(std::shared_ptr<const DialectManager> newDialect) {
+    dialect = std::move(newDialect);
+    ++dialectChanges;
+    if (materialized) {
+        index();
+    } else {
+        materialize();
+    }
+}
 
-    // SEARCH FOR REFERENCES FROM META-BLOCKS (example --> "ref: chapter-01")
-    for (MetaContext *mx: metaBlocks) {
-        TSQueryCursor *wooCursor = ts_query_cursor_new();
-        ts_query_cursor_exec(wooCursor, fieldQuery, ts_tree_root_node(mx->tree));
+void DialectedWooWooDocument::publish(DialectedWooWooDocument &newVersion) {
+    swapVersion(newVersion);
+    std::swap(documentIndex, newVersion.documentIndex);
+    std::swap(outline, newVersion.outline);
+}
 
-        TSQueryMatch match;
-        while (ts_query_cursor_next_match(wooCursor, &match)) {
-            TSNode valueNode;
-            bool correctKey = false;
-            bool correctValue = false;
-            for (uint32_t i = 0; i < match.capture_count; ++i) {
-                uint32_t capture_index = match.captures[i].index;
-                TSNode capturedNode = match.captures[i].node;
-
-                uint32_t valueCaptureName;
-                const char *valueCaptureNameChars = ts_query_capture_name_for_id(
-                        fieldQuery, capture_index, &valueCaptureName);
-                std::string valueCaptureNameStr(valueCaptureNameChars, valueCaptureName);
-
-                if (valueCaptureNameStr == "value") {
-                    if (getMetaNodeText(mx, capturedNode) == referenceValue) {
-                        // the field value is what we want
-                        correctValue = true;
-                    } else {
-                        break;
-                    }
-                    valueNode = capturedNode;
-                } else if (valueCaptureNameStr == "key") {
-                    auto metaFieldKey = getMetaNodeText(mx, capturedNode);
+const DocumentIndex &DialectedWooWooDocument::getIndex() const {
+    return documentIndex;
+}
 
-                    for (const Reference &ref: DialectManager::getInstance()->getPossibleReferencesByTypeName(metaFieldKey)) {
-                        if (ref.metaKey == reference.metaKey) {
-                            correctKey = true;
-                        }
-                    }
+const std::vector<OutlineNode> &DialectedWooWooDocument::getOutline() const {
+    return outline;
+}
 
-                }
-            }
-            if (!correctKey || !correctValue) continue;
-            auto s = ts_node_start_point(valueNode);
-            auto e = ts_node_end_point(valueNode);
-            Location l = {utils::pathToUri(documentPath), Range{{s.row + mx->lineOffset, s.column},
-                                                                {e.row + mx->lineOffset, e.column}}};
-            locations.emplace_back(l);
+DocumentMemoryUsage DialectedWooWooDocument::measureMemory() const {
+    DocumentMemoryUsage usage = WooWooDocument::measureMemory();
+    usage.index = memory::heapBytes(documentIndex.referenceSites) + memory::heapBytes(documentIndex.definitions) +
+                  memory::heapBytes(documentIndex.definitionSites) +
+                  memory::heapBytes(documentIndex.referencableValues) + memory::heapBytes(documentIndex.metaBlocks) +
+                  memory::heapBytes(documentIndex.commentLines);
+    usage.index += documentIndex.includes.capacity() * sizeof(DocumentIndex::Include);
+    for (const DocumentIndex::Include &include: documentIndex.includes) {
+        usage.index += memory::heapBytes(include.target) + memory::heapBytes(include.text);
+    }
+    usage.index += outline.capacity() * sizeof(OutlineNode);
+    for (const OutlineNode &node: outline) {
+        usage.index += memory::heapBytes(node.type) + memory::heapBytes(node.title) + memory::heapBytes(node.label);
+    }
+    return usage;
+}
 
-        }
-        ts_query_cursor_delete(wooCursor);
+void DialectedWooWooDocument::unload() {
+    WooWooDocument::unload();
+    std::vector<OutlineNode>().swap(outline);
+}
 
-    }
+std::vector<Location>
+DialectedWooWooDocument::findLocationsOfReferences(const Reference &reference, const std::string &referenceValue) const {
 
-    // SEARCH FOR REFERENCES FROM SHORT INNER ENVIRONMETS (example --> ".reference:chapter-01")
-    // SEARCH FOR REFERENCES FROM SHORTHANDS (example --> "See Chapter 1"#chapter-01")
+    std::vector<Location> locations;
+
+    auto byKey = documentIndex.referenceSites.find(SymbolTable::getInstance()->find(reference.metaKey));
+    if (byKey == documentIndex.referenceSites.end()) return locations;
+    auto ranges = byKey->second.find(referenceValue);
+    if (ranges == byKey->second.end()) return locations;
+
+    auto uri = utils::pathToUri(documentPath);
+    for (const Range &range: ranges->second) {
+        locations.emplace_back(uri, range);
+    }
+    return locations;
+}
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
+/**
+ * Finds everything in the document body which could reference something and records it by the metaKeys
+ * it can reference and by its value. Ranges are stored already translated to UTF-16.
+ * Meta block fields are recorded by indexMetaBlocks(). Include statements are collected in the same pass.
+ */
+void DialectedWooWooDocument::indexReferenceSites() {
+    const SymbolTable *symbols = SymbolTable::getInstance();
+    auto addSite = [this, symbols](std::string_view typeName, std::string_view value, Range range) {
+        SymbolId typeId = symbols->find(typeName);
+        if (typeId == SymbolTable::NO_SYMBOL) return;
+        utfMappings->utf8ToUtf16(range);
+        addReferenceSite(typeId, std::string(value), range);
+    };
+
+    // REFERENCES FROM SHORT INNER ENVIRONMETS (example --> ".reference:chapter-01")
+    // REFERENCES FROM SHORTHANDS (example --> "See Chapter 1"#chapter-01")
+
+    QueryCursorPool::Lease cursor = QueryCursorPool::acquire();
     ts_query_cursor_exec(cursor, referencesQuery, ts_tree_root_node(tree));
 
     TSQueryMatch match;
-    std::string nodeType;
-    std::string nodeText;
     while (ts_query_cursor_next_match(cursor, &match)) {
-        if (match.capture_count > 0) {
-            TSNode node = match.captures[0].node;
-
-            nodeType = ts_node_type(node);
-            nodeText = getNodeText(node);
-            
-            if (nodeType == "short_inner_environment"){ 
-                auto value = utils::getChildText(node, "short_inner_environment_body", this);
-                auto valueNodeOpt = utils::getChild(node, "short_inner_environment_body");
-                TSNode valueNode;
-                if(!valueNodeOpt.has_value()){
-                    continue;
-                } else {
-                    valueNode = valueNodeOpt.value();
-                }
-                
-                auto s = ts_node_start_point(valueNode);
-                auto e = ts_node_end_point(valueNode);
-                
-                if (value != referenceValue) continue;
-                auto shortInnerEnvironmentType = utils::getChildText(node, "short_inner_environment_type", this);
-
-                for (const Reference &ref: DialectManager::getInstance()->getPossibleReferencesByTypeName(shortInnerEnvironmentType)) {
-                    if (ref.metaKey == reference.metaKey) {
-                        Location l = {utils::pathToUri(documentPath), Range{{s.row, s.column},
-                                                                            {e.row, e.column}}};
-                        locations.emplace_back(l);
-                        break;
-                    }
-                }
-
-            }
-            if (nodeType == "verbose_inner_environment_hash_end") {
-                auto s = ts_node_start_point(node);
-                auto e = ts_node_end_point(node);
-                if (nodeText != referenceValue) continue;
-
-                for (const Reference &ref: DialectManager::getInstance()->getPossibleReferencesByTypeName("#")) {
-                    if (ref.metaKey == reference.metaKey) {
-                        Location l = {utils::pathToUri(documentPath), Range{{s.row, s.column},
-                                                                            {e.row, e.column}}};
-                        locations.emplace_back(l);
-                        break;
-                    }
-                }
+        if (match.capture_count == 0) continue;
+        TSNode node = match.captures[0].node;
+        TSSymbol symbol = ts_node_symbol(node);
+
+        if (symbol == woowoo::sym_short_inner_environment) {
+            auto valueNode = utils::getChild(node, woowoo::sym_short_inner_environment_body);
+            if (!valueNode.has_value()) continue;
+
+            auto s = ts_node_start_point(valueNode.value());
+            auto e = ts_node_end_point(valueNode.value());
+            addSite(utils::getChildText(node, woowoo::sym_short_inner_environment_type, this),
+                    getNodeText(valueNode.value()), Range{{s.row, s.column}, {e.row, e.column}});
+        } else if (symbol == woowoo::sym_verbose_inner_environment_hash_end ||
+                   symbol == woowoo::sym_verbose_inner_environment_at_end) {
+            auto s = ts_node_start_point(node);
+            auto e = ts_node_end_point(node);
+            addSite(symbol == woowoo::sym_verbose_inner_environment_hash_end ? "#" : "@", getNodeText(node),
+                    Range{{s.row, s.column}, {e.row, e.column}});
+        } else if (symbol == woowoo::sym_filename) {
+            auto s = ts_node_start_point(node);
+            auto e = ts_node_end_point(node);
+            Range range{{s.row, s.column}, {e.row, e.column}};
+            utfMappings->utf8ToUtf16(range);
+            std::string text(getNodeText(node));
+            fs::path target(text);
+            if (!target.is_absolute()) {
+                target = documentPath.parent_path() / target;
             }
-            if (nodeType == "verbose_inner_environment_at_end") {
-                auto s = ts_node_start_point(node);
-                auto e = ts_node_end_point(node);
-                if (nodeText != referenceValue) continue;
-
-                for (const Reference &ref: DialectManager::getInstance()->getPossibleReferencesByTypeName("@")) {
-                    if (ref.metaKey == reference.metaKey) {
-                        Location l = {utils::pathToUri(documentPath), Range{{s.row, s.column},
-                                                                            {e.row, e.column}}};
-                        locations.emplace_back(l);
-                        break;
-                    }
-                }
-            }
-
+            documentIndex.includes.push_back(
+                    DocumentIndex::Include{target.lexically_normal().generic_string(), std::move(text), range});
         }
     }
+}
 
-
-    return locations;
-
+void DialectedWooWooDocument::addReferenceSite(SymbolId typeName, const std::string &value, const Range &range) {
+    // a site is listed only once for a metaKey, even if more references share it
+    for (SymbolId metaKey: getDialect()->getReferencedMetaKeysByTypeName(typeName)) {
+        documentIndex.referenceSites[metaKey][value].emplace_back(range);
+    }
 }
 
-// constructs besides metablock fields which could reference something
+// structures of the outline, and blocks (of text) which are only folded
+const std::string DialectedWooWooDocument::outlineQueryString = R"(
+(document_part) @document_part
+(wobject) @wobject
+(classic_outer_environment) @outer_environment
+(fragile_outer_environment) @outer_environment
+(implicit_outer_environment) @outer_environment
+(block) @block
+)";
+
+// constructs besides metablock fields which could reference something, and included files
 const std::string DialectedWooWooDocument::referencesQueryString = R"(
+(filename) @type
 (short_inner_environment) @type
 (verbose_inner_environment_hash_end) @type
 (verbose_inner_environment_at_end) @type
 )";
 
 void DialectedWooWooDocument::updateSource(std::string &source) {
+    uint64_t previousVersion = version;
     WooWooDocument::updateSource(source);
-    prepareQueries();
+    // an unchanged source keeps its index
+    if (version != previousVersion) {
+        index();
+    }
+}
+
+void DialectedWooWooDocument::updateSource(const std::vector<TextEdit> &edits) {
+    uint64_t previousVersion = version;
+    WooWooDocument::updateSource(edits);
+    // the index of the previous version is kept until a pending parse is finished
+    if (version != previousVersion && !isParsePending()) {
+        index();
+    }
+}
+
+bool DialectedWooWooDocument::finishDeferredWork() {
+    if (!WooWooDocument::finishDeferredWork()) return false;
     index();
-}
\ No newline at end of file
+    return true;
+}
@@ -9,39 +9,93 @@
 #include "../dialect/DialectManager.h"
 #include <filesystem>
 #include <optional>
+#include <mutex>
 #include "tree_sitter/api.h"
 #include "../lsp/LSPTypes.h"
+#include "DocumentIndex.h"
+#include "OutlineNode.h"
 
 namespace fs = std::filesystem;
 
 class DialectedWooWooDocument : public WooWooDocument {
 public:
     
-    DialectedWooWooDocument(const fs::path& documentPath1);
+    // the document is indexed by the dialect, the one of the client if it is nullptr
+    explicit DialectedWooWooDocument(const fs::path& documentPath1,
+                                     std::shared_ptr<const DialectManager> dialect = nullptr);
+    // document known only by its index (e.g. from the IndexCache), it is parsed by materialize() when needed
+    DialectedWooWooDocument(const fs::path& documentPath1, DocumentIndex index, const FileState & state,
+                            std::shared_ptr<const DialectManager> dialect = nullptr);
+    // copy to build the next version on, without disturbing the readers of this one
+    DialectedWooWooDocument(const DialectedWooWooDocument & other);
 
     
     ~DialectedWooWooDocument() override;
-    std::vector<std::pair<MetaContext *, TSNode>> getReferencablesBy(const std::string& referencingTypeName);
+    // values (e.g. labels) of this document which can be referenced by the given type
+    [[nodiscard]] std::span<const std::string> getReferencableValuesBy(std::string_view referencingTypeName) const;
+    using WooWooDocument::updateSource;
     void updateSource(std::string &source) override;
+    void updateSource(const std::vector<TextEdit> &edits) override;
+    // indexes the new version once the deferred parse and meta blocks are done
+    bool finishDeferredWork() override;
 
-    std::optional<std::pair<MetaContext *, TSNode>> findReferencable(const std::vector<Reference> & references, const std::string & referenceValue);
+    // reads and parses the document if only its index is known
+    void materialize();
+    // the dialect the document is indexed by
+    [[nodiscard]] const DialectManager * getDialect() const;
+    // indexes the document by another dialect, a document known only by its index is materialized for it
+    void setDialect(std::shared_ptr<const DialectManager> newDialect);
+    // how many times setDialect indexed the document again, the text (and the version) stays the same
+    uint64_t dialectChanges = 0;
+    // makes the version built on a copy of this document the current one, the copy gets the old version
+    void publish(DialectedWooWooDocument & newVersion);
+
+    // range (UTF-16 based) of the value defined as the first matching reference
+    std::optional<Range> findDefinition(std::span<const Reference> references, const std::string & referenceValue) const;
     
-    std::vector<Location> findLocationsOfReferences(const Reference & reference, const std::string & referenceValue);
+    // locations (UTF-16 based) of everything in this document referencing the value through the reference metaKey
+    std::vector<Location> findLocationsOfReferences(const Reference & reference, const std::string & referenceValue) const;
+
+    [[nodiscard]] const DocumentIndex & getIndex() const;
+    // structures and blocks of the current version in document order, empty if the document is not parsed
+    [[nodiscard]] const std::vector<OutlineNode> & getOutline() const;
+    // the index is counted with the outline, it is kept also while the document is not materialized
+    [[nodiscard]] DocumentMemoryUsage measureMemory() const override;
     
 
+protected:
+    void unload() override;
+
 private:
 
     void index();
 
-    void prepareQueries();
-    TSQuery * fieldQuery;
+    // the queries and their capture ids are the same for all documents, they are resolved only once
+    static void prepareQueries();
+    static std::once_flag prepareQueriesFlag;
+    static const TSQuery * fieldQuery;
+    static uint32_t fieldKeyCaptureId;
+    static uint32_t fieldValueCaptureId;
     const static std::string referencesQueryString;
-    TSQuery * referencesQuery;
-    // given a typeName, get all nodes that can be referenced by that
-    std::unordered_map<std::string, std::vector<std::pair<MetaContext *, TSNode>> > referencablesByNode;
-    
-    // given Reference and value (of a metablock field), store the node and MetaContext (this is what is being referenced, e.g. label value)
-    std::unordered_map<Reference, std::unordered_map<std::string, std::pair<MetaContext *, TSNode>>> referencableNodes;
+    static const TSQuery * referencesQuery;
+    const static std::string outlineQueryString;
+    static const TSQuery * outlineQuery;
+    static uint32_t outlineDocumentPartCaptureId;
+    static uint32_t outlineWobjectCaptureId;
+    static uint32_t outlineOuterEnvironmentCaptureId;
+
+    // nullptr for the dialect of the client (DialectManager::getInstance())
+    std::shared_ptr<const DialectManager> dialect;
+    DocumentIndex documentIndex;
+    std::vector<OutlineNode> outline;
+
+    // labels are set to the first value each meta block defines
+    void indexMetaBlocks(std::vector<std::string> & metaBlockLabels);
+    void indexReferenceSites();
+    void addReferenceSite(SymbolId typeName, const std::string & value, const Range & range);
+    void indexLayout();
+    void indexOutline(std::vector<std::string> & metaBlockLabels);
+    [[nodiscard]] Range nodeRange(TSNode node) const;
 };
 
 #endif 
@@ -0,0 +1,49 @@
+#ifndef WUFF_DOCUMENTINDEX_H
+#define WUFF_DOCUMENTINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../dialect/Reference.h"
+#include "../lsp/LSPTypes.h"
+
+/**
+ * Everything other documents need to know about a document, as plain data (no syntax tree nodes),
+ * so that it can be kept without the parsed document and stored in the IndexCache.
+ * All ranges are UTF-16 based. MetaKeys, type and structure names are interned (see SymbolTable).
+ */
+struct DocumentIndex {
+    // an include statement (e.g. ".include chapters/intro.woo")
+    struct Include {
+        // the included file, absolute and lexically normal, resolved against the folder of the document
+        std::string target;
+        // the path as written
+        std::string text;
+        Range range;
+    };
+
+    struct MetaBlockSpan {
+        uint32_t lineOffset;
+        uint32_t byteOffset;
+        uint32_t byteLength;
+    };
+
+    // metaKey -> value -> ranges of everything referencing the value (e.g. ".reference:chapter-01")
+    std::unordered_map<SymbolId, std::unordered_map<std::string, std::vector<Range>>> referenceSites;
+    // reference -> value -> range of the meta field value defining it (e.g. "label: chapter-01")
+    std::unordered_map<ReferenceKey, std::unordered_map<std::string, Range>> definitions;
+    // metaKey -> value -> ranges of all meta field values defining it, a value with more of them is a duplicate
+    std::unordered_map<SymbolId, std::unordered_map<std::string, std::vector<Range>>> definitionSites;
+    // referencing type name -> values which can be referenced by it, in document order
+    std::unordered_map<SymbolId, std::vector<std::string>> referencableValues;
+
+    std::vector<Include> includes;
+
+    std::vector<MetaBlockSpan> metaBlocks;
+    std::vector<uint32_t> commentLines;
+    // whether the syntax tree has errors, a document without them is checked by its index alone (see Linter::check)
+    bool syntaxErrors = false;
+};
+
+#endif //WUFF_DOCUMENTINDEX_H
@@ -0,0 +1,82 @@
+#include "DocumentLru.h"
+#include <iterator>
+#include "DialectedWooWooDocument.h"
+
+DocumentLru::DocumentLru(size_t memoryBudget) : memoryBudget(memoryBudget) {}
+
+void DocumentLru::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    evict();
+}
+
+void DocumentLru::touch(DialectedWooWooDocument *document) {
+    if (!document) return;
+    auto now = std::chrono::steady_clock::now();
+    size_t usage = document->memoryUsage();
+    auto position = positions.find(document);
+    if (position != positions.end()) {
+        order.splice(order.begin(), order, position->second.entry);
+        position->second.lastUsed = now;
+        totalUsage = totalUsage - position->second.usage + usage;
+        position->second.usage = usage;
+    } else {
+        order.push_front(document);
+        positions[document] = Position{order.begin(), now, usage};
+        totalUsage += usage;
+    }
+    evict();
+}
+
+void DocumentLru::forget(const DialectedWooWooDocument *document) {
+    auto position = positions.find(document);
+    if (position == positions.end()) return;
+    remove(position->second.entry);
+}
+
+size_t DocumentLru::evictIdle(std::chrono::steady_clock::time_point usedBefore,
+                              const std::function<bool(const DialectedWooWooDocument *)> &keep) {
+    size_t evicted = 0;
+    // the least recently used ones are at the end, the walk stops at the first one used since
+    for (auto it = order.end(); it != order.begin();) {
+        --it;
+        DialectedWooWooDocument *document = *it;
+        if (positions[document].lastUsed >= usedBefore) break;
+        if (keep(document)) continue;
+        bool dematerialized = document->dematerialize();
+        if (dematerialized || !document->isMaterialized()) {
+            it = order.erase(it);
+            totalUsage -= positions[document].usage;
+            positions.erase(document);
+            evicted += dematerialized;
+        }
+    }
+    return evicted;
+}
+
+/**
+ * Dematerializes the least recently used documents until the usage fits the budget, starting from the end
+ * of the list: a touch within the budget costs nothing more than the update of the total.
+ */
+void DocumentLru::evict() {
+    if (memoryBudget == 0) return;
+
+    auto it = order.end();
+    size_t remaining = order.size();
+    while (totalUsage > memoryBudget && remaining > MIN_RESIDENT) {
+        --it;
+        --remaining;
+        DialectedWooWooDocument *document = *it;
+        if (document->dematerialize() || !document->isMaterialized()) {
+            auto next = std::next(it);
+            remove(it);
+            it = next;
+        }
+    }
+}
+
+void DocumentLru::remove(std::list<DialectedWooWooDocument *>::iterator entry) {
+    auto position = positions.find(*entry);
+    totalUsage -= position->second.usage;
+    positions.erase(position);
+    order.erase(entry);
+}
@@ -0,0 +1,58 @@
+#ifndef WUFF_DOCUMENTLRU_H
+#define WUFF_DOCUMENTLRU_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+class DialectedWooWooDocument;
+
+/**
+ * Keeps the parsed form (source and syntax trees) only of the recently used documents.
+ * Once the documents take more than the memory budget, the least recently used ones are
+ * dematerialized, which leaves them with their index only. Documents changed in memory
+ * cannot be read again from the disk, they stay parsed even over the budget.
+ * Documents not used for a while can be dematerialized regardless of the budget (see evictIdle).
+ */
+class DocumentLru {
+public:
+    static const size_t DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024;
+
+    explicit DocumentLru(size_t memoryBudget = DEFAULT_MEMORY_BUDGET);
+
+    // 0 means no limit
+    void setMemoryBudget(size_t bytes);
+    // marks the (materialized) document as the most recently used one, may evict other documents
+    void touch(DialectedWooWooDocument *document);
+    // has to be called before the document is destroyed
+    void forget(const DialectedWooWooDocument *document);
+    // dematerializes the documents last used before the time, except the kept ones; returns how many
+    size_t evictIdle(std::chrono::steady_clock::time_point usedBefore,
+                     const std::function<bool(const DialectedWooWooDocument *)> &keep);
+
+private:
+    // the most recently used documents are never evicted, a request may be working with them
+    static const size_t MIN_RESIDENT = 2;
+
+    struct Position {
+        std::list<DialectedWooWooDocument *>::iterator entry;
+        std::chrono::steady_clock::time_point lastUsed;
+        // memory usage of the document when it was last used
+        size_t usage;
+    };
+
+    size_t memoryBudget;
+    // sum of the usages of the documents in the list, kept up to date instead of summing them on every touch
+    size_t totalUsage = 0;
+    // most recently used first
+    std::list<DialectedWooWooDocument *> order;
+    std::unordered_map<const DialectedWooWooDocument *, Position> positions;
+
+    void evict();
+    void remove(std::list<DialectedWooWooDocument *>::iterator entry);
+};
+
+
+#endif //WUFF_DOCUMENTLRU_H
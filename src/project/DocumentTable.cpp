@@ -0,0 +1,97 @@
+#include "DocumentTable.h"
+#include "DialectedWooWooDocument.h"
+#include "../utils/utils.h"
+
+DocumentId DocumentTable::add(DialectedWooWooDocument *document) {
+    auto known = idsByDocument.find(document);
+    if (known != idsByDocument.end()) return known->second;
+
+    auto id = static_cast<DocumentId>(entries.size());
+    std::string path = document->documentPath.generic_string();
+    auto replaced = idsByPath.find(path);
+    if (replaced != idsByPath.end()) {
+        remove(entries[replaced->second].document);
+    }
+    entries.push_back(Entry{document, path, {}});
+    idsByPath[path] = id;
+    idsByDocument[document] = id;
+    return id;
+}
+
+void DocumentTable::remove(const DialectedWooWooDocument *document) {
+    auto known = idsByDocument.find(document);
+    if (known == idsByDocument.end()) return;
+
+    Entry &entry = entries[known->second];
+    forgetUris(entry);
+    idsByPath.erase(entry.path);
+    entry.document = nullptr;
+    entry.path.clear();
+    idsByDocument.erase(known);
+}
+
+void DocumentTable::rename(const DialectedWooWooDocument *document, const std::string &oldPath) {
+    auto known = idsByDocument.find(document);
+    if (known == idsByDocument.end()) return;
+
+    Entry &entry = entries[known->second];
+    forgetUris(entry);
+    auto byOldPath = idsByPath.find(oldPath);
+    if (byOldPath != idsByPath.end() && byOldPath->second == known->second) {
+        idsByPath.erase(byOldPath);
+    }
+    entry.path = document->documentPath.generic_string();
+    idsByPath[entry.path] = known->second;
+}
+
+void DocumentTable::clear() {
+    entries.clear();
+    idsByPath.clear();
+    idsByUri.clear();
+    idsByDocument.clear();
+}
+
+DialectedWooWooDocument *DocumentTable::get(DocumentId id) const {
+    if (id >= entries.size()) return nullptr;
+    return entries[id].document;
+}
+
+DialectedWooWooDocument *DocumentTable::findByPath(const std::string &path) const {
+    auto id = idsByPath.find(path);
+    if (id == idsByPath.end()) return nullptr;
+    return entries[id->second].document;
+}
+
+DialectedWooWooDocument *DocumentTable::findByUri(const std::string &uri) {
+    auto id = idsByUri.find(uri);
+    if (id != idsByUri.end()) {
+        return entries[id->second].document;
+    }
+
+    auto byPath = idsByPath.find(utils::uriToPathString(uri));
+    if (byPath == idsByPath.end()) return nullptr;
+    idsByUri[uri] = byPath->second;
+    entries[byPath->second].uris.emplace_back(uri);
+    return entries[byPath->second].document;
+}
+
+DocumentId DocumentTable::idOf(const DialectedWooWooDocument *document) const {
+    auto id = idsByDocument.find(document);
+    if (id == idsByDocument.end()) return NO_DOCUMENT;
+    return id->second;
+}
+
+void DocumentTable::forgetUris(Entry &entry) {
+    for (const std::string &uri: entry.uris) {
+        idsByUri.erase(uri);
+    }
+    entry.uris.clear();
+}
+
+size_t DocumentTable::memoryUsage() const {
+    size_t bytes = entries.capacity() * sizeof(Entry);
+    for (const Entry &entry: entries) {
+        bytes += memory::heapBytes(entry.path) + memory::heapBytes(entry.uris);
+    }
+    return bytes + memory::heapBytes(idsByPath) + memory::heapBytes(idsByUri) + memory::heapBytes(idsByDocument);
+}
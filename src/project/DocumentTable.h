@@ -0,0 +1,55 @@
+#ifndef WUFF_DOCUMENTTABLE_H
+#define WUFF_DOCUMENTTABLE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class DialectedWooWooDocument;
+
+using DocumentId = uint32_t;
+
+/**
+ * All documents of the analyzer by a stable integer id, by path and by the URIs the client used for them.
+ * Ids are never reused, so an id of a deleted document does not resolve to another document.
+ * URIs are interned as they come, a URI is decoded only the first time it is seen.
+ */
+class DocumentTable {
+public:
+    static const DocumentId NO_DOCUMENT = UINT32_MAX;
+
+    // the id of the document, it is added if it is not in the table yet
+    DocumentId add(DialectedWooWooDocument *document);
+    void remove(const DialectedWooWooDocument *document);
+    // has to be called after the path of the document changes
+    void rename(const DialectedWooWooDocument *document, const std::string &oldPath);
+    void clear();
+
+    [[nodiscard]] DialectedWooWooDocument *get(DocumentId id) const;
+    [[nodiscard]] DialectedWooWooDocument *findByPath(const std::string &path) const;
+    DialectedWooWooDocument *findByUri(const std::string &uri);
+    [[nodiscard]] DocumentId idOf(const DialectedWooWooDocument *document) const;
+
+    // estimated heap bytes of the table
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    struct Entry {
+        DialectedWooWooDocument *document;
+        std::string path;
+        // URIs interned for this document, removed together with it
+        std::vector<std::string> uris;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, DocumentId> idsByPath;
+    std::unordered_map<std::string, DocumentId> idsByUri;
+    std::unordered_map<const DialectedWooWooDocument *, DocumentId> idsByDocument;
+
+    void forgetUris(Entry &entry);
+};
+
+
+#endif //WUFF_DOCUMENTTABLE_H
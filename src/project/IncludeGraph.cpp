@@ -0,0 +1,36 @@
+#include "IncludeGraph.h"
+#include "DialectedWooWooDocument.h"
+
+void IncludeGraph::indexDocument(DialectedWooWooDocument *document) {
+    removeDocument(document);
+    std::vector<std::string> &targets = targetsByDocument[document];
+    for (const DocumentIndex::Include &include: document->getIndex().includes) {
+        if (includedBy[include.target].insert(document).second) {
+            targets.push_back(include.target);
+        }
+    }
+}
+
+void IncludeGraph::removeDocument(const DialectedWooWooDocument *document) {
+    auto targets = targetsByDocument.find(document);
+    if (targets == targetsByDocument.end()) return;
+    for (const std::string &target: targets->second) {
+        auto including = includedBy.find(target);
+        if (including == includedBy.end()) continue;
+        including->second.erase(const_cast<DialectedWooWooDocument *>(document));
+        if (including->second.empty()) {
+            includedBy.erase(including);
+        }
+    }
+    targetsByDocument.erase(targets);
+}
+
+const std::set<DialectedWooWooDocument *> *IncludeGraph::getIncluding(const std::string &path) const {
+    auto including = includedBy.find(path);
+    if (including == includedBy.end()) return nullptr;
+    return &including->second;
+}
+
+size_t IncludeGraph::memoryUsage() const {
+    return memory::heapBytes(includedBy) + memory::heapBytes(targetsByDocument);
+}
@@ -0,0 +1,35 @@
+#ifndef WUFF_INCLUDEGRAPH_H
+#define WUFF_INCLUDEGRAPH_H
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class DialectedWooWooDocument;
+
+/**
+ * Which documents of a project include which files. The edges from a document are its DocumentIndex::includes
+ * (resolved when the document is indexed), the graph keeps the reverse edges, by the path of the included file.
+ * The included file does not have to be a known document (or exist at all).
+ */
+class IncludeGraph {
+public:
+    // replaces everything previously indexed for the document
+    void indexDocument(DialectedWooWooDocument *document);
+    void removeDocument(const DialectedWooWooDocument *document);
+
+    // documents including the file (by its absolute, lexically normal path), nullptr if there are none
+    [[nodiscard]] const std::set<DialectedWooWooDocument *> *getIncluding(const std::string &path) const;
+
+    // estimated heap bytes of the graph
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    std::unordered_map<std::string, std::set<DialectedWooWooDocument *>> includedBy;
+    // the files each document is registered as including, to remove it without its (possibly changed) index
+    std::unordered_map<const DialectedWooWooDocument *, std::vector<std::string>> targetsByDocument;
+};
+
+
+#endif //WUFF_INCLUDEGRAPH_H
@@ -0,0 +1,316 @@
+#include "IndexCache.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "DialectedWooWooDocument.h"
+#include "../utils/utils.h"
+#include "../utils/BinaryStream.h"
+
+#ifndef WUFF_VERSION
+#define WUFF_VERSION "dev"
+#endif
+
+namespace {
+
+    const char MAGIC[8] = {'W', 'U', 'F', 'F', 'I', 'D', 'X', '\0'};
+    // has to be increased with every change of the layout of the cache file
+    const uint32_t FORMAT_VERSION = 6;
+
+    // symbols are valid only within a process, the cache stores their names
+    void writeSymbol(BinaryWriter &w, SymbolId value) {
+        w.str(SymbolTable::getInstance()->name(value));
+    }
+
+    SymbolId readSymbol(BinaryReader &r) {
+        return SymbolTable::getInstance()->intern(r.str());
+    }
+
+    void writeRange(BinaryWriter &w, const Range &value) {
+        w.u32(value.start.line);
+        w.u32(value.start.character);
+        w.u32(value.end.line);
+        w.u32(value.end.character);
+    }
+
+    void writeReference(BinaryWriter &w, const ReferenceKey &value) {
+        writeSymbol(w, value.metaKey);
+        writeSymbol(w, value.structureType);
+        writeSymbol(w, value.structureName);
+    }
+
+    Range readRange(BinaryReader &r) {
+        Range value{};
+        value.start.line = r.u32();
+        value.start.character = r.u32();
+        value.end.line = r.u32();
+        value.end.character = r.u32();
+        return value;
+    }
+
+    ReferenceKey readReference(BinaryReader &r) {
+        ReferenceKey value;
+        value.metaKey = readSymbol(r);
+        value.structureType = readSymbol(r);
+        value.structureName = readSymbol(r);
+        return value;
+    }
+
+    // metaKey -> value -> ranges
+    void writeSites(BinaryWriter &w,
+                    const std::unordered_map<SymbolId, std::unordered_map<std::string, std::vector<Range>>> &sites) {
+        w.u32(static_cast<uint32_t>(sites.size()));
+        for (const auto &byKey: sites) {
+            writeSymbol(w, byKey.first);
+            w.u32(static_cast<uint32_t>(byKey.second.size()));
+            for (const auto &byValue: byKey.second) {
+                w.str(byValue.first);
+                w.u32(static_cast<uint32_t>(byValue.second.size()));
+                for (const Range &range: byValue.second) {
+                    writeRange(w, range);
+                }
+            }
+        }
+    }
+
+    void readSites(BinaryReader &r,
+                   std::unordered_map<SymbolId, std::unordered_map<std::string, std::vector<Range>>> &sites) {
+        const size_t rangeSize = 4 * sizeof(uint32_t);
+        for (uint32_t k = r.count(sizeof(uint32_t)); k > 0 && r.ok; --k) {
+            auto &byKey = sites[readSymbol(r)];
+            for (uint32_t v = r.count(sizeof(uint32_t)); v > 0 && r.ok; --v) {
+                auto &ranges = byKey[r.str()];
+                for (uint32_t i = r.count(rangeSize); i > 0 && r.ok; --i) {
+                    ranges.emplace_back(readRange(r));
+                }
+            }
+        }
+    }
+
+    void writeIndex(BinaryWriter &w, const DocumentIndex &index) {
+        writeSites(w, index.referenceSites);
+
+        w.u32(static_cast<uint32_t>(index.definitions.size()));
+        for (const auto &byReference: index.definitions) {
+            writeReference(w, byReference.first);
+            w.u32(static_cast<uint32_t>(byReference.second.size()));
+            for (const auto &byValue: byReference.second) {
+                w.str(byValue.first);
+                writeRange(w, byValue.second);
+            }
+        }
+        writeSites(w, index.definitionSites);
+
+        w.u32(static_cast<uint32_t>(index.referencableValues.size()));
+        for (const auto &byType: index.referencableValues) {
+            writeSymbol(w, byType.first);
+            w.u32(static_cast<uint32_t>(byType.second.size()));
+            for (const std::string &value: byType.second) {
+                w.str(value);
+            }
+        }
+
+        w.u32(static_cast<uint32_t>(index.includes.size()));
+        for (const auto &include: index.includes) {
+            w.str(include.target);
+            w.str(include.text);
+            writeRange(w, include.range);
+        }
+
+        w.u32(static_cast<uint32_t>(index.metaBlocks.size()));
+        for (const auto &span: index.metaBlocks) {
+            w.u32(span.lineOffset);
+            w.u32(span.byteOffset);
+            w.u32(span.byteLength);
+        }
+
+        w.u32(static_cast<uint32_t>(index.commentLines.size()));
+        for (uint32_t line: index.commentLines) {
+            w.u32(line);
+        }
+
+        w.u32(index.syntaxErrors ? 1 : 0);
+    }
+
+    DocumentIndex readIndex(BinaryReader &r) {
+        const size_t rangeSize = 4 * sizeof(uint32_t);
+        DocumentIndex index;
+
+        readSites(r, index.referenceSites);
+
+        for (uint32_t k = r.count(3 * sizeof(uint32_t)); k > 0 && r.ok; --k) {
+            auto &byReference = index.definitions[readReference(r)];
+            for (uint32_t v = r.count(sizeof(uint32_t) + rangeSize); v > 0 && r.ok; --v) {
+                std::string value = r.str();
+                byReference[value] = readRange(r);
+            }
+        }
+        readSites(r, index.definitionSites);
+
+        for (uint32_t k = r.count(sizeof(uint32_t)); k > 0 && r.ok; --k) {
+            auto &values = index.referencableValues[readSymbol(r)];
+            for (uint32_t v = r.count(sizeof(uint32_t)); v > 0 && r.ok; --v) {
+                values.emplace_back(r.str());
+            }
+        }
+
+        for (uint32_t i = r.count(2 * sizeof(uint32_t) + rangeSize); i > 0 && r.ok; --i) {
+            DocumentIndex::Include include;
+            include.target = r.str();
+            include.text = r.str();
+            include.range = readRange(r);
+            index.includes.push_back(std::move(include));
+        }
+
+        for (uint32_t i = r.count(3 * sizeof(uint32_t)); i > 0 && r.ok; --i) {
+            DocumentIndex::MetaBlockSpan span{};
+            span.lineOffset = r.u32();
+            span.byteOffset = r.u32();
+            span.byteLength = r.u32();
+            index.metaBlocks.push_back(span);
+        }
+
+        for (uint32_t i = r.count(sizeof(uint32_t)); i > 0 && r.ok; --i) {
+            index.commentLines.push_back(r.u32());
+        }
+
+        index.syntaxErrors = r.u32() != 0;
+
+        return index;
+    }
+}
+
+
+IndexCache::IndexCache(fs::path cacheFilePath) : cacheFilePath(std::move(cacheFilePath)) {}
+
+fs::path IndexCache::cacheFilePathFor(const fs::path &cacheDirectory, const fs::path &workspaceRoot) {
+    std::stringstream name;
+    name << "workspace-" << std::hex << utils::hashContent(workspaceRoot.lexically_normal().generic_string())
+         << ".idx";
+    return cacheDirectory / name.str();
+}
+
+/**
+ * Identifies everything the indexes depend on besides the documents themselves:
+ * the version of wuff and the layout of the cache file. The dialect is kept by every entry.
+ */
+std::string IndexCache::versionTag() {
+    std::stringstream tag;
+    tag << WUFF_VERSION << "/" << FORMAT_VERSION;
+    return tag.str();
+}
+
+bool IndexCache::load() {
+    entries.clear();
+    {
+        std::lock_guard<std::mutex> lock(changedMutex);
+        changedModificationTimes.clear();
+    }
+
+    auto data = utils::readFile(cacheFilePath);
+    if (!data.has_value()) return false;
+
+    BinaryReader r(data.value());
+    if (!r.expect(MAGIC, sizeof(MAGIC)) || r.str() != versionTag()) {
+        return false;
+    }
+
+    std::unordered_map<std::string, Entry> loaded;
+    for (uint32_t i = r.count(sizeof(uint32_t) + 4 * sizeof(uint64_t)); i > 0 && r.ok; --i) {
+        std::string path = r.str();
+        Entry entry;
+        entry.state.modificationTime = static_cast<int64_t>(r.u64());
+        entry.state.size = r.u64();
+        entry.state.contentHash = r.u64();
+        entry.dialectHash = r.u64();
+        entry.index = readIndex(r);
+        loaded[path] = std::move(entry);
+    }
+
+    if (!r.ok || !r.atEnd()) {
+        std::cerr << "Ignoring corrupted index cache: " << cacheFilePath << std::endl;
+        return false;
+    }
+    entries = std::move(loaded);
+    return true;
+}
+
+bool IndexCache::save() const {
+    std::error_code ec;
+    fs::create_directories(cacheFilePath.parent_path(), ec);
+
+    fs::path temporaryPath = cacheFilePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        BinaryWriter w(out);
+        w.bytes(MAGIC, sizeof(MAGIC));
+        w.str(versionTag());
+        w.u32(static_cast<uint32_t>(entries.size()));
+        for (const auto &entry: entries) {
+            w.str(entry.first);
+            w.u64(static_cast<uint64_t>(entry.second.state.modificationTime));
+            w.u64(entry.second.state.size);
+            w.u64(entry.second.state.contentHash);
+            w.u64(entry.second.dialectHash);
+            writeIndex(w, entry.second.index);
+        }
+        if (!out) return false;
+    }
+
+    fs::rename(temporaryPath, cacheFilePath, ec);
+    if (ec) {
+        fs::remove(temporaryPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::optional<IndexCache::Entry> IndexCache::lookup(const fs::path &documentPath, uint64_t dialectHash) const {
+    std::string path = documentPath.generic_string();
+    auto entry = entries.find(path);
+    if (entry == entries.end() || entry->second.dialectHash != dialectHash) return std::nullopt;
+
+    std::error_code ec;
+    auto size = fs::file_size(documentPath, ec);
+    if (ec || size != entry->second.state.size) return std::nullopt;
+    auto modificationTime = fs::last_write_time(documentPath, ec);
+    if (ec) return std::nullopt;
+    auto modificationCount = static_cast<int64_t>(modificationTime.time_since_epoch().count());
+    if (modificationCount == entry->second.state.modificationTime) {
+        return entry->second;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(changedMutex);
+        auto changed = changedModificationTimes.find(path);
+        if (changed != changedModificationTimes.end() && changed->second == modificationCount) return std::nullopt;
+    }
+
+    // touched, but possibly not changed (e.g. a fresh checkout), compare the content
+    auto content = utils::readFile(documentPath);
+    if (!content.has_value() || utils::hashContent(content.value()) != entry->second.state.contentHash) {
+        std::lock_guard<std::mutex> lock(changedMutex);
+        changedModificationTimes[path] = modificationCount;
+        return std::nullopt;
+    }
+    Entry touched = entry->second;
+    touched.state.modificationTime = modificationCount;
+    return touched;
+}
+
+void IndexCache::store(const std::vector<DialectedWooWooDocument *> &documents) {
+    entries.clear();
+    {
+        std::lock_guard<std::mutex> lock(changedMutex);
+        changedModificationTimes.clear();
+    }
+    for (DialectedWooWooDocument *document: documents) {
+        // documents changed in memory would have to be indexed again from the disk anyway
+        if (!document->diskState.has_value()) continue;
+        entries[document->documentPath.generic_string()] = Entry{document->diskState.value(),
+                                                                 document->getDialect()->dialectHash,
+                                                                 document->getIndex()};
+    }
+}
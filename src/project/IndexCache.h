@@ -0,0 +1,59 @@
+#ifndef WUFF_INDEXCACHE_H
+#define WUFF_INDEXCACHE_H
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DocumentIndex.h"
+#include "WooWooDocument.h"
+
+namespace fs = std::filesystem;
+
+class DialectedWooWooDocument;
+
+/**
+ * Indexes of the documents of one workspace, persisted in a single binary file between sessions.
+ * A cached index is only used while the file on disk is the same as when it was indexed
+ * (same modification time and size, or the same content hash), while the cache was written
+ * by the same version of wuff and for the dialect the document was indexed by.
+ */
+class IndexCache {
+public:
+    struct Entry {
+        FileState state;
+        // DialectManager::dialectHash of the dialect of the index, documents of several projects can differ in it
+        uint64_t dialectHash = 0;
+        DocumentIndex index;
+    };
+
+    explicit IndexCache(fs::path cacheFilePath);
+
+    // the cache file used for the given workspace within the cache directory
+    static fs::path cacheFilePathFor(const fs::path &cacheDirectory, const fs::path &workspaceRoot);
+
+    // reads the cache file, returns false (and keeps the cache empty) if it is missing, stale or corrupted
+    bool load();
+    // writes the cache file atomically (a temporary file is renamed over the old one)
+    bool save() const;
+
+    // the cached index of the document, if the file on disk did not change since it was indexed by the dialect
+    [[nodiscard]] std::optional<Entry> lookup(const fs::path &documentPath, uint64_t dialectHash) const;
+    // replaces the content of the cache by the indexes of the documents which are unchanged on disk
+    void store(const std::vector<DialectedWooWooDocument *> &documents);
+
+private:
+    fs::path cacheFilePath;
+    std::unordered_map<std::string, Entry> entries;
+    // documents whose content was found changed, by the modification time they were compared at,
+    // so that a touched and changed file is not read and hashed again by every lookup
+    mutable std::mutex changedMutex;
+    mutable std::unordered_map<std::string, int64_t> changedModificationTimes;
+
+    static std::string versionTag();
+};
+
+
+#endif //WUFF_INDEXCACHE_H
@@ -0,0 +1,271 @@
+#include "LabelIndex.h"
+#include <algorithm>
+#include <tuple>
+#include <unordered_set>
+#include "DialectedWooWooDocument.h"
+
+void LabelIndex::indexDocument(DialectedWooWooDocument *document) {
+    removeDocument(document);
+
+    // the same field defines the label for every reference matching it, it is listed once
+    std::vector<Label> documentLabels;
+    for (const auto &byReference: document->getIndex().definitions) {
+        for (const auto &byValue: byReference.second) {
+            documentLabels.push_back(Label{byValue.first, byReference.first.metaKey, byValue.second, document});
+        }
+    }
+    auto position = [](const Label &l) {
+        return std::tie(l.value, l.range.start.line, l.range.start.character);
+    };
+    std::sort(documentLabels.begin(), documentLabels.end(),
+              [&position](const Label &a, const Label &b) { return position(a) < position(b); });
+    documentLabels.erase(std::unique(documentLabels.begin(), documentLabels.end(),
+                                     [&position](const Label &a, const Label &b) { return position(a) == position(b); }),
+                         documentLabels.end());
+
+    if (!documentLabels.empty()) {
+        auto &slots = slotsByDocument[document];
+        slots.reserve(documentLabels.size());
+        for (Label &label: documentLabels) {
+            slots.push_back(addLabel(std::move(label)));
+        }
+    }
+
+    const auto &referencableValues = document->getIndex().referencableValues;
+    if (referencableValues.empty()) return;
+    auto &entries = referencableByDocument[document];
+    for (const auto &byType: referencableValues) {
+        ReferencableValues &values = referencableByType[byType.first];
+        for (const std::string &value: byType.second) {
+            auto entry = values.try_emplace(value, 0).first;
+            ++entry->second;
+            entries.emplace_back(byType.first, entry);
+        }
+    }
+}
+
+void LabelIndex::removeDocument(const DialectedWooWooDocument *document) {
+    auto slots = slotsByDocument.find(document);
+    if (slots != slotsByDocument.end()) {
+        for (uint32_t slot: slots->second) {
+            removeLabel(slot);
+        }
+        slotsByDocument.erase(slots);
+    }
+
+    auto entries = referencableByDocument.find(document);
+    if (entries != referencableByDocument.end()) {
+        for (auto &entry: entries->second) {
+            if (--entry.second->second > 0) continue;
+            auto values = referencableByType.find(entry.first);
+            values->second.erase(entry.second);
+            if (values->second.empty()) {
+                referencableByType.erase(values);
+            }
+        }
+        referencableByDocument.erase(entries);
+    }
+}
+
+std::vector<std::string_view> LabelIndex::completions(SymbolId referencingType, std::string_view prefix, size_t limit,
+                                                      bool &incomplete) const {
+    std::vector<std::string_view> values;
+    incomplete = false;
+    auto byType = referencableByType.find(referencingType);
+    if (byType == referencableByType.end()) return values;
+
+    for (auto it = byType->second.lower_bound(prefix); it != byType->second.end() && it->first.starts_with(prefix); ++it) {
+        if (values.size() == limit) {
+            incomplete = true;
+            break;
+        }
+        values.emplace_back(it->first);
+    }
+    return values;
+}
+
+size_t LabelIndex::size() const {
+    return labels.size() - freeSlots.size();
+}
+
+uint32_t LabelIndex::addLabel(Label label) {
+    std::string folded = fold(label.value);
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        labels[slot] = std::move(label);
+    } else {
+        slot = static_cast<uint32_t>(labels.size());
+        labels.emplace_back(std::move(label));
+        foldedValues.emplace_back();
+        signatures.push_back(0);
+    }
+
+    signatures[slot] = signature(folded);
+    forEachTrigram(folded, [this, slot](uint32_t trigram) {
+        auto &postings = byTrigram[trigram];
+        // a trigram repeated within the value is listed once
+        if (postings.empty() || postings.back() != slot) {
+            postings.push_back(slot);
+        }
+    });
+    byValue.emplace(folded, slot);
+    foldedValues[slot] = std::move(folded);
+    return slot;
+}
+
+void LabelIndex::removeLabel(uint32_t slot) {
+    const std::string &folded = foldedValues[slot];
+
+    auto range = byValue.equal_range(folded);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == slot) {
+            byValue.erase(it);
+            break;
+        }
+    }
+    forEachTrigram(folded, [this, slot](uint32_t trigram) {
+        auto postings = byTrigram.find(trigram);
+        if (postings == byTrigram.end()) return;
+        auto &list = postings->second;
+        auto it = std::find(list.begin(), list.end(), slot);
+        if (it == list.end()) return;
+        // the order of the postings does not matter
+        *it = list.back();
+        list.pop_back();
+        if (list.empty()) {
+            byTrigram.erase(postings);
+        }
+    });
+
+    labels[slot] = Label{};
+    foldedValues[slot].clear();
+    signatures[slot] = 0;
+    freeSlots.push_back(slot);
+}
+
+std::vector<LabelIndex::Match> LabelIndex::search(std::string_view query, size_t limit) const {
+    std::vector<Match> matches;
+    if (limit == 0) return matches;
+    std::string folded = fold(query);
+
+    // EXACT and PREFIX, the map is ordered so the exact match comes first
+    for (auto it = byValue.lower_bound(folded); it != byValue.end() && it->first.starts_with(folded); ++it) {
+        if (matches.size() >= limit) return matches;
+        matches.push_back(Match{&labels[it->second], it->first.size() == folded.size() ? EXACT : PREFIX});
+    }
+    if (matches.size() >= limit || folded.empty()) return matches;
+
+    size_t prefixMatches = matches.size();
+    std::unordered_set<uint32_t> found;
+    auto add = [&](uint32_t slot, uint32_t rank) {
+        if (found.insert(slot).second) {
+            matches.push_back(Match{&labels[slot], rank});
+        }
+    };
+
+    // SUBSTRING, candidates are the labels with the rarest trigram of the query
+    if (folded.size() >= 3) {
+        const std::vector<uint32_t> *rarest = nullptr;
+        bool missing = false;
+        forEachTrigram(folded, [&](uint32_t trigram) {
+            auto postings = byTrigram.find(trigram);
+            if (postings == byTrigram.end()) {
+                missing = true;
+            } else if (!rarest || postings->second.size() < rarest->size()) {
+                rarest = &postings->second;
+            }
+        });
+        if (!missing && rarest) {
+            for (uint32_t slot: *rarest) {
+                const std::string &value = foldedValues[slot];
+                if (!value.starts_with(folded) && value.find(folded) != std::string::npos) {
+                    add(slot, SUBSTRING);
+                }
+            }
+        }
+    }
+
+    // FUZZY (and SUBSTRING of queries too short to have a trigram), only if there is still room for them
+    if (matches.size() < limit) {
+        uint64_t querySignature = signature(folded);
+        for (uint32_t slot = 0; slot < signatures.size(); ++slot) {
+            if ((signatures[slot] & querySignature) != querySignature || !labels[slot].document) continue;
+            const std::string &value = foldedValues[slot];
+            if (value.starts_with(folded) || found.count(slot)) continue;
+            if (value.find(folded) != std::string::npos) {
+                add(slot, SUBSTRING);
+            } else if (isSubsequence(folded, value)) {
+                add(slot, FUZZY);
+            }
+        }
+    }
+
+    auto rest = matches.begin() + static_cast<std::ptrdiff_t>(prefixMatches);
+    if (matches.size() > limit) {
+        std::partial_sort(rest, matches.begin() + static_cast<std::ptrdiff_t>(limit), matches.end(), isBetter);
+        matches.resize(limit);
+    } else {
+        std::sort(rest, matches.end(), isBetter);
+    }
+    return matches;
+}
+
+bool LabelIndex::isBetter(const Match &a, const Match &b) {
+    if (a.rank != b.rank) return a.rank < b.rank;
+    if (a.label->value.size() != b.label->value.size()) return a.label->value.size() < b.label->value.size();
+    return a.label->value < b.label->value;
+}
+
+std::string LabelIndex::fold(std::string_view text) {
+    std::string folded(text);
+    for (char &c: folded) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return folded;
+}
+
+uint64_t LabelIndex::signature(std::string_view folded) {
+    // a bit for every letter and digit, the other characters share the remaining bits
+    uint64_t bits = 0;
+    for (char c: folded) {
+        auto byte = static_cast<unsigned char>(c);
+        if (byte >= 'a' && byte <= 'z') {
+            bits |= uint64_t{1} << (byte - 'a');
+        } else if (byte >= '0' && byte <= '9') {
+            bits |= uint64_t{1} << (26 + byte - '0');
+        } else {
+            bits |= uint64_t{1} << (36 + byte % 28);
+        }
+    }
+    return bits;
+}
+
+bool LabelIndex::isSubsequence(std::string_view query, std::string_view folded) {
+    size_t q = 0;
+    for (size_t i = 0; i < folded.size() && q < query.size(); ++i) {
+        if (folded[i] == query[q]) ++q;
+    }
+    return q == query.size();
+}
+
+template<typename F>
+void LabelIndex::forEachTrigram(std::string_view folded, F &&f) {
+    for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+        f(static_cast<uint32_t>(static_cast<unsigned char>(folded[i])) << 16 |
+          static_cast<uint32_t>(static_cast<unsigned char>(folded[i + 1])) << 8 |
+          static_cast<uint32_t>(static_cast<unsigned char>(folded[i + 2])));
+    }
+}
+
+size_t LabelIndex::memoryUsage() const {
+    size_t bytes = labels.capacity() * sizeof(Label);
+    for (const Label &label: labels) {
+        bytes += memory::heapBytes(label.value);
+    }
+    return bytes + memory::heapBytes(foldedValues) + memory::heapBytes(signatures) + memory::heapBytes(freeSlots) +
+           memory::heapBytes(slotsByDocument) + memory::heapBytes(byValue) + memory::heapBytes(byTrigram) +
+           memory::heapBytes(referencableByType) + memory::heapBytes(referencableByDocument);
+}
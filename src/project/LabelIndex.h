@@ -0,0 +1,102 @@
+#ifndef WUFF_LABELINDEX_H
+#define WUFF_LABELINDEX_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../lsp/LSPTypes.h"
+#include "../utils/SymbolTable.h"
+
+class DialectedWooWooDocument;
+
+/**
+ * Every label of a project (a value which can be referenced, e.g. "label: chapter-01"), searchable by a query
+ * as typed into a workspace symbol search.
+ *
+ * Labels are kept case folded in an ordered map (for prefix matches) and in an inverted index of their
+ * trigrams (for substring matches). Fuzzy matches (the query as a subsequence of the label) are found
+ * by a scan of a contiguous array of character signatures, so only labels containing every character
+ * of the query are compared. Documents are indexed again every time they are re-parsed.
+ *
+ * For completion, the distinct values referencable by each referencing type are kept sorted as well.
+ */
+class LabelIndex {
+public:
+    struct Label {
+        std::string value;
+        // metaKey of the field defining the label
+        SymbolId metaKey;
+        // UTF-16 based
+        Range range;
+        // nullptr if the slot is free
+        DialectedWooWooDocument *document;
+    };
+
+    struct Match {
+        const Label *label;
+        // lower is better: exact, prefix, substring and fuzzy matches
+        uint32_t rank;
+    };
+
+    // replaces everything previously indexed for the document
+    void indexDocument(DialectedWooWooDocument *document);
+    void removeDocument(const DialectedWooWooDocument *document);
+
+    // at most limit best matches of the query (case insensitive), best first; an empty query matches everything
+    [[nodiscard]] std::vector<Match> search(std::string_view query, size_t limit) const;
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * Distinct values referencable by the type (e.g. by ".reference:") which start with the prefix, in order.
+     * At most limit values are returned, incomplete is set if there are more of them.
+     * The views are valid until the index changes.
+     */
+    [[nodiscard]] std::vector<std::string_view> completions(SymbolId referencingType, std::string_view prefix,
+                                                            size_t limit, bool &incomplete) const;
+
+    // how matches are ordered, also across indexes
+    static bool isBetter(const Match &a, const Match &b);
+
+    // estimated heap bytes of the index
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t EXACT = 0;
+    static constexpr uint32_t PREFIX = 1;
+    static constexpr uint32_t SUBSTRING = 2;
+    static constexpr uint32_t FUZZY = 3;
+
+    // by slot, a removed label leaves a free slot (reused by the next one)
+    std::vector<Label> labels;
+    std::vector<std::string> foldedValues;
+    std::vector<uint64_t> signatures;
+    std::vector<uint32_t> freeSlots;
+
+    std::unordered_map<const DialectedWooWooDocument *, std::vector<uint32_t>> slotsByDocument;
+    // case folded value -> slot
+    std::multimap<std::string, uint32_t, std::less<>> byValue;
+    // trigram of the case folded value -> slots
+    std::unordered_map<uint32_t, std::vector<uint32_t>> byTrigram;
+
+    // value -> number of documents (and fields) it is referencable from
+    using ReferencableValues = std::map<std::string, uint32_t, std::less<>>;
+    // referencing type -> its values
+    std::unordered_map<SymbolId, ReferencableValues> referencableByType;
+    std::unordered_map<const DialectedWooWooDocument *,
+            std::vector<std::pair<SymbolId, ReferencableValues::iterator>>> referencableByDocument;
+
+    uint32_t addLabel(Label label);
+    void removeLabel(uint32_t slot);
+
+    static std::string fold(std::string_view text);
+    static uint64_t signature(std::string_view folded);
+    static bool isSubsequence(std::string_view query, std::string_view folded);
+    template<typename F>
+    static void forEachTrigram(std::string_view folded, F &&f);
+};
+
+
+#endif //WUFF_LABELINDEX_H
@@ -7,14 +7,52 @@
 #include <utility>
 
 
-MetaContext::MetaContext(TSTree *tree, uint32_t lineOffset, uint32_t byteOffset, std::string parentType,
-                         std::string parentName)
-        : tree(tree), lineOffset(lineOffset), byteOffset(byteOffset), parentType(std::move(parentType)),
-          parentName(std::move(parentName)) // Initializer list
+MetaContext::MetaContext(TSTree *tree, uint32_t lineOffset, uint32_t lineCount, uint32_t byteOffset,
+                         uint32_t byteLength, std::string_view parentType, std::string_view parentName)
+        : tree(tree), lineOffset(lineOffset), lineCount(lineCount), byteOffset(byteOffset),
+          byteLength(byteLength) // Initializer list
 {
-    if (this->parentType.find("outer_environment") != std::string::npos) {
-        this->parentType = "outer_environment";
+    setParent(parentType, parentName);
+}
+
+MetaContext::MetaContext(const MetaContext &other)
+        : tree(other.tree ? ts_tree_copy(other.tree) : nullptr), lineOffset(other.lineOffset),
+          lineCount(other.lineCount), byteOffset(other.byteOffset), byteLength(other.byteLength),
+          edited(other.edited), parentType(other.parentType), parentName(other.parentName) {}
+
+MetaContext::MetaContext(MetaContext &&other) noexcept
+        : tree(other.tree), lineOffset(other.lineOffset), lineCount(other.lineCount), byteOffset(other.byteOffset),
+          byteLength(other.byteLength), edited(other.edited), parentType(other.parentType),
+          parentName(std::move(other.parentName)) {
+    other.tree = nullptr;
+}
+
+MetaContext &MetaContext::operator=(MetaContext &&other) noexcept {
+    if (this != &other) {
+        ts_tree_delete(tree);
+        tree = other.tree;
+        other.tree = nullptr;
+        lineOffset = other.lineOffset;
+        lineCount = other.lineCount;
+        byteOffset = other.byteOffset;
+        byteLength = other.byteLength;
+        edited = other.edited;
+        parentType = other.parentType;
+        parentName = std::move(other.parentName);
     }
+    return *this;
+}
+
+void MetaContext::setParent(std::string_view type, std::string_view name) {
+    if (type.find("outer_environment") != std::string_view::npos) {
+        type = "outer_environment";
+    }
+    parentType = SymbolTable::getInstance()->intern(type);
+    parentName = name;
+}
+
+MetaContext::~MetaContext() {
+    ts_tree_delete(tree);
 }
 
 
@@ -7,19 +7,48 @@
 
 #include <tree_sitter/api.h>
 #include <string>
+#include <string_view>
+#include "../utils/SymbolTable.h"
 
 
+/**
+ * A meta block of a document. Its YAML is parsed as an included range of the whole source, the positions
+ * of the tree are the ones in the document (no offsets to add). The tree is edited along with the source,
+ * a block changed by an edit keeps it until it is parsed again, which makes that parse incremental.
+ */
 class MetaContext {
 public:
-    MetaContext(TSTree *tree, uint32_t lineOffset, uint32_t byteOffset, std::string parentType,
-                std::string parentName);
+    // the tree is nullptr if the YAML of the block is not parsed yet
+    MetaContext(TSTree *tree, uint32_t lineOffset, uint32_t lineCount, uint32_t byteOffset, uint32_t byteLength,
+                std::string_view parentType, std::string_view parentName);
+    // the copy has its own copy of the tree (ts_tree_copy is cheap, the nodes are shared)
+    MetaContext(const MetaContext &other);
+    MetaContext(MetaContext &&other) noexcept;
+    MetaContext &operator=(const MetaContext &) = delete;
+    MetaContext &operator=(MetaContext &&other) noexcept;
+    ~MetaContext();
+
+    // the type is interned, the name is kept as it is in the source
+    void setParent(std::string_view type, std::string_view name);
+
+    // large documents parse the YAML of a block only once it is needed, an edited block is parsed again
+    [[nodiscard]] bool isParsed() const { return tree != nullptr && !edited; }
+    // the line the block ends on
+    [[nodiscard]] uint32_t lastLine() const { return lineOffset + lineCount; }
 
     static const std::string metaFieldQueryString;
     
     TSTree *tree;
     uint32_t lineOffset;
+    // line breaks inside of the block, it does not change when the block is moved
+    uint32_t lineCount;
     uint32_t byteOffset;
-    std::string parentType;
+    uint32_t byteLength;
+    // the tree was edited along with the source but not parsed again
+    bool edited = false;
+    // interned (node types of the grammar), SymbolTable::EMPTY if there is none
+    SymbolId parentType = SymbolTable::EMPTY;
+    // not interned, every partial name typed while editing would stay in the SymbolTable; empty if there is none
     std::string parentName;
 };
 
@@ -0,0 +1,39 @@
+#ifndef WUFF_OUTLINENODE_H
+#define WUFF_OUTLINENODE_H
+
+#include <cstdint>
+#include <string>
+#include "../lsp/LSPTypes.h"
+
+/**
+ * A structure of a document (document part, wobject, outer environment) or a block of text.
+ * The outline of a document is a list of them in document order, built once per version of the document
+ * and shared by the document symbols and the folding ranges. All ranges are UTF-16 based.
+ */
+struct OutlineNode {
+    enum class Kind {
+        DocumentPart,
+        Wobject,
+        OuterEnvironment,
+        Block
+    };
+
+    Kind kind;
+    // e.g. "Chapter" or "Theorem"
+    std::string type;
+    // only document parts have a title
+    std::string title;
+    // value of the first field of the meta block defining something (e.g. "label: chapter-01"), empty if none
+    std::string label;
+    Range range;
+    // of the type of the structure
+    Range selectionRange;
+    uint32_t startByte;
+    uint32_t endByte;
+    // index of the enclosing structure (blocks are not structures), NO_PARENT at the top level
+    uint32_t parent;
+
+    static const uint32_t NO_PARENT = UINT32_MAX;
+};
+
+#endif //WUFF_OUTLINENODE_H
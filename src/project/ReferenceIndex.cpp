@@ -0,0 +1,111 @@
+#include "ReferenceIndex.h"
+#include "DialectedWooWooDocument.h"
+
+void ReferenceIndex::indexDocument(DialectedWooWooDocument *document) {
+    removeDocument(document);
+
+    auto &referencingEntriesOfDocument = referencingEntries[document];
+    for (const auto &byKey: document->getIndex().referenceSites) {
+        for (const auto &byValue: byKey.second) {
+            referencing[byKey.first][byValue.first].insert(document);
+            referencingEntriesOfDocument.emplace_back(byKey.first, byValue.first);
+        }
+    }
+
+    auto &definingEntriesOfDocument = definingEntries[document];
+    for (const auto &byReference: document->getIndex().definitions) {
+        for (const auto &byValue: byReference.second) {
+            defining[byReference.first][byValue.first].insert(document);
+            definingEntriesOfDocument.emplace_back(byReference.first, byValue.first);
+        }
+    }
+
+    auto &definedAtEntriesOfDocument = definedAtEntries[document];
+    for (const auto &byKey: document->getIndex().definitionSites) {
+        for (const auto &byValue: byKey.second) {
+            definedAt[byKey.first][byValue.first][document] = static_cast<uint32_t>(byValue.second.size());
+            definedAtEntriesOfDocument.emplace_back(byKey.first, byValue.first);
+        }
+    }
+}
+
+void ReferenceIndex::removeDocument(const DialectedWooWooDocument *document) {
+    auto referencingIt = referencingEntries.find(document);
+    if (referencingIt != referencingEntries.end()) {
+        for (const auto &entry: referencingIt->second) {
+            auto &byValue = referencing[entry.first];
+            auto documents = byValue.find(entry.second);
+            if (documents == byValue.end()) continue;
+            documents->second.erase(const_cast<DialectedWooWooDocument *>(document));
+            if (documents->second.empty()) {
+                byValue.erase(documents);
+            }
+        }
+        referencingEntries.erase(referencingIt);
+    }
+
+    auto definingIt = definingEntries.find(document);
+    if (definingIt != definingEntries.end()) {
+        for (const auto &entry: definingIt->second) {
+            auto &byValue = defining[entry.first];
+            auto documents = byValue.find(entry.second);
+            if (documents == byValue.end()) continue;
+            documents->second.erase(const_cast<DialectedWooWooDocument *>(document));
+            if (documents->second.empty()) {
+                byValue.erase(documents);
+            }
+        }
+        definingEntries.erase(definingIt);
+    }
+
+    auto definedAtIt = definedAtEntries.find(document);
+    if (definedAtIt != definedAtEntries.end()) {
+        for (const auto &entry: definedAtIt->second) {
+            auto &byValue = definedAt[entry.first];
+            auto documents = byValue.find(entry.second);
+            if (documents == byValue.end()) continue;
+            documents->second.erase(const_cast<DialectedWooWooDocument *>(document));
+            if (documents->second.empty()) {
+                byValue.erase(documents);
+            }
+        }
+        definedAtEntries.erase(definedAtIt);
+    }
+}
+
+std::set<DialectedWooWooDocument *>
+ReferenceIndex::getReferencingDocuments(const std::string &metaKey, const std::string &value) const {
+    auto byKey = referencing.find(SymbolTable::getInstance()->find(metaKey));
+    if (byKey == referencing.end()) return {};
+    auto documents = byKey->second.find(value);
+    if (documents == byKey->second.end()) return {};
+    return documents->second;
+}
+
+std::set<DialectedWooWooDocument *>
+ReferenceIndex::getDefiningDocuments(std::span<const Reference> references, const std::string &value) const {
+    std::set<DialectedWooWooDocument *> result;
+    for (const Reference &reference: references) {
+        auto byReference = defining.find(reference.key());
+        if (byReference == defining.end()) continue;
+        auto documents = byReference->second.find(value);
+        if (documents == byReference->second.end()) continue;
+        result.insert(documents->second.begin(), documents->second.end());
+    }
+    return result;
+}
+
+const std::unordered_map<DialectedWooWooDocument *, uint32_t> *
+ReferenceIndex::getDefinitionSites(SymbolId metaKey, const std::string &value) const {
+    auto byKey = definedAt.find(metaKey);
+    if (byKey == definedAt.end()) return nullptr;
+    auto documents = byKey->second.find(value);
+    if (documents == byKey->second.end()) return nullptr;
+    return &documents->second;
+}
+
+size_t ReferenceIndex::memoryUsage() const {
+    return memory::heapBytes(referencing) + memory::heapBytes(defining) + memory::heapBytes(definedAt) +
+           memory::heapBytes(referencingEntries) + memory::heapBytes(definingEntries) +
+           memory::heapBytes(definedAtEntries);
+}
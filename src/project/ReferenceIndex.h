@@ -0,0 +1,56 @@
+#ifndef WUFF_REFERENCEINDEX_H
+#define WUFF_REFERENCEINDEX_H
+
+#include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../dialect/Reference.h"
+
+class DialectedWooWooDocument;
+
+/**
+ * Inverted index of a project: which documents reference or define a given value.
+ *
+ * Documents are indexed again every time they are re-parsed, so that lookups for references and definitions
+ * only visit the documents which contain a result, instead of every document of the project.
+ */
+class ReferenceIndex {
+public:
+    // replaces everything previously indexed for the document
+    void indexDocument(DialectedWooWooDocument *document);
+    void removeDocument(const DialectedWooWooDocument *document);
+
+    // documents referencing the value through a field whose possible references include the metaKey
+    [[nodiscard]] std::set<DialectedWooWooDocument *> getReferencingDocuments(const std::string &metaKey,
+                                                                              const std::string &value) const;
+
+    // documents where the value is defined as any of the given references
+    [[nodiscard]] std::set<DialectedWooWooDocument *> getDefiningDocuments(std::span<const Reference> references,
+                                                                           const std::string &value) const;
+
+    // documents with meta fields defining the value under the metaKey (with their number), nullptr if there are none
+    [[nodiscard]] const std::unordered_map<DialectedWooWooDocument *, uint32_t> *
+    getDefinitionSites(SymbolId metaKey, const std::string &value) const;
+
+    // estimated heap bytes of the index
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    // metaKey -> value -> documents
+    std::unordered_map<SymbolId, std::unordered_map<std::string, std::set<DialectedWooWooDocument *>>> referencing;
+    // reference -> value -> documents
+    std::unordered_map<ReferenceKey, std::unordered_map<std::string, std::set<DialectedWooWooDocument *>>> defining;
+    // metaKey -> value -> documents -> number of defining fields
+    std::unordered_map<SymbolId, std::unordered_map<std::string, std::unordered_map<DialectedWooWooDocument *, uint32_t>>> definedAt;
+
+    // what each document contributed, so that it can be removed without scanning the whole index
+    std::unordered_map<const DialectedWooWooDocument *, std::vector<std::pair<SymbolId, std::string>>> referencingEntries;
+    std::unordered_map<const DialectedWooWooDocument *, std::vector<std::pair<ReferenceKey, std::string>>> definingEntries;
+    std::unordered_map<const DialectedWooWooDocument *, std::vector<std::pair<SymbolId, std::string>>> definedAtEntries;
+};
+
+
+#endif //WUFF_REFERENCEINDEX_H
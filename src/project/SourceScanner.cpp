@@ -0,0 +1,129 @@
+#include "SourceScanner.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WUFF_SCAN_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WUFF_SCAN_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define WUFF_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    inline uint32_t countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    void newLineAt(const char *data, uint32_t position, uint32_t size, SourceScan &result) {
+        auto line = static_cast<uint32_t>(result.lineStarts.size());
+        result.lineStarts.push_back(position + 1);
+        if (position + 1 < size && data[position + 1] == '%') {
+            result.commentLines.push_back(line);
+        }
+    }
+
+    void nonAsciiAt(SourceScan &result) {
+        auto line = static_cast<uint32_t>(result.lineStarts.size() - 1);
+        if (result.nonAsciiLines.empty() || result.nonAsciiLines.back() != line) {
+            result.nonAsciiLines.push_back(line);
+        }
+    }
+
+    void handleMask(const char *data, uint32_t offset, uint32_t mask, uint32_t size, SourceScan &result) {
+        while (mask) {
+            uint32_t position = offset + countTrailingZeros(mask);
+            if (data[position] == '\n') {
+                newLineAt(data, position, size, result);
+            } else {
+                nonAsciiAt(result);
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    void scanScalar(const char *data, uint32_t begin, uint32_t end, uint32_t size, SourceScan &result) {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (data[i] == '\n') {
+                newLineAt(data, i, size, result);
+            } else if (static_cast<unsigned char>(data[i]) >= 0x80) {
+                nonAsciiAt(result);
+            }
+        }
+    }
+
+#ifdef WUFF_SCAN_AVX2
+    __attribute__((target("avx2")))
+    uint32_t scanAvx2(const char *data, uint32_t size, SourceScan &result) {
+        const __m256i newLine = _mm256_set1_epi8('\n');
+        uint32_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            // high bit marks non-ASCII bytes
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(chunk)) |
+                        static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newLine)));
+            if (mask) {
+                handleMask(data, i, mask, size, result);
+            }
+        }
+        return i;
+    }
+#endif
+}
+
+SourceScan SourceScanner::scan(const std::string &source) {
+    SourceScan result;
+    const char *data = source.data();
+    auto size = static_cast<uint32_t>(source.size());
+
+    // most lines are short, reserve a guess to avoid regrowing
+    result.lineStarts.reserve(size / 32 + 1);
+    result.lineStarts.push_back(0);
+    if (size > 0 && data[0] == '%') {
+        result.commentLines.push_back(0);
+    }
+
+    uint32_t i = 0;
+#ifdef WUFF_SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        i = scanAvx2(data, size, result);
+    }
+#endif
+
+#if defined(WUFF_SCAN_SSE2)
+    const __m128i newLine = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newLine)));
+        if (mask) {
+            handleMask(data, i, mask, size, result);
+        }
+    }
+#elif defined(WUFF_SCAN_NEON)
+    const uint8x16_t newLine = vdupq_n_u8('\n');
+    const uint8x16_t highBit = vdupq_n_u8(0x80);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+        uint8x16_t interesting = vorrq_u8(vceqq_u8(chunk, newLine), vtstq_u8(chunk, highBit));
+        // NEON has no movemask, only skip the uninteresting chunks quickly
+        if (vmaxvq_u8(interesting)) {
+            scanScalar(data, i, i + 16, size, result);
+        }
+    }
+#endif
+
+    scanScalar(data, i, size, size, result);
+    return result;
+}
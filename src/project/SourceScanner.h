@@ -0,0 +1,30 @@
+#ifndef WUFF_SOURCESCANNER_H
+#define WUFF_SOURCESCANNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Everything the document needs to know about the raw text, collected in a single pass.
+ */
+struct SourceScan {
+    // byte offset of the first character of every line
+    std::vector<uint32_t> lineStarts;
+    // lines starting with '%'
+    std::vector<uint32_t> commentLines;
+    // lines containing at least one non-ASCII byte (need UTF-16 checkpoints)
+    std::vector<uint32_t> nonAsciiLines;
+};
+
+/**
+ * Finds new lines, comment lines and non-ASCII bytes of a source using SIMD instructions
+ * (AVX2 if the CPU supports it, SSE2 or NEON otherwise), with a scalar fallback.
+ */
+class SourceScanner {
+public:
+    static SourceScan scan(const std::string &source);
+};
+
+
+#endif //WUFF_SOURCESCANNER_H
@@ -4,51 +4,108 @@
 
 // UTF8toUTF16Mapping.cpp
 #include "UTF8toUTF16Mapping.h"
+#include <algorithm>
+#include <cstring>
+#include "../utils/MemoryUsage.h"
+
 void UTF8toUTF16Mapping::buildMappings(const std::string& source) {
-    utf8ToUtf16Mappings.clear();
-    utf16ToUtf8Mappings.clear();
-    std::istringstream stream(source);
-    std::string line;
-    while (std::getline(stream, line)) {
-        utf8ToUtf16Mappings.push_back(lineUtf8ToUtf16Mapping(line));
-    }
+    buildMappings(source, SourceScanner::scan(source));
+}
 
-    // Build reverse mappings
-    for (const auto& map : utf8ToUtf16Mappings) {
-        std::unordered_map<uint32_t, uint32_t> reverseMap;
-        for (const auto& pair : map) {
-            reverseMap[pair.second] = pair.first;
-        }
-        utf16ToUtf8Mappings.push_back(reverseMap);
+void UTF8toUTF16Mapping::buildMappings(const std::string &source, const SourceScan &scan) {
+    lineStarts = scan.lineStarts;
+    checkpoints.clear();
+    sourceSize = source.size();
+
+    // ASCII-only lines need no checkpoints
+    for (uint32_t lineNum: scan.nonAsciiLines) {
+        uint32_t end = lineNum + 1 < lineStarts.size() ? lineStarts[lineNum + 1] - 1 : sourceSize;
+        scanLine(source, lineNum, lineStarts[lineNum], end, checkpoints);
     }
 }
 
-std::unordered_map<uint32_t , uint32_t > UTF8toUTF16Mapping::lineUtf8ToUtf16Mapping(const std::string& line) {
-    std::unordered_map<uint32_t , uint32_t > mapping;
-    uint32_t utf8Offset = 0;
-    uint32_t utf16Position = 0;
-
-    while (utf8Offset < line.size()) {
-        unsigned char c = line[utf8Offset];
-        int charLen = utf8CharLen(c);
-        if (charLen == 0) { // Error handling for invalid UTF-8 byte
-            std::cerr << "Invalid UTF-8 byte encountered" << std::endl;
-            break;
+void UTF8toUTF16Mapping::updateMappings(const std::string &source, uint32_t startLine, uint32_t oldEndLine,
+                                        uint32_t newEndLine) {
+    if (startLine >= lineStarts.size() || oldEndLine < startLine || newEndLine < startLine) {
+        buildMappings(source);
+        return;
+    }
+    oldEndLine = std::min<uint32_t>(oldEndLine, lineStarts.size() - 1);
+    int64_t byteDelta = static_cast<int64_t>(source.size()) - sourceSize;
+    int64_t lineDelta = static_cast<int64_t>(newEndLine) - oldEndLine;
+
+    // find starts of the edited lines in the new source
+    std::vector<uint32_t> newStarts;
+    std::vector<Checkpoint> newCheckpoints;
+    uint32_t begin = lineStarts[startLine];
+    for (uint32_t lineNum = startLine; lineNum <= newEndLine; ++lineNum) {
+        if (begin > source.size()) {
+            buildMappings(source);
+            return;
         }
+        const void *newLine = std::memchr(source.data() + begin, '\n', source.size() - begin);
+        uint32_t end = newLine ? static_cast<const char *>(newLine) - source.data() : source.size();
+        if (lineNum != startLine) {
+            newStarts.push_back(begin);
+        }
+        scanLine(source, lineNum, begin, end, newCheckpoints);
+        begin = end + 1;
+    }
 
-        uint32_t codePoint = utf8ToCodePoint(line, utf8Offset, charLen);
-
-        int utf16Len = (codePoint >= 0x10000) ? 2 : 1;
+    // replace the starts of the edited lines and move the lines behind them
+    lineStarts.erase(lineStarts.begin() + startLine + 1, lineStarts.begin() + oldEndLine + 1);
+    lineStarts.insert(lineStarts.begin() + startLine + 1, newStarts.begin(), newStarts.end());
+    for (size_t i = newEndLine + 1; i < lineStarts.size(); ++i) {
+        lineStarts[i] = lineStarts[i] + byteDelta;
+    }
 
-        for (int i = 0; i < charLen; ++i) {
-            mapping[utf8Offset - charLen + i] = utf16Position; // Adjust the index for mapping
-        }
+    auto first = std::lower_bound(checkpoints.begin(), checkpoints.end(), startLine,
+                                  [](const Checkpoint &cp, uint32_t line) { return cp.line < line; });
+    auto last = std::lower_bound(first, checkpoints.end(), oldEndLine + 1,
+                                 [](const Checkpoint &cp, uint32_t line) { return cp.line < line; });
+    for (auto it = last; it != checkpoints.end(); ++it) {
+        it->line = it->line + lineDelta;
+    }
+    auto insertAt = checkpoints.erase(first, last);
+    checkpoints.insert(insertAt, newCheckpoints.begin(), newCheckpoints.end());
 
-        utf16Position += utf16Len;
+    sourceSize = source.size();
+}
 
+void UTF8toUTF16Mapping::scanLine(const std::string &source, uint32_t lineNum, uint32_t begin, uint32_t end,
+                                  std::vector<Checkpoint> &target) const {
+    // difference between UTF-8 and UTF-16 columns accumulated so far on this line
+    uint32_t shift = 0;
+    for (uint32_t i = begin; i < end;) {
+        auto c = static_cast<unsigned char>(source[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
         }
+        // invalid bytes are counted as one code unit each
+        uint32_t charLen = std::max(utf8CharLen(c), 1);
+        charLen = std::min(charLen, end - i);
+        // only characters outside the BMP (4 bytes in UTF-8) need a surrogate pair
+        uint32_t utf16Len = charLen == 4 ? 2 : 1;
+
+        uint32_t column = i - begin;
+        target.push_back(Checkpoint{lineNum, column, column - shift, static_cast<uint8_t>(charLen),
+                                    static_cast<uint8_t>(utf16Len)});
+        shift += charLen - utf16Len;
+        i += charLen;
+    }
+}
 
-    return mapping;
+const UTF8toUTF16Mapping::Checkpoint *
+UTF8toUTF16Mapping::lastCheckpointBefore(uint32_t lineNum, uint32_t offset, bool utf16) const {
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), std::make_pair(lineNum, offset),
+                               [utf16](const std::pair<uint32_t, uint32_t> &position, const Checkpoint &cp) {
+                                   uint32_t column = utf16 ? cp.utf16Offset : cp.utf8Offset;
+                                   return position < std::make_pair(cp.line, column);
+                               });
+    if (it == checkpoints.begin()) return nullptr;
+    --it;
+    return it->line == lineNum ? &*it : nullptr;
 }
 
 
@@ -65,44 +122,43 @@ int UTF8toUTF16Mapping::utf8CharLen(unsigned char firstByte) {
     return 0; // Error case
 }
 
-uint32_t UTF8toUTF16Mapping::utf8ToCodePoint(const std::string& utf8, uint32_t & offset, int length) {
-    uint32_t codePoint = 0;
-    if (length == 1) {
-        codePoint = utf8[offset];
-    } else if (length == 2) {
-        codePoint = ((utf8[offset] & 0x1F) << 6) | (utf8[offset + 1] & 0x3F);
-    } else if (length == 3) {
-        codePoint = ((utf8[offset] & 0x0F) << 12) | ((utf8[offset + 1] & 0x3F) << 6) | (utf8[offset + 2] & 0x3F);
-    } else if (length == 4) {
-        codePoint = ((utf8[offset] & 0x07) << 18) | ((utf8[offset + 1] & 0x3F) << 12) | ((utf8[offset + 2] & 0x3F) << 6) | (utf8[offset + 3] & 0x3F);
-    }
-    offset += length;
-    return codePoint;
-}
-
 
 std::pair<uint32_t, uint32_t> UTF8toUTF16Mapping::utf8ToUtf16(uint32_t lineNum, uint32_t utf8Offset) const {
-    if (lineNum < utf8ToUtf16Mappings.size()) {
-        const auto& mapping = utf8ToUtf16Mappings[lineNum];
-        auto it = mapping.find(utf8Offset);
-        if (it != mapping.end()) {
-            return {lineNum, it->second};
-        }
+    const Checkpoint *cp = lastCheckpointBefore(lineNum, utf8Offset, false);
+    if (!cp) {
+        // only ASCII characters before this position
+        return {lineNum, utf8Offset};
     }
-    // Return the original offset if the line number or utf8Offset is out of range or not found
-    return {lineNum, utf8Offset};
+    if (utf8Offset < cp->utf8Offset + cp->utf8Length) {
+        // inside of a multibyte character
+        return {lineNum, cp->utf16Offset};
+    }
+    return {lineNum, cp->utf16Offset + cp->utf16Length + (utf8Offset - cp->utf8Offset - cp->utf8Length)};
 }
 
 std::pair<uint32_t, uint32_t> UTF8toUTF16Mapping::utf16ToUtf8(uint32_t lineNum, uint32_t utf16Offset) const {
-    if (lineNum < utf16ToUtf8Mappings.size()) {
-        const auto& mapping = utf16ToUtf8Mappings[lineNum];
-        auto it = mapping.find(utf16Offset);
-        if (it != mapping.end()) {
-            return {lineNum, it->second};
-        }
+    const Checkpoint *cp = lastCheckpointBefore(lineNum, utf16Offset, true);
+    if (!cp) {
+        // only ASCII characters before this position
+        return {lineNum, utf16Offset};
+    }
+    if (utf16Offset < cp->utf16Offset + cp->utf16Length) {
+        // inside of a surrogate pair
+        return {lineNum, cp->utf8Offset};
     }
-    // Return the original offset if the line number or utf16Offset is out of range or not found
-    return {lineNum, utf16Offset};
+    return {lineNum, cp->utf8Offset + cp->utf8Length + (utf16Offset - cp->utf16Offset - cp->utf16Length)};
+}
+
+uint32_t UTF8toUTF16Mapping::lineStart(uint32_t lineNum) const {
+    return lineNum < lineStarts.size() ? lineStarts[lineNum] : sourceSize;
+}
+
+uint32_t UTF8toUTF16Mapping::lineCount() const {
+    return lineStarts.size();
+}
+
+size_t UTF8toUTF16Mapping::memoryUsage() const {
+    return memory::heapBytes(lineStarts) + memory::heapBytes(checkpoints);
 }
 
 void UTF8toUTF16Mapping::utf8ToUtf16(Location & loc) const{
@@ -122,4 +178,4 @@ void UTF8toUTF16Mapping::utf8ToUtf16(Range & range) const{
     range.start.character = transStart.second;
     range.end.line = transEnd.first;
     range.end.character = transEnd.second;
-}
\ No newline at end of file
+}
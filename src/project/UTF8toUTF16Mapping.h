@@ -7,16 +7,24 @@
 
 
 #include <cstdint>
-#include <iostream>
-#include <sstream>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include "../lsp/LSPTypes.h"
-
+#include "SourceScanner.h"
+
+/**
+ * Translates columns between UTF-8 (bytes, used by tree-sitter) and UTF-16 (code units, used by LSP).
+ *
+ * Only the start of every line and one checkpoint per non-ASCII character are stored,
+ * positions on ASCII-only lines (and ASCII runs of other lines) are translated arithmetically.
+ */
 class UTF8toUTF16Mapping {
 public:
     void buildMappings(const std::string& source);
+    void buildMappings(const std::string& source, const SourceScan& scan);
+
+    // Refresh lines [startLine, newEndLine] of the edited source; lines after oldEndLine are only shifted.
+    void updateMappings(const std::string& source, uint32_t startLine, uint32_t oldEndLine, uint32_t newEndLine);
 
     [[nodiscard]] std::pair<uint32_t, uint32_t> utf8ToUtf16(uint32_t lineNum, uint32_t utf8Offset) const;
 
@@ -25,12 +33,30 @@ public:
     void utf8ToUtf16(Location & loc) const;
     void utf8ToUtf16(Range & r) const;
 
+    // byte offset of the first character of the line (or the source size if the line does not exist)
+    [[nodiscard]] uint32_t lineStart(uint32_t lineNum) const;
+    [[nodiscard]] uint32_t lineCount() const;
+    // heap bytes of the tables
+    [[nodiscard]] size_t memoryUsage() const;
+
 private:
-    std::vector<std::unordered_map<uint32_t, uint32_t>> utf8ToUtf16Mappings;
-    std::vector<std::unordered_map<uint32_t, uint32_t>> utf16ToUtf8Mappings;
-    std::unordered_map<uint32_t, uint32_t> lineUtf8ToUtf16Mapping(const std::string& line);
+    struct Checkpoint {
+        uint32_t line;
+        uint32_t utf8Offset;   // byte column where the character starts
+        uint32_t utf16Offset;  // UTF-16 column where the character starts
+        uint8_t utf8Length;
+        uint8_t utf16Length;
+    };
+
+    std::vector<uint32_t> lineStarts;
+    // sorted by line and column
+    std::vector<Checkpoint> checkpoints;
+    uint32_t sourceSize = 0;
+
+    void scanLine(const std::string& source, uint32_t lineNum, uint32_t begin, uint32_t end,
+                  std::vector<Checkpoint>& target) const;
+    [[nodiscard]] const Checkpoint * lastCheckpointBefore(uint32_t lineNum, uint32_t offset, bool utf16) const;
     static int utf8CharLen(unsigned char firstByte);
-    static uint32_t utf8ToCodePoint(const std::string& utf8, uint32_t & offset, int length);
 };
 
 #endif //WUFF_UTF8TOUTF16MAPPING_H
@@ -3,94 +3,548 @@
 //
 
 #include "WooWooDocument.h"
-#include <fstream>
-#include <sstream>
+#include <iostream>
 #include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include "SourceScanner.h"
+#include "../utils/utils.h"
+#include "../utils/Stats.h"
+#include "../utils/SpanTracer.h"
 
+namespace {
+    // a large document is parsed in chunks of this, the cancellation of the request is checked between them
+    const uint64_t LARGE_FILE_PARSE_CHUNK_MICROS = 5000;
+    // lines taken as visible before the client sets the viewport
+    const uint32_t DEFAULT_VISIBLE_LINES = 200;
+}
+
+std::atomic<size_t> WooWooDocument::largeFileThreshold{0};
+std::atomic<uint64_t> WooWooDocument::largeFileParseBudget{0};
 
-WooWooDocument::WooWooDocument(fs::path documentPath) : documentPath(std::move(documentPath)) {
+WooWooDocument::WooWooDocument(fs::path documentPath, bool loadSource) : documentPath(std::move(documentPath)) {
     utfMappings = new UTF8toUTF16Mapping();
-    updateSource();
+    if (loadSource) {
+        updateSource();
+    }
 }
 
-void WooWooDocument::updateSource() {
-    std::ifstream file(documentPath, std::ios::in);
-    if (file) {
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        file.close();
-        std::string fileContents = buffer.str();
-        updateSource(fileContents);
-    } else {
+WooWooDocument::WooWooDocument(const WooWooDocument &other)
+        : deferredParse(other.deferredParse), materialized(other.materialized),
+          tree(other.tree ? ts_tree_copy(other.tree) : nullptr),
+          utfMappings(new UTF8toUTF16Mapping(*other.utfMappings)), documentPath(other.documentPath),
+          project(other.project), source(other.source), diskState(other.diskState), version(other.version),
+          lastChange(other.lastChange), metaBlocks(other.metaBlocks), commentLines(other.commentLines),
+          viewport(other.viewport) {}
+
+void WooWooDocument::swapVersion(WooWooDocument &other) {
+    std::swap(materialized, other.materialized);
+    std::swap(tree, other.tree);
+    std::swap(metaBlocks, other.metaBlocks);
+    std::swap(commentLines, other.commentLines);
+    std::swap(utfMappings, other.utfMappings);
+    std::swap(source, other.source);
+    std::swap(diskState, other.diskState);
+    std::swap(version, other.version);
+    std::swap(lastChange, other.lastChange);
+    std::swap(deferredParse, other.deferredParse);
+}
+
+std::optional<std::pair<std::string, FileState>> WooWooDocument::readFromDisk() const {
+    std::error_code ec;
+    auto modificationTime = fs::last_write_time(documentPath, ec);
+    auto fileContents = utils::readFile(documentPath);
+    if (!fileContents.has_value()) {
         std::cerr << "Could not open file: " << documentPath << std::endl;
+        return std::nullopt;
     }
+    FileState state{ec ? 0 : static_cast<int64_t>(modificationTime.time_since_epoch().count()),
+                    fileContents->size(), utils::hashContent(fileContents.value())};
+    return std::make_pair(std::move(fileContents.value()), state);
+}
+
+void WooWooDocument::updateSource() {
+    auto read = readFromDisk();
+    if (!read.has_value()) return;
+    if (materialized && read->first == source) {
+        // read again with the content it already had (e.g. touched or saved), the parse stays valid
+        diskState = read->second;
+        Stats::count(Counter::UnchangedDiskSourceSkipped);
+        return;
+    }
+    updateSource(read->first);
+    diskState = read->second;
+}
+
+bool WooWooDocument::refreshDiskState() {
+    if (!materialized) return false;
+    auto read = readFromDisk();
+    if (!read.has_value() || read->first != source) return false;
+    diskState = read->second;
+    Stats::count(Counter::UnchangedDiskSourceSkipped);
+    return true;
 }
 
 
 void WooWooDocument::updateSource(std::string &newSource) {
+    // the same text again (e.g. a full text change which changed nothing), the parse stays valid
+    if (materialized && tree && newSource == source) {
+        Stats::count(Counter::UnchangedSourceSkipped);
+        return;
+    }
     this->source = std::move(newSource);
+    ++version;
+    materialized = true;
+    diskState.reset();
+    lastChange.reset();
+    // the whole text was replaced, nothing from the old version can be reused
     deleteCommentsAndMetas();
-    tree = Parser::getInstance()->parseWooWoo(source);
-    metaBlocks = Parser::getInstance()->parseMetas(tree, source);
-    utfMappings->buildMappings(source);
+    ts_tree_delete(tree);
+    tree = nullptr;
+    // lines, comments and non-ASCII characters are all found in one pass
+    SourceScan scan;
+    {
+        ScopedTimer timer(Timer::ScanSource);
+        scan = SourceScanner::scan(source);
+    }
+    {
+        ScopedTimer timer(Timer::BuildMappings);
+        utfMappings->buildMappings(source, scan);
+    }
+    reparse();
+    ScopedTimer timer(Timer::UpdateComments);
+    updateComments(scan.commentLines);
+}
+
+/**
+ * Applies LSP-style ranged content changes and re-parses the document incrementally.
+ * 
+ * The edits are applied in the given order, the range of each one refers to the document
+ * as it is after applying all the previous ones (same as in textDocument/didChange).
+ * 
+ * @param edits Ranges (in UTF-16 code units) to be replaced and their new text.
+ */
+void WooWooDocument::updateSource(const std::vector<TextEdit> &edits) {
+    // lines touched by the edits, in the coordinates of the already edited source
+    std::optional<ChangedLines> change;
+    int64_t lineShift = 0;
+    std::optional<ScopedTimer> applyTimer(std::in_place, Timer::ApplyEdits);
+    for (const TextEdit &edit: edits) {
+        // an edit changing nothing does not move anything either, the next ones do not depend on it
+        if (isNoOpEdit(edit)) {
+            Stats::count(Counter::NoOpEditSkipped);
+            continue;
+        }
+        uint32_t lastLine = utfMappings->lineCount() > 0 ? utfMappings->lineCount() - 1 : 0;
+        uint32_t startLine = std::min(edit.range.start.line, lastLine);
+        uint32_t endLine = std::max(startLine, std::min(edit.range.end.line, lastLine));
+        uint32_t newEndLine = startLine + std::count(edit.newText.begin(), edit.newText.end(), '\n');
+
+        if (!change) {
+            change = ChangedLines{startLine, 0, newEndLine};
+        } else {
+            // the lines already touched move with the lines after the edit
+            uint32_t touchedLast = change->newLast;
+            if (touchedLast > endLine) {
+                touchedLast = touchedLast + newEndLine - endLine;
+            } else if (touchedLast >= startLine) {
+                touchedLast = newEndLine;
+            }
+            change->first = std::min(change->first, startLine);
+            change->newLast = std::max(touchedLast, newEndLine);
+        }
+        lineShift += static_cast<int64_t>(newEndLine) - endLine;
+        applyEdit(edit);
+    }
+    applyTimer.reset();
+    if (!change) return;
+    ++version;
+    diskState.reset();
+    change->oldLast = static_cast<uint32_t>(std::max<int64_t>(change->first, change->newLast - lineShift));
+    reparse(&change.value());
+    lastChange = change;
+    ScopedTimer timer(Timer::UpdateComments);
     updateComments();
 }
 
+bool WooWooDocument::isNoOpEdit(const TextEdit &edit) const {
+    auto start = utfMappings->utf16ToUtf8(edit.range.start.line, edit.range.start.character);
+    auto end = utfMappings->utf16ToUtf8(edit.range.end.line, edit.range.end.character);
+    uint32_t startByte = byteOffset(start.first, start.second);
+    uint32_t oldEndByte = std::max(startByte, byteOffset(end.first, end.second));
+    return oldEndByte - startByte == edit.newText.size() &&
+           source.compare(startByte, oldEndByte - startByte, edit.newText) == 0;
+}
+
+/**
+ * Replaces the given range of the source and records the edit in the current syntax tree,
+ * so that the next parse can reuse the unchanged parts of it. Does not re-parse the document.
+ */
+void WooWooDocument::applyEdit(const TextEdit &edit) {
+    auto start = utfMappings->utf16ToUtf8(edit.range.start.line, edit.range.start.character);
+    auto end = utfMappings->utf16ToUtf8(edit.range.end.line, edit.range.end.character);
+
+    uint32_t startByte = byteOffset(start.first, start.second);
+    uint32_t oldEndByte = byteOffset(end.first, end.second);
+    TSPoint startPoint = {start.first, startByte - byteOffset(start.first, 0)};
+    TSPoint oldEndPoint = {end.first, oldEndByte - byteOffset(end.first, 0)};
+    if (oldEndByte < startByte) {
+        // reversed range, treat it as an insertion
+        oldEndByte = startByte;
+        oldEndPoint = startPoint;
+    }
+    source.replace(startByte, oldEndByte - startByte, edit.newText);
+
+    // compute where the inserted text ends
+    TSPoint newEndPoint = startPoint;
+    auto lastNewLine = edit.newText.rfind('\n');
+    if (lastNewLine == std::string::npos) {
+        newEndPoint.column += edit.newText.size();
+    } else {
+        newEndPoint.row += std::count(edit.newText.begin(), edit.newText.end(), '\n');
+        newEndPoint.column = edit.newText.size() - lastNewLine - 1;
+    }
+
+    TSInputEdit inputEdit;
+    inputEdit.start_byte = startByte;
+    inputEdit.old_end_byte = oldEndByte;
+    inputEdit.new_end_byte = startByte + edit.newText.size();
+    inputEdit.start_point = startPoint;
+    inputEdit.old_end_point = oldEndPoint;
+    inputEdit.new_end_point = newEndPoint;
+
+    // positions of the next edit are relative to the already edited source
+    utfMappings->updateMappings(source, startPoint.row, oldEndPoint.row, newEndPoint.row);
+    shiftMetaBlocks(inputEdit);
+
+    if (!tree) return;
+    ts_tree_edit(tree, &inputEdit);
+}
+
+/**
+ * Keeps meta blocks through an edit, so that their YAML does not have to be parsed again (or only incrementally).
+ * Blocks located after the edit are moved (their trees too), a block containing the edit gets it in its tree
+ * and is marked edited, blocks overlapping the edit only partly are dropped.
+ */
+void WooWooDocument::shiftMetaBlocks(const TSInputEdit &edit) {
+    uint32_t oldEndRow = edit.old_end_point.row;
+    uint32_t newEndRow = edit.new_end_point.row;
+    // blocks are compacted in place, the dropped ones are freed at the end
+    auto kept = metaBlocks.begin();
+    for (MetaContext &mx: metaBlocks) {
+        uint32_t metaEndByte = mx.byteOffset + mx.byteLength;
+        if (edit.old_end_byte <= mx.byteOffset) {
+            // the edit is entirely before the block
+            mx.byteOffset = mx.byteOffset + edit.new_end_byte - edit.old_end_byte;
+            mx.lineOffset = mx.lineOffset + newEndRow - oldEndRow;
+            if (mx.tree) ts_tree_edit(mx.tree, &edit);
+        } else if (edit.start_byte < metaEndByte) {
+            if (edit.start_byte < mx.byteOffset || edit.old_end_byte > metaEndByte) {
+                // the edit reaches out of the block
+                continue;
+            }
+            mx.byteLength = mx.byteLength + edit.new_end_byte - edit.old_end_byte;
+            mx.lineCount = mx.lineCount + newEndRow - oldEndRow;
+            if (mx.tree) {
+                ts_tree_edit(mx.tree, &edit);
+                mx.edited = true;
+            }
+        }
+        if (&*kept != &mx) {
+            *kept = std::move(mx);
+        }
+        ++kept;
+    }
+    metaBlocks.erase(kept, metaBlocks.end());
+}
+
+/**
+ * Parses the source again, reusing the old tree if it was edited.
+ * If change is given, it is extended to cover also the lines whose syntax changed by the edits.
+ * An edit of a large document is parsed within the budget of the large-file mode, if the parse does not finish,
+ * the edited old tree stays and the parse is left pending (the meta blocks are then the ones kept by the edit).
+ */
+void WooWooDocument::reparse(ChangedLines *change) {
+    std::optional<ScopedTimer> parseTimer(std::in_place, Timer::ParseWooWoo);
+    ScopedSpan parseSpan("parse_woowoo", "parse", documentPath, source.size());
+    TSTree *oldTree = tree;
+    // a parse of the previous version cannot be resumed on the changed source
+    deferredParse.reset();
+    bool bounded = change && oldTree && isLarge();
+    if (bounded) {
+        auto deferred = std::make_shared<DeferredParse>();
+        tree = Parser::getInstance()->parseWooWoo(deferred->parse, source, oldTree, LARGE_FILE_PARSE_CHUNK_MICROS,
+                                                  largeFileParseBudget.load(std::memory_order_relaxed));
+        if (!tree) {
+            tree = oldTree;
+            deferred->lines = *change;
+            deferredParse = std::move(deferred);
+            return;
+        }
+    } else {
+        tree = Parser::getInstance()->parseWooWoo(source, oldTree);
+    }
+    if (change && oldTree && tree) {
+        extendChange(oldTree, tree, *change);
+    }
+    ts_tree_delete(oldTree);
+    parseTimer.reset();
+    parseSpan.end();
+    parseMetaBlocks(bounded);
+}
+
+void WooWooDocument::extendChange(const TSTree *oldTree, const TSTree *newTree, ChangedLines &change) {
+    uint32_t rangeCount = 0;
+    TSRange *ranges = ts_tree_get_changed_ranges(oldTree, newTree, &rangeCount);
+    for (uint32_t i = 0; i < rangeCount; ++i) {
+        uint32_t first = ranges[i].start_point.row;
+        uint32_t last = ranges[i].end_point.row;
+        if (last > first && ranges[i].end_point.column == 0) --last;
+        change.first = std::min(change.first, first);
+        if (last > change.newLast) {
+            // lines after the changed ones are only shifted
+            change.oldLast += last - change.newLast;
+            change.newLast = last;
+        }
+    }
+    free(ranges);
+}
+
+void WooWooDocument::parseMetaBlocks(bool deferOutOfView) {
+    // meta blocks kept from the previous version are reused if they are still there
+    ScopedTimer metasTimer(Timer::ParseMetas);
+    ScopedSpan metasSpan("parse_metas", "parse", documentPath, source.size());
+    std::optional<LineSpan> parsedLines;
+    if (deferOutOfView) {
+        parsedLines = visibleLines();
+    }
+    metaBlocks = Parser::getInstance()->parseMetas(tree, source, std::move(metaBlocks), parsedLines);
+}
+
+void WooWooDocument::setLargeFileMode(size_t thresholdBytes, uint64_t parseBudgetMicros) {
+    largeFileThreshold.store(thresholdBytes, std::memory_order_relaxed);
+    largeFileParseBudget.store(parseBudgetMicros, std::memory_order_relaxed);
+}
+
+bool WooWooDocument::isLarge() const {
+    size_t threshold = largeFileThreshold.load(std::memory_order_relaxed);
+    return threshold != 0 && source.size() >= threshold;
+}
+
+LineSpan WooWooDocument::visibleLines() const {
+    uint32_t lastLine = utfMappings->lineCount() > 0 ? utfMappings->lineCount() - 1 : 0;
+    if (!viewport) {
+        return LineSpan{0, std::min(lastLine, DEFAULT_VISIBLE_LINES - 1)};
+    }
+    uint32_t first = std::min(viewport->first, lastLine);
+    return LineSpan{first, std::clamp(viewport->last, first, lastLine)};
+}
+
+bool WooWooDocument::isParsePending() const {
+    return deferredParse != nullptr;
+}
+
+bool WooWooDocument::hasDeferredWork() const {
+    return deferredParse || std::any_of(metaBlocks.begin(), metaBlocks.end(),
+                                        [](const MetaContext &mx) { return !mx.isParsed(); });
+}
+
+/**
+ * Finishes what the large-file mode left for later: the pending parse (without a budget) and the YAML
+ * of all meta blocks. The result is a new version whose last change covers the lines which were reparsed,
+ * so the caches of the components are brought up to date incrementally.
+ */
+bool WooWooDocument::finishDeferredWork() {
+    if (!materialized || !hasDeferredWork()) return false;
+    std::optional<ChangedLines> change;
+    if (deferredParse) {
+        std::shared_ptr<DeferredParse> deferred = std::move(deferredParse);
+        std::optional<ScopedTimer> parseTimer(std::in_place, Timer::ParseWooWoo);
+        ScopedSpan parseSpan("finish_parse", "parse", documentPath, source.size());
+        TSTree *parsed = Parser::getInstance()->parseWooWoo(deferred->parse, source, tree,
+                                                            LARGE_FILE_PARSE_CHUNK_MICROS, 0);
+        // the lines of the edit were covered by the stale tree, the content of the lines does not move
+        change = ChangedLines{deferred->lines.first, deferred->lines.newLast, deferred->lines.newLast};
+        extendChange(tree, parsed, *change);
+        ts_tree_delete(tree);
+        tree = parsed;
+        parseTimer.reset();
+        parseSpan.end();
+        parseMetaBlocks(true);
+    }
+    std::optional<LineSpan> metaLines = parseDeferredMetas(LineSpan{0, UINT32_MAX});
+    if (metaLines) {
+        if (!change) {
+            change = ChangedLines{metaLines->first, metaLines->last, metaLines->last};
+        } else {
+            change->first = std::min(change->first, metaLines->first);
+            uint32_t last = std::max(change->newLast, metaLines->last);
+            change->oldLast = change->newLast = last;
+        }
+    }
+    ++version;
+    lastChange = change;
+    return true;
+}
+
+std::optional<LineSpan> WooWooDocument::parseDeferredMetas(LineSpan lines) {
+    std::optional<LineSpan> parsed;
+    // the first block which does not end before the lines
+    auto first = std::lower_bound(metaBlocks.begin(), metaBlocks.end(), lines.first,
+                                  [](const MetaContext &m, uint32_t line) { return m.lastLine() < line; });
+    for (auto mx = first; mx != metaBlocks.end() && mx->lineOffset <= lines.last; ++mx) {
+        if (mx->isParsed()) continue;
+        parseMetaBlock(*mx);
+        // the blocks are in document order
+        parsed = LineSpan{parsed ? parsed->first : mx->lineOffset, mx->lastLine()};
+    }
+    return parsed;
+}
+
+void WooWooDocument::parseMetaBlock(MetaContext &mx) {
+    TSTree *parsed = Parser::getInstance()->parseYaml(source, mx.byteOffset, mx.byteLength, mx.lineOffset, mx.tree);
+    ts_tree_delete(mx.tree);
+    mx.tree = parsed;
+    mx.edited = false;
+}
+
+/**
+ * Converts a (line, UTF-8 column) position to a byte offset in the source.
+ * Columns past the end of the line are clamped to the end of the line, as LSP prescribes.
+ */
+uint32_t WooWooDocument::byteOffset(uint32_t line, uint32_t column) const {
+    if (line >= utfMappings->lineCount()) {
+        return source.size();
+    }
+    uint32_t lineStart = utfMappings->lineStart(line);
+    // the next line starts right after the new line character
+    uint32_t lineEnd = line + 1 < utfMappings->lineCount() ? utfMappings->lineStart(line + 1) - 1 : source.size();
+    return std::min(lineStart + column, lineEnd);
+}
+
 void WooWooDocument::updateComments() {
+    // the line table is up to date, only the first character of every line has to be checked
+    std::vector<uint32_t> commentLineNumbers;
+    for (uint32_t line = 0; line < utfMappings->lineCount(); ++line) {
+        uint32_t lineStart = utfMappings->lineStart(line);
+        if (lineStart < source.size() && source[lineStart] == '%') {
+            commentLineNumbers.emplace_back(line);
+        }
+    }
+    updateComments(commentLineNumbers);
+}
 
-    std::istringstream stream(source);
-    std::string line;
-    uint32_t lineIndex = 0;
-    while (std::getline(stream, line)) {
-        if (!line.empty() && line[0] == '%')
-            commentLines.emplace_back(new CommentLine(lineIndex, line.size()));
-        lineIndex++;
+void WooWooDocument::updateComments(const std::vector<uint32_t> &commentLineNumbers) {
+    commentLines.clear();
+    commentLines.reserve(commentLineNumbers.size());
+
+    for (uint32_t line: commentLineNumbers) {
+        uint32_t lineStart = utfMappings->lineStart(line);
+        uint32_t lineEnd = line + 1 < utfMappings->lineCount() ? utfMappings->lineStart(line + 1) - 1 : source.size();
+        commentLines.emplace_back(line, lineEnd - lineStart);
     }
+}
 
+bool WooWooDocument::isMaterialized() const {
+    return materialized;
 }
 
-std::string WooWooDocument::substr(uint32_t startByte, uint32_t endByte) const {
-    return source.substr(startByte, endByte - startByte);
+bool WooWooDocument::dematerialize() {
+    // changes made only in memory would be lost
+    if (!materialized || !diskState.has_value()) return false;
+    unload();
+    return true;
 }
 
-std::string WooWooDocument::getNodeText(TSNode node) const {
+void WooWooDocument::unload() {
+    deferredParse.reset();
+    // give the memory back, not only reset the storage
+    std::vector<MetaContext>().swap(metaBlocks);
+    std::vector<CommentLine>().swap(commentLines);
+    ts_tree_delete(tree);
+    tree = nullptr;
+    std::string().swap(source);
+    delete utfMappings;
+    utfMappings = new UTF8toUTF16Mapping();
+    materialized = false;
+}
+
+size_t WooWooDocument::memoryUsage() const {
+    if (!materialized) return 0;
+    // tree-sitter does not report the size of a tree, its nodes take several times the size of the text
+    const size_t treeBytesPerSourceByte = 8;
+    return source.capacity() * (1 + treeBytesPerSourceByte) + utfMappings->lineCount() * sizeof(uint32_t);
+}
+
+DocumentMemoryUsage WooWooDocument::measureMemory() const {
+    DocumentMemoryUsage usage;
+    usage.uri = utils::pathToUri(documentPath);
+    usage.materialized = materialized;
+    usage.source = memory::heapBytes(source);
+    usage.tree = memory::treeBytes(tree);
+    usage.metaTrees = metaBlocks.capacity() * sizeof(MetaContext);
+    for (const MetaContext &mx: metaBlocks) {
+        usage.metaTrees += memory::treeBytes(mx.tree) + memory::heapBytes(mx.parentName);
+    }
+    usage.utfMappings = sizeof(UTF8toUTF16Mapping) + utfMappings->memoryUsage();
+    usage.commentLines = memory::heapBytes(commentLines);
+    return usage;
+}
+
+std::string_view WooWooDocument::substr(uint32_t startByte, uint32_t endByte) const {
+    return std::string_view(source).substr(startByte, endByte - startByte);
+}
+
+std::string_view WooWooDocument::getNodeText(TSNode node) const {
     // function assumes that the node is a part of this document!
     uint32_t start_byte = ts_node_start_byte(node);
     uint32_t end_byte = ts_node_end_byte(node);
     return substr(start_byte, end_byte);
 }
 
-std::string WooWooDocument::getMetaNodeText(MetaContext *mx, TSNode node) const {
-    uint32_t meta_start_byte = ts_node_start_byte(node);
-    uint32_t meta_end_byte = ts_node_end_byte(node);
-    return substr(meta_start_byte + mx->byteOffset, meta_end_byte + mx->byteOffset);
-}
-
 
 void WooWooDocument::deleteCommentsAndMetas() {
-    for (MetaContext *metaBlock: metaBlocks) {
-        delete metaBlock;
-    }
+    // the storage is kept for the next version
     metaBlocks.clear();
-
-    for (CommentLine *commentLine: commentLines) {
-        delete commentLine;
-    }
     commentLines.clear();
-
 }
 
 WooWooDocument::~WooWooDocument() {
-    deleteCommentsAndMetas();
     ts_tree_delete(tree);
     tree = nullptr;
+    delete utfMappings;
 }
 
 MetaContext *WooWooDocument::getMetaContextByLine(uint32_t line) {
-    for (MetaContext * mx : metaBlocks){
-        if(mx->lineOffset <= line && line <= (ts_node_end_point(ts_tree_root_node(mx->tree)).row + mx->lineOffset) ){
-            return mx;
-        }
+    // the last block starting on the line or before it
+    auto mx = std::upper_bound(metaBlocks.begin(), metaBlocks.end(), line,
+                               [](uint32_t l, const MetaContext &m) { return l < m.lineOffset; });
+    if (mx == metaBlocks.begin() || (--mx)->lastLine() < line) {
+        return nullptr;
+    }
+    if (!mx->isParsed()) {
+        parseDeferredMetas(LineSpan{line, line});
+    }
+    return &*mx;
+}
+
+MetaContext *WooWooDocument::getMetaContextByByte(uint32_t byte) {
+    auto mx = std::upper_bound(metaBlocks.begin(), metaBlocks.end(), byte,
+                               [](uint32_t b, const MetaContext &m) { return b < m.byteOffset; });
+    if (mx == metaBlocks.begin()) {
+        return nullptr;
+    }
+    --mx;
+    // the end of the block still belongs to it (the cursor right after the last character)
+    if (mx->byteOffset + mx->byteLength < byte) {
+        return nullptr;
+    }
+    if (!mx->isParsed()) {
+        parseMetaBlock(*mx);
     }
-    return nullptr;
-}
\ No newline at end of file
+    return &*mx;
+}
+
+MetaContext *WooWooDocument::getMetaContextAt(uint32_t line, uint32_t column) {
+    return getMetaContextByByte(byteOffset(line, column));
+}
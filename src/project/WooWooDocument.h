@@ -5,38 +5,150 @@
 #ifndef WUFF_WOOWOODOCUMENT_H
 #define WUFF_WOOWOODOCUMENT_H
 
+#include <atomic>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <tree_sitter/api.h>
 #include "../parser/Parser.h"
 #include "UTF8toUTF16Mapping.h"
 #include "CommentLine.h"
+#include "../lsp/LSPTypes.h"
+#include "../utils/MemoryUsage.h"
 
 namespace fs = std::filesystem;
 
+class WooWooProject;
+
+// state of a file on disk at the time it was read
+struct FileState {
+    int64_t modificationTime;
+    uint64_t size;
+    uint64_t contentHash;
+};
+
+// lines [first, oldLast] of the previous version of a document which became lines [first, newLast]
+struct ChangedLines {
+    uint32_t first;
+    uint32_t oldLast;
+    uint32_t newLast;
+};
+
 class WooWooDocument {
 
 private:
     void updateComments();
+    void updateComments(const std::vector<uint32_t> &commentLineNumbers);
     void deleteCommentsAndMetas();
-    
+    void reparse(ChangedLines *change = nullptr);
+    void shiftMetaBlocks(const TSInputEdit &edit);
+    // parses the YAML of the block, incrementally if its tree was edited
+    void parseMetaBlock(MetaContext &mx);
+    [[nodiscard]] uint32_t byteOffset(uint32_t line, uint32_t column) const;
+    // whether the edit replaces a range by the text it already has
+    [[nodiscard]] bool isNoOpEdit(const TextEdit &edit) const;
+    // the content of the file and its state, nullopt if it cannot be read
+    [[nodiscard]] std::optional<std::pair<std::string, FileState>> readFromDisk() const;
+    // parses the YAML of the meta blocks, of the visible ones only if deferOutOfView is set
+    void parseMetaBlocks(bool deferOutOfView);
+    // extends the change to cover also the lines whose syntax differs between the trees
+    static void extendChange(const TSTree *oldTree, const TSTree *newTree, ChangedLines &change);
+
+    // the parse of an edit of a large document which ran out of its budget
+    struct DeferredParse {
+        PendingParse parse;
+        // the lines of the edit, relative to the previous version
+        ChangedLines lines{};
+    };
+    // shared by the versions built on this one, resumed by finishDeferredWork()
+    std::shared_ptr<DeferredParse> deferredParse;
+
+    static std::atomic<size_t> largeFileThreshold;
+    static std::atomic<uint64_t> largeFileParseBudget;
+
+protected:
+    // false while only the path of the document is known (the source was not read yet)
+    bool materialized = false;
+    // drops the source and the syntax trees
+    virtual void unload();
+
 public:
-    TSTree* tree;
-    std::vector<MetaContext *> metaBlocks;
-    std::vector<CommentLine *> commentLines;
+    TSTree* tree = nullptr;
     UTF8toUTF16Mapping * utfMappings;
 
     fs::path documentPath;
+    // the project the document currently belongs to, maintained by the project
+    WooWooProject * project = nullptr;
     std::string source;
-    
-    WooWooDocument(fs::path documentPath1);
+    // set if the source is the content of the file on disk, unset once it is changed in memory
+    std::optional<FileState> diskState;
+
+    // increases with every change of the source
+    uint64_t version = 0;
+    // what the last (incremental) change touched, unset if the whole source was replaced
+    std::optional<ChangedLines> lastChange;
+
+    // objects of the current parse, by value; a new version reuses the storage of the previous one;
+    // the meta blocks do not overlap and are kept in document order (by line and by byte), lookups are binary searches
+    std::vector<MetaContext> metaBlocks;
+    std::vector<CommentLine> commentLines;
+
+    // lines shown by the client, the expensive features of a large document are limited to them;
+    // it belongs to the document, not to a version
+    std::optional<LineSpan> viewport;
+
+    // the source is read and parsed right away unless loadSource is false
+    explicit WooWooDocument(fs::path documentPath1, bool loadSource = true);
+    // independent copy of the current version, the syntax trees are shared until one of the documents changes
+    WooWooDocument(const WooWooDocument &other);
+    WooWooDocument &operator=(const WooWooDocument &) = delete;
     virtual ~WooWooDocument();
 
+    [[nodiscard]] bool isMaterialized() const;
+    // exchanges the versions (source, trees, mappings, state) of the documents, not their path or project
+    void swapVersion(WooWooDocument &other);
+    // frees the source and the syntax trees if they can be read again from the disk, returns whether it did
+    bool dematerialize();
+    // rough number of bytes held by the source, the syntax trees and the mappings of the document
+    [[nodiscard]] size_t memoryUsage() const;
+    // bytes held by the parts of the document, counted (and the trees walked) for a report, not for the eviction
+    [[nodiscard]] virtual DocumentMemoryUsage measureMemory() const;
+
+    // reads the source from the disk, nothing is parsed again if it did not change
     void updateSource();
+    // marks the source changed in memory as the content of the file again if the file has the same content
+    // (e.g. after it was saved), returns whether it did
+    bool refreshDiskState();
     virtual void updateSource(std::string &source);
-    [[nodiscard]] std::string getNodeText(TSNode node) const;
-    std::string getMetaNodeText(MetaContext * mx, TSNode node) const;
-    [[nodiscard]] std::string substr(uint32_t startByte, uint32_t endByte) const;
+    virtual void updateSource(const std::vector<TextEdit> &edits);
+    void applyEdit(const TextEdit &edit);
+    // views into the source, valid only until the source of the document changes;
+    // nodes of the meta blocks are positioned in the source as well
+    [[nodiscard]] std::string_view getNodeText(TSNode node) const;
+    [[nodiscard]] std::string_view substr(uint32_t startByte, uint32_t endByte) const;
+    // the meta block covering the line/byte/position (UTF-8), nullptr if there is none;
+    // the YAML of a block which was not parsed yet is parsed
     MetaContext * getMetaContextByLine(uint32_t line);
+    MetaContext * getMetaContextByByte(uint32_t byte);
+    MetaContext * getMetaContextAt(uint32_t line, uint32_t column);
+
+    /**
+     * Documents of at least thresholdBytes (0 turns the mode off) are large. An edit of a large document
+     * is parsed for at most parseBudgetMicros, the rest of the parse and the YAML of the meta blocks out of view
+     * are left to finishDeferredWork(). Applies to all documents of the process.
+     */
+    static void setLargeFileMode(size_t thresholdBytes, uint64_t parseBudgetMicros);
+    [[nodiscard]] bool isLarge() const;
+    // the viewport, or the first lines of the document if the client did not set it
+    [[nodiscard]] LineSpan visibleLines() const;
+    // the tree is the edited tree of the previous version until the parse is finished
+    [[nodiscard]] bool isParsePending() const;
+    // the parse or some meta blocks wait for finishDeferredWork()
+    [[nodiscard]] bool hasDeferredWork() const;
+    // finishes the parse and parses every meta block as a new version, returns whether there was anything to do
+    virtual bool finishDeferredWork();
+    // parses the deferred meta blocks overlapping the lines, returns the lines of the blocks it parsed
+    std::optional<LineSpan> parseDeferredMetas(LineSpan lines);
 };
 
 
@@ -5,56 +5,168 @@
 #include "WooWooProject.h"
 #include "DialectedWooWooDocument.h"
 #include "../utils/utils.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
 
+namespace {
+    std::atomic<uint64_t> lastDocumentsVersion{0};
+}
 
-WooWooProject::WooWooProject() : projectFolderPath(std::nullopt) {}
 
-WooWooProject::WooWooProject(const fs::path &projectFolderPath) : projectFolderPath(projectFolderPath) {
+WooWooProject::WooWooProject()
+        : documentsVersion(++lastDocumentsVersion), indexVersion(documentsVersion), projectFolderPath(std::nullopt) {}
 
-    // Woofile parsing disabled for now - just detect project by Woofile existence
-    // TODO: Enable when Woofile features (bibtex, etc.) are implemented
-    woofile = nullptr;
+WooWooProject::WooWooProject(const fs::path &projectFolderPath, const std::vector<fs::path> &documentPaths,
+                             ThreadPool *threadPool, const IndexCache *indexCache)
+        : documentsVersion(++lastDocumentsVersion), indexVersion(documentsVersion),
+          projectFolderPath(projectFolderPath) {
 
-    for (const auto &entry: fs::recursive_directory_iterator(projectFolderPath)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".woo") {
-            loadDocument(entry.path());
-        }
-    }
+    // its "exclude" patterns are applied by the WorkspaceScanner, the bibliography is loaded by the analyzer
+    loadWoofile();
 
+    loadDocuments(documentPaths, threadPool, indexCache);
 }
 
 
 void WooWooProject::loadDocument(const fs::path &documentPath) {
-    documents[documentPath.generic_string()] = std::make_shared<DialectedWooWooDocument>(documentPath);
+    auto document = std::make_shared<DialectedWooWooDocument>(documentPath, dialect);
+    addDocument(document);
+}
+
+std::shared_ptr<DialectedWooWooDocument>
+WooWooProject::createDocument(const fs::path &documentPath, const IndexCache *indexCache,
+                              const std::shared_ptr<const DialectManager> &dialect) {
+    if (indexCache) {
+        uint64_t dialectHash = (dialect ? dialect.get() : DialectManager::getInstance())->dialectHash;
+        auto cached = indexCache->lookup(documentPath, dialectHash);
+        if (cached.has_value()) {
+            return std::make_shared<DialectedWooWooDocument>(documentPath, std::move(cached->index), cached->state,
+                                                             dialect);
+        }
+    }
+    // only the index is kept, the document is parsed again once it is needed
+    auto document = std::make_shared<DialectedWooWooDocument>(documentPath, dialect);
+    document->dematerialize();
+    return document;
+}
+
+void WooWooProject::loadDocuments(const std::vector<fs::path> &documentPaths, ThreadPool *threadPool,
+                                  const IndexCache *indexCache) {
+    // the order of the directory walk is unspecified, merge in a fixed order
+    std::vector<fs::path> sortedPaths = documentPaths;
+    std::sort(sortedPaths.begin(), sortedPaths.end());
+
+    if (!threadPool || threadPool->size() < 2 || sortedPaths.size() < 2) {
+        for (const fs::path &documentPath: sortedPaths) {
+            addDocument(createDocument(documentPath, indexCache, dialect));
+        }
+        return;
+    }
+
+    std::vector<std::future<std::shared_ptr<DialectedWooWooDocument>>> loadedDocuments;
+    loadedDocuments.reserve(sortedPaths.size());
+    for (const fs::path &documentPath: sortedPaths) {
+        loadedDocuments.emplace_back(threadPool->submit([documentPath, indexCache, projectDialect = dialect]() {
+            return createDocument(documentPath, indexCache, projectDialect);
+        }, Lane::Indexing));
+    }
+    // documents and the reference index are only modified from this thread
+    for (auto &loadedDocument: loadedDocuments) {
+        addDocument(loadedDocument.get());
+    }
 }
 
 void WooWooProject::addDocument(const std::shared_ptr<DialectedWooWooDocument>& document) {
-    documents[document->documentPath.generic_string()] = document;
+    auto [slot, added] = slotsByPath.try_emplace(document->documentPath.generic_string(),
+                                                 static_cast<uint32_t>(documents.size()));
+    if (added) {
+        documents.push_back(document.get());
+        owners.push_back(document);
+    } else if (owners[slot->second] != document) {
+        DialectedWooWooDocument *replaced = documents[slot->second];
+        referenceIndex.removeDocument(replaced);
+        labelIndex.removeDocument(replaced);
+        includeGraph.removeDocument(replaced);
+        documents[slot->second] = document.get();
+        owners[slot->second] = document;
+    }
+    document->project = this;
+    documentsVersion = ++lastDocumentsVersion;
+    indexVersion = documentsVersion;
+    referenceIndex.indexDocument(document.get());
+    labelIndex.indexDocument(document.get());
+    includeGraph.indexDocument(document.get());
+}
+
+void WooWooProject::documentChanged(DialectedWooWooDocument *document) {
+    indexVersion = ++lastDocumentsVersion;
+    referenceIndex.indexDocument(document);
+    labelIndex.indexDocument(document);
+    includeGraph.indexDocument(document);
+}
+
+std::set<DialectedWooWooDocument *>
+WooWooProject::getDocumentsReferencing(const Reference &reference, const std::string &value) const {
+    return referenceIndex.getReferencingDocuments(reference.metaKey, value);
+}
+
+std::set<DialectedWooWooDocument *>
+WooWooProject::getDocumentsReferencing(const std::string &metaKey, const std::string &value) const {
+    return referenceIndex.getReferencingDocuments(metaKey, value);
+}
+
+const std::unordered_map<DialectedWooWooDocument *, uint32_t> *
+WooWooProject::getDefinitionSites(SymbolId metaKey, const std::string &value) const {
+    return referenceIndex.getDefinitionSites(metaKey, value);
+}
+
+std::set<DialectedWooWooDocument *>
+WooWooProject::getDocumentsDefining(std::span<const Reference> references, const std::string &value) const {
+    return referenceIndex.getDefiningDocuments(references, value);
+}
+
+const std::set<DialectedWooWooDocument *> *WooWooProject::getDocumentsIncluding(const std::string &path) const {
+    return includeGraph.getIncluding(path);
+}
+
+std::vector<LabelIndex::Match> WooWooProject::searchLabels(std::string_view query, size_t limit) const {
+    return labelIndex.search(query, limit);
+}
+
+std::vector<std::string_view>
+WooWooProject::completeReferencables(std::string_view referencingType, std::string_view prefix, size_t limit,
+                                     bool &incomplete) const {
+    return labelIndex.completions(SymbolTable::getInstance()->find(referencingType), prefix, limit, incomplete);
+}
+
+uint64_t WooWooProject::getDocumentsVersion() const {
+    return documentsVersion;
+}
+
+uint64_t WooWooProject::getIndexVersion() const {
+    return indexVersion;
 }
 
 DialectedWooWooDocument * WooWooProject::getDocument(const std::string &docPath) {
-    auto doc = documents.find(docPath);
-    if (doc != documents.end()) {
-        return doc->second.get();
+    auto slot = slotsByPath.find(docPath);
+    if (slot != slotsByPath.end()) {
+        return documents[slot->second];
     }
     return nullptr;
 }
 
 DialectedWooWooDocument * WooWooProject::getDocument(const WooWooDocument*  document) {
-    for (const auto &doc: documents) {
-        if (doc.second->documentPath == document->documentPath) {
-            return doc.second.get();
-        }
-    }
-    return nullptr;
+    return getDocument(document->documentPath.generic_string());
 }
 
-std::set<DialectedWooWooDocument * > WooWooProject::getAllDocuments() {
-    std::set<DialectedWooWooDocument * > documentSet;
-    for (const auto &pair: documents) {
-        documentSet.insert(pair.second.get());
-    }
-    return documentSet;
+std::span<DialectedWooWooDocument *const> WooWooProject::getDocuments() const {
+    return documents;
+}
+
+size_t WooWooProject::documentCount() const {
+    return documents.size();
 }
 
 
@@ -69,18 +181,92 @@ void WooWooProject::deleteDocumentByUri(const std::string &uri) {
 }
 
 std::shared_ptr<DialectedWooWooDocument> WooWooProject::getDocumentShared(WooWooDocument *document) {
-    for (const auto &doc: documents) {
-        if (doc.second->documentPath == document->documentPath) {
-            return doc.second;
-        }
+    auto slot = slotsByPath.find(document->documentPath.generic_string());
+    if (slot != slotsByPath.end()) {
+        return owners[slot->second];
     }
     return nullptr;
 }
 
 void WooWooProject::deleteDocument(const DialectedWooWooDocument * document) {
     if (!document) return;
-    auto it = documents.find(document->documentPath.generic_string());
-    if (it != documents.end()) {
-        documents.erase(it);
+    referenceIndex.removeDocument(document);
+    labelIndex.removeDocument(document);
+    includeGraph.removeDocument(document);
+    auto slot = slotsByPath.find(document->documentPath.generic_string());
+    if (slot != slotsByPath.end()) {
+        uint32_t removed = slot->second;
+        slotsByPath.erase(slot);
+        if (documents[removed]->project == this) {
+            documents[removed]->project = nullptr;
+        }
+        // the last document takes the slot, the rest of them stay where they are
+        uint32_t last = static_cast<uint32_t>(documents.size() - 1);
+        if (removed != last) {
+            documents[removed] = documents[last];
+            owners[removed] = std::move(owners[last]);
+            slotsByPath[documents[removed]->documentPath.generic_string()] = removed;
+        }
+        documents.pop_back();
+        owners.pop_back();
+        documentsVersion = ++lastDocumentsVersion;
+        indexVersion = documentsVersion;
+    }
+}
+
+std::vector<fs::path> WooWooProject::loadWoofile() {
+    woofile.reset();
+    if (!projectFolderPath.has_value()) return {};
+    try {
+        woofile = std::make_unique<Woofile>(projectFolderPath.value());
+    } catch (const std::exception &e) {
+        // the Woofile still marks a project even if it cannot be read
+        std::cerr << "Could not read Woofile in " << projectFolderPath.value() << ": " << e.what() << std::endl;
+        dialect.reset();
+        return {};
+    }
+    loadDialect();
+    return bibliographyFiles();
+}
+
+void WooWooProject::loadDialect() {
+    if (woofile->dialect.empty()) {
+        dialect.reset();
+        return;
+    }
+    try {
+        // compiled once for all projects naming a dialect with the same content
+        dialect = DialectManager::loadShared(woofile->dialect.string());
+    } catch (const std::exception &e) {
+        std::cerr << "Could not load dialect " << woofile->dialect << " of project " << projectFolderPath.value()
+                  << ", using the dialect of the client: " << e.what() << std::endl;
+        dialect.reset();
+    }
+}
+
+std::vector<fs::path> WooWooProject::bibliographyFiles() const {
+    if (!woofile || woofile->bibtex.empty()) return {};
+    return {woofile->bibtex};
+}
+
+void WooWooProject::bibliographyChanged() {
+    indexVersion = ++lastDocumentsVersion;
+}
+
+void WooWooProject::measureMemory(MemoryUsage &usage) const {
+    // the slots, the map of their paths and the documents themselves (and the control blocks of their shared
+    // pointers)
+    size_t documentObjects = documents.capacity() * sizeof(DialectedWooWooDocument *) +
+                             owners.capacity() * sizeof(std::shared_ptr<DialectedWooWooDocument>) +
+                             slotsByPath.bucket_count() * sizeof(void *);
+    for (const auto &[path, slot]: slotsByPath) {
+        usage.documents.push_back(documents[slot]->measureMemory());
+        documentObjects += sizeof(decltype(slotsByPath)::value_type) + memory::heapBytes(path) +
+                           sizeof(DialectedWooWooDocument) + 3 * memory::ALLOCATION_OVERHEAD;
     }
+    usage.subsystems["documents"] += documentObjects;
+    usage.subsystems["reference_index"] += referenceIndex.memoryUsage();
+    usage.subsystems["label_index"] += labelIndex.memoryUsage();
+    usage.subsystems["include_graph"] += includeGraph.memoryUsage();
+    usage.subsystems["bibliography"] += bibliography.memoryUsage();
 }
@@ -7,8 +7,16 @@
 #include <string>
 #include <unordered_map>
 #include <filesystem>
+#include <span>
+#include <vector>
 #include "DialectedWooWooDocument.h"
 #include "Woofile.h"
+#include "ReferenceIndex.h"
+#include "LabelIndex.h"
+#include "IncludeGraph.h"
+#include "IndexCache.h"
+#include "BibliographyIndex.h"
+#include "../utils/ThreadPool.h"
 
 namespace fs = std::filesystem;
 
@@ -16,21 +24,78 @@ namespace fs = std::filesystem;
 class WooWooProject {
 
 private:
-    std::unordered_map<std::string, std::shared_ptr<DialectedWooWooDocument>> documents;
+    // the documents, densely by their slots (a removed one is replaced by the last one), iterated without
+    // allocating; owners keeps them alive in the same slots
+    std::vector<DialectedWooWooDocument *> documents;
+    std::vector<std::shared_ptr<DialectedWooWooDocument>> owners;
+    // path (generic) -> slot
+    std::unordered_map<std::string, uint32_t> slotsByPath;
+    ReferenceIndex referenceIndex;
+    LabelIndex labelIndex;
+    IncludeGraph includeGraph;
+    uint64_t documentsVersion;
+    uint64_t indexVersion;
+    void loadDialect();
 public:
-    Woofile * woofile;
+    // nullptr if the project has no folder or its Woofile cannot be read
+    std::unique_ptr<Woofile> woofile;
     std::optional<fs::path> projectFolderPath;
+    // entries of the bibliography named by the Woofile, kept up to date by the analyzer
+    BibliographyIndex bibliography;
+    // the dialect named by the Woofile (shared with the projects naming the same one), nullptr if the project
+    // uses the dialect of the client; the documents are indexed again by the analyzer when it changes
+    std::shared_ptr<const DialectManager> dialect;
     WooWooProject();
-    WooWooProject(const fs::path & projectFolderPath);
+    WooWooProject(const fs::path & projectFolderPath, const std::vector<fs::path> & documentPaths,
+                  ThreadPool * threadPool = nullptr, const IndexCache * indexCache = nullptr);
     DialectedWooWooDocument * getDocument(const std::string & docPath);
     DialectedWooWooDocument * getDocument(const WooWooDocument * document);
     DialectedWooWooDocument * getDocumentByUri(const std::string &docUri);
     std::shared_ptr<DialectedWooWooDocument> getDocumentShared(WooWooDocument * doc);
-    std::set<DialectedWooWooDocument *> getAllDocuments();  // New member function declaration
+    // every document of the project, in no particular order; valid until a document is added or removed
+    [[nodiscard]] std::span<DialectedWooWooDocument *const> getDocuments() const;
+    [[nodiscard]] size_t documentCount() const;
     void deleteDocumentByUri(const std::string &uri);
     void loadDocument(const fs::path &documentPath);
+    // the document to be added, with its cached index if it is valid, otherwise parsed (and unloaded again);
+    // touches no project, can run on any thread
+    static std::shared_ptr<DialectedWooWooDocument> createDocument(const fs::path &documentPath, const IndexCache * indexCache,
+                                                                   const std::shared_ptr<const DialectManager> & dialect);
+    // documents are read and parsed in parallel if a pool is given, the result does not depend on it
+    // only the indexes of the documents are kept, the documents are parsed again once they are needed
+    void loadDocuments(const std::vector<fs::path> &documentPaths, ThreadPool * threadPool,
+                       const IndexCache * indexCache = nullptr);
     void deleteDocument(const DialectedWooWooDocument * document);
+    // replaces the document with the same path, if there is one
     void addDocument(const std::shared_ptr<DialectedWooWooDocument>& document);
+    // has to be called after the source of a document changes, keeps the reference and label indexes up to date
+    void documentChanged(DialectedWooWooDocument * document);
+    std::set<DialectedWooWooDocument *> getDocumentsReferencing(const Reference & reference, const std::string & value) const;
+    std::set<DialectedWooWooDocument *> getDocumentsReferencing(const std::string & metaKey, const std::string & value) const;
+    // documents defining the value under the metaKey, with the number of defining fields in each of them
+    [[nodiscard]] const std::unordered_map<DialectedWooWooDocument *, uint32_t> *
+    getDefinitionSites(SymbolId metaKey, const std::string & value) const;
+    std::set<DialectedWooWooDocument *> getDocumentsDefining(std::span<const Reference> references, const std::string & value) const;
+    // documents of the project including the file (by its absolute, lexically normal path), nullptr if none
+    [[nodiscard]] const std::set<DialectedWooWooDocument *> *getDocumentsIncluding(const std::string & path) const;
+    // labels defined in the documents of the project, best matches of the query first
+    [[nodiscard]] std::vector<LabelIndex::Match> searchLabels(std::string_view query, size_t limit) const;
+    // values referencable by the type starting with the prefix (see LabelIndex::completions)
+    [[nodiscard]] std::vector<std::string_view> completeReferencables(std::string_view referencingType,
+                                                                      std::string_view prefix, size_t limit,
+                                                                      bool &incomplete) const;
+    // changes whenever a document is added to or removed from the project, unique among all projects
+    [[nodiscard]] uint64_t getDocumentsVersion() const;
+    // changes whenever a document is added, removed or changed (its index is updated) and when the bibliography
+    // changes, unique among all projects
+    [[nodiscard]] uint64_t getIndexVersion() const;
+    // reads the Woofile (and the dialect it names) again, returns the bibliography files it names (absolute)
+    std::vector<fs::path> loadWoofile();
+    [[nodiscard]] std::vector<fs::path> bibliographyFiles() const;
+    // has to be called after the entries of the bibliography changed
+    void bibliographyChanged();
+    // adds the documents of the project and its indexes to the report (not the totals)
+    void measureMemory(MemoryUsage & usage) const;
 };
 
 
@@ -7,8 +7,12 @@
 Woofile::Woofile(const fs::path &projectFolderPath) {
     YAML::Node yamlData = YAML::LoadFile((projectFolderPath / "Woofile").string());
     deserialize(yamlData);
-    // TODO: if bibtex is set, load it and process it
-    // https://gitlab.fit.cvut.cz/BI-MA1/bi-ma1/-/blob/master/src/textbook/references.bib
+    if (!bibtex.empty() && bibtex.is_relative()) {
+        bibtex = (projectFolderPath / bibtex).lexically_normal();
+    }
+    if (!dialect.empty() && dialect.is_relative()) {
+        dialect = (projectFolderPath / dialect).lexically_normal();
+    }
 }
 
 void Woofile::deserialize(const YAML::Node &node) {
@@ -17,5 +21,18 @@ void Woofile::deserialize(const YAML::Node &node) {
     } else {
         bibtex.clear();
     }
+
+    if (node["dialect"]) {
+        dialect = node["dialect"].as<std::string>();
+    } else {
+        dialect.clear();
+    }
+
+    exclude.clear();
+    if (node["exclude"] && node["exclude"].IsSequence()) {
+        for (const auto &pattern: node["exclude"]) {
+            exclude.emplace_back(pattern.as<std::string>());
+        }
+    }
 }
 
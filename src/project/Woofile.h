@@ -7,13 +7,22 @@
 
 #include "yaml-cpp/yaml.h"
 #include <filesystem>
+#include <string>
+#include <vector>
 namespace fs = std::filesystem;
 
 class Woofile {
 public:
+    // throws if the Woofile cannot be read or parsed
     Woofile(const fs::path & projectFolderPath);
     
+    // the bibliography (builder.bibtex), absolute once the Woofile is loaded; empty if there is none
     fs::path bibtex;
+    // the dialect (YAML or image) of the documents of the project, absolute once the Woofile is loaded;
+    // empty if the project uses the dialect of the client
+    fs::path dialect;
+    // gitignore-like patterns (relative to the project folder) of files and folders which are not part of the project
+    std::vector<std::string> exclude;
     void deserialize(const YAML::Node& node);
 
 };
@@ -0,0 +1,197 @@
+#include "WorkspaceScanner.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include "Woofile.h"
+#include "../utils/utils.h"
+
+namespace {
+    struct IgnoreRule {
+        fs::path base;
+        std::string pattern;
+        bool negated = false;
+        bool directoryOnly = false;
+        // patterns with a slash are matched against the path relative to the base, others against the name
+        bool anchored = false;
+    };
+
+    // rules are shared by a whole subtree and only copied when a folder adds new ones
+    using IgnoreRules = std::shared_ptr<const std::vector<IgnoreRule>>;
+
+    struct PendingDirectory {
+        fs::path path;
+        std::optional<fs::path> project;
+        IgnoreRules rules;
+    };
+
+    struct ScannedDirectory {
+        std::optional<fs::path> project;
+        bool isProject = false;
+        std::vector<fs::path> documents;
+        std::vector<PendingDirectory> subdirectories;
+    };
+
+    std::optional<IgnoreRule> parseIgnoreLine(std::string line, const fs::path &base) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') return std::nullopt;
+
+        IgnoreRule rule;
+        rule.base = base;
+        if (line[0] == '!') {
+            rule.negated = true;
+            line.erase(0, 1);
+        }
+        if (!line.empty() && line.back() == '/') {
+            rule.directoryOnly = true;
+            line.pop_back();
+        }
+        rule.anchored = line.find('/') != std::string::npos;
+        if (!line.empty() && line[0] == '/') {
+            line.erase(0, 1);
+        }
+        if (line.empty()) return std::nullopt;
+        rule.pattern = line;
+        return rule;
+    }
+
+    bool isIgnored(const std::vector<IgnoreRule> &rules, const fs::path &path, bool isDirectory) {
+        bool ignored = false;
+        // the last matching rule decides, so that negated rules can re-include paths
+        for (const IgnoreRule &rule: rules) {
+            if (rule.directoryOnly && !isDirectory) continue;
+            // only rules which could flip the current state have to be matched
+            if (rule.negated == ignored) {
+                std::string subject = rule.anchored ? path.lexically_relative(rule.base).generic_string()
+                                                    : path.filename().string();
+                if (utils::globMatch(rule.pattern, subject)) {
+                    ignored = !rule.negated;
+                }
+            }
+        }
+        return ignored;
+    }
+
+    ScannedDirectory scanDirectory(const PendingDirectory &directory) {
+        ScannedDirectory result;
+
+        std::vector<fs::directory_entry> entries;
+        std::error_code ec;
+        for (fs::directory_iterator it(directory.path, fs::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            entries.emplace_back(*it);
+        }
+
+        bool hasWoofile = false;
+        bool hasGitignore = false;
+        for (const auto &entry: entries) {
+            auto name = entry.path().filename();
+            if (name == "Woofile" && entry.is_regular_file(ec)) hasWoofile = true;
+            if (name == ".gitignore" && entry.is_regular_file(ec)) hasGitignore = true;
+        }
+
+        std::vector<IgnoreRule> newRules;
+        if (hasGitignore) {
+            std::ifstream gitignore(directory.path / ".gitignore");
+            std::string line;
+            while (std::getline(gitignore, line)) {
+                if (auto rule = parseIgnoreLine(line, directory.path)) {
+                    newRules.emplace_back(std::move(rule.value()));
+                }
+            }
+        }
+        if (hasWoofile) {
+            try {
+                Woofile woofile(directory.path);
+                for (const std::string &pattern: woofile.exclude) {
+                    if (auto rule = parseIgnoreLine(pattern, directory.path)) {
+                        newRules.emplace_back(std::move(rule.value()));
+                    }
+                }
+            } catch (const std::exception &e) {
+                // the Woofile still marks a project even if it cannot be read
+                std::cerr << "Could not read Woofile in " << directory.path << ": " << e.what() << std::endl;
+            }
+        }
+
+        IgnoreRules rules = directory.rules;
+        if (!newRules.empty()) {
+            auto extended = std::make_shared<std::vector<IgnoreRule>>(*directory.rules);
+            extended->insert(extended->end(), newRules.begin(), newRules.end());
+            rules = std::move(extended);
+        }
+
+        result.isProject = hasWoofile;
+        result.project = hasWoofile ? std::optional<fs::path>(directory.path) : directory.project;
+
+        for (const auto &entry: entries) {
+            const fs::path &path = entry.path();
+            if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+                if (path.filename() == ".git" || isIgnored(*rules, path, true)) continue;
+                result.subdirectories.push_back(PendingDirectory{path, result.project, rules});
+            } else if (path.extension() == ".woo" && entry.is_regular_file(ec) && !isIgnored(*rules, path, false)) {
+                result.documents.emplace_back(path);
+            }
+        }
+
+        std::sort(result.documents.begin(), result.documents.end());
+        std::sort(result.subdirectories.begin(), result.subdirectories.end(),
+                  [](const PendingDirectory &a, const PendingDirectory &b) { return a.path < b.path; });
+        return result;
+    }
+}
+
+WorkspaceScanner::WorkspaceScanner(ThreadPool *threadPool) : threadPool(threadPool) {}
+
+WorkspaceLayout WorkspaceScanner::scan(const fs::path &rootPath) const {
+    WorkspaceLayout layout;
+
+    std::error_code ec;
+    if (!fs::is_directory(rootPath, ec)) return layout;
+
+    // breadth-first, one level at a time, so that the directories of a level can be listed in parallel
+    std::vector<PendingDirectory> level{
+            PendingDirectory{rootPath, std::nullopt, std::make_shared<const std::vector<IgnoreRule>>()}};
+
+    while (!level.empty()) {
+        std::vector<ScannedDirectory> scanned;
+        scanned.reserve(level.size());
+
+        if (threadPool && threadPool->size() > 1 && level.size() > 1) {
+            std::vector<std::future<ScannedDirectory>> futures;
+            futures.reserve(level.size());
+            for (const PendingDirectory &directory: level) {
+                futures.emplace_back(threadPool->submit([&directory]() { return scanDirectory(directory); },
+                                                      Lane::Indexing));
+            }
+            for (auto &future: futures) {
+                scanned.emplace_back(future.get());
+            }
+        } else {
+            for (const PendingDirectory &directory: level) {
+                scanned.emplace_back(scanDirectory(directory));
+            }
+        }
+
+        std::vector<PendingDirectory> nextLevel;
+        for (ScannedDirectory &directory: scanned) {
+            if (directory.isProject) {
+                // also projects without any documents are created
+                layout.projects[directory.project.value()];
+            }
+            auto &documents = directory.project ? layout.projects[directory.project.value()]
+                                                : layout.standaloneDocuments;
+            documents.insert(documents.end(), directory.documents.begin(), directory.documents.end());
+            for (PendingDirectory &subdirectory: directory.subdirectories) {
+                nextLevel.emplace_back(std::move(subdirectory));
+            }
+        }
+        level = std::move(nextLevel);
+    }
+
+    return layout;
+}
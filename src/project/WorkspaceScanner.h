@@ -0,0 +1,35 @@
+#ifndef WUFF_WORKSPACESCANNER_H
+#define WUFF_WORKSPACESCANNER_H
+
+#include <filesystem>
+#include <map>
+#include <vector>
+#include "../utils/ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+struct WorkspaceLayout {
+    // project folder -> its documents, a document belongs to the innermost project containing it
+    std::map<fs::path, std::vector<fs::path>> projects;
+    // documents which are not part of any project
+    std::vector<fs::path> standaloneDocuments;
+};
+
+/**
+ * Finds all projects (folders with a Woofile) and WooWoo documents of a workspace in a single directory walk.
+ *
+ * Files and folders matched by a .gitignore or by the "exclude" patterns of a Woofile are skipped, as is
+ * every .git folder. Directories of the same depth are listed in parallel if a thread pool is given.
+ */
+class WorkspaceScanner {
+public:
+    explicit WorkspaceScanner(ThreadPool *threadPool = nullptr);
+
+    [[nodiscard]] WorkspaceLayout scan(const fs::path &rootPath) const;
+
+private:
+    ThreadPool *threadPool;
+};
+
+
+#endif //WUFF_WORKSPACESCANNER_H
@@ -1,6 +1,7 @@
 #include "tree_sitter/parser.h"
 
 #include <cctype>  // For islower and isalpha
+#include <cstring> // For memcpy
 #include <cwctype> // For iswalnum
 
 // order must match the externals array in grammar, actual names do not matter
@@ -21,6 +22,7 @@ enum TokenType {
 
 const int INDENT_LEN = 2;
 
+// state of a single scan, it is not serialized and starts over with every scan
 struct State {
 
     int space_count = 0;
@@ -28,15 +30,20 @@ struct State {
 
 };
 
+/**
+ * Tree-sitter deserializes the scanner before every scan (from the state serialized after the token before it),
+ * also when it reuses a part of an old tree. Everything a scan depends on is therefore either serialized
+ * or reset by deserialize; the scanner holds no memory of its own beyond itself.
+ */
 struct Scanner {
 
-    int16_t indent_level;
+    int16_t indent_level = 0;
 
     // the desired indentation level, -1 = nothing unprocessed
     // if the number is not -1, that means we must emit indent/dedent immediately
-    int16_t unprocessed_indentation;
+    int16_t unprocessed_indentation = -1;
 
-    State *state;
+    State state;
 
     Scanner() {
         deserialize(NULL, 0);
@@ -90,8 +97,8 @@ struct Scanner {
         } else {
             // we consumed spaces at the beginning of a line but it was NOT an empty line
             // a flag needs to be set as a sign that some spaces were scanned
-            state->space_count += spaces_consumed;
-            state->space_count_changed_flag = spaces_consumed != 0;
+            state.space_count += spaces_consumed;
+            state.space_count_changed_flag = spaces_consumed != 0;
             return false;
         }
 
@@ -138,42 +145,42 @@ struct Scanner {
             if (onNewline(lexer) && newline_count == 0) {
                 ++newline_count;
                 could_be_indent = true; // indent could be on the next line
-                state->space_count = 0;
+                state.space_count = 0;
                 advance(lexer);
                 mark_end(lexer);
 
-            } else if (state->space_count_changed_flag || lexer->lookahead == ' ') {
-                if (!state->space_count_changed_flag) {
-                    state->space_count++;
+            } else if (state.space_count_changed_flag || lexer->lookahead == ' ') {
+                if (!state.space_count_changed_flag) {
+                    state.space_count++;
                     advance(lexer);
                 } else {
                     // consumed spaces via newline detection
-                    state->space_count_changed_flag = false;
+                    state.space_count_changed_flag = false;
                 }
-                if (state->space_count == indent_level * INDENT_LEN) {
+                if (state.space_count == indent_level * INDENT_LEN) {
                     // mark end of newline (start of next content, considering indentation)
                     // may be overriden by potential indentation
                     mark_end(lexer);
 
                 }
 
-                if (state->space_count == (indent_level + 1) * INDENT_LEN) {
+                if (state.space_count == (indent_level + 1) * INDENT_LEN) {
                     // mark end of first new indent level (others may follow, but they will not be the part of this emission)
                     mark_end(lexer);
                 }
 
             } else if (lexer->eof(lexer)) {
-                state->space_count = 0;
+                state.space_count = 0;
                 break;
             } else {
                 break;
             }
         }
 
-        uint16_t new_indent_level = state->space_count / INDENT_LEN;
+        uint16_t new_indent_level = state.space_count / INDENT_LEN;
 
         if (valid_symbols[INDENT] && new_indent_level > indent_level && could_be_indent) {
-            if (state->space_count % INDENT_LEN != 0 && !valid_symbols[ERROR_SENTINEL]) {
+            if (state.space_count % INDENT_LEN != 0 && !valid_symbols[ERROR_SENTINEL]) {
                 // indent found, but there are extra spaces, return nothing, which will cause ERROR node to be added
                 // this will cause the scanner to be called one more time, but this time we do emit the indent
                 return false;
@@ -194,7 +201,7 @@ struct Scanner {
 
             if (valid_symbols[DEDENT] && new_indent_level < indent_level) {
 
-                state->space_count = 0;
+                state.space_count = 0;
                 if (valid_symbols[EMPTY_LINE] || valid_symbols[MULTI_EMPTY_LINE]) {
                     // we could just be on an empty line and the indentation level will continue on next line
                     // same for MULTI_EMPTY_LINE - in wobjects could be confused with dedent
@@ -217,14 +224,14 @@ struct Scanner {
                             multi = true;
                         }
 
-                        state->space_count_changed_flag = false;
+                        state.space_count_changed_flag = false;
                         while (lexer->lookahead == ' ') {
                             // count spaces on the first next non-empty line
                             advance(lexer);
-                            ++state->space_count;
+                            ++state.space_count;
                         }
 
-                        new_indent_level = state->space_count / INDENT_LEN;
+                        new_indent_level = state.space_count / INDENT_LEN;
 
                         if (new_indent_level == indent_level) {
                             // it was just an empty line, indent is continuing on the same level, no DEDENT
@@ -245,22 +252,22 @@ struct Scanner {
 
                     mark_end(lexer);
 
-                    state->space_count = 0;
+                    state.space_count = 0;
 
                     // consume newlines + spaces to get to the nearest content line
                     while (onNewline(lexer)) {
                         ++newline_count;
                         advance(lexer);
                     }
-                    state->space_count_changed_flag = false;
+                    state.space_count_changed_flag = false;
 
                     while (lexer->lookahead == ' ') {
                         advance(lexer);
-                        ++state->space_count;
+                        ++state.space_count;
                     }
 
 
-                    new_indent_level = state->space_count / INDENT_LEN;
+                    new_indent_level = state.space_count / INDENT_LEN;
 
                     if (new_indent_level >= indent_level) {
                         // expecting dedent, not a newline, but content is continuing on the same indent level the line below
@@ -290,19 +297,19 @@ struct Scanner {
                     for (;;) {
                         if (onNewline(lexer)) {
                             ++newline_count;
-                            state->space_count = 0;
+                            state.space_count = 0;
                             advance(lexer);
                             mark_end(lexer);
 
-                        } else if (state->space_count_changed_flag || lexer->lookahead == ' ') {
-                            if (!state->space_count_changed_flag) {
+                        } else if (state.space_count_changed_flag || lexer->lookahead == ' ') {
+                            if (!state.space_count_changed_flag) {
                                 advance(lexer);
-                                ++state->space_count;
+                                ++state.space_count;
                             } else {
-                                state->space_count_changed_flag = false;
+                                state.space_count_changed_flag = false;
                             }
 
-                            if (state->space_count == INDENT_LEN * indent_level) {
+                            if (state.space_count == INDENT_LEN * indent_level) {
                                 mark_end(lexer);
                             }
 
@@ -311,7 +318,7 @@ struct Scanner {
                         }
                     }
 
-                    new_indent_level = state->space_count / INDENT_LEN;
+                    new_indent_level = state.space_count / INDENT_LEN;
                     if (newline_count >= 2) {
                         // more than two empty lines
                         lexer->result_symbol = MULTI_EMPTY_LINE;
@@ -369,10 +376,10 @@ struct Scanner {
                 while (lexer->lookahead == ' ') {
                     // count spaces on the first next non-empty line
                     advance(lexer);
-                    ++state->space_count;
+                    ++state.space_count;
                 }
 
-                int new_indent_level = state->space_count / INDENT_LEN;
+                int new_indent_level = state.space_count / INDENT_LEN;
 
                 if (new_indent_level >= indent_level) {
                     mark_end(lexer); // (mark all the way to the point where next content is starting)
@@ -453,7 +460,7 @@ struct Scanner {
         }
 
         if (valid_symbols[TEXT] || valid_symbols[TEXT_NO_SPACE_NO_DOT] || valid_symbols[VERBOSE_INNER_ENV_META]) {
-            int spaceDotCount = state->space_count;
+            int spaceDotCount = state.space_count;
             int consumed = spaceDotCount;
             bool startWithDot = false;
 
@@ -648,24 +655,26 @@ struct Scanner {
         return lexer->lookahead == ':';
     }
 
+    // both levels whole, a char would wrap them past 127
     unsigned serialize(char *buffer) {
         size_t i = 0;
-        buffer[i++] = indent_level;
-        buffer[i++] = unprocessed_indentation;
+        memcpy(buffer + i, &indent_level, sizeof(indent_level));
+        i += sizeof(indent_level);
+        memcpy(buffer + i, &unprocessed_indentation, sizeof(unprocessed_indentation));
+        i += sizeof(unprocessed_indentation);
         return i;
     }
 
     void deserialize(const char *buffer, unsigned length) {
         indent_level = 0;
         unprocessed_indentation = -1;
-        state = new State();
-
-        size_t i = 0;
-        if (length > 0) {
-
-            indent_level = buffer[i++];
-            unprocessed_indentation = buffer[i++];
+        state = State();
 
+        if (length >= sizeof(indent_level) + sizeof(unprocessed_indentation)) {
+            size_t i = 0;
+            memcpy(&indent_level, buffer + i, sizeof(indent_level));
+            i += sizeof(indent_level);
+            memcpy(&unprocessed_indentation, buffer + i, sizeof(unprocessed_indentation));
         }
 
     }
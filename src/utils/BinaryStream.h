@@ -0,0 +1,99 @@
+#ifndef WUFF_BINARYSTREAM_H
+#define WUFF_BINARYSTREAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+/**
+ * Writes integers (in the native byte order) and length-prefixed strings, the layout of the binary
+ * files of wuff (index cache, dialect images). The files are not meant to be moved between machines.
+ */
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::ostream &out) : out(out) {}
+
+    void bytes(const char *value, size_t size) { out.write(value, static_cast<std::streamsize>(size)); }
+
+    void u32(uint32_t value) { out.write(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+    void u64(uint64_t value) { out.write(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+    void str(const std::string &value) {
+        u32(static_cast<uint32_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+private:
+    std::ostream &out;
+};
+
+// reads what BinaryWriter wrote from a buffer, once anything is out of bounds all further reads fail
+class BinaryReader {
+public:
+    explicit BinaryReader(const std::string &data) : data(data) {}
+
+    bool ok = true;
+
+    // true if the next bytes are the expected ones
+    bool expect(const char *expected, size_t size) {
+        if (!ok || data.size() - position < size || std::memcmp(data.data() + position, expected, size) != 0) {
+            ok = false;
+            return false;
+        }
+        position += size;
+        return true;
+    }
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::string str() {
+        uint32_t size = u32();
+        if (!ok || data.size() - position < size) {
+            ok = false;
+            return {};
+        }
+        std::string value = data.substr(position, size);
+        position += size;
+        return value;
+    }
+
+    // number of following items, each of them takes at least minItemSize bytes
+    uint32_t count(size_t minItemSize) {
+        uint32_t value = u32();
+        if (!ok || (data.size() - position) / minItemSize < value) {
+            ok = false;
+            return 0;
+        }
+        return value;
+    }
+
+    [[nodiscard]] bool atEnd() const { return position == data.size(); }
+
+private:
+    const std::string &data;
+    size_t position = 0;
+
+    void read(void *target, size_t size) {
+        if (!ok || data.size() - position < size) {
+            ok = false;
+            return;
+        }
+        std::memcpy(target, data.data() + position, size);
+        position += size;
+    }
+};
+
+
+#endif //WUFF_BINARYSTREAM_H
@@ -0,0 +1,57 @@
+#include "CancellationToken.h"
+
+namespace {
+    thread_local const CancellationToken *currentToken = nullptr;
+
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+CancellationToken::CancellationToken() : state(std::make_shared<State>()) {}
+
+void CancellationToken::cancel() {
+    std::atomic_ref<size_t>(state->cancelled).store(1);
+}
+
+void CancellationToken::setTimeout(uint64_t milliseconds) {
+    state->deadline.store(now() + static_cast<int64_t>(milliseconds) * 1000000);
+}
+
+bool CancellationToken::isCancelled() const {
+    if (std::atomic_ref<size_t>(state->cancelled).load() != 0) return true;
+    int64_t deadline = state->deadline.load();
+    return deadline != 0 && now() >= deadline;
+}
+
+void CancellationToken::throwIfCancelled() const {
+    if (isCancelled()) {
+        throw RequestCancelled();
+    }
+}
+
+const size_t *CancellationToken::flag() const {
+    return &state->cancelled;
+}
+
+uint64_t CancellationToken::remainingMicros() const {
+    int64_t deadline = state->deadline.load();
+    if (deadline == 0) return 0;
+    // tree-sitter takes 0 as no timeout, a passed deadline still has to stop the parse
+    int64_t remaining = (deadline - now()) / 1000;
+    return remaining > 0 ? static_cast<uint64_t>(remaining) : 1;
+}
+
+const CancellationToken &CancellationToken::current() {
+    static const CancellationToken none;
+    return currentToken ? *currentToken : none;
+}
+
+CancellationScope::CancellationScope(CancellationToken token) : token(std::move(token)), previous(currentToken) {
+    currentToken = &this->token;
+}
+
+CancellationScope::~CancellationScope() {
+    currentToken = previous;
+}
@@ -0,0 +1,66 @@
+#ifndef WUFF_CANCELLATIONTOKEN_H
+#define WUFF_CANCELLATIONTOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+// thrown out of a request whose token was cancelled (or whose deadline passed)
+class RequestCancelled : public std::runtime_error {
+public:
+    RequestCancelled() : std::runtime_error("request cancelled") {}
+};
+
+/**
+ * Shared flag telling a running request to stop, optionally with a deadline.
+ * Copies share the same state, the client keeps one copy and the request checks another.
+ *
+ * A request sees the token through CancellationToken::current(), which is set by a CancellationScope
+ * for the thread running the request. A default constructed token is never cancelled.
+ */
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void cancel();
+    // the token is cancelled once the time passes (counted from now)
+    void setTimeout(uint64_t milliseconds);
+    [[nodiscard]] bool isCancelled() const;
+    void throwIfCancelled() const;
+
+    // for ts_parser_set_cancellation_flag, non-zero once cancelled by cancel()
+    [[nodiscard]] const size_t *flag() const;
+    // for ts_parser_set_timeout_micros, 0 if there is no deadline
+    [[nodiscard]] uint64_t remainingMicros() const;
+
+    // the token of the request running on this thread (one which is never cancelled if there is none)
+    static const CancellationToken &current();
+
+private:
+    struct State {
+        alignas(std::atomic_ref<size_t>::required_alignment) size_t cancelled = 0;
+        // steady clock nanoseconds, 0 if there is no deadline
+        std::atomic<int64_t> deadline{0};
+    };
+
+    std::shared_ptr<State> state;
+};
+
+// makes the token the current one of this thread while the scope lives
+class CancellationScope {
+public:
+    explicit CancellationScope(CancellationToken token);
+    ~CancellationScope();
+    CancellationScope(const CancellationScope &) = delete;
+    CancellationScope &operator=(const CancellationScope &) = delete;
+
+private:
+    CancellationToken token;
+    const CancellationToken *previous;
+};
+
+
+#endif //WUFF_CANCELLATIONTOKEN_H
@@ -0,0 +1,94 @@
+#include "DiagnosticsScheduler.h"
+#include <algorithm>
+#include <iostream>
+
+DiagnosticsScheduler::DiagnosticsScheduler(Diagnose diagnose, std::chrono::milliseconds delay)
+        : diagnose(std::move(diagnose)), delay(delay) {
+    worker = std::thread(&DiagnosticsScheduler::workerLoop, this);
+}
+
+DiagnosticsScheduler::~DiagnosticsScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    scheduledChanged.notify_all();
+    // documents still waiting for their delay are not diagnosed anymore
+    worker.join();
+}
+
+void DiagnosticsScheduler::schedule(const std::string &uri) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scheduled[uri] = Clock::now() + delay;
+    }
+    scheduledChanged.notify_one();
+}
+
+void DiagnosticsScheduler::forget(const std::string &uri) {
+    std::lock_guard<std::mutex> lock(mutex);
+    scheduled.erase(uri);
+    if (uri == diagnosing) diagnosingForgotten = true;
+    published.erase(std::remove_if(published.begin(), published.end(),
+                                   [&uri](const PublishDiagnosticsParams &params) { return params.uri == uri; }),
+                    published.end());
+}
+
+std::vector<PublishDiagnosticsParams> DiagnosticsScheduler::take(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    publishedChanged.wait_for(lock, timeout, [this]() { return stopping || !published.empty(); });
+    std::vector<PublishDiagnosticsParams> taken;
+    taken.swap(published);
+    return taken;
+}
+
+size_t DiagnosticsScheduler::queueDepth() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return scheduled.size();
+}
+
+void DiagnosticsScheduler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (scheduled.empty()) {
+            scheduledChanged.wait(lock);
+            continue;
+        }
+        auto next = std::min_element(scheduled.begin(), scheduled.end(), [](const auto &a, const auto &b) {
+            return a.second < b.second;
+        });
+        if (next->second > Clock::now()) {
+            // woken up early by a change of the schedule, the next document is looked up again
+            scheduledChanged.wait_until(lock, next->second);
+            continue;
+        }
+        std::string uri = next->first;
+        scheduled.erase(next);
+        diagnosing = uri;
+        diagnosingForgotten = false;
+
+        lock.unlock();
+        std::vector<Diagnostic> diagnostics;
+        bool diagnosed = true;
+        try {
+            diagnostics = diagnose(uri);
+        } catch (const std::exception &e) {
+            std::cerr << "Could not diagnose " << uri << ": " << e.what() << std::endl;
+            diagnosed = false;
+        }
+        lock.lock();
+        bool forgotten = diagnosingForgotten;
+        diagnosing.clear();
+
+        // a document changed during its run is diagnosed again, its result would be outdated anyway
+        if (!diagnosed || forgotten || scheduled.count(uri) != 0) continue;
+        auto previous = std::find_if(published.begin(), published.end(),
+                                     [&uri](const PublishDiagnosticsParams &params) { return params.uri == uri; });
+        if (previous != published.end()) {
+            previous->diagnostics = std::move(diagnostics);
+        } else {
+            published.emplace_back(uri, std::move(diagnostics));
+        }
+        publishedChanged.notify_all();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef WUFF_DIAGNOSTICSSCHEDULER_H
+#define WUFF_DIAGNOSTICSSCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../lsp/LSPTypes.h"
+
+/**
+ * Computes the diagnostics of changed documents on its own thread, once the document
+ * was not changed for the given delay. Rapid changes of a document are coalesced into a single run,
+ * results are kept until they are taken, only the latest result of a document is kept.
+ */
+class DiagnosticsScheduler {
+public:
+    using Diagnose = std::function<std::vector<Diagnostic>(const std::string &uri)>;
+
+    DiagnosticsScheduler(Diagnose diagnose, std::chrono::milliseconds delay);
+    ~DiagnosticsScheduler();
+
+    DiagnosticsScheduler(const DiagnosticsScheduler &) = delete;
+    DiagnosticsScheduler &operator=(const DiagnosticsScheduler &) = delete;
+
+    // (re)starts the delay of the document, its diagnostics are computed once it passes
+    void schedule(const std::string &uri);
+    // the document will not be diagnosed, unless it is scheduled again
+    void forget(const std::string &uri);
+    // diagnostics computed since the last call, waits up to the timeout if there are none yet
+    std::vector<PublishDiagnosticsParams> take(std::chrono::milliseconds timeout);
+    // number of documents waiting to be diagnosed
+    [[nodiscard]] size_t queueDepth();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void workerLoop();
+
+    Diagnose diagnose;
+    std::chrono::milliseconds delay;
+
+    // uri -> time the diagnostics are due
+    std::unordered_map<std::string, Clock::time_point> scheduled;
+    std::vector<PublishDiagnosticsParams> published;
+    // document the worker is diagnosing right now, its result is dropped if it is forgotten meanwhile
+    std::string diagnosing;
+    bool diagnosingForgotten = false;
+
+    std::mutex mutex;
+    std::condition_variable scheduledChanged;
+    std::condition_variable publishedChanged;
+    bool stopping = false;
+    std::thread worker;
+};
+
+
+#endif //WUFF_DIAGNOSTICSSCHEDULER_H
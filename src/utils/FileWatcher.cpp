@@ -0,0 +1,193 @@
+#include "FileWatcher.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // folders which change a lot and never contain anything of a workspace
+    bool isSkippedDirectory(const fs::path &path) {
+        return path.filename() == ".git";
+    }
+}
+
+FileWatcher::FileWatcher(fs::path rootPath, std::chrono::milliseconds batchDelay, Callback onChanges)
+        : rootPath(std::move(rootPath)), batchDelay(batchDelay), onChanges(std::move(onChanges)) {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0 || stopFd < 0) {
+        std::cerr << "Could not watch " << this->rootPath << ": " << std::strerror(errno) << std::endl;
+    } else {
+        watchTree(this->rootPath);
+    }
+#else
+    takeSnapshot(snapshot);
+#endif
+    worker = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher() {
+    stopping = true;
+#ifdef __linux__
+    if (stopFd >= 0) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(stopFd, &one, sizeof(one));
+    }
+#endif
+    worker.join();
+#ifdef __linux__
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (stopFd >= 0) close(stopFd);
+#endif
+}
+
+bool FileWatcher::isNative() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FileWatcher::isWatchedFile(const fs::path &path) {
+    return path.extension() == ".woo" || path.extension() == ".bib" || path.filename() == "Woofile" ||
+           path.filename() == ".gitignore";
+}
+
+#ifdef __linux__
+
+void FileWatcher::watchTree(const fs::path &directory) {
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_DELETE_SELF | IN_ONLYDIR;
+    std::error_code ec;
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), mask);
+    if (wd < 0) return;
+    watchedDirectories[wd] = directory;
+
+    for (fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec) && !it->is_symlink(ec) && !isSkippedDirectory(it->path())) {
+            watchTree(it->path());
+        }
+    }
+}
+
+void FileWatcher::readEvents(std::set<fs::path> &changed) {
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) return;
+
+        for (char *at = buffer; at < buffer + length;) {
+            auto *event = reinterpret_cast<inotify_event *>(at);
+            at += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // events were lost, everything has to be checked
+                changed.insert(rootPath);
+                continue;
+            }
+            auto directory = watchedDirectories.find(event->wd);
+            if (directory == watchedDirectories.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                watchedDirectories.erase(directory);
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            fs::path path = directory->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                if (isSkippedDirectory(path)) continue;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    // the files of a directory moved in do not get events of their own
+                    watchTree(path);
+                }
+                changed.insert(path);
+            } else if (isWatchedFile(path)) {
+                changed.insert(path);
+            }
+        }
+    }
+}
+
+void FileWatcher::run() {
+    if (inotifyFd < 0 || stopFd < 0) return;
+
+    std::set<fs::path> changed;
+    pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    while (!stopping) {
+        // waits indefinitely for the first change, then for the batch delay after the last one
+        int timeout = changed.empty() ? -1 : static_cast<int>(batchDelay.count());
+        int ready = poll(descriptors, 2, timeout);
+        if (stopping) return;
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (ready == 0) {
+            std::vector<fs::path> batch(changed.begin(), changed.end());
+            changed.clear();
+            onChanges(batch);
+            continue;
+        }
+        if (descriptors[0].revents & POLLIN) {
+            readEvents(changed);
+        }
+    }
+}
+
+#else
+
+void FileWatcher::takeSnapshot(std::unordered_map<std::string, fs::file_time_type> &files) const {
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            if (isSkippedDirectory(it->path())) it.disable_recursion_pending();
+            continue;
+        }
+        if (isWatchedFile(it->path())) {
+            files[it->path().generic_string()] = it->last_write_time(ec);
+        }
+    }
+}
+
+void FileWatcher::run() {
+    // the tree is walked again at most every poll interval, the batch delay at the shortest
+    const auto pollInterval = std::max(batchDelay, std::chrono::milliseconds(1000));
+    while (!stopping) {
+        for (auto waited = std::chrono::milliseconds(0); waited < pollInterval && !stopping;
+             waited += std::chrono::milliseconds(50)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (stopping) return;
+
+        std::unordered_map<std::string, fs::file_time_type> current;
+        takeSnapshot(current);
+        std::vector<fs::path> batch;
+        for (const auto &file: current) {
+            auto previous = snapshot.find(file.first);
+            if (previous == snapshot.end() || previous->second != file.second) {
+                batch.emplace_back(file.first);
+            }
+        }
+        for (const auto &file: snapshot) {
+            if (current.count(file.first) == 0) {
+                batch.emplace_back(file.first);
+            }
+        }
+        snapshot = std::move(current);
+        if (!batch.empty()) {
+            onChanges(batch);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef WUFF_FILEWATCHER_H
+#define WUFF_FILEWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Watches a directory tree for changes of the files which shape a workspace (WooWoo documents,
+ * Woofiles, bibliographies and .gitignore files) and of its directories, on its own thread.
+ *
+ * Changes are collected until none came for the batch delay and then reported at once, every path only once.
+ * On Linux the tree is watched by inotify, elsewhere it is compared to its previous state every poll interval.
+ * If the watcher loses events (the inotify queue overflows), the root itself is reported.
+ */
+class FileWatcher {
+public:
+    using Callback = std::function<void(const std::vector<fs::path> &changedPaths)>;
+
+    FileWatcher(fs::path rootPath, std::chrono::milliseconds batchDelay, Callback onChanges);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // whether the changes are reported by the operating system, instead of by polling
+    [[nodiscard]] static bool isNative();
+
+    // whether the path is one of the files the watcher reports
+    [[nodiscard]] static bool isWatchedFile(const fs::path &path);
+
+private:
+    fs::path rootPath;
+    std::chrono::milliseconds batchDelay;
+    Callback onChanges;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    void run();
+
+#ifdef __linux__
+    int inotifyFd = -1;
+    // written to wake the worker up when the watcher is stopped
+    int stopFd = -1;
+    std::unordered_map<int, fs::path> watchedDirectories;
+
+    void watchTree(const fs::path &directory);
+    void readEvents(std::set<fs::path> &changed);
+#else
+    // modification times of the watched files as of the last poll
+    std::unordered_map<std::string, fs::file_time_type> snapshot;
+
+    void takeSnapshot(std::unordered_map<std::string, fs::file_time_type> &files) const;
+#endif
+};
+
+
+#endif //WUFF_FILEWATCHER_H
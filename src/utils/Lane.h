@@ -0,0 +1,22 @@
+#ifndef WUFF_LANE_H
+#define WUFF_LANE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Priority of work, from the most urgent. Work of a lane is only started
+ * when no work of the lanes before it is waiting.
+ */
+enum class Lane : uint8_t {
+    // requests of the client waiting for their answer (hover, completion, definition, ...)
+    Interactive = 0,
+    // loading and indexing of documents
+    Indexing = 1,
+    // work nobody waits for, such as diagnostics computed in the background
+    Background = 2,
+};
+
+constexpr size_t LANE_COUNT = 3;
+
+#endif //WUFF_LANE_H
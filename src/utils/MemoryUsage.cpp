@@ -0,0 +1,30 @@
+#include "MemoryUsage.h"
+
+namespace {
+    // a heap allocated subtree of tree-sitter with its children array, small leaves are stored inline
+    constexpr size_t BYTES_PER_NODE = 80;
+}
+
+size_t memory::treeBytes(const TSTree *tree) {
+    if (!tree) return 0;
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    size_t nodes = 1;
+    // depth first, every node is visited once
+    while (true) {
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            ++nodes;
+            continue;
+        }
+        bool next = false;
+        do {
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                ++nodes;
+                next = true;
+                break;
+            }
+        } while (ts_tree_cursor_goto_parent(&cursor));
+        if (!next) break;
+    }
+    ts_tree_cursor_delete(&cursor);
+    return nodes * BYTES_PER_NODE;
+}
@@ -0,0 +1,141 @@
+#ifndef WUFF_MEMORYUSAGE_H
+#define WUFF_MEMORYUSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <tree_sitter/api.h>
+
+/**
+ * Estimates of the heap memory held by the data structures of the analyzer. Containers are counted by their
+ * capacity and by the nodes of their elements (with a typical allocator overhead), strings stored inline
+ * take nothing. The numbers are meant for comparisons and for finding what grows, not for accounting to the byte.
+ */
+namespace memory {
+    // bookkeeping of the allocator for every allocation
+    constexpr size_t ALLOCATION_OVERHEAD = 2 * sizeof(void *);
+
+    // the overloads are declared first so that nested containers find each other
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    size_t heapBytes(const T &);
+    size_t heapBytes(const std::string &value);
+    template<typename A, typename B>
+    size_t heapBytes(const std::pair<A, B> &value);
+    template<typename T, typename Allocator>
+    size_t heapBytes(const std::vector<T, Allocator> &value);
+    template<typename K, typename V, typename Hash, typename Equal, typename Allocator>
+    size_t heapBytes(const std::unordered_map<K, V, Hash, Equal, Allocator> &value);
+    template<typename K, typename V, typename Compare, typename Allocator>
+    size_t heapBytes(const std::map<K, V, Compare, Allocator> &value);
+    template<typename K, typename V, typename Compare, typename Allocator>
+    size_t heapBytes(const std::multimap<K, V, Compare, Allocator> &value);
+    template<typename K, typename Compare, typename Allocator>
+    size_t heapBytes(const std::set<K, Compare, Allocator> &value);
+
+    // whatever the elements of a container own besides themselves
+    template<typename Container>
+    size_t elementHeapBytes(const Container &container) {
+        if constexpr (std::is_trivially_copyable_v<typename Container::value_type>) {
+            return 0;
+        } else {
+            size_t bytes = 0;
+            for (const auto &element: container) bytes += heapBytes(element);
+            return bytes;
+        }
+    }
+
+    // a tree node: the element, the (three) links and the color
+    template<typename Container>
+    size_t treeNodeBytes(const Container &container) {
+        return container.size() * (sizeof(typename Container::value_type) + 4 * sizeof(void *) +
+                                   ALLOCATION_OVERHEAD) + elementHeapBytes(container);
+    }
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    size_t heapBytes(const T &) {
+        return 0;
+    }
+
+    inline size_t heapBytes(const std::string &value) {
+        static const size_t inlineCapacity = std::string().capacity();
+        return value.capacity() > inlineCapacity ? value.capacity() + 1 + ALLOCATION_OVERHEAD : 0;
+    }
+
+    template<typename A, typename B>
+    size_t heapBytes(const std::pair<A, B> &value) {
+        return heapBytes(value.first) + heapBytes(value.second);
+    }
+
+    template<typename T, typename Allocator>
+    size_t heapBytes(const std::vector<T, Allocator> &value) {
+        if (value.capacity() == 0) return 0;
+        return value.capacity() * sizeof(T) + ALLOCATION_OVERHEAD + elementHeapBytes(value);
+    }
+
+    template<typename K, typename V, typename Hash, typename Equal, typename Allocator>
+    size_t heapBytes(const std::unordered_map<K, V, Hash, Equal, Allocator> &value) {
+        // the bucket array and a singly linked node (with the cached hash) for every element
+        return value.bucket_count() * sizeof(void *) +
+               value.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void *) + ALLOCATION_OVERHEAD) +
+               elementHeapBytes(value);
+    }
+
+    template<typename K, typename V, typename Compare, typename Allocator>
+    size_t heapBytes(const std::map<K, V, Compare, Allocator> &value) {
+        return treeNodeBytes(value);
+    }
+
+    template<typename K, typename V, typename Compare, typename Allocator>
+    size_t heapBytes(const std::multimap<K, V, Compare, Allocator> &value) {
+        return treeNodeBytes(value);
+    }
+
+    template<typename K, typename Compare, typename Allocator>
+    size_t heapBytes(const std::set<K, Compare, Allocator> &value) {
+        return treeNodeBytes(value);
+    }
+
+    /**
+     * Estimate of the memory of a syntax tree, tree-sitter does not report it. Counts the nodes of the tree
+     * (visiting all of them) and takes the typical size of a node. Trees copied by ts_tree_copy share their nodes,
+     * the estimate of each of the copies includes them.
+     */
+    size_t treeBytes(const TSTree *tree);
+}
+
+// bytes held by a document, by what holds them
+struct DocumentMemoryUsage {
+    std::string uri;
+    // false if only the index of the document is kept (the source and the trees are not loaded)
+    bool materialized = false;
+    size_t source = 0;
+    // the WooWoo syntax tree
+    size_t tree = 0;
+    // the YAML syntax trees of the meta blocks, with the meta contexts
+    size_t metaTrees = 0;
+    size_t utfMappings = 0;
+    size_t commentLines = 0;
+    // the DocumentIndex
+    size_t index = 0;
+
+    [[nodiscard]] size_t total() const {
+        return source + tree + metaTrees + utfMappings + commentLines + index;
+    }
+};
+
+// bytes held by the analyzer, the subsystems include the sums of the parts of the documents
+struct MemoryUsage {
+    std::vector<DocumentMemoryUsage> documents;
+    // subsystem (e.g. "source", "reference_index", "queries") -> bytes
+    std::map<std::string, size_t> subsystems;
+    size_t total = 0;
+};
+
+
+#endif //WUFF_MEMORYUSAGE_H
@@ -0,0 +1,34 @@
+#include "PeriodicTask.h"
+#include <algorithm>
+#include <iostream>
+
+PeriodicTask::PeriodicTask(std::function<void()> task, std::chrono::milliseconds period)
+        : task(std::move(task)), period(period) {
+    worker = std::thread(&PeriodicTask::workerLoop, this);
+}
+
+PeriodicTask::~PeriodicTask() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopRequested.notify_all();
+    worker.join();
+}
+
+void PeriodicTask::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto next = std::chrono::steady_clock::now() + period;
+    while (!stopping) {
+        if (stopRequested.wait_until(lock, next, [this]() { return stopping; })) break;
+        lock.unlock();
+        try {
+            task();
+        } catch (const std::exception &e) {
+            std::cerr << "Periodic task failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+        // a task running longer than the period does not make the next runs pile up
+        next = std::max(next + period, std::chrono::steady_clock::now());
+    }
+}
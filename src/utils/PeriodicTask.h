@@ -0,0 +1,35 @@
+#ifndef WUFF_PERIODICTASK_H
+#define WUFF_PERIODICTASK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Runs a task on its own thread once every period, the first time one period after it is created.
+ * Destroying it waits for the task if it is running, it is not run anymore after that.
+ */
+class PeriodicTask {
+public:
+    PeriodicTask(std::function<void()> task, std::chrono::milliseconds period);
+    ~PeriodicTask();
+
+    PeriodicTask(const PeriodicTask &) = delete;
+    PeriodicTask &operator=(const PeriodicTask &) = delete;
+
+private:
+    void workerLoop();
+
+    std::function<void()> task;
+    std::chrono::milliseconds period;
+
+    std::mutex mutex;
+    std::condition_variable stopRequested;
+    bool stopping = false;
+    std::thread worker;
+};
+
+
+#endif //WUFF_PERIODICTASK_H
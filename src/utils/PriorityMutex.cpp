@@ -0,0 +1,34 @@
+#include "PriorityMutex.h"
+
+void PriorityMutex::lock() {
+    lock(Lane::Interactive);
+}
+
+void PriorityMutex::lock(Lane lane) {
+    std::unique_lock<std::mutex> guard(mutex);
+    ++waitingByLane[static_cast<size_t>(lane)];
+    released.wait(guard, [this, lane]() { return !held && !urgentWaiting(lane); });
+    --waitingByLane[static_cast<size_t>(lane)];
+    held = true;
+}
+
+void PriorityMutex::unlock() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        held = false;
+    }
+    // every waiter checks whether it is the most urgent one
+    released.notify_all();
+}
+
+size_t PriorityMutex::waiting(Lane lane) {
+    std::lock_guard<std::mutex> guard(mutex);
+    return waitingByLane[static_cast<size_t>(lane)];
+}
+
+bool PriorityMutex::urgentWaiting(Lane lane) const {
+    for (size_t i = 0; i < static_cast<size_t>(lane); ++i) {
+        if (waitingByLane[i] > 0) return true;
+    }
+    return false;
+}
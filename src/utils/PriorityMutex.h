@@ -0,0 +1,51 @@
+#ifndef WUFF_PRIORITYMUTEX_H
+#define WUFF_PRIORITYMUTEX_H
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include "Lane.h"
+
+/**
+ * Mutex granted to the waiter of the most urgent lane first, so that a request of the client
+ * does not queue up behind background work waiting for the same lock.
+ * lock() and unlock() (and so std::lock_guard) use the interactive lane.
+ */
+class PriorityMutex {
+public:
+    void lock();
+    void lock(Lane lane);
+    void unlock();
+
+    // number of threads waiting for the mutex in the lane
+    [[nodiscard]] size_t waiting(Lane lane);
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    std::array<size_t, LANE_COUNT> waitingByLane{};
+    bool held = false;
+
+    [[nodiscard]] bool urgentWaiting(Lane lane) const;
+};
+
+// holds the mutex in the given lane for its lifetime
+class PriorityLock {
+public:
+    PriorityLock(PriorityMutex &mutex, Lane lane) : mutex(mutex) {
+        mutex.lock(lane);
+    }
+
+    ~PriorityLock() {
+        mutex.unlock();
+    }
+
+    PriorityLock(const PriorityLock &) = delete;
+    PriorityLock &operator=(const PriorityLock &) = delete;
+
+private:
+    PriorityMutex &mutex;
+};
+
+
+#endif //WUFF_PRIORITYMUTEX_H
@@ -0,0 +1,77 @@
+#include "SessionTrace.h"
+#include <algorithm>
+#include <stdexcept>
+#include "utils.h"
+
+namespace {
+    const char MAGIC[8] = {'W', 'U', 'F', 'F', 'T', 'R', 'C', '\0'};
+    // has to be increased with every change of the layout of the trace file or of the encoding of the arguments
+    const uint32_t FORMAT_VERSION = 1;
+
+    uint64_t microseconds(SessionRecorder::Clock::duration duration) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+}
+
+void SessionRecorder::start(const fs::path &tracePath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (out.is_open()) out.close();
+    recording = false;
+
+    out.open(tracePath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot write the trace file: " + tracePath.string());
+    }
+    BinaryWriter w(out);
+    w.bytes(MAGIC, sizeof(MAGIC));
+    w.u32(FORMAT_VERSION);
+    origin = Clock::now();
+    recording = true;
+}
+
+void SessionRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    recording = false;
+    if (out.is_open()) out.close();
+}
+
+void SessionRecorder::record(const char *method, Clock::time_point begin, Clock::time_point end, bool failed,
+                             const std::string &arguments) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // the recording may have stopped while the call ran
+    if (!recording || begin < origin) return;
+
+    BinaryWriter w(out);
+    w.str(method);
+    w.u64(microseconds(begin - origin));
+    w.u64(microseconds(end - begin));
+    w.u32(failed ? 1 : 0);
+    w.str(arguments);
+    // a session can end by the process being killed, every call is kept
+    out.flush();
+}
+
+std::optional<std::vector<TraceRecord>> SessionRecorder::read(const fs::path &tracePath) {
+    auto data = utils::readFile(tracePath);
+    if (!data.has_value()) return std::nullopt;
+
+    BinaryReader r(data.value());
+    if (!r.expect(MAGIC, sizeof(MAGIC)) || r.u32() != FORMAT_VERSION) return std::nullopt;
+
+    std::vector<TraceRecord> records;
+    while (r.ok && !r.atEnd()) {
+        TraceRecord record;
+        record.method = r.str();
+        record.start = r.u64();
+        record.duration = r.u64();
+        record.failed = r.u32() != 0;
+        record.arguments = r.str();
+        // a call cut off by the end of the process is dropped
+        if (r.ok) records.push_back(std::move(record));
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const TraceRecord &a, const TraceRecord &b) {
+        return a.start < b.start;
+    });
+    return records;
+}
@@ -0,0 +1,327 @@
+#ifndef WUFF_SESSIONTRACE_H
+#define WUFF_SESSIONTRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BinaryStream.h"
+#include "../lsp/LSPTypes.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * Reads the arguments of a recorded call. Strings starting with the URI of the recorded workspace
+ * are moved to the workspace the trace is replayed on.
+ */
+class TraceReader {
+public:
+    explicit TraceReader(const std::string &data) : reader(data) {}
+
+    BinaryReader reader;
+    std::string recordedRoot;
+    std::string replayedRoot;
+
+    std::string str() {
+        std::string value = reader.str();
+        if (!recordedRoot.empty() && value.compare(0, recordedRoot.size(), recordedRoot) == 0
+            && (value.size() == recordedRoot.size() || value[recordedRoot.size()] == '/')) {
+            value.replace(0, recordedRoot.size(), replayedRoot);
+        }
+        return value;
+    }
+};
+
+/**
+ * Encoding of an argument type of the recorded requests, specialized for every type they take.
+ */
+template<typename T>
+struct TraceCodec;
+
+template<>
+struct TraceCodec<std::string> {
+    static void write(BinaryWriter &w, const std::string &value) { w.str(value); }
+    static std::string read(TraceReader &r) { return r.str(); }
+};
+
+template<>
+struct TraceCodec<uint32_t> {
+    static void write(BinaryWriter &w, uint32_t value) { w.u32(value); }
+    static uint32_t read(TraceReader &r) { return r.reader.u32(); }
+};
+
+template<>
+struct TraceCodec<uint64_t> {
+    static void write(BinaryWriter &w, uint64_t value) { w.u64(value); }
+    static uint64_t read(TraceReader &r) { return r.reader.u64(); }
+};
+
+template<>
+struct TraceCodec<bool> {
+    static void write(BinaryWriter &w, bool value) { w.u32(value ? 1 : 0); }
+    static bool read(TraceReader &r) { return r.reader.u32() != 0; }
+};
+
+template<typename T>
+struct TraceCodec<std::optional<T>> {
+    static void write(BinaryWriter &w, const std::optional<T> &value) {
+        w.u32(value.has_value() ? 1 : 0);
+        if (value.has_value()) TraceCodec<T>::write(w, value.value());
+    }
+
+    static std::optional<T> read(TraceReader &r) {
+        if (r.reader.u32() == 0) return std::nullopt;
+        return TraceCodec<T>::read(r);
+    }
+};
+
+template<typename T>
+struct TraceCodec<std::vector<T>> {
+    static void write(BinaryWriter &w, const std::vector<T> &value) {
+        w.u32(static_cast<uint32_t>(value.size()));
+        for (const T &item: value) TraceCodec<T>::write(w, item);
+    }
+
+    static std::vector<T> read(TraceReader &r) {
+        std::vector<T> value;
+        for (uint32_t i = r.reader.count(1); i > 0 && r.reader.ok; --i) {
+            value.push_back(TraceCodec<T>::read(r));
+        }
+        return value;
+    }
+};
+
+template<typename A, typename B>
+struct TraceCodec<std::pair<A, B>> {
+    static void write(BinaryWriter &w, const std::pair<A, B> &value) {
+        TraceCodec<A>::write(w, value.first);
+        TraceCodec<B>::write(w, value.second);
+    }
+
+    static std::pair<A, B> read(TraceReader &r) {
+        A first = TraceCodec<A>::read(r);
+        B second = TraceCodec<B>::read(r);
+        return {std::move(first), std::move(second)};
+    }
+};
+
+template<>
+struct TraceCodec<Position> {
+    static void write(BinaryWriter &w, const Position &value) {
+        w.u32(value.line);
+        w.u32(value.character);
+    }
+
+    static Position read(TraceReader &r) {
+        uint32_t line = r.reader.u32();
+        return Position{line, r.reader.u32()};
+    }
+};
+
+template<>
+struct TraceCodec<Range> {
+    static void write(BinaryWriter &w, const Range &value) {
+        TraceCodec<Position>::write(w, value.start);
+        TraceCodec<Position>::write(w, value.end);
+    }
+
+    static Range read(TraceReader &r) {
+        Position start = TraceCodec<Position>::read(r);
+        return Range{start, TraceCodec<Position>::read(r)};
+    }
+};
+
+template<>
+struct TraceCodec<TextDocumentIdentifier> {
+    static void write(BinaryWriter &w, const TextDocumentIdentifier &value) { w.str(value.uri); }
+    static TextDocumentIdentifier read(TraceReader &r) { return TextDocumentIdentifier(r.str()); }
+};
+
+template<>
+struct TraceCodec<TextDocumentPositionParams> {
+    static void write(BinaryWriter &w, const TextDocumentPositionParams &value) {
+        TraceCodec<TextDocumentIdentifier>::write(w, value.textDocument);
+        TraceCodec<Position>::write(w, value.position);
+    }
+
+    static TextDocumentPositionParams read(TraceReader &r) {
+        TextDocumentIdentifier textDocument = TraceCodec<TextDocumentIdentifier>::read(r);
+        return {std::move(textDocument), TraceCodec<Position>::read(r)};
+    }
+};
+
+template<>
+struct TraceCodec<DefinitionParams> {
+    static void write(BinaryWriter &w, const DefinitionParams &value) {
+        TraceCodec<TextDocumentPositionParams>::write(w, value);
+    }
+
+    static DefinitionParams read(TraceReader &r) {
+        TextDocumentPositionParams params = TraceCodec<TextDocumentPositionParams>::read(r);
+        return {params.textDocument, params.position};
+    }
+};
+
+template<>
+struct TraceCodec<CompletionParams> {
+    static void write(BinaryWriter &w, const CompletionParams &value) {
+        TraceCodec<TextDocumentPositionParams>::write(w, value);
+        w.u32(value.context.has_value() ? 1 : 0);
+        if (value.context.has_value()) {
+            w.u32(static_cast<uint32_t>(value.context->triggerKind));
+            TraceCodec<std::optional<std::string>>::write(w, value.context->triggerCharacter);
+        }
+    }
+
+    static CompletionParams read(TraceReader &r) {
+        TextDocumentPositionParams params = TraceCodec<TextDocumentPositionParams>::read(r);
+        std::optional<CompletionContext> context;
+        if (r.reader.u32() != 0) {
+            auto triggerKind = static_cast<CompletionTriggerKind>(r.reader.u32());
+            context.emplace(triggerKind, TraceCodec<std::optional<std::string>>::read(r));
+        }
+        return {params.textDocument, params.position, std::move(context)};
+    }
+};
+
+template<>
+struct TraceCodec<ReferenceParams> {
+    static void write(BinaryWriter &w, const ReferenceParams &value) {
+        TraceCodec<TextDocumentPositionParams>::write(w, value);
+        w.u32(value.includeDeclaration ? 1 : 0);
+    }
+
+    static ReferenceParams read(TraceReader &r) {
+        TextDocumentPositionParams params = TraceCodec<TextDocumentPositionParams>::read(r);
+        return {params.textDocument, params.position, r.reader.u32() != 0};
+    }
+};
+
+template<>
+struct TraceCodec<RenameParams> {
+    static void write(BinaryWriter &w, const RenameParams &value) {
+        TraceCodec<TextDocumentPositionParams>::write(w, value);
+        w.str(value.newName);
+    }
+
+    static RenameParams read(TraceReader &r) {
+        TextDocumentPositionParams params = TraceCodec<TextDocumentPositionParams>::read(r);
+        return {params.textDocument, params.position, r.reader.str()};
+    }
+};
+
+template<>
+struct TraceCodec<SemanticTokensRangeParams> {
+    static void write(BinaryWriter &w, const SemanticTokensRangeParams &value) {
+        TraceCodec<TextDocumentIdentifier>::write(w, value.textDocument);
+        TraceCodec<Range>::write(w, value.range);
+    }
+
+    static SemanticTokensRangeParams read(TraceReader &r) {
+        TextDocumentIdentifier textDocument = TraceCodec<TextDocumentIdentifier>::read(r);
+        return {std::move(textDocument), TraceCodec<Range>::read(r)};
+    }
+};
+
+template<>
+struct TraceCodec<SemanticTokensDeltaParams> {
+    static void write(BinaryWriter &w, const SemanticTokensDeltaParams &value) {
+        TraceCodec<TextDocumentIdentifier>::write(w, value.textDocument);
+        w.str(value.previousResultId);
+    }
+
+    static SemanticTokensDeltaParams read(TraceReader &r) {
+        TextDocumentIdentifier textDocument = TraceCodec<TextDocumentIdentifier>::read(r);
+        return {std::move(textDocument), r.reader.str()};
+    }
+};
+
+template<>
+struct TraceCodec<FileEvent> {
+    static void write(BinaryWriter &w, const FileEvent &value) {
+        w.str(value.uri);
+        w.u32(static_cast<uint32_t>(value.type));
+    }
+
+    static FileEvent read(TraceReader &r) {
+        std::string uri = r.str();
+        return {std::move(uri), static_cast<FileChangeType>(r.reader.u32())};
+    }
+};
+
+// one call of the analyzer, times are in microseconds since the recording started
+struct TraceRecord {
+    std::string method;
+    uint64_t start;
+    uint64_t duration;
+    // the call threw (e.g. it was cancelled)
+    bool failed;
+    std::string arguments;
+};
+
+/**
+ * Writes the calls made to an analyzer to a trace file: the name of the method, its encoded arguments,
+ * when it started and how long it took. Calls can be recorded from any thread, in the order they finish.
+ */
+class SessionRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // replaces the file, throws std::runtime_error if it cannot be written
+    void start(const fs::path &tracePath);
+    void stop();
+
+    [[nodiscard]] bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    template<typename... Args>
+    static std::string encode(const Args &... args) {
+        std::ostringstream out;
+        BinaryWriter w(out);
+        (TraceCodec<std::decay_t<Args>>::write(w, args), ...);
+        return out.str();
+    }
+
+    // records the call once it goes out of scope
+    class Call {
+    public:
+        Call(SessionRecorder &recorder, const char *method, std::string arguments)
+                : recorder(recorder), method(method), arguments(std::move(arguments)), begin(Clock::now()),
+                  exceptions(std::uncaught_exceptions()) {}
+
+        ~Call() {
+            recorder.record(method, begin, Clock::now(), std::uncaught_exceptions() > exceptions, arguments);
+        }
+
+        Call(const Call &) = delete;
+        Call &operator=(const Call &) = delete;
+
+    private:
+        SessionRecorder &recorder;
+        const char *method;
+        std::string arguments;
+        Clock::time_point begin;
+        int exceptions;
+    };
+
+    // the calls of the trace file ordered by their start, nullopt if it is not a trace or it is corrupted
+    static std::optional<std::vector<TraceRecord>> read(const fs::path &tracePath);
+
+private:
+    std::mutex mutex;
+    std::ofstream out;
+    std::atomic<bool> recording{false};
+    Clock::time_point origin;
+
+    void record(const char *method, Clock::time_point begin, Clock::time_point end, bool failed,
+                const std::string &arguments);
+};
+
+
+#endif //WUFF_SESSIONTRACE_H
@@ -0,0 +1,146 @@
+#include "SpanTracer.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    struct Span {
+        const char *name;
+        const char *category;
+        SpanTracer::Clock::time_point begin;
+        SpanTracer::Clock::time_point end;
+        std::string document;
+        uint64_t bytes;
+    };
+
+    struct ThreadSpans {
+        std::mutex mutex;
+        uint32_t threadId = 0;
+        std::vector<Span> spans;
+        // spans which did not fit into the buffer
+        uint64_t dropped = 0;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        // buffers of every thread which recorded something, they outlive the threads
+        std::vector<std::shared_ptr<ThreadSpans>> threads;
+        SpanTracer::Clock::time_point origin = SpanTracer::Clock::now();
+        std::atomic<size_t> maxEventsPerThread{0};
+        uint32_t nextThreadId = 1;
+    };
+
+    // never destroyed, threads may still record while the process exits
+    Registry &registry() {
+        static auto *instance = new Registry();
+        return *instance;
+    }
+
+    ThreadSpans &threadSpans() {
+        thread_local std::shared_ptr<ThreadSpans> local;
+        if (!local) {
+            local = std::make_shared<ThreadSpans>();
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            local->threadId = r.nextThreadId++;
+            r.threads.push_back(local);
+        }
+        return *local;
+    }
+
+    // microseconds since the tracing started, with the nanoseconds as the fraction
+    std::string microseconds(SpanTracer::Clock::duration duration) {
+        auto nanoseconds = std::max<int64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0);
+        char text[32];
+        std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(nanoseconds / 1000),
+                      static_cast<long long>(nanoseconds % 1000));
+        return text;
+    }
+}
+
+std::atomic<bool> SpanTracer::enabled{false};
+
+void SpanTracer::start(size_t maxEventsPerThread) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    // buffers of ended threads are not needed anymore
+    std::erase_if(r.threads, [](const std::shared_ptr<ThreadSpans> &thread) { return thread.use_count() == 1; });
+    for (const auto &thread: r.threads) {
+        std::lock_guard<std::mutex> threadLock(thread->mutex);
+        thread->spans.clear();
+        thread->dropped = 0;
+    }
+    r.maxEventsPerThread.store(maxEventsPerThread, std::memory_order_relaxed);
+    r.origin = Clock::now();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void SpanTracer::stop() {
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+void SpanTracer::record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                        std::string document, uint64_t bytes) {
+    ThreadSpans &thread = threadSpans();
+    size_t maxEvents = registry().maxEventsPerThread.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(thread.mutex);
+    if (thread.spans.size() >= maxEvents) {
+        ++thread.dropped;
+        return;
+    }
+    thread.spans.push_back(Span{name, category, begin, end, std::move(document), bytes});
+}
+
+std::string SpanTracer::chromeTrace() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    uint64_t dropped = 0;
+    auto separate = [&out, &first]() {
+        if (!first) out += ",\n";
+        first = false;
+    };
+    for (const auto &thread: r.threads) {
+        std::lock_guard<std::mutex> threadLock(thread->mutex);
+        dropped += thread->dropped;
+        if (thread->spans.empty()) continue;
+        std::string tid = std::to_string(thread->threadId);
+        separate();
+        out += R"({"name":"thread_name","ph":"M","pid":1,"tid":)" + tid + R"(,"args":{"name":"thread )" + tid +
+               "\"}}";
+        for (const Span &span: thread->spans) {
+            separate();
+            out += R"({"name":")";
+            utils::appendJsonEscaped(out, span.name);
+            out += R"(","cat":")";
+            utils::appendJsonEscaped(out, span.category);
+            out += R"(","ph":"X","pid":1,"tid":)" + tid;
+            out += ",\"ts\":" + microseconds(span.begin - r.origin);
+            out += ",\"dur\":" + microseconds(span.end - span.begin);
+            out += ",\"args\":{";
+            if (!span.document.empty()) {
+                out += "\"document\":\"";
+                utils::appendJsonEscaped(out, span.document);
+                out += "\",";
+            }
+            out += "\"bytes\":" + std::to_string(span.bytes) + "}}";
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_spans\":" + std::to_string(dropped) + "}}";
+    return out;
+}
+
+void SpanTracer::writeChromeTrace(const std::string &path) {
+    std::string trace = chromeTrace();
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(trace.data(), static_cast<std::streamsize>(trace.size()))) {
+        throw std::runtime_error("Cannot write the span trace: " + path);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef WUFF_SPANTRACER_H
+#define WUFF_SPANTRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * Process-wide, optional tracing of individual spans (requests, component calls, parses, indexing, queries)
+ * with their thread, document and size, exported in the Chrome Trace Event format (loads in Perfetto too).
+ *
+ * While tracing is off a span costs a relaxed load. While it is on, every thread appends to a buffer of its own
+ * (its lock is taken by the owner and by the export only), at most maxEventsPerThread spans are kept per thread.
+ */
+class SpanTracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // drops the spans of the previous tracing
+    static void start(size_t maxEventsPerThread);
+    // the spans are kept until the next start
+    static void stop();
+
+    [[nodiscard]] static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // name and category are expected to be string literals
+    static void record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                       std::string document, uint64_t bytes);
+
+    // the spans recorded so far as a Chrome Trace Event JSON object
+    static std::string chromeTrace();
+    // throws std::runtime_error if the file cannot be written
+    static void writeChromeTrace(const std::string &path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// a span from its construction to its destruction, recorded only if the tracing was on when it began
+class ScopedSpan {
+public:
+    ScopedSpan(const char *name, const char *category, const std::string &document = {}, uint64_t bytes = 0)
+            : name(name), category(category) {
+        if (!SpanTracer::isEnabled()) return;
+        active = true;
+        this->document = document;
+        this->bytes = bytes;
+        begin = SpanTracer::Clock::now();
+    }
+
+    // the path is converted only if the span is recorded
+    ScopedSpan(const char *name, const char *category, const std::filesystem::path &document, uint64_t bytes)
+            : ScopedSpan(name, category, std::string(), bytes) {
+        if (active) this->document = document.string();
+    }
+
+    ~ScopedSpan() {
+        end();
+    }
+
+    // records the span before the end of the scope
+    void end() {
+        if (!active) return;
+        active = false;
+        SpanTracer::record(name, category, begin, SpanTracer::Clock::now(), std::move(document), bytes);
+    }
+
+    // sizes known only once the work is done (the number of results, bytes produced)
+    void setBytes(uint64_t value) {
+        bytes = value;
+    }
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+private:
+    const char *name;
+    const char *category;
+    bool active = false;
+    std::string document;
+    uint64_t bytes = 0;
+    SpanTracer::Clock::time_point begin;
+};
+
+
+#endif //WUFF_SPANTRACER_H
@@ -0,0 +1,286 @@
+#include "Stats.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+    const char *const counterNames[] = {
+            // full text updates identical to the source, nothing was parsed again
+            "unchanged_source_skipped",
+            // files read again from the disk with the content the document already had
+            "unchanged_disk_source_skipped",
+            // edits replacing text by the same text, dropped before the parse
+            "noop_edit_skipped",
+            // hovers and definitions answered from the results at the same node
+            "position_cache_hits",
+            // parsed documents the client did not have open, unloaded once they were idle
+            "idle_documents_evicted",
+            // documents parsed in the background before the client asked for them
+            "documents_prefetched",
+    };
+    static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == static_cast<size_t>(Counter::COUNT));
+
+    const char *const timerNames[] = {
+            // lines, comments and non-ASCII characters of a replaced source found in one pass
+            "scan_source",
+            // UTF-8 to UTF-16 tables of a replaced source
+            "build_mappings",
+            // ranged edits applied to the source and to the old tree
+            "apply_edits",
+            // tree-sitter parse of the document, incremental after edits
+            "parse_woowoo",
+            // YAML parses of the meta blocks which are not reused
+            "parse_metas",
+            "update_comments",
+            // DialectedWooWooDocument::index()
+            "index",
+    };
+    static_assert(sizeof(timerNames) / sizeof(timerNames[0]) == static_cast<size_t>(Timer::COUNT));
+
+    // the stages, then the timers created by timerId, the last one takes the names which do not fit
+    constexpr size_t MAX_TIMERS = 48;
+    // four buckets for every power of two of nanoseconds (at most 25 % apart), up to 2^40 ns (about 18 minutes)
+    constexpr uint32_t MAX_EXPONENT = 40;
+    constexpr size_t BUCKETS = MAX_EXPONENT * 4;
+
+    size_t bucketOf(uint64_t nanoseconds) {
+        if (nanoseconds < 4) return nanoseconds;
+        auto exponent = static_cast<uint32_t>(std::bit_width(nanoseconds) - 1);
+        if (exponent >= MAX_EXPONENT) return BUCKETS - 1;
+        auto quarter = static_cast<uint32_t>((nanoseconds >> (exponent - 2)) & 3);
+        return exponent * 4 + quarter - 4;
+    }
+
+    uint64_t bucketLow(size_t bucket) {
+        if (bucket < 4) return bucket;
+        size_t exponent = (bucket + 4) / 4;
+        size_t quarter = (bucket + 4) % 4;
+        return static_cast<uint64_t>(4 + quarter) << (exponent - 2);
+    }
+
+    uint64_t bucketHigh(size_t bucket) {
+        return bucket + 1 < BUCKETS ? bucketLow(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+    // written only by the thread owning it, a plain store is enough (and avoids a locked instruction)
+    void add(std::atomic<uint64_t> &value, uint64_t amount) {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    struct ThreadHistograms {
+        std::array<Histogram, MAX_TIMERS> timers;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        // histograms of every thread which recorded something, they outlive the threads
+        std::vector<std::unique_ptr<ThreadHistograms>> threads;
+        // histograms of ended threads, taken over by new ones
+        std::vector<ThreadHistograms *> unused;
+        // by id
+        std::vector<std::string> names{std::begin(timerNames), std::end(timerNames)};
+    };
+
+    // never destroyed, threads may still record while the process exits
+    Registry &registry() {
+        static auto *instance = new Registry();
+        return *instance;
+    }
+
+    struct LocalHistograms {
+        ThreadHistograms *histograms = nullptr;
+
+        ~LocalHistograms() {
+            if (!histograms) return;
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.unused.push_back(histograms);
+        }
+    };
+
+    thread_local LocalHistograms localHistograms;
+
+    ThreadHistograms &threadHistograms() {
+        if (!localHistograms.histograms) {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            if (!r.unused.empty()) {
+                localHistograms.histograms = r.unused.back();
+                r.unused.pop_back();
+            } else {
+                r.threads.push_back(std::make_unique<ThreadHistograms>());
+                localHistograms.histograms = r.threads.back().get();
+            }
+        }
+        return *localHistograms.histograms;
+    }
+
+    struct MergedHistogram {
+        std::array<uint64_t, BUCKETS> buckets{};
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+    };
+
+    // the registry has to be locked
+    MergedHistogram merge(const Registry &r, size_t timer) {
+        MergedHistogram merged;
+        for (const auto &thread: r.threads) {
+            const Histogram &histogram = thread->timers[timer];
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                merged.buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+            }
+            merged.count += histogram.count.load(std::memory_order_relaxed);
+            merged.total += histogram.total.load(std::memory_order_relaxed);
+            merged.max = std::max(merged.max, histogram.max.load(std::memory_order_relaxed));
+        }
+        return merged;
+    }
+
+    // the middle of the bucket the percentile falls into
+    uint64_t percentile(const MergedHistogram &histogram, double p) {
+        auto rank = static_cast<uint64_t>(p * static_cast<double>(histogram.count) + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += histogram.buckets[i];
+            if (seen >= rank) {
+                uint64_t low = bucketLow(i);
+                uint64_t middle = low + (std::min(bucketHigh(i), histogram.max) - low) / 2;
+                return std::min(middle, histogram.max);
+            }
+        }
+        return histogram.max;
+    }
+
+    std::string number(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", value);
+        return text;
+    }
+}
+
+std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> Stats::values{};
+
+uint32_t Stats::timerId(const char *name) {
+    // names are looked up by their address first, without taking the lock
+    thread_local std::vector<std::pair<const char *, uint32_t>> known;
+    for (const auto &entry: known) {
+        if (entry.first == name) return entry.second;
+    }
+
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    uint32_t id = 0;
+    while (id < r.names.size() && r.names[id] != name) ++id;
+    if (id == r.names.size()) {
+        if (r.names.size() + 1 < MAX_TIMERS) {
+            r.names.emplace_back(name);
+        } else {
+            id = MAX_TIMERS - 1;
+            if (r.names.size() < MAX_TIMERS) r.names.emplace_back("other");
+        }
+    }
+    known.emplace_back(name, id);
+    return id;
+}
+
+void Stats::record(uint32_t timer, uint64_t nanoseconds) {
+    Histogram &histogram = threadHistograms().timers[timer < MAX_TIMERS ? timer : MAX_TIMERS - 1];
+    add(histogram.buckets[bucketOf(nanoseconds)], 1);
+    add(histogram.count, 1);
+    add(histogram.total, nanoseconds);
+    if (nanoseconds > histogram.max.load(std::memory_order_relaxed)) {
+        histogram.max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+std::map<std::string, uint64_t> Stats::counters() {
+    std::map<std::string, uint64_t> result;
+    for (size_t i = 0; i < values.size(); ++i) {
+        result[counterNames[i]] = values[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+std::map<std::string, TimerSummary> Stats::timers() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::map<std::string, TimerSummary> result;
+    for (size_t timer = 0; timer < r.names.size(); ++timer) {
+        MergedHistogram histogram = merge(r, timer);
+        if (histogram.count == 0) continue;
+        TimerSummary &summary = result[r.names[timer]];
+        summary.count = histogram.count;
+        summary.total = histogram.total;
+        summary.p50 = percentile(histogram, 0.5);
+        summary.p90 = percentile(histogram, 0.9);
+        summary.p99 = percentile(histogram, 0.99);
+        summary.max = histogram.max;
+    }
+    return result;
+}
+
+std::string Stats::prometheus() {
+    // few fixed bounds (in seconds) instead of the fine buckets, a bucket is counted once all of it is below
+    static const double bounds[] = {1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2,
+                                    0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+    std::string text;
+    text += "# HELP wuff_events_total Work done, or avoided, by the analyzer.\n";
+    text += "# TYPE wuff_events_total counter\n";
+    for (const auto &[name, value]: counters()) {
+        text += "wuff_events_total{event=\"" + name + "\"} " + std::to_string(value) + "\n";
+    }
+
+    text += "# HELP wuff_duration_seconds Durations of the requests and of the stages of source updates.\n";
+    text += "# TYPE wuff_duration_seconds histogram\n";
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t timer = 0; timer < r.names.size(); ++timer) {
+        MergedHistogram histogram = merge(r, timer);
+        if (histogram.count == 0) continue;
+        std::string labels = "operation=\"" + r.names[timer] + "\"";
+        size_t bucket = 0;
+        uint64_t cumulative = 0;
+        for (double bound: bounds) {
+            auto boundNanoseconds = static_cast<uint64_t>(bound * 1e9);
+            while (bucket < BUCKETS && bucketHigh(bucket) <= boundNanoseconds) {
+                cumulative += histogram.buckets[bucket++];
+            }
+            text += "wuff_duration_seconds_bucket{" + labels + ",le=\"" + number(bound) + "\"} " +
+                    std::to_string(cumulative) + "\n";
+        }
+        text += "wuff_duration_seconds_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(histogram.count) + "\n";
+        text += "wuff_duration_seconds_sum{" + labels + "} " + number(static_cast<double>(histogram.total) / 1e9) +
+                "\n";
+        text += "wuff_duration_seconds_count{" + labels + "} " + std::to_string(histogram.count) + "\n";
+    }
+    return text;
+}
+
+void Stats::reset() {
+    for (auto &value: values) {
+        value.store(0, std::memory_order_relaxed);
+    }
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto &thread: r.threads) {
+        for (Histogram &histogram: thread->timers) {
+            for (auto &bucket: histogram.buckets) bucket.store(0, std::memory_order_relaxed);
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.total.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+        }
+    }
+}
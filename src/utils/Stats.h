@@ -0,0 +1,100 @@
+#ifndef WUFF_STATS_H
+#define WUFF_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// events counted by Stats, see counterNames for what they mean
+enum class Counter : uint8_t {
+    UnchangedSourceSkipped = 0,
+    UnchangedDiskSourceSkipped,
+    NoOpEditSkipped,
+    PositionCacheHit,
+    IdleDocumentEvicted,
+    DocumentPrefetched,
+    COUNT
+};
+
+// stages of a source update timed by Stats, see timerNames; requests are timed by their names
+enum class Timer : uint8_t {
+    ScanSource = 0,
+    BuildMappings,
+    ApplyEdits,
+    ParseWooWoo,
+    ParseMetas,
+    UpdateComments,
+    Index,
+    COUNT
+};
+
+// durations recorded by a timer, in nanoseconds (percentiles are estimated from the histogram)
+struct TimerSummary {
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+};
+
+/**
+ * Process-wide counters of what the analyzer did, or avoided doing, and latency histograms of what it did.
+ * Counting is a relaxed atomic increment. Every thread records durations to histograms of its own
+ * (no locks and no contended cache lines), summaries merge the histograms of all threads.
+ * Both can be done from any thread at any time.
+ */
+class Stats {
+public:
+    static void count(Counter counter, uint64_t amount = 1) {
+        values[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // the id of the timer of the name, created on first use (names are expected to be string literals)
+    static uint32_t timerId(const char *name);
+    static void record(uint32_t timer, uint64_t nanoseconds);
+
+    static void record(Timer timer, uint64_t nanoseconds) {
+        record(static_cast<uint32_t>(timer), nanoseconds);
+    }
+
+    // the counters by name
+    static std::map<std::string, uint64_t> counters();
+    // the timers which recorded something, by name
+    static std::map<std::string, TimerSummary> timers();
+    // counters and timers in the Prometheus text exposition format
+    static std::string prometheus();
+    // approximate while something is recorded at the same time
+    static void reset();
+
+private:
+    static std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> values;
+};
+
+// records the time from its construction to its destruction
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Timer timer) : ScopedTimer(static_cast<uint32_t>(timer)) {}
+
+    explicit ScopedTimer(uint32_t timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        Stats::record(timer, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    uint32_t timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#endif //WUFF_STATS_H
@@ -0,0 +1,55 @@
+#include "SymbolTable.h"
+#include "MemoryUsage.h"
+
+std::unique_ptr<SymbolTable> SymbolTable::instance;
+std::once_flag SymbolTable::initInstanceFlag;
+
+SymbolTable *SymbolTable::getInstance() {
+    std::call_once(initInstanceFlag, []() {
+        instance.reset(new SymbolTable());
+    });
+    return instance.get();
+}
+
+SymbolTable::SymbolTable() {
+    names.emplace_back();
+    ids.emplace(names.back(), EMPTY);
+}
+
+SymbolId SymbolTable::intern(std::string_view name) {
+    {
+        // almost every name is already known, looking it up does not block other readers
+        std::shared_lock<std::shared_mutex> lock(symbolsMutex);
+        auto id = ids.find(name);
+        if (id != ids.end()) return id->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(symbolsMutex);
+    auto id = ids.find(name);
+    if (id != ids.end()) return id->second;
+    auto newId = static_cast<SymbolId>(names.size());
+    names.emplace_back(name);
+    ids.emplace(names.back(), newId);
+    return newId;
+}
+
+SymbolId SymbolTable::find(std::string_view name) const {
+    std::shared_lock<std::shared_mutex> lock(symbolsMutex);
+    auto id = ids.find(name);
+    return id != ids.end() ? id->second : NO_SYMBOL;
+}
+
+const std::string &SymbolTable::name(SymbolId id) const {
+    std::shared_lock<std::shared_mutex> lock(symbolsMutex);
+    return names.at(id);
+}
+
+size_t SymbolTable::memoryUsage() const {
+    std::shared_lock<std::shared_mutex> lock(symbolsMutex);
+    // the unused rest of the last block of the deque is not counted
+    size_t bytes = names.size() * sizeof(std::string) + memory::heapBytes(ids);
+    for (const std::string &name: names) {
+        bytes += memory::heapBytes(name);
+    }
+    return bytes;
+}
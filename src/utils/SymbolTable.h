@@ -0,0 +1,51 @@
+#ifndef WUFF_SYMBOLTABLE_H
+#define WUFF_SYMBOLTABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using SymbolId = uint32_t;
+
+/**
+ * Process-wide table of interned identifiers (structure types and names, meta keys, referencing type names).
+ *
+ * Every distinct string gets a 32-bit id once, so that indexes can store and compare ids instead of strings.
+ * Ids are only valid within the process, anything persisted has to store the names.
+ * Symbols are never removed, only names from dialects and the grammar should be interned (text of a document
+ * can be looked up with find). The table can be used from several threads at once.
+ */
+class SymbolTable {
+public:
+    static SymbolTable *getInstance();
+
+    // the id of the name, a new one if the name was not interned yet
+    SymbolId intern(std::string_view name);
+    // the id of the name, NO_SYMBOL if it was never interned (so nothing indexed can match it)
+    [[nodiscard]] SymbolId find(std::string_view name) const;
+    [[nodiscard]] const std::string &name(SymbolId id) const;
+    // estimated heap bytes of the names and the lookup table
+    [[nodiscard]] size_t memoryUsage() const;
+
+    // the empty string, always interned
+    static const SymbolId EMPTY = 0;
+    static const SymbolId NO_SYMBOL = UINT32_MAX;
+
+private:
+    SymbolTable();
+    static std::unique_ptr<SymbolTable> instance;
+    static std::once_flag initInstanceFlag;
+
+    mutable std::shared_mutex symbolsMutex;
+    // a deque does not move its elements, the views in ids stay valid
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, SymbolId> ids;
+};
+
+
+#endif //WUFF_SYMBOLTABLE_H
@@ -0,0 +1,49 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksAvailable.notify_all();
+    // tasks already submitted are still finished, their futures may be waited for
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+size_t ThreadPool::queueDepth(Lane lane) {
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    return lanes[static_cast<size_t>(lane)].size();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            auto next = lanes.end();
+            tasksAvailable.wait(lock, [this, &next]() {
+                next = std::find_if(lanes.begin(), lanes.end(), [](const auto &lane) { return !lane.empty(); });
+                return stopping || next != lanes.end();
+            });
+            if (next == lanes.end()) return;
+            task = std::move(next->front());
+            next->pop_front();
+        }
+        task();
+    }
+}
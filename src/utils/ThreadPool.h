@@ -0,0 +1,59 @@
+#ifndef WUFF_THREADPOOL_H
+#define WUFF_THREADPOOL_H
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Lane.h"
+
+/**
+ * Fixed-size pool of worker threads executing submitted tasks, a task of a more urgent lane first
+ * and the tasks of one lane in FIFO order. A running task is not interrupted.
+ *
+ * Tasks must not wait for other tasks of the same pool, a pool whose workers all wait would never finish.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&task, Lane lane = Lane::Interactive) {
+        using Result = std::invoke_result_t<F>;
+        // std::function needs a copyable callable, packaged_task is move-only
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(tasksMutex);
+            lanes[static_cast<size_t>(lane)].emplace_back([packaged]() { (*packaged)(); });
+        }
+        tasksAvailable.notify_one();
+        return result;
+    }
+
+    [[nodiscard]] size_t size() const;
+    // number of tasks of the lane waiting for a worker
+    [[nodiscard]] size_t queueDepth(Lane lane);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::array<std::deque<std::function<void()>>, LANE_COUNT> lanes;
+    std::mutex tasksMutex;
+    std::condition_variable tasksAvailable;
+    bool stopping = false;
+};
+
+
+#endif //WUFF_THREADPOOL_H
@@ -3,6 +3,7 @@
 //
 
 #include <string>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -75,11 +76,11 @@ namespace utils {
         return uri;
     }
 
-    std::optional<TSNode> getChild(TSNode node, const char *childType) {
+    std::optional<TSNode> getChild(TSNode node, TSSymbol childSymbol) {
         uint32_t child_count = ts_node_child_count(node);
         for (uint32_t i = 0; i < child_count; ++i) {
             TSNode child = ts_node_child(node, i);
-            if (strcmp(ts_node_type(child), childType) == 0) {
+            if (ts_node_symbol(child) == childSymbol) {
                 return child;
             }
         }
@@ -94,15 +95,145 @@ namespace utils {
         }
     }
 
-    std::string getChildText(TSNode node, const char *childType, WooWooDocument *doc) {
+    namespace {
+        // matches the character class starting at pattern[p] ('['), moves p behind it
+        bool matchClass(const std::string &pattern, size_t &p, char c, bool &valid) {
+            size_t i = p + 1;
+            bool negated = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+            if (negated) ++i;
+            bool matched = false;
+            bool first = true;
+            while (i < pattern.size() && (pattern[i] != ']' || first)) {
+                first = false;
+                if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                    matched |= pattern[i] <= c && c <= pattern[i + 2];
+                    i += 3;
+                } else {
+                    matched |= pattern[i] == c;
+                    ++i;
+                }
+            }
+            // an unterminated class is taken literally
+            valid = i < pattern.size();
+            if (valid) p = i + 1;
+            return matched != negated;
+        }
+
+        bool globMatchFrom(const std::string &pattern, size_t p, const std::string &path, size_t s) {
+            while (p < pattern.size()) {
+                char pc = pattern[p];
+                if (pc == '*') {
+                    if (p + 1 < pattern.size() && pattern[p + 1] == '*') {
+                        // '**' matches anything, "**/" also matches no directory at all
+                        size_t rest = p + 2;
+                        while (rest < pattern.size() && pattern[rest] == '*') ++rest;
+                        if (rest < pattern.size() && pattern[rest] == '/' && globMatchFrom(pattern, rest + 1, path, s)) {
+                            return true;
+                        }
+                        for (size_t k = s; k <= path.size(); ++k) {
+                            if (globMatchFrom(pattern, rest, path, k)) return true;
+                        }
+                        return false;
+                    }
+                    for (size_t k = s;; ++k) {
+                        if (globMatchFrom(pattern, p + 1, path, k)) return true;
+                        if (k == path.size() || path[k] == '/') return false;
+                    }
+                }
+                if (s == path.size()) return false;
+                if (pc == '?') {
+                    if (path[s] == '/') return false;
+                    ++p;
+                    ++s;
+                    continue;
+                }
+                if (pc == '[') {
+                    bool valid;
+                    size_t next = p;
+                    bool matched = matchClass(pattern, next, path[s], valid);
+                    if (valid) {
+                        if (!matched || path[s] == '/') return false;
+                        p = next;
+                        ++s;
+                        continue;
+                    }
+                }
+                if (pc == '\\' && p + 1 < pattern.size()) {
+                    pc = pattern[++p];
+                }
+                if (pc != path[s]) return false;
+                ++p;
+                ++s;
+            }
+            return s == path.size();
+        }
+    }
+
+    bool globMatch(const std::string &pattern, const std::string &path) {
+        return globMatchFrom(pattern, 0, path, 0);
+    }
+
+    std::optional<std::string> readFile(const fs::path &path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file) return std::nullopt;
+        std::streamoff size = file.tellg();
+        if (size < 0) return std::nullopt;
+        file.seekg(0);
+        std::string content(static_cast<size_t>(size), '\0');
+        file.read(content.data(), size);
+        // the file could have been shortened in the meantime
+        content.resize(static_cast<size_t>(file.gcount()));
+        if (file.bad()) return std::nullopt;
+        return content;
+    }
+
+    /**
+     * Consumes 8 bytes at a time (read as little endian, so the hash is the same on every platform), each word
+     * is mixed in as by the single-lane rounds of XXH64 and the result finalized by its avalanche.
+     */
+    uint64_t hashContent(std::string_view content) {
+        const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+        const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+        const uint64_t prime3 = 0x165667B19E3779F9ull;
+        const uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+        const uint64_t prime5 = 0x27D4EB2F165667C5ull;
+        auto rotate = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+
+        const auto *data = reinterpret_cast<const unsigned char *>(content.data());
+        const size_t size = content.size();
+        uint64_t hash = prime5 + size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            // compiled to a single load where the platform is little endian
+            uint64_t word = 0;
+            for (int byte = 7; byte >= 0; --byte) {
+                word = (word << 8) | data[i + byte];
+            }
+            hash ^= rotate(word * prime2, 31) * prime1;
+            hash = rotate(hash, 27) * prime1 + prime4;
+        }
+        for (; i < size; ++i) {
+            hash ^= data[i] * prime5;
+            hash = rotate(hash, 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    std::string_view getChildText(TSNode node, TSSymbol childSymbol, WooWooDocument *doc) {
         uint32_t child_count = ts_node_child_count(node);
         for (uint32_t i = 0; i < child_count; ++i) {
             TSNode child = ts_node_child(node, i);
-            if (strcmp(ts_node_type(child), childType) == 0) {
+            if (ts_node_symbol(child) == childSymbol) {
                 return doc->getNodeText(child);
             }
         }
-        return ""; // Return an empty string if no matching child is found
+        return {}; // Return an empty string if no matching child is found
     }
 
     void reportQueryError(const std::string &queryName, uint32_t errorOffset, TSQueryError errorType) {
@@ -131,6 +262,33 @@ namespace utils {
         throw std::runtime_error(errorMessage);
     }
 
+    void appendJsonEscaped(std::string &out, std::string_view text) {
+        for (char c: text) {
+            switch (c) {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+    }
+
     void appendToLogFile(const std::string &message) {
         std::ofstream logFile("log.txt", std::ios::app);
 
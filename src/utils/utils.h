@@ -5,7 +5,11 @@
 #ifndef WUFF_UTILS_H
 #define WUFF_UTILS_H
 class WooWooDocument;
+#include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <tree_sitter/api.h>
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -14,9 +18,19 @@ namespace utils {
     std::string percentDecode(const std::string& encoded);
     std::string uriToPathString(const std::string& uri);
     std::string pathToUri(const fs::path &documentPath);
+    // the whole file in one read into a buffer of its size (no stream copies), nullopt if it cannot be read
+    std::optional<std::string> readFile(const fs::path &path);
     bool endsWith(const std::string &str, const std::string &suffix) ;
-    std::optional<TSNode> getChild(TSNode node, const char *childTypes);
-    std::string getChildText(TSNode node, const char *childType, WooWooDocument *doc);
+    // gitignore-like glob: '*' and '?' do not match '/', '**' matches across directories, [a-z] and [!a-z] classes
+    bool globMatch(const std::string &pattern, const std::string &path);
+    // the text as the content of a JSON string (without the quotes), UTF-8 is passed through
+    void appendJsonEscaped(std::string &out, std::string_view text);
+    // fast 64-bit hash of the content, stable across runs and platforms
+    uint64_t hashContent(std::string_view content);
+    // the first child with the symbol (see woowoo::Symbol), nullopt if there is none
+    std::optional<TSNode> getChild(TSNode node, TSSymbol childSymbol);
+    // a view into the source of the document, empty if the node has no such child
+    std::string_view getChildText(TSNode node, TSSymbol childSymbol, WooWooDocument *doc);
     void appendToLogFile(const std::string & message);
     void reportQueryError(const std::string & queryName, uint32_t errorOffset, TSQueryError errorType);
 } // namespace utils
@@ -0,0 +1,38 @@
+from wuff import DocumentFeature, Position, Range, TextDocumentIdentifier
+
+
+def diagnostic_summary(diagnostics):
+    return [(d.range.start.line, d.range.start.character, d.message) for d in diagnostics]
+
+
+def folding_summary(ranges):
+    return [(r.start_line, r.end_line, r.kind) for r in ranges]
+
+
+def test_analyze_document_matches_separate_requests(analyzer, file3_uri):
+    tdi = TextDocumentIdentifier(file3_uri)
+    analysis = analyzer.analyze_document(tdi, DocumentFeature.All)
+    assert analysis.semantic_tokens == analyzer.semantic_tokens(tdi)
+    assert diagnostic_summary(analysis.diagnostics) == diagnostic_summary(analyzer.diagnose(tdi))
+    assert folding_summary(analysis.folding_ranges) == folding_summary(analyzer.folding_ranges(tdi))
+
+
+def test_analyze_document_computes_requested_features(analyzer, file2_uri):
+    tdi = TextDocumentIdentifier(file2_uri)
+    before = analyzer.analyze_document(tdi, DocumentFeature.SemanticTokens | DocumentFeature.FoldingRanges)
+    assert before.semantic_tokens is not None and before.folding_ranges is not None
+    assert before.diagnostics is None
+
+    analyzer.document_did_change_incremental(tdi, [(Range(Position(0, 0), Position(0, 0)), "% note\n")])
+    try:
+        after = analyzer.analyze_document(tdi, DocumentFeature.FoldingRanges)
+        assert after.version > before.version
+        assert after.semantic_tokens is None
+        # a single comment line is not folded, the ranges after it are moved
+        assert folding_summary(after.folding_ranges) == [(start + 1, end + 1, kind) for start, end, kind
+                                                         in folding_summary(before.folding_ranges)]
+    finally:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(0, 0), Position(1, 0)), "")])
+
+    missing = analyzer.analyze_document(TextDocumentIdentifier("file:///missing.woo"), DocumentFeature.All)
+    assert missing.version == 0 and missing.diagnostics is None
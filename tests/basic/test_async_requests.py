@@ -0,0 +1,18 @@
+from wuff import TextDocumentIdentifier
+
+
+def test_async_results_match_blocking_ones(analyzer, file1_uri, file2_uri, file3_uri):
+    tdis = [TextDocumentIdentifier(uri) for uri in [file1_uri, file2_uri, file3_uri]]
+    pending = [(analyzer.semantic_tokens_async(tdi), analyzer.diagnose_async(tdi)) for tdi in tdis]
+    for tdi, (tokens, diagnostics) in zip(tdis, pending):
+        assert tokens.result() == analyzer.semantic_tokens(tdi)
+        assert len(diagnostics.result()) == len(analyzer.diagnose(tdi))
+
+
+def test_async_request_error_is_raised_on_result(analyzer):
+    pending = analyzer.semantic_tokens_async(TextDocumentIdentifier("not-a-file-uri"))
+    try:
+        pending.result()
+        assert False, "expected the request to fail"
+    except Exception:
+        pass
@@ -0,0 +1,22 @@
+from pathlib import Path
+
+from wuff import TextDocumentIdentifier
+
+
+def test_background_diagnostics(load_analyzer, file3_uri):
+    # a separate analyzer, the scheduler would keep diagnosing the documents of the other tests
+    analyzer = load_analyzer()
+    analyzer.start_background_diagnostics(10)
+
+    original = (Path(__file__).parent.parent.resolve() / "files" / "test_project" / "file3.woo").read_text()
+    tdi = TextDocumentIdentifier(file3_uri)
+    # rapid changes are coalesced into a single run
+    for _ in range(5):
+        analyzer.document_did_change(tdi, original)
+
+    published = analyzer.take_diagnostics(5000)
+    assert [params.uri for params in published] == [file3_uri]
+    assert len(published[0].diagnostics) == 1
+    assert analyzer.take_diagnostics(0) == []
+    # nothing is left waiting in any lane
+    assert analyzer.queue_depths() == {"interactive": 0, "indexing": 0, "background": 0}
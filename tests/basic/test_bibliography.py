@@ -0,0 +1,57 @@
+from pathlib import Path
+import wuff
+from wuff import (
+    CompletionParams, Position, CompletionContext, CompletionTriggerKind,
+    DefinitionParams, TextDocumentIdentifier, FileEvent, FileChangeType
+)
+
+KNUTH = """@book{knuth84,
+  title = {The {TeX}book},
+  author = {Donald E. Knuth},
+  year = 1984
+}
+"""
+
+LAMPORT = """@Article{lamport94,
+  title = "LaTeX: A Document Preparation System",
+  year = 1994
+}
+"""
+
+
+def complete_citation(analyzer, uri, line, char):
+    params = CompletionParams(TextDocumentIdentifier(uri), Position(line, char),
+                              CompletionContext(CompletionTriggerKind.TriggerCharacter, ":"))
+    return [item.label for item in analyzer.complete(params)]
+
+
+def test_bibliography_from_woofile(tmp_path):
+    (tmp_path / "Woofile").write_text("builder:\n  bibtex: refs.bib\n")
+    bibliography = tmp_path / "refs.bib"
+    bibliography.write_text(KNUTH + "\n" + LAMPORT)
+    (tmp_path / "a.woo").write_text("Hello, see .cite:knuth84\n")
+
+    analyzer = wuff.WooWooAnalyzer()
+    analyzer.set_dialect(str(Path(__file__).parent.parent.resolve() / "files" / "fit_math.yaml"))
+    analyzer.load_workspace(tmp_path.as_uri())
+    a_uri = (tmp_path / "a.woo").as_uri()
+
+    assert complete_citation(analyzer, a_uri, 0, 17) == ["knuth84", "lamport94"]
+    definition = analyzer.go_to_definition(DefinitionParams(TextDocumentIdentifier(a_uri), Position(0, 20)))
+    assert definition.uri.endswith("refs.bib")
+    assert definition.range.start.line == 0
+    assert definition.range.start.character == 6
+
+    # an entry added in front of the cited one, the rest of the file is only moved
+    bibliography.write_text("@misc{first,\n  title = {First}\n}\n\n" + KNUTH + "\n" + LAMPORT)
+    analyzer.did_change_watched_files([FileEvent(bibliography.as_uri(), FileChangeType.Changed)])
+    assert complete_citation(analyzer, a_uri, 0, 17) == ["first", "knuth84", "lamport94"]
+    definition = analyzer.go_to_definition(DefinitionParams(TextDocumentIdentifier(a_uri), Position(0, 20)))
+    assert definition.range.start.line == 4
+
+    # the cited entry is gone
+    bibliography.write_text(LAMPORT)
+    analyzer.did_change_watched_files([FileEvent(bibliography.as_uri(), FileChangeType.Changed)])
+    assert complete_citation(analyzer, a_uri, 0, 17) == ["lamport94"]
+    definition = analyzer.go_to_definition(DefinitionParams(TextDocumentIdentifier(a_uri), Position(0, 20)))
+    assert definition.uri == ""
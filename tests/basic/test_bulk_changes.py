@@ -0,0 +1,31 @@
+from wuff import FileEvent, FileChangeType
+
+
+def test_rename_folder_refactors_includes(load_analyzer, tmp_path):
+    (tmp_path / "Woofile").write_text("")
+    (tmp_path / "main.woo").write_text(".include chapters/a.woo\n.include chapters/b.woo\n")
+    (tmp_path / "chapters").mkdir()
+    (tmp_path / "chapters" / "a.woo").write_text("\n")
+    (tmp_path / "chapters" / "b.woo").write_text(".include ../main.woo\n")
+
+    analyzer = load_analyzer(tmp_path)
+    (tmp_path / "chapters").rename(tmp_path / "parts")
+    edit = analyzer.rename_files([((tmp_path / "chapters").as_uri(), (tmp_path / "parts").as_uri())])
+
+    main_edits = sorted(e.new_text for e in edit.changes[(tmp_path / "main.woo").as_uri()])
+    assert main_edits == ["parts/a.woo", "parts/b.woo"]
+    # the include of a document which did not move stays valid from the moved one
+    assert (tmp_path / "parts" / "b.woo").as_uri() not in edit.changes
+
+
+def test_watched_file_events(load_analyzer, included_paths, tmp_path):
+    (tmp_path / "Woofile").write_text("")
+    (tmp_path / "main.woo").write_text("\n")
+    (tmp_path / "a.woo").write_text("\n")
+    analyzer = load_analyzer(tmp_path)
+
+    (tmp_path / "b.woo").write_text("\n")
+    (tmp_path / "a.woo").unlink()
+    analyzer.did_change_watched_files([FileEvent((tmp_path / "b.woo").as_uri(), FileChangeType.Created),
+                                       FileEvent((tmp_path / "a.woo").as_uri(), FileChangeType.Deleted)])
+    assert included_paths(analyzer, (tmp_path / "main.woo").as_uri()) == {"main.woo", "b.woo"}
@@ -0,0 +1,27 @@
+import pytest
+import wuff
+from wuff import ReferenceParams, Position, TextDocumentIdentifier
+
+
+def test_cancelled_request_raises(analyzer, file1_uri):
+    token = wuff.CancellationToken()
+    token.cancel()
+    params = ReferenceParams(TextDocumentIdentifier(file1_uri), Position(4, 41), True)
+    with pytest.raises(wuff.RequestCancelled):
+        analyzer.references(params, token)
+
+
+def test_passed_deadline_cancels_request(analyzer, file1_uri):
+    token = wuff.CancellationToken()
+    token.set_timeout(0)
+    assert token.is_cancelled()
+    params = ReferenceParams(TextDocumentIdentifier(file1_uri), Position(4, 41), True)
+    with pytest.raises(wuff.RequestCancelled):
+        analyzer.references_async(params, token).result()
+
+
+def test_uncancelled_token_does_not_change_result(analyzer, file1_uri):
+    params = ReferenceParams(TextDocumentIdentifier(file1_uri), Position(4, 41), True)
+    expected = [(loc.uri, loc.range.start.line) for loc in analyzer.references(params)]
+    result = analyzer.references(params, wuff.CancellationToken())
+    assert [(loc.uri, loc.range.start.line) for loc in result] == expected
@@ -0,0 +1,30 @@
+from wuff import TextDocumentIdentifier
+
+
+def summary(published):
+    return [(params.uri, sorted((d.range.start.line, d.message) for d in params.diagnostics))
+            for params in published]
+
+
+def test_check_workspace_matches_diagnose(load_analyzer, tmp_path, file3_uri):
+    analyzer = load_analyzer(cache_directory=str(tmp_path))
+    published = analyzer.check_workspace()
+    # every document once, in the order of their paths
+    uris = [params.uri for params in published]
+    assert file3_uri in uris and uris == sorted(uris)
+    for params in published:
+        expected = analyzer.diagnose(TextDocumentIdentifier(params.uri))
+        assert sorted(d.message for d in params.diagnostics) == sorted(d.message for d in expected)
+    assert len(next(p for p in published if p.uri == file3_uri).diagnostics) == 1
+
+    # a warm start checks the documents from the cached index alone
+    del analyzer
+    assert summary(load_analyzer(cache_directory=str(tmp_path)).check_workspace()) == summary(published)
+
+
+def test_check_workspace_waits_for_progressive_load(load_analyzer, file3_uri):
+    analyzer = load_analyzer(progressive=True)
+    # the documents still being loaded are checked too
+    published = analyzer.check_workspace()
+    assert analyzer.load_progress().done
+    assert file3_uri in [params.uri for params in published]
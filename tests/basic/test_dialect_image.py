@@ -0,0 +1,51 @@
+import shutil
+from pathlib import Path
+import pytest
+import wuff
+from wuff import TextDocumentPositionParams, TextDocumentIdentifier, Position
+
+DIALECT_PATH = Path(__file__).parent.parent.resolve() / "files" / "fit_math.yaml"
+
+
+def hover_docpart(analyzer, uri):
+    return analyzer.hover(TextDocumentPositionParams(TextDocumentIdentifier(uri), Position(0, 3)))
+
+
+def test_compiled_dialect_matches_yaml(analyzer, file1_uri, tmp_path):
+    expected = hover_docpart(analyzer, file1_uri)
+
+    image_path = wuff.compile_dialect(str(DIALECT_PATH), str(tmp_path / "fit_math.bin"))
+    assert Path(image_path).is_file()
+    try:
+        analyzer.set_dialect(image_path)
+        assert hover_docpart(analyzer, file1_uri) == expected
+    finally:
+        analyzer.set_dialect(str(DIALECT_PATH))
+
+
+def test_image_next_to_the_yaml(analyzer, file1_uri, tmp_path):
+    expected = hover_docpart(analyzer, file1_uri)
+    dialect_copy = tmp_path / "fit_math.yaml"
+    shutil.copy(DIALECT_PATH, dialect_copy)
+
+    image_path = Path(wuff.compile_dialect(str(dialect_copy)))
+    assert image_path == tmp_path / "fit_math.yaml.bin"
+    try:
+        analyzer.set_dialect(str(dialect_copy))
+        assert hover_docpart(analyzer, file1_uri) == expected
+
+        # the image is stale once the YAML changes, the YAML is loaded instead
+        with open(dialect_copy, "a") as f:
+            f.write("\n# changed\n")
+        analyzer.set_dialect(str(dialect_copy))
+        assert hover_docpart(analyzer, file1_uri) == expected
+    finally:
+        analyzer.set_dialect(str(DIALECT_PATH))
+
+
+def test_corrupted_image_is_rejected(analyzer, tmp_path):
+    image_path = Path(wuff.compile_dialect(str(DIALECT_PATH), str(tmp_path / "fit_math.bin")))
+    image_path.write_bytes(image_path.read_bytes()[:-3])
+    with pytest.raises(Exception):
+        analyzer.set_dialect(str(image_path))
+    analyzer.set_dialect(str(DIALECT_PATH))
@@ -0,0 +1,32 @@
+from wuff import TextDocumentIdentifier, Range, Position
+
+
+def diagnose_document(analyzer, uri):
+    return analyzer.diagnose(TextDocumentIdentifier(uri))
+
+
+def replace_line(analyzer, uri, line, old_length, new_text):
+    change = (Range(Position(line, 0), Position(line, old_length)), new_text)
+    analyzer.document_did_change_incremental(TextDocumentIdentifier(uri), [change])
+
+
+def test_incremental_change(analyzer, file1_uri):
+    broken_line = "Missing node: .cite:   ?"
+    try:
+        replace_line(analyzer, file1_uri, 5, len("Thanks."), broken_line)
+        diagnostics = diagnose_document(analyzer, file1_uri)
+        assert len(diagnostics) == 1, "Expected the edit to introduce exactly 1 diagnostic"
+        assert diagnostics[0].message == "Syntax error: MISSING short_inner_environment_body"
+    finally:
+        replace_line(analyzer, file1_uri, 5, len(broken_line), "Thanks.")
+
+    diagnostics = diagnose_document(analyzer, file1_uri)
+    assert len(diagnostics) == 0, "Expected no diagnostics after reverting the edit"
+
+
+def test_unchanged_content_is_skipped(analyzer, file1_uri):
+    skipped = analyzer.get_stats()["noop_edit_skipped"]
+    # "Thanks." replaced by itself
+    replace_line(analyzer, file1_uri, 5, len("Thanks."), "Thanks.")
+    assert analyzer.get_stats()["noop_edit_skipped"] == skipped + 1
+    assert len(diagnose_document(analyzer, file1_uri)) == 0
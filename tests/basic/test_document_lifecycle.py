@@ -0,0 +1,57 @@
+from wuff import TextDocumentIdentifier, Position, DefinitionParams
+
+
+def write_project(tmp_path):
+    (tmp_path / "Woofile").write_text("")
+    (tmp_path / "main.woo").write_text(".include other.woo\n")
+    (tmp_path / "other.woo").write_text(".Chapter Other\n  label: other\n\nText.\n")
+    return tmp_path
+
+
+def materialized(analyzer, uri):
+    return next(document for document in analyzer.memory_usage().documents if document.uri == uri).materialized
+
+
+def test_closed_document_drops_unsaved_changes_and_its_trees(load_analyzer, tmp_path):
+    analyzer = load_analyzer(write_project(tmp_path))
+    uri = (tmp_path / "other.woo").as_uri()
+    analyzer.open_document(TextDocumentIdentifier(uri))
+    analyzer.document_did_change(TextDocumentIdentifier(uri), ".Chapter Other\n  label: changed\n\nText.\n")
+    assert {symbol.name for symbol in analyzer.workspace_symbols("changed")} == {"changed"}
+
+    analyzer.close_document(TextDocumentIdentifier(uri))
+    assert not materialized(analyzer, uri)
+    assert {symbol.name for symbol in analyzer.workspace_symbols("other")} == {"other"}
+    assert not analyzer.workspace_symbols("changed")
+
+
+def test_idle_eviction_and_prefetch_after_definition(load_analyzer, wait_for, tmp_path):
+    analyzer = load_analyzer(write_project(tmp_path))
+    analyzer.set_idle_eviction(50)
+    main_uri = (tmp_path / "main.woo").as_uri()
+    other_uri = (tmp_path / "other.woo").as_uri()
+    for uri in (main_uri, other_uri):
+        analyzer.open_document(TextDocumentIdentifier(uri))
+        analyzer.semantic_tokens(TextDocumentIdentifier(uri))
+    analyzer.close_document(TextDocumentIdentifier(other_uri))
+    # kept parsed for a while in case it is opened again, the open one stays parsed
+    assert materialized(analyzer, other_uri)
+    assert wait_for(lambda: not materialized(analyzer, other_uri))
+    assert materialized(analyzer, main_uri)
+    assert analyzer.get_stats()["idle_documents_evicted"] > 0
+
+    analyzer.set_idle_eviction(0)
+    definition = analyzer.go_to_definition(DefinitionParams(TextDocumentIdentifier(main_uri), Position(0, 11)))
+    assert definition.uri == other_uri
+    # parsed in the background before the client opens it
+    assert wait_for(lambda: materialized(analyzer, other_uri))
+
+
+def test_prefetch_hint(load_analyzer, wait_for, tmp_path):
+    analyzer = load_analyzer(write_project(tmp_path))
+    uri = (tmp_path / "other.woo").as_uri()
+    prefetched = analyzer.get_stats()["documents_prefetched"]
+    analyzer.prefetch_document(uri)
+    assert wait_for(lambda: materialized(analyzer, uri))
+    assert analyzer.get_stats()["documents_prefetched"] == prefetched + 1
+    assert analyzer.diagnose(TextDocumentIdentifier(uri)) == []
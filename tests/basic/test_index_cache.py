@@ -0,0 +1,30 @@
+from wuff import (
+    CompletionParams, Position, CompletionContext,
+    CompletionTriggerKind, TextDocumentIdentifier
+)
+
+
+def completed_labels(analyzer, uri):
+    params = CompletionParams(TextDocumentIdentifier(uri), Position(4, 41),
+                              CompletionContext(CompletionTriggerKind.TriggerCharacter, ":"))
+    return sorted(item.label for item in analyzer.complete(params))
+
+
+def test_warm_start_matches_cold_start(load_analyzer, tmp_path, file1_uri):
+    cold = load_analyzer(cache_directory=str(tmp_path))
+    assert list(tmp_path.glob("workspace-*.idx"))
+
+    # documents other than the requested one are only known from the cache
+    warm = load_analyzer(cache_directory=str(tmp_path))
+    assert completed_labels(warm, file1_uri) == completed_labels(cold, file1_uri)
+    assert warm.semantic_tokens(TextDocumentIdentifier(file1_uri)) == \
+        cold.semantic_tokens(TextDocumentIdentifier(file1_uri))
+
+
+def test_corrupted_cache_is_ignored(load_analyzer, tmp_path, file1_uri):
+    cold = load_analyzer(cache_directory=str(tmp_path))
+    for cache_file in tmp_path.glob("workspace-*.idx"):
+        cache_file.write_bytes(cache_file.read_bytes()[:40])
+
+    warm = load_analyzer(cache_directory=str(tmp_path))
+    assert completed_labels(warm, file1_uri) == completed_labels(cold, file1_uri)
@@ -0,0 +1,26 @@
+import json
+from wuff import TextDocumentIdentifier, Position, DefinitionParams, ReferenceParams, CancellationToken
+
+
+def location_tuple(location):
+    return location.uri, location.range.start.line, location.range.start.character
+
+
+def test_references_json_matches_objects(analyzer, file2_uri):
+    params = ReferenceParams(TextDocumentIdentifier(file2_uri), Position(1, 11), True)
+    encoded = json.loads(analyzer.references_json(params))
+    expected = [location_tuple(location) for location in analyzer.references(params)]
+    assert [(l["uri"], l["range"]["start"]["line"], l["range"]["start"]["character"]) for l in encoded] == expected
+
+
+def test_definition_json(analyzer, file1_uri):
+    definition = json.loads(analyzer.go_to_definition_json(DefinitionParams(TextDocumentIdentifier(file1_uri),
+                                                                            Position(4, 43))))
+    assert "file2.woo" in definition["uri"]
+    assert definition["range"]["start"] == {"line": 1, "character": 9}
+
+
+def test_folding_ranges_json(analyzer, file2_uri):
+    tdi = TextDocumentIdentifier(file2_uri)
+    encoded = json.loads(analyzer.folding_ranges_json(tdi, CancellationToken()))
+    assert [r["startLine"] for r in encoded] == [r.start_line for r in analyzer.folding_ranges(tdi)]
@@ -0,0 +1,24 @@
+from wuff import TextDocumentIdentifier, Range, Position
+
+
+def test_large_document_features_limited_to_viewport(analyzer, file2_uri):
+    document = TextDocumentIdentifier(file2_uri)
+    all_tokens = list(analyzer.semantic_tokens(document))
+    assert len(analyzer.folding_ranges(document)) == 3
+    assert not analyzer.is_partial(document)
+
+    # every document is large from now on
+    analyzer.set_large_file_mode(1)
+    try:
+        analyzer.set_viewport(document, Range(Position(0, 0), Position(1, 0)))
+        assert analyzer.is_partial(document)
+        tokens = list(analyzer.semantic_tokens(document))
+        assert 0 < len(tokens) < len(all_tokens)
+        ranges = analyzer.folding_ranges(document)
+        assert 0 < len(ranges) < 3
+        assert all(folding_range.start_line <= 1 for folding_range in ranges)
+    finally:
+        analyzer.set_large_file_mode(0)
+
+    assert not analyzer.is_partial(document)
+    assert list(analyzer.semantic_tokens(document)) == all_tokens
@@ -0,0 +1,12 @@
+from wuff import TextDocumentIdentifier
+
+
+def test_unloaded_documents_are_parsed_again(load_analyzer, file1_uri, file2_uri, file3_uri):
+    unlimited = load_analyzer(memory_budget=0)
+    # every document but the two most recently used is unloaded right away
+    tiny = load_analyzer(memory_budget=1)
+    for _ in range(2):
+        for uri in [file1_uri, file2_uri, file3_uri]:
+            tdi = TextDocumentIdentifier(uri)
+            assert tiny.semantic_tokens(tdi) == unlimited.semantic_tokens(tdi)
+            assert len(tiny.diagnose(tdi)) == len(unlimited.diagnose(tdi))
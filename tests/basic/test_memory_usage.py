@@ -0,0 +1,17 @@
+from wuff import TextDocumentIdentifier
+
+
+def test_memory_usage_by_document_and_subsystem(analyzer, file1_uri):
+    analyzer.semantic_tokens(TextDocumentIdentifier(file1_uri))
+    usage = analyzer.memory_usage()
+
+    document = next(document for document in usage.documents if document.uri == file1_uri)
+    assert document.materialized
+    assert document.source > 0 and document.tree > 0 and document.index > 0
+    assert document.total == (document.source + document.tree + document.meta_trees + document.utf_mappings
+                              + document.comment_lines + document.index)
+
+    for subsystem in ("source", "syntax_trees", "reference_index", "label_index", "queries", "dialect"):
+        assert usage.subsystems[subsystem] > 0
+    assert usage.total == sum(usage.subsystems.values())
+    assert usage.subsystems["source"] == sum(document.source for document in usage.documents)
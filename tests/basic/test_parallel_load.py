@@ -0,0 +1,21 @@
+from wuff import TextDocumentIdentifier, ReferenceParams, Position
+
+
+def test_parallel_load_matches_sequential(load_analyzer, file1_uri, file2_uri, file3_uri):
+    sequential = load_analyzer(thread_pool_size=1)
+    parallel = load_analyzer(thread_pool_size=4)
+    for uri in [file1_uri, file2_uri, file3_uri]:
+        tdi = TextDocumentIdentifier(uri)
+        assert parallel.semantic_tokens(tdi) == sequential.semantic_tokens(tdi)
+        assert len(parallel.diagnose(tdi)) == len(sequential.diagnose(tdi))
+
+
+def test_parallel_references_match_sequential(load_analyzer, file2_uri):
+    sequential = load_analyzer(thread_pool_size=1)
+    parallel = load_analyzer(thread_pool_size=4)
+    params = ReferenceParams(TextDocumentIdentifier(file2_uri), Position(1, 11), True)
+    expected = [(location.uri, location.range.start.line, location.range.start.character)
+                for location in sequential.references(params)]
+    found = [(location.uri, location.range.start.line, location.range.start.character)
+             for location in parallel.references(params)]
+    assert found == expected
@@ -0,0 +1,22 @@
+import os
+import time
+from pathlib import Path
+import wuff
+from wuff import TextDocumentIdentifier, TextDocumentPositionParams, Position
+
+
+def test_progressive_load(file1_uri):
+    analyzer = wuff.WooWooAnalyzer()
+    tests_path = Path(__file__).parent.parent.resolve()
+    analyzer.set_dialect(str(tests_path / "files" / "fit_math.yaml"))
+    # opened before the workspace is loaded, it is loaded before returning
+    analyzer.open_document(TextDocumentIdentifier(file1_uri))
+    analyzer.load_workspace_progressive(f"file:///{tests_path / 'files' / 'test_project'}".replace(os.sep, '/'))
+    assert analyzer.hover(TextDocumentPositionParams(TextDocumentIdentifier(file1_uri), Position(0, 3))) != ""
+
+    deadline = time.time() + 10
+    while not analyzer.load_progress().done and time.time() < deadline:
+        time.sleep(0.01)
+    progress = analyzer.load_progress()
+    assert progress.done
+    assert progress.discovered == progress.parsed == progress.indexed == 4
@@ -0,0 +1,39 @@
+from pathlib import Path
+import wuff
+from wuff import TextDocumentPositionParams, TextDocumentIdentifier, Position, FileEvent, FileChangeType
+
+DIALECT_PATH = Path(__file__).parent.parent.resolve() / "files" / "fit_math.yaml"
+DEFAULT_DESCRIPTION = "Top-level document part with the chapter's textual content"
+
+
+def write_project(root, woofile):
+    root.mkdir()
+    (root / "Woofile").write_text(woofile)
+    (root / "main.woo").write_text(".Chapter Intro\n  label: intro\n\nText.\n")
+
+
+def hover(analyzer, root):
+    uri = (root / "main.woo").as_uri()
+    return analyzer.hover(TextDocumentPositionParams(TextDocumentIdentifier(uri), Position(0, 3)))
+
+
+def test_woofile_dialect_is_used_by_its_project_only(tmp_path):
+    custom_dialect = tmp_path / "custom.yaml"
+    custom_dialect.write_text(DIALECT_PATH.read_text().replace(DEFAULT_DESCRIPTION, "A chapter of the course"))
+    (tmp_path / "workspace").mkdir()
+    custom = tmp_path / "workspace" / "custom"
+    plain = tmp_path / "workspace" / "plain"
+    write_project(custom, "dialect: ../../custom.yaml\n")
+    write_project(plain, "")
+
+    analyzer = wuff.WooWooAnalyzer()
+    analyzer.set_dialect(str(DIALECT_PATH))
+    analyzer.load_workspace((tmp_path / "workspace").as_uri())
+    assert "A chapter of the course" in hover(analyzer, custom)
+    assert DEFAULT_DESCRIPTION in hover(analyzer, plain)
+
+    # the project goes back to the dialect of the client once its Woofile does not name one
+    (custom / "Woofile").write_text("")
+    analyzer.did_change_watched_files([FileEvent((custom / "Woofile").as_uri(), FileChangeType.Changed)])
+    assert DEFAULT_DESCRIPTION in hover(analyzer, custom)
+    assert DEFAULT_DESCRIPTION in hover(analyzer, plain)
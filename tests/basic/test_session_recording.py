@@ -0,0 +1,25 @@
+from pathlib import Path
+import wuff
+from wuff import TextDocumentIdentifier, TextDocumentPositionParams, Position
+
+
+def test_recording_writes_requests(tmp_path):
+    project = Path(__file__).parent.parent.resolve() / "files" / "test_project"
+    trace_path = tmp_path / "session.trace"
+
+    analyzer = wuff.WooWooAnalyzer()
+    analyzer.start_recording(str(trace_path))
+    analyzer.set_dialect(str(Path(__file__).parent.parent.resolve() / "files" / "fit_math.yaml"))
+    analyzer.load_workspace(project.as_uri())
+    document = TextDocumentIdentifier((project / "file1.woo").as_uri())
+    analyzer.hover(TextDocumentPositionParams(document, Position(0, 3)))
+    analyzer.hover_async(TextDocumentPositionParams(document, Position(0, 3))).result()
+    analyzer.stop_recording()
+    # not recorded anymore
+    analyzer.folding_ranges(document)
+
+    trace = trace_path.read_bytes()
+    assert trace.startswith(b"WUFFTRC\0")
+    assert trace.count(b"hover") == 2
+    assert b"load_workspace" in trace and b"set_dialect" in trace
+    assert b"folding_ranges" not in trace
@@ -0,0 +1,33 @@
+import json
+from pathlib import Path
+from wuff import TextDocumentIdentifier, TextDocumentPositionParams, Position
+
+
+def test_spans_exported_as_chrome_trace(analyzer, file1_uri, tmp_path):
+    document = TextDocumentIdentifier(file1_uri)
+    source = (Path(__file__).parent.parent / "files" / "test_project" / "file1.woo").read_text()
+
+    analyzer.start_span_tracing()
+    analyzer.hover(TextDocumentPositionParams(document, Position(0, 3)))
+    analyzer.document_did_change(document, source + "\n")
+    analyzer.document_did_change(document, source)
+    analyzer.stop_span_tracing()
+    # nothing is traced once the tracing stopped
+    analyzer.folding_ranges(document)
+
+    trace_path = tmp_path / "spans.json"
+    analyzer.write_span_trace(str(trace_path))
+    trace = json.loads(trace_path.read_text())
+    spans = [event for event in trace["traceEvents"] if event["ph"] == "X"]
+    names = {span["name"] for span in spans}
+    assert {"hover", "Hoverer::hover", "document_did_change", "parse_woowoo", "parse_metas", "index",
+            "query"} <= names
+    assert "folding_ranges" not in names
+
+    component = next(span for span in spans if span["name"] == "Hoverer::hover")
+    request = next(span for span in spans if span["name"] == "hover")
+    assert component["args"]["document"] == file1_uri
+    assert request["ts"] <= component["ts"] and component["dur"] <= request["dur"]
+    parse = next(span for span in spans if span["name"] == "parse_woowoo")
+    assert parse["args"]["bytes"] > 0
+    assert json.loads(analyzer.get_span_trace()) == trace
@@ -0,0 +1,20 @@
+from pathlib import Path
+from wuff import TextDocumentIdentifier, TextDocumentPositionParams, Position
+
+
+def test_request_and_stage_latencies(analyzer, file1_uri):
+    document = TextDocumentIdentifier(file1_uri)
+    source = (Path(__file__).parent.parent / "files" / "test_project" / "file1.woo").read_text()
+    analyzer.hover(TextDocumentPositionParams(document, Position(0, 3)))
+    analyzer.document_did_change(document, source + "\n")
+    analyzer.document_did_change(document, source)
+
+    timers = analyzer.get_stats()["timers"]
+    assert timers["hover"]["count"] >= 1
+    for stage in ("parse_woowoo", "parse_metas", "build_mappings", "index"):
+        assert timers[stage]["count"] >= 2
+        assert 0 <= timers[stage]["p50_ms"] <= timers[stage]["max_ms"]
+
+    text = analyzer.get_stats_prometheus()
+    assert 'wuff_duration_seconds_count{operation="hover"}' in text
+    assert 'wuff_events_total{event="noop_edit_skipped"}' in text
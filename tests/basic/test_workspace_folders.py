@@ -0,0 +1,36 @@
+from pathlib import Path
+import wuff
+
+
+def write_folder(root, label):
+    root.mkdir()
+    (root / "Woofile").write_text("")
+    (root / f"{label}.woo").write_text(f".Chapter {label}\n  label: {label}\n\nText.\n")
+
+
+def labels(analyzer, query):
+    return {symbol.name for symbol in analyzer.workspace_symbols(query)}
+
+
+def test_add_and_remove_workspace_folders(tmp_path):
+    write_folder(tmp_path / "first", "alpha")
+    write_folder(tmp_path / "second", "beta")
+
+    analyzer = wuff.WooWooAnalyzer()
+    analyzer.set_dialect(str(Path(__file__).parent.parent.resolve() / "files" / "fit_math.yaml"))
+    analyzer.load_workspace((tmp_path / "first").as_uri())
+    analyzer.load_workspace((tmp_path / "second").as_uri())
+    # loading a folder again does not load its documents twice
+    analyzer.load_workspace((tmp_path / "first").as_uri())
+
+    folders = analyzer.workspace_folders()
+    assert [uri.rstrip("/").rsplit("/", 1)[-1] for uri in folders] == ["first", "second"]
+    assert "alpha" in labels(analyzer, "alpha")
+    assert "beta" in labels(analyzer, "beta")
+    assert len(analyzer.memory_usage().documents) == 2
+
+    analyzer.remove_workspace_folder((tmp_path / "second").as_uri())
+    assert len(analyzer.workspace_folders()) == 1
+    assert "beta" not in labels(analyzer, "beta")
+    assert "alpha" in labels(analyzer, "alpha")
+    assert len(analyzer.memory_usage().documents) == 1
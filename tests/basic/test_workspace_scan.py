@@ -0,0 +1,20 @@
+def test_ignored_files_and_nested_projects(load_analyzer, included_paths, tmp_path):
+    files = {
+        "Woofile": "exclude:\n  - drafts/**\n",
+        ".gitignore": "node_modules/\n",
+        "a.woo": "\n",
+        "drafts/b.woo": "\n",
+        "node_modules/c.woo": "\n",
+        "nested/Woofile": "",
+        "nested/d.woo": "\n",
+    }
+    for name, content in files.items():
+        path = tmp_path / name
+        path.parent.mkdir(parents=True, exist_ok=True)
+        path.write_text(content)
+
+    analyzer = load_analyzer(tmp_path)
+
+    # excluded and ignored files are not loaded, the nested project owns its documents
+    assert included_paths(analyzer, (tmp_path / "a.woo").as_uri()) == {"a.woo"}
+    assert included_paths(analyzer, (tmp_path / "nested" / "d.woo").as_uri()) == {"d.woo"}
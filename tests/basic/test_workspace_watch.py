@@ -0,0 +1,22 @@
+def test_watch_reshapes_projects(load_analyzer, included_paths, wait_for, tmp_path):
+    (tmp_path / "Woofile").write_text("")
+    (tmp_path / "a.woo").write_text("\n")
+    (tmp_path / "nested").mkdir()
+    (tmp_path / "nested" / "d.woo").write_text("\n")
+
+    analyzer = load_analyzer(tmp_path)
+    analyzer.watch_workspace(batch_delay_ms=50)
+    a_uri = (tmp_path / "a.woo").as_uri()
+    assert included_paths(analyzer, a_uri) == {"a.woo", "nested/d.woo"}
+
+    # a document created outside of the client
+    (tmp_path / "b.woo").write_text("\n")
+    assert wait_for(lambda: included_paths(analyzer, a_uri) == {"a.woo", "b.woo", "nested/d.woo"})
+
+    # a new Woofile takes its documents over
+    (tmp_path / "nested" / "Woofile").write_text("")
+    assert wait_for(lambda: included_paths(analyzer, a_uri) == {"a.woo", "b.woo"})
+
+    (tmp_path / "b.woo").unlink()
+    assert wait_for(lambda: included_paths(analyzer, a_uri) == {"a.woo"})
+    analyzer.stop_watching_workspace()
@@ -23,3 +23,14 @@ def test_complete_nothing(analyzer, file1_uri):
     cp = create_completion_params(file1_uri, 0, 0)
     results = analyzer.complete(cp)
     assert len(results) == 0
+
+def test_complete_incomplete_refilters(analyzer, file1_uri):
+    # "ct2" is already typed after the ':', only the matching label is left
+    cp = CompletionParams(
+        TextDocumentIdentifier(file1_uri),
+        Position(4, 44),
+        CompletionContext(CompletionTriggerKind.TriggerForIncompleteCompletions, None)
+    )
+    results = analyzer.complete(cp)
+    assert [result.label for result in results] == ["ct2"]
+    assert not results.is_incomplete
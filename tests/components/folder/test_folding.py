@@ -1,4 +1,4 @@
-from wuff import TextDocumentIdentifier, FoldingRange
+from wuff import TextDocumentIdentifier, FoldingRange, Range, Position
 
 
 def get_folding_ranges(analyzer, uri):
@@ -23,3 +23,23 @@ def test_folding_ranges_in_populated_document(analyzer, file2_uri):
 def test_folding_ranges_in_empty_document(analyzer, empty_uri):
     ranges = get_folding_ranges(analyzer, empty_uri)
     assert len(ranges) == 0, "Expected no folding ranges in an empty document"
+
+
+def as_tuples(ranges):
+    return [(r.start_line, r.end_line, r.kind) for r in ranges]
+
+
+def test_folding_ranges_follow_incremental_change(analyzer, file2_uri):
+    tdi = TextDocumentIdentifier(file2_uri)
+    before = as_tuples(get_folding_ranges(analyzer, file2_uri))
+    comment = "% first\n% second\n"
+    analyzer.document_did_change_incremental(tdi, [(Range(Position(0, 0), Position(0, 0)), comment)])
+    try:
+        after = as_tuples(get_folding_ranges(analyzer, file2_uri))
+        # a run of comment lines is folded, the ranges after it are moved
+        assert after[0] == (0, 1, "comment")
+        assert after[1:] == [(start + 2, end + 2, kind) for start, end, kind in before]
+    finally:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(0, 0), Position(2, 0)), "")])
+
+    assert as_tuples(get_folding_ranges(analyzer, file2_uri)) == before
@@ -1,4 +1,9 @@
-from wuff import TextDocumentIdentifier
+import os
+
+from wuff import (
+    TextDocumentIdentifier, SemanticTokensRangeParams, SemanticTokensDeltaParams,
+    SemanticTokensDelta, Range, Position
+)
 
 
 def test_semantic_tokens(analyzer, file1_uri):
@@ -12,6 +17,86 @@ def test_semantic_tokens(analyzer, file1_uri):
         tokens) == total_integers, f"Expected {total_integers} integers representing {expected_token_count} tokens"
 
 
+def test_semantic_tokens_buffer(analyzer, file1_uri):
+    tokens = analyzer.semantic_tokens(TextDocumentIdentifier(file1_uri))
+    # the integers are not boxed, they can be forwarded as they are
+    assert isinstance(tokens, memoryview)
+    assert tokens.format == "I" and tokens.itemsize == 4
+    assert tokens.readonly
+    assert tokens.tolist() == list(tokens)
+
+
 def test_semantic_tokens_empty(analyzer, empty_uri):
     tokens = analyzer.semantic_tokens(TextDocumentIdentifier(empty_uri))
     assert len(tokens) == 0, "Expected no semantic tokens in an empty document"
+
+
+def decode_lines(tokens):
+    lines, line = [], 0
+    for i in range(0, len(tokens), 5):
+        line += tokens[i]
+        lines.append(line)
+    return lines
+
+
+def test_semantic_tokens_range(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    full_lines = decode_lines(analyzer.semantic_tokens(tdi))
+    params = SemanticTokensRangeParams(tdi, Range(Position(1, 0), Position(1, 100)))
+    range_lines = decode_lines(analyzer.semantic_tokens_range(params))
+    assert range_lines == [line for line in full_lines if line == 1]
+
+
+def test_semantic_tokens_range_ending_at_line_start(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    full_lines = decode_lines(analyzer.semantic_tokens(tdi))
+    # the end is exclusive, nothing of the line it ends at is requested
+    params = SemanticTokensRangeParams(tdi, Range(Position(1, 0), Position(2, 0)))
+    range_lines = decode_lines(analyzer.semantic_tokens_range(params))
+    assert range_lines == [line for line in full_lines if line == 1]
+
+
+def test_semantic_tokens_delta(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    full = analyzer.semantic_tokens_full(tdi)
+    assert full.data == analyzer.semantic_tokens(tdi)
+
+    delta = analyzer.semantic_tokens_delta(SemanticTokensDeltaParams(tdi, full.result_id))
+    assert isinstance(delta, SemanticTokensDelta)
+    assert delta.edits == []
+    assert delta.result_id != full.result_id
+
+    # an unknown previous result gets all tokens
+    unknown = analyzer.semantic_tokens_delta(SemanticTokensDeltaParams(tdi, "unknown"))
+    assert unknown.data == full.data
+
+
+def test_semantic_tokens_delta_forgotten_on_close(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    full = analyzer.semantic_tokens_full(tdi)
+    analyzer.close_document(tdi)
+    # the remembered result is dropped with the document, all tokens are sent again
+    delta = analyzer.semantic_tokens_delta(SemanticTokensDeltaParams(tdi, full.result_id))
+    assert not isinstance(delta, SemanticTokensDelta)
+    assert delta.data == full.data
+
+
+def test_semantic_tokens_after_incremental_change(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    with open(os.path.join(os.path.dirname(__file__), "..", "..", "files", "test_project", "file1.woo")) as f:
+        original = f.read()
+    before = analyzer.semantic_tokens(tdi)
+    inserted = "% a comment\n.include file2.woo\n"
+    try:
+        # only the inserted lines are collected again, the rest of the cached tokens is moved
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(3, 0), Position(3, 0)), inserted)])
+        incremental = analyzer.semantic_tokens(tdi)
+        assert len(incremental) > len(before)
+
+        lines = original.split("\n")
+        changed = "\n".join(lines[:3]) + "\n" + inserted + "\n".join(lines[3:])
+        analyzer.document_did_change(tdi, changed)
+        assert analyzer.semantic_tokens(tdi) == incremental
+    finally:
+        analyzer.document_did_change(tdi, original)
+    assert analyzer.semantic_tokens(tdi) == before
@@ -16,3 +16,15 @@ def test_hover_none(analyzer, file1_uri):
         TextDocumentIdentifier(file1_uri),
         Position(2, 3)))
     assert len(result) == 0, "Expected hover result to be empty"
+
+
+def test_hover_same_node_cached(analyzer, file1_uri):
+    document = TextDocumentIdentifier(file1_uri)
+    first = analyzer.hover(TextDocumentPositionParams(document, Position(0, 3)))
+    hits = analyzer.get_stats()["position_cache_hits"]
+    # another character of the same document part type
+    second = analyzer.hover(TextDocumentPositionParams(document, Position(0, 6)))
+    assert second == first
+    assert analyzer.get_stats()["position_cache_hits"] == hits + 1
+    # a position outside of the node is not answered by it
+    assert analyzer.hover(TextDocumentPositionParams(document, Position(2, 3))) == ""
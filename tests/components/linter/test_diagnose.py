@@ -1,4 +1,6 @@
-from wuff import TextDocumentIdentifier, Diagnostic, DiagnosticSeverity
+import os
+
+from wuff import TextDocumentIdentifier, Diagnostic, DiagnosticSeverity, Range, Position
 
 def diagnose_document(analyzer, uri):
     return analyzer.diagnose(TextDocumentIdentifier(uri))
@@ -17,3 +19,47 @@ def test_diagnose_errors_missing(analyzer, file3_uri):
     assert len(diagnostics) == 1, "Expected exactly 1 diagnostic for file with missing elements"
     assert diagnostics[0].severity == DiagnosticSeverity.Error, "Expected the diagnostic severity to be 'Error'"
     assert diagnostics[0].message == "Syntax error: MISSING short_inner_environment_body", "Expected specific syntax error message"
+
+def test_diagnose_after_incremental_change(analyzer, file3_uri):
+    tdi = TextDocumentIdentifier(file3_uri)
+    with open(os.path.join(os.path.dirname(__file__), "..", "..", "files", "test_project", "file3.woo")) as f:
+        original = f.read()
+    before = diagnose_document(analyzer, file3_uri)
+    try:
+        # the lines above the missing node are not part of it, its diagnostic is only moved
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(3, 0), Position(3, 0)), "\n\n")])
+        incremental = diagnose_document(analyzer, file3_uri)
+        assert len(incremental) == 1
+        assert incremental[0].range.start.line == before[0].range.start.line + 2
+
+        lines = original.split("\n")
+        analyzer.document_did_change(tdi, "\n".join(lines[:3]) + "\n\n\n" + "\n".join(lines[3:]))
+        full = diagnose_document(analyzer, file3_uri)
+        assert [(d.range.start.line, d.range.start.character, d.message) for d in full] == \
+               [(d.range.start.line, d.range.start.character, d.message) for d in incremental]
+    finally:
+        analyzer.document_did_change(tdi, original)
+    assert len(diagnose_document(analyzer, file3_uri)) == 1
+
+def test_diagnose_unresolved_reference(analyzer, file1_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    try:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(4, 41), Position(4, 44)), "nowhere")])
+        diagnostics = diagnose_document(analyzer, file1_uri)
+        assert [d.message for d in diagnostics] == ["Unresolved reference: nowhere"]
+        assert diagnostics[0].severity == DiagnosticSeverity.Warning
+        assert diagnostics[0].range.start.line == 4
+    finally:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(4, 41), Position(4, 48)), "ct2")])
+    assert len(diagnose_document(analyzer, file1_uri)) == 0
+
+def test_diagnose_duplicate_label(analyzer, file1_uri, file2_uri):
+    tdi = TextDocumentIdentifier(file1_uri)
+    try:
+        # ct2 is already defined in file2
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(1, 9), Position(1, 12)), "ct2")])
+        assert [d.message for d in diagnose_document(analyzer, file1_uri)] == ["Duplicate label: ct2"]
+        assert "Duplicate label: ct2" in [d.message for d in diagnose_document(analyzer, file2_uri)]
+    finally:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(1, 9), Position(1, 12)), "ct1")])
+    assert len(diagnose_document(analyzer, file1_uri)) == 0
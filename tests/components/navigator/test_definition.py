@@ -16,3 +16,13 @@ def test_navigate_to_definition(analyzer, file1_uri):
     assert "file2.woo" in definition.uri, "Expected 'file2.woo' in the definition URI"
     assert definition.range.start.line == 1, "Expected start line to be 1"
     assert definition.range.start.character == 9, "Expected start character to be 9"
+
+def test_definition_same_node_cached(analyzer, file1_uri):
+    first = get_definition(analyzer, file1_uri, 4, 43)
+    hits = analyzer.get_stats()["position_cache_hits"]
+    # another character of the same reference
+    second = get_definition(analyzer, file1_uri, 4, 40)
+    assert analyzer.get_stats()["position_cache_hits"] == hits + 1
+    assert second.uri == first.uri
+    assert second.range.start.line == first.range.start.line
+    assert second.range.start.character == first.range.start.character
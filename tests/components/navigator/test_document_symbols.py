@@ -0,0 +1,15 @@
+from wuff import TextDocumentIdentifier, SymbolKind
+
+
+def test_document_symbols_of_document_part(analyzer, file1_uri):
+    symbols = analyzer.document_symbols(TextDocumentIdentifier(file1_uri))
+    assert len(symbols) == 1, "Expected one top-level document part"
+    chapter = symbols[0]
+    assert chapter.kind == SymbolKind.Module
+    assert chapter.name.startswith("Chapter") and "Test1" in chapter.name
+    assert chapter.detail == "ct1", "Expected the label of the chapter as its detail"
+    assert chapter.range.start.line == 0
+
+
+def test_document_symbols_in_empty_document(analyzer, empty_uri):
+    assert len(analyzer.document_symbols(TextDocumentIdentifier(empty_uri))) == 0
@@ -1,4 +1,4 @@
-from wuff import ReferenceParams, TextDocumentIdentifier, Position, CompletionItem
+from wuff import ReferenceParams, TextDocumentIdentifier, Position, Range, CompletionItem
 
 def create_reference_params(uri, line, char, include_declaration):
     return ReferenceParams(TextDocumentIdentifier(uri), Position(line, char), include_declaration)
@@ -14,3 +14,37 @@ def test_find_references(analyzer, file2_uri):
 def test_find_references_include_declaration(analyzer, file2_uri):
     references = get_references(analyzer, file2_uri, 1, 11, True)
     assert len(references) == 4, "Expected to find 4 references including the declaration"
+
+def test_references_around_meta_block(analyzer, file2_uri):
+    # positions next to the meta block but outside of its fields must not fail
+    for line, char in [(0, 14), (1, 0), (1, 2), (2, 0), (3, 0)]:
+        get_references(analyzer, file2_uri, line, char, True)
+    assert len(get_references(analyzer, file2_uri, 1, 11, False)) == 3
+
+def test_references_in_chunks(analyzer, file2_uri):
+    params = create_reference_params(file2_uri, 1, 11, True)
+    search = analyzer.start_references(params)
+    chunks = []
+    while not search.done():
+        chunks.append(analyzer.next_references(search, 1))
+    assert all(chunks), "Every chunk has at least one location"
+    streamed = [(l.uri, l.range.start.line, l.range.start.character) for chunk in chunks for l in chunk]
+    expected = [(l.uri, l.range.start.line, l.range.start.character) for l in analyzer.references(params)]
+    assert sorted(streamed) == sorted(expected)
+
+def test_references_in_chunks_nothing_to_search(analyzer, file2_uri):
+    search = analyzer.start_references(create_reference_params(file2_uri, 4, 0, True))
+    assert search.done()
+    assert analyzer.next_references(search) == []
+
+def test_references_after_meta_block_edit(analyzer, file2_uri):
+    tdi = TextDocumentIdentifier(file2_uri)
+    # "label: ct2" becomes "label: ct2x", the YAML of the block is parsed again from its edited tree
+    analyzer.document_did_change_incremental(tdi, [(Range(Position(1, 12), Position(1, 12)), "x")])
+    try:
+        references = get_references(analyzer, file2_uri, 1, 11, True)
+        assert [(l.range.start.line, l.range.start.character, l.range.end.character) for l in references] == \
+               [(1, 9, 13)]
+    finally:
+        analyzer.document_did_change_incremental(tdi, [(Range(Position(1, 12), Position(1, 13)), "")])
+    assert len(get_references(analyzer, file2_uri, 1, 11, False)) == 3
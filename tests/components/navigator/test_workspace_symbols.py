@@ -0,0 +1,23 @@
+from wuff import SymbolKind
+
+
+def test_workspace_symbols_prefix(analyzer):
+    symbols = analyzer.workspace_symbols("ct")
+    names = [symbol.name for symbol in symbols]
+    assert {"ct1", "ct2", "ct3"} <= set(names), "Expected every label starting with 'ct'"
+
+
+def test_workspace_symbols_exact_first(analyzer):
+    symbols = analyzer.workspace_symbols("CT2")
+    assert symbols, "Expected a match of the label regardless of case"
+    assert symbols[0].name == "ct2"
+    assert symbols[0].kind == SymbolKind.Key
+    assert "file2.woo" in symbols[0].location.uri
+    assert symbols[0].location.range.start.line == 1
+    assert symbols[0].location.range.start.character == 9
+
+
+def test_workspace_symbols_fuzzy(analyzer):
+    names = [symbol.name for symbol in analyzer.workspace_symbols("c3")]
+    assert "ct3" in names, "Expected a fuzzy match of 'c3'"
+    assert not analyzer.workspace_symbols("no-such-label-anywhere")
@@ -1,25 +1,75 @@
 import os
+import re
+import time
 from pathlib import Path
 import pytest
 import wuff
+from wuff import CompletionContext, CompletionParams, CompletionTriggerKind, Position, TextDocumentIdentifier
+
+DIALECT_PATH = Path(__file__).parent.resolve() / "files" / "fit_math.yaml"
+TEST_PROJECT_PATH = Path(__file__).parent.resolve() / "files" / "test_project"
 
 
 @pytest.fixture(scope="session")
 def analyzer():
     analyzer = wuff.WooWooAnalyzer()
+    analyzer.set_dialect(str(DIALECT_PATH))
+    analyzer.load_workspace(f"file:///{TEST_PROJECT_PATH}".replace(os.sep, '/'))
+    yield analyzer
 
-    dialect_path = Path(__file__).parent.parent.resolve() / "tests" / "files" / "fit_math.yaml"
 
-    analyzer.set_dialect(str(dialect_path))
-    test_project_path = Path(__file__).parent.resolve() / "files" / "test_project"
-    test_project_uri = f"file:///{test_project_path}".replace(os.sep, '/')
-    analyzer.load_workspace(test_project_uri)
-    yield analyzer
+@pytest.fixture
+def load_analyzer():
+    """
+    Makes a separate analyzer with the test dialect and loads a workspace folder (the test project if none is given).
+    Settings which have to come before the load are given by the names of their setters,
+    e.g. load_analyzer(tmp_path, cache_directory=str(cache)) calls set_cache_directory.
+    """
+    def load(workspace=None, progressive=False, **settings):
+        analyzer = wuff.WooWooAnalyzer()
+        for name, value in settings.items():
+            getattr(analyzer, f"set_{name}")(value)
+        analyzer.set_dialect(str(DIALECT_PATH))
+        uri = workspace.as_uri() if workspace else f"file:///{TEST_PROJECT_PATH}".replace(os.sep, '/')
+        if progressive:
+            analyzer.load_workspace_progressive(uri)
+        else:
+            analyzer.load_workspace(uri)
+        return analyzer
+
+    return load
+
+
+
+@pytest.fixture(scope="session")
+def included_paths():
+    """
+    The paths a document can include (offered by the completion of an include statement), relative to its project:
+    the documents the project owns.
+    """
+    def paths(analyzer, uri):
+        params = CompletionParams(TextDocumentIdentifier(uri), Position(0, 0),
+                                  CompletionContext(CompletionTriggerKind.TriggerCharacter, "."))
+        items = analyzer.complete(params)
+        assert len(items) == 1
+        return set(re.search(r"\|(.*)\|", items[0].insertText).group(1).split(","))
+
+    return paths
+
+
+@pytest.fixture(scope="session")
+def wait_for():
+    """Polls the condition until it holds or the timeout (in seconds) runs out, returns whether it holds."""
+    def wait(condition, timeout=10):
+        deadline = time.time() + timeout
+        while not condition() and time.time() < deadline:
+            time.sleep(0.02)
+        return condition()
 
+    return wait
 
 def generate_woo_file_uri(filename):
-    test_project_path = Path(__file__).parent.resolve() / "files" / "test_project"
-    file_path = test_project_path / filename
+    file_path = TEST_PROJECT_PATH / filename
     file_uri = f"file:///{file_path}".replace(os.sep, '/')
     return file_uri
 